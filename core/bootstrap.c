@@ -76,7 +76,7 @@ int bootstrap_initiating_request(lwm2m_context_t * context)
             coap_set_header_uri_query(transaction->message, query);
             transaction->callback = prv_handleBootstrapReply;
             transaction->userData = (void *)context;
-            context->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(context->transactionList, transaction);
+            transaction_add(context, transaction);
             if (transaction_send(context, transaction) == 0)
             {
                 LOG("[BOOTSTRAP] DI bootstrap requested to BS server\r\n");
@@ -118,12 +118,12 @@ void bootstrap_failed(lwm2m_context_t * context)
 
 void reset_bootstrap_timer(lwm2m_context_t * context)
 {
-    context->bsStart = lwm2m_gettime();
+    context->bsStart = lwm2m_gettime_ms();
 }
 
 void update_bootstrap_state(lwm2m_context_t * context,
-        uint32_t currentTime,
-        time_t* timeoutP)
+        int64_t currentTime,
+        int64_t * timeoutP)
 {
     if (context->bsState == BOOTSTRAP_REQUESTED)
     {
@@ -139,7 +139,7 @@ void update_bootstrap_state(lwm2m_context_t * context,
         {
             // get ClientHoldOffTime from bootstrapServer->lifetime
             // (see objects.c => object_getServers())
-            int32_t timeToBootstrap = (context->bsStart + bootstrapServer->lifetime) - currentTime;
+            int64_t timeToBootstrap = (context->bsStart + (int64_t)bootstrapServer->lifetime * 1000) - currentTime;
             LOG("[BOOTSTRAP] ClientHoldOffTime %ld\r\n", (long)timeToBootstrap);
             if (0 >= timeToBootstrap)
             {
@@ -159,7 +159,7 @@ void update_bootstrap_state(lwm2m_context_t * context,
     {
         // Use COAP_DEFAULT_MAX_AGE according proposal in
         // https://github.com/OpenMobileAlliance/OMA-LwM2M-Public-Review/issues/35
-        int32_t timeToBootstrap = (context->bsStart + COAP_DEFAULT_MAX_AGE) - currentTime;
+        int64_t timeToBootstrap = (context->bsStart + COAP_DEFAULT_MAX_AGE * 1000) - currentTime;
         LOG("[BOOTSTRAP] Pending %ld\r\n", (long)timeToBootstrap);
         if (0 >= timeToBootstrap)
         {
@@ -169,7 +169,7 @@ void update_bootstrap_state(lwm2m_context_t * context,
             // 2) there are coherent configurations for provisioned DM servers
             // if these conditions are not met, then bootstrap has failed and previous security
             // and server object configurations might be restored by client
-            LOG("\r\n[BOOTSTRAP] Bootstrap finished at: %lu (difftime: %lu s)\r\n",
+            LOG("\r\n[BOOTSTRAP] Bootstrap finished at: %lu (difftime: %lu ms)\r\n",
                     (unsigned long)currentTime, (unsigned long)(currentTime - context->bsStart));
             context->bsState = BOOTSTRAP_FINISHED;
             context->bsStart = currentTime;
@@ -200,7 +200,7 @@ void update_bootstrap_state(lwm2m_context_t * context,
         {
             // get ClientHoldOffTime from bootstrapServer->lifetime
             // (see objects.c => object_getServers())
-            int32_t timeToBootstrap = (context->bsStart + bootstrapServer->lifetime) - currentTime;
+            int64_t timeToBootstrap = (context->bsStart + (int64_t)bootstrapServer->lifetime * 1000) - currentTime;
             LOG("[BOOTSTRAP] Bootstrap failed: %lu, now waiting during ClientHoldOffTime %ld ...\r\n",
                     (unsigned long)context->bsStart, (long)timeToBootstrap);
             if (0 >= timeToBootstrap)
@@ -344,7 +344,7 @@ int lwm2m_bootstrap_delete(lwm2m_context_t * contextP,
     transaction->callback = bs_result_callback;
     transaction->userData = (void *)dataP;
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
+    transaction_add(contextP, transaction);
 
     return transaction_send(contextP, transaction);
 }
@@ -386,7 +386,7 @@ int lwm2m_bootstrap_write(lwm2m_context_t * contextP,
     transaction->callback = bs_result_callback;
     transaction->userData = (void *)dataP;
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
+    transaction_add(contextP, transaction);
 
     return transaction_send(contextP, transaction);
 }
@@ -415,7 +415,7 @@ int lwm2m_bootstrap_finish(lwm2m_context_t * contextP,
     transaction->callback = bs_result_callback;
     transaction->userData = (void *)dataP;
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
+    transaction_add(contextP, transaction);
 
     return transaction_send(contextP, transaction);
 }
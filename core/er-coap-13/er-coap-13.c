@@ -63,10 +63,7 @@
 /*-----------------------------------------------------------------------------------*/
 /*- Variables -----------------------------------------------------------------------*/
 /*-----------------------------------------------------------------------------------*/
-static uint16_t current_mid = 0;
-
-coap_status_t coap_error_code = NO_ERROR;
-char *coap_error_message = "";
+/* No global state: packets are handled by several contexts at the same time. */
 /*-----------------------------------------------------------------------------------*/
 /*- LOCAL HELP FUNCTIONS ------------------------------------------------------------*/
 /*-----------------------------------------------------------------------------------*/
@@ -262,6 +259,7 @@ coap_add_multi_option(multi_option_t **dst, uint8_t *option, size_t option_len,
   if (opt)
   {
     opt->next = NULL;
+    opt->is_inline = 0;
     opt->len = option_len;
     if (is_static)
     {
@@ -296,19 +294,51 @@ coap_add_multi_option(multi_option_t **dst, uint8_t *option, size_t option_len,
   }
 }
 
+/* Adds an option pointing into the packet buffer, using the storage of the packet while available. */
+static
+void
+coap_add_option_view(coap_packet_t *coap_pkt, multi_option_t **dst, uint8_t *option, size_t option_len)
+{
+  multi_option_t *opt;
+
+  if (coap_pkt->option_view_count >= COAP_MAX_OPTION_VIEWS)
+  {
+    coap_add_multi_option(dst, option, option_len, 1);
+    return;
+  }
+
+  opt = coap_pkt->option_views + coap_pkt->option_view_count;
+  coap_pkt->option_view_count++;
+
+  opt->next = NULL;
+  opt->is_static = 1;
+  opt->is_inline = 1;
+  opt->len = option_len;
+  opt->data = option;
+
+  while (*dst)
+  {
+    dst = &((*dst)->next);
+  }
+  *dst = opt;
+}
+
 static
 void
 free_multi_option(multi_option_t *dst)
 {
-  if (dst)
+  while (dst)
   {
     multi_option_t *n = dst->next;
     if (dst->is_static == 0)
     {
         lwm2m_free(dst->data);
     }
-    lwm2m_free(dst);
-    free_multi_option(n);
+    if (dst->is_inline == 0)
+    {
+        lwm2m_free(dst);
+    }
+    dst = n;
   }
 }
 
@@ -380,12 +410,6 @@ coap_get_variable(const uint8_t *buffer, size_t length, const char *name, const
   return 0;
 }
 
-/*-----------------------------------------------------------------------------------*/
-uint16_t
-coap_get_mid()
-{
-  return ++current_mid;
-}
 /*-----------------------------------------------------------------------------------*/
 /*- MEASSAGE PROCESSING -------------------------------------------------------------*/
 /*-----------------------------------------------------------------------------------*/
@@ -491,7 +515,7 @@ coap_serialize_message(void *packet, uint8_t *buffer)
   {
     /* An error occured. Caller must check for !=0. */
     coap_pkt->buffer = NULL;
-    coap_error_message = "Serialized header exceeds COAP_MAX_HEADER_SIZE";
+    coap_pkt->error_message = "Serialized header exceeds COAP_MAX_HEADER_SIZE";
     return 0;
   }
 
@@ -511,6 +535,90 @@ coap_serialize_message(void *packet, uint8_t *buffer)
   return (option - buffer) + coap_pkt->payload_len; /* packet length */
 }
 /*-----------------------------------------------------------------------------------*/
+/*
+ * Notifications of the same content to several observers only differ by their header, token and
+ * Observe option, which come first in the message. coap_serialize_notification() serializes the
+ * options after Observe and the payload once, after COAP_NOTIFICATION_PREFIX_SIZE free bytes.
+ * coap_serialize_notification_prefix() then writes the differing part of each notification in
+ * these free bytes, right before the common part.
+ */
+size_t
+coap_serialize_notification(void *packet, uint8_t *buffer)
+{
+  coap_packet_t *const coap_pkt = (coap_packet_t *) packet;
+  uint8_t *option;
+  unsigned int current_number = COAP_OPTION_OBSERVE;
+
+  /* the options numbered below Observe would not be shared */
+  if (IS_OPTION(coap_pkt, COAP_OPTION_IF_MATCH)
+   || IS_OPTION(coap_pkt, COAP_OPTION_URI_HOST)
+   || IS_OPTION(coap_pkt, COAP_OPTION_ETAG)
+   || IS_OPTION(coap_pkt, COAP_OPTION_IF_NONE_MATCH))
+  {
+    coap_free_header(packet);
+    coap_pkt->error_message = "Option not allowed before Observe in a notification";
+    return 0;
+  }
+
+  coap_pkt->buffer = buffer;
+  option = buffer + COAP_NOTIFICATION_PREFIX_SIZE;
+
+  COAP_SERIALIZE_INT_OPTION(    COAP_OPTION_URI_PORT,       uri_port, "Uri-Port")
+  COAP_SERIALIZE_MULTI_OPTION(  COAP_OPTION_LOCATION_PATH,  location_path, "Location-Path")
+  COAP_SERIALIZE_MULTI_OPTION(  COAP_OPTION_URI_PATH,       uri_path, "Uri-Path")
+  COAP_SERIALIZE_INT_OPTION(    COAP_OPTION_CONTENT_TYPE,   content_type, "Content-Format")
+  COAP_SERIALIZE_INT_OPTION(    COAP_OPTION_MAX_AGE,        max_age, "Max-Age")
+  COAP_SERIALIZE_MULTI_OPTION(  COAP_OPTION_URI_QUERY,      uri_query, "Uri-Query")
+  COAP_SERIALIZE_ACCEPT_OPTION( COAP_OPTION_ACCEPT,         accept, "Accept")
+  COAP_SERIALIZE_STRING_OPTION( COAP_OPTION_LOCATION_QUERY, location_query, '&', "Location-Query")
+  COAP_SERIALIZE_BLOCK_OPTION(  COAP_OPTION_BLOCK2,         block2, "Block2")
+  COAP_SERIALIZE_BLOCK_OPTION(  COAP_OPTION_BLOCK1,         block1, "Block1")
+  COAP_SERIALIZE_INT_OPTION(    COAP_OPTION_SIZE,           size, "Size")
+  COAP_SERIALIZE_STRING_OPTION( COAP_OPTION_PROXY_URI,      proxy_uri, '\0', "Proxy-Uri")
+
+  coap_free_header(packet);
+
+  if ((option - coap_pkt->buffer) > COAP_MAX_HEADER_SIZE)
+  {
+    coap_pkt->buffer = NULL;
+    coap_pkt->error_message = "Serialized header exceeds COAP_MAX_HEADER_SIZE";
+    return 0;
+  }
+
+  if (coap_pkt->payload_len)
+  {
+    *option = 0xFF;
+    ++option;
+  }
+  memmove(option, coap_pkt->payload, coap_pkt->payload_len);
+
+  return (option - (buffer + COAP_NOTIFICATION_PREFIX_SIZE)) + coap_pkt->payload_len;
+}
+
+size_t
+coap_serialize_notification_prefix(uint8_t *buffer, coap_message_type_t type, uint8_t code, uint16_t mid, const uint8_t *token, size_t token_len, uint32_t observe)
+{
+  uint8_t prefix[COAP_NOTIFICATION_PREFIX_SIZE];
+  size_t length;
+
+  if (token_len > COAP_TOKEN_LEN) return 0;
+
+  prefix[0] = COAP_HEADER_VERSION_MASK & 1<<COAP_HEADER_VERSION_POSITION;
+  prefix[0] |= COAP_HEADER_TYPE_MASK & type<<COAP_HEADER_TYPE_POSITION;
+  prefix[0] |= COAP_HEADER_TOKEN_LEN_MASK & token_len<<COAP_HEADER_TOKEN_LEN_POSITION;
+  prefix[1] = code;
+  prefix[2] = (uint8_t) (mid>>8);
+  prefix[3] = (uint8_t) (mid);
+  memcpy(prefix + COAP_HEADER_LEN, token, token_len);
+  length = COAP_HEADER_LEN + token_len;
+  /* the Observe value is 24 bits long, as in coap_set_header_observe() */
+  length += coap_serialize_int_option(COAP_OPTION_OBSERVE, 0, prefix + length, 0x00FFFFFF & observe);
+
+  memcpy(buffer + COAP_NOTIFICATION_PREFIX_SIZE - length, prefix, length);
+
+  return length;
+}
+/*-----------------------------------------------------------------------------------*/
 coap_status_t
 coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
 {
@@ -531,7 +639,7 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
 
   if (coap_pkt->version != 1)
   {
-    coap_error_message = "CoAP version must be 1";
+    coap_pkt->error_message = "CoAP version must be 1";
     return BAD_REQUEST_4_00;
   }
 
@@ -666,18 +774,18 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
       case COAP_OPTION_URI_PATH:
         /* coap_merge_multi_option() operates in-place on the IPBUF, but final packet field should be const string -> cast to string */
         // coap_merge_multi_option( (char **) &(coap_pkt->uri_path), &(coap_pkt->uri_path_len), current_option, option_length, 0);
-        coap_add_multi_option( &(coap_pkt->uri_path), current_option, option_length, 1);
+        coap_add_option_view(coap_pkt, &(coap_pkt->uri_path), current_option, option_length);
         PRINTF("Uri-Path [%.*s]\n", sizeof(multi_option_t), coap_pkt->uri_path);
         break;
       case COAP_OPTION_URI_QUERY:
         /* coap_merge_multi_option() operates in-place on the IPBUF, but final packet field should be const string -> cast to string */
         // coap_merge_multi_option( (char **) &(coap_pkt->uri_query), &(coap_pkt->uri_query_len), current_option, option_length, '&');
-        coap_add_multi_option( &(coap_pkt->uri_query), current_option, option_length, 1);
+        coap_add_option_view(coap_pkt, &(coap_pkt->uri_query), current_option, option_length);
         PRINTF("Uri-Query [%.*s]\n", sizeof(multi_option_t), coap_pkt->uri_query);
         break;
 
       case COAP_OPTION_LOCATION_PATH:
-        coap_add_multi_option( &(coap_pkt->location_path), current_option, option_length, 1);
+        coap_add_option_view(coap_pkt, &(coap_pkt->location_path), current_option, option_length);
         break;
       case COAP_OPTION_LOCATION_QUERY:
         /* coap_merge_multi_option() operates in-place on the IPBUF, but final packet field should be const string -> cast to string */
@@ -691,7 +799,7 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
         coap_pkt->proxy_uri_len = option_length;
         /*TODO length > 270 not implemented (actually not required) */
         PRINTF("Proxy-Uri NOT IMPLEMENTED [%.*s]\n", coap_pkt->proxy_uri_len, coap_pkt->proxy_uri);
-        coap_error_message = "This is a constrained server (Contiki)";
+        coap_pkt->error_message = "This is a constrained server (Contiki)";
         return PROXYING_NOT_SUPPORTED_5_05;
         break;
 
@@ -724,7 +832,7 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
         /* Check if critical (odd) */
         if (option_number & 1)
         {
-          coap_error_message = "Unsupported critical option";
+          coap_pkt->error_message = "Unsupported critical option";
           return BAD_OPTION_4_02;
         }
     }
@@ -59,11 +59,15 @@
 #define COAP_DEFAULT_MAX_AGE                 60
 #define COAP_RESPONSE_TIMEOUT                2
 #define COAP_MAX_RETRANSMIT                  4
+#define COAP_ACK_RANDOM_FACTOR               150 /* percent */
+#define COAP_NSTART                          1
+#define COAP_PROBING_RATE                    1 /* bytes per second */
 
 #define COAP_HEADER_LEN                      4 /* | version:0x03 type:0x0C tkl:0xF0 | code | mid:0x00FF | mid:0xFF00 | */
 #define COAP_ETAG_LEN                        8 /* The maximum number of bytes for the ETag */
 #define COAP_TOKEN_LEN                       8 /* The maximum number of bytes for the Token */
 #define COAP_MAX_ACCEPT_NUM                  2 /* The maximum number of accept preferences to parse/store */
+#define COAP_MAX_OPTION_VIEWS                8 /* The number of Uri-Path, Uri-Query and Location-Path options parsed without allocation */
 
 #define COAP_HEADER_VERSION_MASK             0xC0
 #define COAP_HEADER_VERSION_POSITION         6
@@ -84,6 +88,9 @@
 #endif /* COAP_MAX_HEADER_SIZE */
 
 #define COAP_MAX_PACKET_SIZE  (COAP_MAX_HEADER_SIZE + REST_MAX_CHUNK_SIZE)
+
+/* Header, token and Observe option of a notification */
+#define COAP_NOTIFICATION_PREFIX_SIZE   (COAP_HEADER_LEN + COAP_TOKEN_LEN + 4)
 /*                                        0/14          48 for IPv6 (28 for IPv4) */
 #if COAP_MAX_PACKET_SIZE > (UIP_BUFSIZE - UIP_LLH_LEN - UIP_IPUDPH_LEN)
 //#error "UIP_CONF_BUFFER_SIZE too small for REST_MAX_CHUNK_SIZE"
@@ -202,7 +209,8 @@ typedef enum {
 
 typedef struct _multi_option_t {
   struct _multi_option_t *next;
-  uint8_t is_static;
+  uint8_t is_static;  /* data points into the packet buffer */
+  uint8_t is_inline;  /* the option is stored in coap_packet_t::option_views */
   uint8_t len;
   uint8_t *data;
 } multi_option_t;
@@ -253,6 +261,13 @@ typedef struct {
   uint16_t payload_len;
   uint8_t *payload;
 
+  /* the parsed multi options are views into the packet buffer stored here, so parsing does not allocate */
+  uint8_t option_view_count;
+  multi_option_t option_views[COAP_MAX_OPTION_VIEWS];
+
+  /* human-readable description of the last parsing or serialization error */
+  const char *error_message;
+
 } coap_packet_t;
 
 /* Option format serialization*/
@@ -311,13 +326,10 @@ typedef struct {
       current_number = number; \
     }
 
-/* To store error code and human-readable payload */
-extern char *coap_error_message;
-
-uint16_t coap_get_mid(void);
-
 void coap_init_message(void *packet, coap_message_type_t type, uint8_t code, uint16_t mid);
 size_t coap_serialize_message(void *packet, uint8_t *buffer);
+size_t coap_serialize_notification(void *packet, uint8_t *buffer);
+size_t coap_serialize_notification_prefix(uint8_t *buffer, coap_message_type_t type, uint8_t code, uint16_t mid, const uint8_t *token, size_t token_len, uint32_t observe);
 coap_status_t coap_parse_message(void *request, uint8_t *data, uint16_t data_len);
 void coap_free_header(void *packet);
 
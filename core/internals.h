@@ -101,6 +101,17 @@
 #define QUERY_VERSION_FULL      "lwm2m=1.0"
 #define QUERY_VERSION_FULL_LEN  9
 
+#define ATTR_MIN_PERIOD_STR     "pmin"
+#define ATTR_MIN_PERIOD_LEN     4
+#define ATTR_MAX_PERIOD_STR     "pmax"
+#define ATTR_MAX_PERIOD_LEN     4
+#define ATTR_GREATER_THAN_STR   "gt"
+#define ATTR_GREATER_THAN_LEN   2
+#define ATTR_LESS_THAN_STR      "lt"
+#define ATTR_LESS_THAN_LEN      2
+#define ATTR_STEP_STR           "st"
+#define ATTR_STEP_LEN           2
+
 #define LWM2M_URI_FLAG_DM           (uint8_t)0x00
 #define LWM2M_URI_FLAG_DELETE_ALL   (uint8_t)0x10
 #define LWM2M_URI_FLAG_REGISTRATION (uint8_t)0x20
@@ -126,19 +137,14 @@ typedef struct
 } bs_data_t;
 #endif
 
-typedef struct _obs_list_
-{
-    struct _obs_list_ * next;
-    lwm2m_observed_t * item;
-} obs_list_t;
-
 
 // defined in uri.c
 int lwm2m_get_number(char * uriString, size_t uriLength);
-lwm2m_uri_t * lwm2m_decode_uri(char * altPath, multi_option_t *uriPath);
+lwm2m_uri_t * lwm2m_decode_uri(char * altPath, multi_option_t *uriPath, lwm2m_uri_t * uriP);
 int prv_get_number(uint8_t * uriString, size_t uriLength);
 
 // defined in objects.c
+coap_status_t object_readData(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, int * sizeP, lwm2m_data_t ** dataP);
 coap_status_t object_read(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_media_type_t * formatP, uint8_t ** bufferP, size_t * lengthP);
 coap_status_t object_write(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_media_type_t format, uint8_t * buffer, size_t length);
 coap_status_t object_create(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_media_type_t format, uint8_t * buffer, size_t length);
@@ -149,26 +155,40 @@ int prv_getRegisterPayload(lwm2m_context_t * contextP, uint8_t * buffer, size_t
 int object_getServers(lwm2m_context_t * contextP);
 
 // defined in transaction.c
+int transaction_init(lwm2m_context_t * contextP);
 lwm2m_transaction_t * transaction_new(coap_message_type_t type, coap_method_t method, char * altPath, lwm2m_uri_t * uriP, uint16_t mID, uint8_t token_len, uint8_t* token, lwm2m_endpoint_type_t peerType, void * peerP);
 
 int transaction_send(lwm2m_context_t * contextP, lwm2m_transaction_t * transacP);
 void transaction_free(lwm2m_transaction_t * transacP);
+void transaction_add(lwm2m_context_t * contextP, lwm2m_transaction_t * transacP);
 void transaction_remove(lwm2m_context_t * contextP, lwm2m_transaction_t * transacP);
+void transaction_remove_peer(lwm2m_context_t * contextP, lwm2m_peer_queue_t * queueP);
+void transaction_set_congestion(lwm2m_context_t * contextP, lwm2m_peer_queue_t * queueP, uint8_t nstart, uint16_t probingRate);
 bool transaction_handle_response(lwm2m_context_t * contextP, void * fromSessionH, coap_packet_t * message, coap_packet_t * response);
+void transaction_step(lwm2m_context_t * contextP, int64_t currentTime, int64_t * timeoutP);
 
 // defined in management.c
 coap_status_t handle_dm_request(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, void * fromSessionH, coap_packet_t * message, coap_packet_t * response);
 coap_status_t handle_delete_all(lwm2m_context_t * context);
 
 // defined in observe.c
-coap_status_t handle_observe_request(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_server_t * serverP, coap_packet_t * message, coap_packet_t * response);
+coap_status_t handle_observe_request(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_server_t * serverP, coap_packet_t * message, coap_packet_t * response, lwm2m_media_type_t format, uint8_t * buffer, size_t length);
 void cancel_observe(lwm2m_context_t * contextP, uint16_t mid, void * fromSessionH);
+void observe_remove_server(lwm2m_context_t * contextP, lwm2m_server_t * serverP);
+void observe_flush_server(lwm2m_context_t * contextP, lwm2m_server_t * serverP);
+void observe_clear_server(lwm2m_server_t * serverP);
+coap_status_t handle_write_attributes(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_server_t * serverP, multi_option_t * query);
+void observe_step(lwm2m_context_t * contextP, int64_t currentTime, int64_t * timeoutP);
 
 // defined in registration.c
 coap_status_t handle_registration_request(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, void * fromSessionH, coap_packet_t * message, coap_packet_t * response);
 void registration_deregister(lwm2m_context_t * contextP, lwm2m_server_t * serverP);
 void prv_freeClient(lwm2m_client_t * clientP);
-void registration_update(lwm2m_context_t * contextP, time_t currentTime, time_t * timeoutP);
+lwm2m_client_t * registration_find_client(lwm2m_context_t * contextP, uint16_t clientID);
+int registration_restore_client(lwm2m_context_t * contextP, lwm2m_client_t * clientP);
+void registration_remove_client(lwm2m_context_t * contextP, lwm2m_client_t * clientP);
+void registration_free_clients(lwm2m_context_t * contextP);
+void registration_update(lwm2m_context_t * contextP, int64_t currentTime, int64_t * timeoutP);
 
 // defined in packet.c
 coap_status_t message_send(lwm2m_context_t * contextP, coap_packet_t * message, void * sessionH);
@@ -176,16 +196,23 @@ coap_status_t message_send(lwm2m_context_t * contextP, coap_packet_t * message,
 // defined in observe.c
 bool handle_observe_notify(lwm2m_context_t * contextP, void * fromSessionH, coap_packet_t * message, coap_packet_t * response);
 void observation_remove(lwm2m_client_t * clientP, lwm2m_observation_t * observationP);
+int observation_restore(lwm2m_context_t * contextP, lwm2m_observation_t * observationP);
+void observe_batch_step(lwm2m_context_t * contextP, int64_t currentTime, int64_t * timeoutP);
+void observe_batch_free(lwm2m_context_t * contextP);
 
 // defined in bootstrap.c
 void handle_bootstrap_response(lwm2m_context_t * context, coap_packet_t * message, void * fromSessionH);
 void bootstrap_failed(lwm2m_context_t * context);
 void reset_bootstrap_timer(lwm2m_context_t * context);
-void update_bootstrap_state(lwm2m_context_t * contextP, uint32_t currentTime, time_t* timeoutP);
+void update_bootstrap_state(lwm2m_context_t * contextP, int64_t currentTime, int64_t * timeoutP);
 void delete_bootstrap_server_list(lwm2m_context_t * contextP);
 uint8_t handle_bootstrap_request(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, void * fromSessionH, coap_packet_t * message, coap_packet_t * response);
 coap_status_t handle_bootstrap_finish(lwm2m_context_t * context, void * fromSessionH);
 
+// defined in tlv.c
+// Same as lwm2m_data_parse() with the URI the payload applies to, if known.
+int data_parse(lwm2m_uri_t * uriP, uint8_t * buffer, size_t bufferLen, lwm2m_media_type_t format, lwm2m_data_t ** dataP);
+
 // defined in liblwm2m.c
 void delete_transaction_list(lwm2m_context_t * context);
 void delete_server_list(lwm2m_context_t * context);
@@ -193,13 +220,38 @@ void delete_observed_list(lwm2m_context_t * contextP);
 
 // defined in json.c
 #ifdef LWM2M_SUPPORT_JSON
-int lwm2m_json_parse(uint8_t * buffer, size_t bufferLen, lwm2m_data_t ** dataP);
+// Names are relative to uriP or, when absolute, must start with it. Without uriP, an absolute "bn" is
+// used instead and relative names start at the resource level.
+int lwm2m_json_parse(lwm2m_uri_t * uriP, uint8_t * buffer, size_t bufferLen, lwm2m_data_t ** dataP);
 int lwm2m_json_serialize(int size, lwm2m_data_t * tlvP, uint8_t ** bufferP);
+// Called with each chunk of the document written by lwm2m_json_serialize_chunks(). Returns 0 to go on.
+typedef int (*lwm2m_json_chunk_callback_t)(uint8_t * chunk, size_t length, void * userData);
+// Writes the document in chunk and gives it to callback each time it is full, then once with the rest.
+// Returns the total length of the document or 0 in case of error.
+int lwm2m_json_serialize_chunks(int size, lwm2m_data_t * tlvP, uint8_t * chunk, size_t chunkSize, lwm2m_json_chunk_callback_t callback, void * userData);
 #endif
 
 // defined in utils.c
 lwm2m_binding_t lwm2m_stringToBinding(uint8_t *buffer, size_t length);
+// Write the value as text in string without any terminating null. Return the length written or 0 if string is too short.
+size_t utils_intToText(int64_t data, uint8_t * string, size_t length);
+size_t utils_floatToText(double data, uint8_t * string, size_t length);
 int prv_isAltPathValid(const char * altPath);
+size_t utils_hash(const uint8_t * buffer, size_t length);
+// Timer heap of the items holding an int64_t date at timeOffset and a size_t index at indexOffset.
+void utils_heapInit(lwm2m_heap_t * heapP, size_t timeOffset, size_t indexOffset);
+void utils_heapFree(lwm2m_heap_t * heapP);
+// Make room for one more item in advance so that utils_heapSchedule() cannot fail for it.
+int utils_heapReserve(lwm2m_heap_t * heapP);
+void utils_heapRelease(lwm2m_heap_t * heapP);
+// Insert the item or move it after its date changed.
+int utils_heapSchedule(lwm2m_heap_t * heapP, void * itemP);
+void utils_heapUnschedule(lwm2m_heap_t * heapP, void * itemP);
+// The item with the earliest date, NULL when the heap is empty.
+void * utils_heapTop(lwm2m_heap_t * heapP);
+// Seed once per context, then return 32 random bits from the context's own generator.
+void utils_randomSeed(lwm2m_context_t * contextP);
+uint32_t utils_random(lwm2m_context_t * contextP);
 #ifdef LWM2M_CLIENT_MODE
 lwm2m_server_t * prv_findServer(lwm2m_context_t * contextP, void * fromSessionH);
 lwm2m_server_t * utils_findBootstrapServer(lwm2m_context_t * contextP, void * fromSessionH);
@@ -24,81 +24,57 @@
 
 #ifdef LWM2M_SUPPORT_JSON
 
-#define PRV_JSON_BUFFER_SIZE 1024
-
-#define JSON_MIN_ARRAY_LEN      21      // e":[{"n":"N","v":X}]}
-#define JSON_MIN_BASE_LEN        7      // n":"N",
-#define JSON_ITEM_MAX_SIZE      36      // with ten characters for value
+#define PRV_JSON_MAX_LEVEL      3       // object instance, multiple resource, resource instance
+#define PRV_JSON_MAX_PATH       4       // object, object instance, resource, resource instance
+#define PRV_JSON_NAME_MAX_LEN   24      // /65535/65535/65535/65535
 
 #define JSON_FALSE_STRING  "false"
 #define JSON_TRUE_STRING   "true"
 
-#define JSON_RES_ITEM_TEMPLATE      "{\"n\":\"%d\","
-#define JSON_INST_ITEM_TEMPLATE     "{\"n\":\"%d/%d\","
-#define JSON_ITEM_BOOL_TRUE         "\"bv\":true},"
-#define JSON_ITEM_BOOL_FALSE        "\"bv\":false},"
-#define JSON_ITEM_FLOAT_TEMPLATE    "\"v\":%.16g},"
-#define JSON_ITEM_INTEGER_TEMPLATE  "\"v\":%"PRId64"},"
-#define JSON_ITEM_STRING_BEGIN      "\"sv\":\""
-#define JSON_ITEM_STRING_END        "\"},"
-
-#define JSON_HEADER             "{\"e\":["
-#define JSON_FOOTER             "]}"
-#define JSON_HEADER_SIZE        6
-#define JSON_FOOTER_SIZE        2
-
-
-#define _GO_TO_NEXT_CHAR(I,B,L)         \
-    {                                   \
-        I++;                            \
-        I += prv_skipSpace(B+I, L-I);   \
-        if (I == L) return -1;    \
-    }
-
-typedef enum
-{
-    _STEP_START,
-    _STEP_TOKEN,
-    _STEP_ANY_SEPARATOR,
-    _STEP_SEPARATOR,
-    _STEP_QUOTED_VALUE,
-    _STEP_VALUE,
-    _STEP_DONE
-} _itemState;
+/*
+ * The document is read in a single pass into an array of records pointing in the buffer. The
+ * names are then resolved against "bn" and the request URI, the records are sorted by name and
+ * the tree is built in a single allocation holding the lwm2m_data_t and the unescaped strings.
+ * Numbers are left as text in the buffer.
+ */
 
 typedef enum
 {
     _TYPE_UNSET,
     _TYPE_FALSE,
     _TYPE_TRUE,
+    _TYPE_INTEGER,
     _TYPE_FLOAT,
-    _TYPE_STRING
+    _TYPE_STRING,
+    _TYPE_LINK
 } _type;
 
 typedef struct
 {
-    uint16_t    resId;
-    uint16_t    resInstId;
+    uint8_t *   name;
+    size_t      nameLen;
+    uint16_t    ids[PRV_JSON_MAX_LEVEL];
+    int         idCount;
     _type       type;
-    uint8_t *      value;
+    bool        escaped;
+    uint8_t *   value;
     size_t      valueLen;
+    double      time;
+    int         index;      // in the document, the last one wins between records of the same time
 } _record_t;
 
-static int prv_isReserved(char sign)
+typedef struct
 {
-    if (sign == '['
-     || sign == '{'
-     || sign == ']'
-     || sign == '}'
-     || sign == ':'
-     || sign == ','
-     || sign == '"')
-    {
-        return 1;
-    }
+    uint8_t *   baseName;
+    size_t      baseNameLen;
+    double      baseTime;
+    _record_t * recordArray;
+    int         count;
+    int         size;       // of recordArray
+    size_t      extraLen;   // bytes needed for the unescaped strings and the object links
+} _document_t;
 
-    return 0;
-}
+static const uint8_t prv_boolText[] = "01";
 
 static int prv_isWhiteSpace(uint8_t sign)
 {
@@ -114,580 +90,1038 @@ static int prv_isWhiteSpace(uint8_t sign)
 }
 
 static size_t prv_skipSpace(uint8_t * buffer,
-                            size_t bufferLen)
+                            size_t bufferLen,
+                            size_t index)
 {
-    size_t i;
-
-    i = 0;
-    while ((i < bufferLen)
-        && prv_isWhiteSpace(buffer[i]))
+    while ((index < bufferLen)
+        && prv_isWhiteSpace(buffer[index]))
     {
-        i++;
+        index++;
     }
 
-    return i;
+    return index;
 }
 
-static int prv_split(uint8_t * buffer,
-                     size_t bufferLen,
-                     int * tokenStartP,
-                     int * tokenLenP,
-                     int * valueStartP,
-                     int * valueLenP)
+static int prv_hexValue(uint8_t sign)
 {
-    size_t index;
-    _itemState step;
+    if ('0' <= sign && sign <= '9') return sign - '0';
+    if ('a' <= sign && sign <= 'f') return sign - 'a' + 10;
+    if ('A' <= sign && sign <= 'F') return sign - 'A' + 10;
+    return -1;
+}
 
-    index = 0;
-    step = _STEP_START;
+static int prv_isDigit(uint8_t sign)
+{
+    return ('0' <= sign && sign <= '9');
+}
 
-    index = prv_skipSpace(buffer + index, bufferLen - index);
-    if (index == bufferLen) return -1;
+// Reads the string starting with the quote at buffer[*indexP]. On success, *indexP is moved after
+// the closing quote and the content is returned without the quotes.
+static int prv_readString(uint8_t * buffer,
+                          size_t bufferLen,
+                          size_t * indexP,
+                          uint8_t ** stringP,
+                          size_t * lengthP,
+                          bool * escapedP)
+{
+    size_t index;
+    size_t start;
 
-    while ((index < bufferLen)
-        && (buffer[index] != ','))
+    index = *indexP;
+    if (index >= bufferLen || buffer[index] != '"') return -1;
+    index++;
+    start = index;
+    *escapedP = false;
+
+    while (1)
     {
-        switch (step)
+        while (index < bufferLen
+            && buffer[index] != '"'
+            && buffer[index] != '\\'
+            && buffer[index] >= 0x20)
         {
-        case _STEP_START:
-            if (buffer[index] != '"') return -1;
-            *tokenStartP = index+1;
-            step = _STEP_TOKEN;
-            break;
-
-        case _STEP_TOKEN:
-            if (buffer[index] == '"')
-            {
-                *tokenLenP = index - *tokenStartP;
-                step = _STEP_ANY_SEPARATOR;
-            }
-            break;
-
-        case _STEP_ANY_SEPARATOR:
-            if (buffer[index] != ':') return -1;
-            step = _STEP_SEPARATOR;
-            break;
+            index++;
+        }
+        if (index >= bufferLen || buffer[index] < 0x20) return -1;
+        if (buffer[index] == '"') break;
 
-        case _STEP_SEPARATOR:
-            if (buffer[index] == '"')
-            {
-                *valueStartP = index;
-                step = _STEP_QUOTED_VALUE;
-            } else if (!prv_isReserved(buffer[index]))
-            {
-                *valueStartP = index;
-                step = _STEP_VALUE;
-            } else
-            {
-                return -1;
-            }
+        *escapedP = true;
+        index++;
+        if (index >= bufferLen) return -1;
+        switch (buffer[index])
+        {
+        case '"':
+        case '\\':
+        case '/':
+        case 'b':
+        case 'f':
+        case 'n':
+        case 'r':
+        case 't':
+            index++;
             break;
 
-        case _STEP_QUOTED_VALUE:
-            if (buffer[index] == '"' && buffer[index-1] != '\\' )
-            {
-                *valueLenP = index - *valueStartP + 1;
-                step = _STEP_DONE;
-            }
-            break;
+        case 'u':
+        {
+            int i;
 
-        case _STEP_VALUE:
-            if (prv_isWhiteSpace(buffer[index]))
+            if (bufferLen - index <= 4) return -1;
+            for (i = 1 ; i <= 4 ; i++)
             {
-                *valueLenP = index - *valueStartP;
-                step = _STEP_DONE;
+                if (prv_hexValue(buffer[index + i]) < 0) return -1;
             }
+            index += 5;
+        }
             break;
 
-        case _STEP_DONE:
         default:
             return -1;
         }
+    }
+
+    *stringP = buffer + start;
+    *lengthP = index - start;
+    *indexP = index + 1;
+
+    return 0;
+}
 
+// Reads the number starting at buffer[*indexP] as defined by the JSON grammar.
+static int prv_readNumber(uint8_t * buffer,
+                          size_t bufferLen,
+                          size_t * indexP,
+                          _type * typeP)
+{
+    size_t index;
+
+    index = *indexP;
+    *typeP = _TYPE_INTEGER;
+
+    if (index < bufferLen && buffer[index] == '-') index++;
+    if (index >= bufferLen) return -1;
+    if (buffer[index] == '0')
+    {
         index++;
-        if (step == _STEP_START
-         || step == _STEP_ANY_SEPARATOR
-         || step == _STEP_SEPARATOR
-         || step == _STEP_DONE)
-        {
-            index += prv_skipSpace(buffer + index, bufferLen - index);
-        }
     }
-
-    if (step == _STEP_VALUE)
+    else if (prv_isDigit(buffer[index]))
+    {
+        while (index < bufferLen && prv_isDigit(buffer[index])) index++;
+    }
+    else
+    {
+        return -1;
+    }
+    if (index < bufferLen && buffer[index] == '.')
+    {
+        *typeP = _TYPE_FLOAT;
+        index++;
+        if (index >= bufferLen || !prv_isDigit(buffer[index])) return -1;
+        while (index < bufferLen && prv_isDigit(buffer[index])) index++;
+    }
+    if (index < bufferLen && (buffer[index] == 'e' || buffer[index] == 'E'))
     {
-        *valueLenP = index - *valueStartP;
-        step = _STEP_DONE;
+        *typeP = _TYPE_FLOAT;
+        index++;
+        if (index < bufferLen && (buffer[index] == '+' || buffer[index] == '-')) index++;
+        if (index >= bufferLen || !prv_isDigit(buffer[index])) return -1;
+        while (index < bufferLen && prv_isDigit(buffer[index])) index++;
     }
 
-    if (step != _STEP_DONE) return -1;
+    *indexP = index;
 
-    return (int)index;
+    return 0;
 }
 
-static int prv_countItems(uint8_t * buffer,
-                          size_t bufferLen)
+static int prv_readTime(uint8_t * buffer,
+                        size_t bufferLen,
+                        size_t * indexP,
+                        double * timeP)
 {
-    int count;
+    size_t start;
+    _type type;
+
+    start = *indexP;
+    if (0 != prv_readNumber(buffer, bufferLen, indexP, &type)) return -1;
+    if (0 == lwm2m_PlainTextToFloat64(buffer + start, *indexP - start, timeP)) return -1;
+
+    return 0;
+}
+
+// Reads "objectId:instanceId".
+static int prv_readLink(uint8_t * buffer,
+                        size_t length,
+                        uint16_t * objectIdP,
+                        uint16_t * instanceIdP)
+{
+    uint32_t ids[2];
     size_t index;
-    int in;
+    int i;
 
-    count = 0;
     index = 0;
-    in = 0;
-
-    while (index < bufferLen)
+    for (i = 0 ; i < 2 ; i++)
     {
-        if (in == 0)
+        size_t start;
+
+        if (i == 1)
         {
-            if (buffer[index] != '{') return -1;
-            in = 1;
-            _GO_TO_NEXT_CHAR(index, buffer, bufferLen);
+            if (index >= length || buffer[index] != ':') return -1;
+            index++;
         }
-        else
+        start = index;
+        ids[i] = 0;
+        while (index < length && prv_isDigit(buffer[index]))
         {
-            if (buffer[index] == '{') return -1;
-            if (buffer[index] == '}')
-            {
-                in = 0;
-                count++;
-                _GO_TO_NEXT_CHAR(index, buffer, bufferLen);
-                if (buffer[index] == ']')
-                {
-                    break;
-                }
-                if (buffer[index] != ',') return -1;
-                _GO_TO_NEXT_CHAR(index, buffer, bufferLen);
-            }
-            else
-            {
-                _GO_TO_NEXT_CHAR(index, buffer, bufferLen);
-            }
+            ids[i] = ids[i] * 10 + (buffer[index] - '0');
+            if (ids[i] > LWM2M_MAX_ID) return -1;
+            index++;
         }
+        if (index == start) return -1;
     }
-    if (in == 1) return -1;
+    if (index != length) return -1;
+
+    *objectIdP = (uint16_t)ids[0];
+    *instanceIdP = (uint16_t)ids[1];
 
-    return count;
+    return 0;
 }
 
-static int prv_parseItem(uint8_t * buffer,
-                         size_t bufferLen,
-                         _record_t * recordP)
+static bool prv_isKey(uint8_t * key,
+                      size_t keyLen,
+                      const char * name)
+{
+    size_t nameLen;
+
+    nameLen = strlen(name);
+
+    return (keyLen == nameLen && 0 == memcmp(key, name, nameLen));
+}
+
+static int prv_readRecord(uint8_t * buffer,
+                          size_t bufferLen,
+                          size_t * indexP,
+                          _record_t * recordP,
+                          size_t * extraLenP)
 {
     size_t index;
+    bool nameFound = false;
+    bool timeFound = false;
+
+    index = *indexP;
+    if (index >= bufferLen || buffer[index] != '{') return -1;
+    index = prv_skipSpace(buffer, bufferLen, index + 1);
 
-    recordP->resId = LWM2M_MAX_ID;
-    recordP->resInstId = LWM2M_MAX_ID;
+    recordP->name = NULL;
+    recordP->nameLen = 0;
     recordP->type = _TYPE_UNSET;
-    recordP->value = NULL;
-    recordP->valueLen = 0;
+    recordP->escaped = false;
+    recordP->time = 0;
 
-    index = 0;
-    do
+    while (1)
     {
-        int tokenStart;
-        int tokenLen;
-        int valueStart;
-        int valueLen;
-        int next;
-
-        next = prv_split(buffer+index, bufferLen-index, &tokenStart, &tokenLen, &valueStart, &valueLen);
-        if (next < 0) return -1;
-
-        switch (tokenLen)
+        uint8_t * key;
+        size_t keyLen;
+        bool escaped;
+
+        if (0 != prv_readString(buffer, bufferLen, &index, &key, &keyLen, &escaped)) return -1;
+        if (escaped) return -1;
+        index = prv_skipSpace(buffer, bufferLen, index);
+        if (index >= bufferLen || buffer[index] != ':') return -1;
+        index = prv_skipSpace(buffer, bufferLen, index + 1);
+        if (index >= bufferLen) return -1;
+
+        if (prv_isKey(key, keyLen, "n"))
         {
-        case 1:
+            if (nameFound) return -1;
+            nameFound = true;
+            if (0 != prv_readString(buffer, bufferLen, &index, &recordP->name, &recordP->nameLen, &escaped)) return -1;
+            if (escaped) return -1;
+        }
+        else if (prv_isKey(key, keyLen, "t"))
         {
-            switch (buffer[index+tokenStart])
-            {
-            case 'n':
-            {
-                int i;
-                uint32_t readId;
-
-                if (recordP->resId != LWM2M_MAX_ID) return -1;
-
-                // Check for " around URI
-                if (valueLen < 3
-                 || buffer[index+valueStart] != '"'
-                 || buffer[index+valueStart+valueLen-1] != '"')
-                {
-                    return -1;
-                }
-                i = 1;
-                readId = 0;
-                while (i < valueLen-1 && buffer[index+valueStart+i] != '/')
-                {
-                    if (buffer[index+valueStart+i] < '0'
-                     || buffer[index+valueStart+i] > '9')
-                    {
-                        return -1;
-                    }
-                    readId *= 10;
-                    readId += buffer[index+valueStart+i] - '0';
-                    if (readId > LWM2M_MAX_ID) return -1;
-                    i++;
-                }
-                recordP->resId = readId;
-                if (buffer[index+valueStart+i] == '/')
-                {
-                    int j;
-
-                    if (i == valueLen-1) return -1;
-
-                    j = 1;
-                    readId = 0;
-                    while (i+j < valueLen-1)
-                    {
-                        if (buffer[index+valueStart+i+j] < '0'
-                         || buffer[index+valueStart+i+j] > '9')
-                        {
-                            return -1;
-                        }
-                        readId *= 10;
-                        readId += buffer[index+valueStart+i+j] - '0';
-                        if (readId > LWM2M_MAX_ID) return -1;
-                        i++;
-                    }
-                    recordP->resInstId = readId;
-                }
-                // TODO: support more URIs than just res and res/instance
-            }
-            break;
-
-            case 'v':
-                if (recordP->type != _TYPE_UNSET) return -1;
-                recordP->type = _TYPE_FLOAT;
-                recordP->value = buffer + index + valueStart;
-                recordP->valueLen = valueLen;
-                break;
-
-            case 't':
-                // TODO: support time
-                break;
-
-            default:
-                return -1;
-            }
+            if (timeFound) return -1;
+            timeFound = true;
+            if (0 != prv_readTime(buffer, bufferLen, &index, &recordP->time)) return -1;
         }
-        break;
-
-        case 2:
+        else
         {
-            // "bv", "ov", or "sv"
-            if (buffer[index+tokenStart+1] != 'v') return -1;
-            switch (buffer[index+tokenStart])
+            if (recordP->type != _TYPE_UNSET) return -1;
+            if (prv_isKey(key, keyLen, "v"))
+            {
+                recordP->value = buffer + index;
+                if (0 != prv_readNumber(buffer, bufferLen, &index, &recordP->type)) return -1;
+                recordP->valueLen = buffer + index - recordP->value;
+            }
+            else if (prv_isKey(key, keyLen, "bv"))
             {
-            case 'b':
-                if (recordP->type != _TYPE_UNSET) return -1;
-                if (0 == lwm2m_strncmp(JSON_TRUE_STRING, (char *)buffer + index + valueStart, valueLen))
+                if (bufferLen - index >= sizeof(JSON_TRUE_STRING) - 1
+                 && 0 == memcmp(buffer + index, JSON_TRUE_STRING, sizeof(JSON_TRUE_STRING) - 1))
                 {
                     recordP->type = _TYPE_TRUE;
+                    index += sizeof(JSON_TRUE_STRING) - 1;
                 }
-                else if (0 == lwm2m_strncmp(JSON_FALSE_STRING, (char *)buffer + index + valueStart, valueLen))
+                else if (bufferLen - index >= sizeof(JSON_FALSE_STRING) - 1
+                      && 0 == memcmp(buffer + index, JSON_FALSE_STRING, sizeof(JSON_FALSE_STRING) - 1))
                 {
                     recordP->type = _TYPE_FALSE;
+                    index += sizeof(JSON_FALSE_STRING) - 1;
                 }
                 else
                 {
                     return -1;
                 }
-                break;
-
-            case 'o':
-                if (recordP->type != _TYPE_UNSET) return -1;
-                // TODO: support object link
-                break;
-
-            case 's':
-                if (recordP->type != _TYPE_UNSET) return -1;
-                // Check for " around value
-                if (valueLen < 2
-                 || buffer[index+valueStart] != '"'
-                 || buffer[index+valueStart+valueLen-1] != '"')
-                {
-                    return -1;
-                }
+            }
+            else if (prv_isKey(key, keyLen, "sv"))
+            {
                 recordP->type = _TYPE_STRING;
-                recordP->value = buffer + index + valueStart + 1;
-                recordP->valueLen = valueLen - 2;
-                break;
-
-            default:
+                if (0 != prv_readString(buffer, bufferLen, &index, &recordP->value, &recordP->valueLen, &recordP->escaped)) return -1;
+                // unescaping never makes a string longer
+                if (recordP->escaped) *extraLenP += recordP->valueLen;
+            }
+            else if (prv_isKey(key, keyLen, "ov"))
+            {
+                uint16_t objectId;
+                uint16_t instanceId;
+
+                recordP->type = _TYPE_LINK;
+                if (0 != prv_readString(buffer, bufferLen, &index, &recordP->value, &recordP->valueLen, &escaped)) return -1;
+                if (escaped) return -1;
+                if (0 != prv_readLink(recordP->value, recordP->valueLen, &objectId, &instanceId)) return -1;
+                *extraLenP += 4;
+            }
+            else
+            {
                 return -1;
             }
         }
-        break;
 
-        default:
-            return -1;
-        }
+        index = prv_skipSpace(buffer, bufferLen, index);
+        if (index >= bufferLen) return -1;
+        if (buffer[index] == '}') break;
+        if (buffer[index] != ',') return -1;
+        index = prv_skipSpace(buffer, bufferLen, index + 1);
+    }
+
+    if (recordP->type == _TYPE_UNSET) return -1;
 
-        index += next + 1;
-    } while (index < bufferLen);
+    *indexP = index + 1;
 
     return 0;
 }
 
-static int prv_convertRecord(_record_t * recordArray,
-                             int count,
-                             lwm2m_data_t ** dataP)
+static int prv_readRecordArray(uint8_t * buffer,
+                               size_t bufferLen,
+                               size_t * indexP,
+                               _document_t * docP)
 {
-    int index;
-    int tlvIndex;
-    lwm2m_data_t * tlvP;
+    size_t index;
 
-    // may be overkill
-    tlvP = lwm2m_data_new(count);
-    if (NULL == tlvP) return -1;
-    tlvIndex = 0;
+    index = *indexP;
+    if (index >= bufferLen || buffer[index] != '[') return -1;
+    index = prv_skipSpace(buffer, bufferLen, index + 1);
+    if (index < bufferLen && buffer[index] == ']')
+    {
+        *indexP = index + 1;
+        return 0;
+    }
 
-    for (index = 0 ; index < count ; index++)
+    while (1)
     {
-        lwm2m_data_t * targetP;
+        _record_t * recordP;
+
+        // the array is sized on the count of '{' in the document
+        if (docP->count >= docP->size) return -1;
+        recordP = docP->recordArray + docP->count;
+        if (0 != prv_readRecord(buffer, bufferLen, &index, recordP, &docP->extraLen)) return -1;
+        recordP->index = docP->count;
+        docP->count++;
+
+        index = prv_skipSpace(buffer, bufferLen, index);
+        if (index >= bufferLen) return -1;
+        if (buffer[index] == ']') break;
+        if (buffer[index] != ',') return -1;
+        index = prv_skipSpace(buffer, bufferLen, index + 1);
+    }
 
-        if (recordArray[index].resInstId == LWM2M_MAX_ID)
+    *indexP = index + 1;
+
+    return 0;
+}
+
+static int prv_readDocument(uint8_t * buffer,
+                            size_t bufferLen,
+                            _document_t * docP)
+{
+    size_t index;
+    bool baseNameFound = false;
+    bool baseTimeFound = false;
+    bool arrayFound = false;
+
+    index = prv_skipSpace(buffer, bufferLen, 0);
+    if (index >= bufferLen || buffer[index] != '{') return -1;
+    index = prv_skipSpace(buffer, bufferLen, index + 1);
+
+    while (1)
+    {
+        uint8_t * key;
+        size_t keyLen;
+        bool escaped;
+
+        if (0 != prv_readString(buffer, bufferLen, &index, &key, &keyLen, &escaped)) return -1;
+        if (escaped) return -1;
+        index = prv_skipSpace(buffer, bufferLen, index);
+        if (index >= bufferLen || buffer[index] != ':') return -1;
+        index = prv_skipSpace(buffer, bufferLen, index + 1);
+
+        if (prv_isKey(key, keyLen, "e"))
+        {
+            if (arrayFound) return -1;
+            arrayFound = true;
+            if (0 != prv_readRecordArray(buffer, bufferLen, &index, docP)) return -1;
+        }
+        else if (prv_isKey(key, keyLen, "bn"))
         {
-            targetP = tlvP + tlvIndex;
-            targetP->type = LWM2M_TYPE_RESOURCE;
-            targetP->id = recordArray[index].resId;
-            tlvIndex++;
+            if (baseNameFound) return -1;
+            baseNameFound = true;
+            if (0 != prv_readString(buffer, bufferLen, &index, &docP->baseName, &docP->baseNameLen, &escaped)) return -1;
+            if (escaped) return -1;
+        }
+        else if (prv_isKey(key, keyLen, "bt"))
+        {
+            if (baseTimeFound) return -1;
+            baseTimeFound = true;
+            if (0 != prv_readTime(buffer, bufferLen, &index, &docP->baseTime)) return -1;
         }
         else
         {
-            int resIndex;
+            return -1;
+        }
 
-            resIndex = 0;
-            while (resIndex < tlvIndex
-                && tlvP[resIndex].id != recordArray[index].resId)
-            {
-                resIndex++;
-            }
-            if (resIndex == tlvIndex)
-            {
-                targetP = lwm2m_data_new(1);
-                if (NULL == targetP) goto error;
+        index = prv_skipSpace(buffer, bufferLen, index);
+        if (index >= bufferLen) return -1;
+        if (buffer[index] == '}') break;
+        if (buffer[index] != ',') return -1;
+        index = prv_skipSpace(buffer, bufferLen, index + 1);
+    }
 
-                tlvP[resIndex].type = LWM2M_TYPE_MULTIPLE_RESOURCE;
-                tlvP[resIndex].id = recordArray[index].resId;
-                tlvP[resIndex].length = 1;
-                tlvP[resIndex].value = (uint8_t *)targetP;
+    if (!arrayFound) return -1;
+    if (prv_skipSpace(buffer, bufferLen, index + 1) != bufferLen) return -1;
 
-                tlvIndex++;
-            }
-            else
-            {
-                targetP = lwm2m_data_new(tlvP[resIndex].length + 1);
-                if (NULL == targetP) goto error;
+    return 0;
+}
 
-                memcpy(targetP + 1, tlvP[resIndex].value, tlvP[resIndex].length * sizeof(lwm2m_data_t));
-                lwm2m_free(tlvP[resIndex].value);   // do not use lwm2m_data_free() to preserve value pointers
-                tlvP[resIndex].value = (uint8_t *)targetP;
-                tlvP[resIndex].length++;
-            }
+// Parses "/o/i/r/ri" or "r/ri" with an optional trailing '/'.
+// Returns 1 if the path is absolute, 0 if it is relative, -1 in case of error.
+static int prv_parsePath(uint8_t * path,
+                         size_t length,
+                         uint16_t * ids,
+                         int * countP)
+{
+    size_t index;
+    int count;
+    int result;
 
-            targetP->type = LWM2M_TYPE_RESOURCE_INSTANCE;
-            targetP->id = recordArray[index].resInstId;
+    index = 0;
+    result = 0;
+    if (length > 0 && path[0] == '/')
+    {
+        result = 1;
+        index = 1;
+    }
+
+    count = 0;
+    while (index < length)
+    {
+        uint32_t id;
+        size_t start;
+
+        start = index;
+        id = 0;
+        while (index < length && prv_isDigit(path[index]))
+        {
+            id = id * 10 + (path[index] - '0');
+            if (id >= LWM2M_MAX_ID) return -1;
+            index++;
         }
-        switch (recordArray[index].type)
+        if (index == start || count == PRV_JSON_MAX_PATH) return -1;
+        ids[count] = (uint16_t)id;
+        count++;
+        if (index < length)
         {
-        case _TYPE_FALSE:
-            lwm2m_data_encode_bool(false, targetP);
+            if (path[index] != '/') return -1;
+            index++;
+        }
+    }
+
+    *countP = count;
+
+    return result;
+}
+
+// Gives each record its IDs relative to the object or object instance targeted by the request URI,
+// or by "bn" when absolute and there is no URI. As in the serializer, names below a resource URI
+// still start with the resource ID. Returns the level of the first ID: 1 for object instances, 2
+// for resources.
+static int prv_resolveNames(_document_t * docP,
+                            lwm2m_uri_t * uriP)
+{
+    uint16_t baseIds[PRV_JSON_MAX_PATH];
+    int baseCount;
+    int i;
+
+    baseCount = 0;
+    if (uriP != NULL)
+    {
+        baseIds[baseCount++] = uriP->objectId;
+        if (LWM2M_URI_IS_SET_INSTANCE(uriP))
+        {
+            baseIds[baseCount++] = uriP->instanceId;
+        }
+    }
+    else if (docP->baseNameLen > 0 && docP->baseName[0] == '/')
+    {
+        if (1 != prv_parsePath(docP->baseName, docP->baseNameLen, baseIds, &baseCount)) return -1;
+        if (baseCount == 0 || baseCount > PRV_JSON_MAX_LEVEL) return -1;
+        if (baseCount > 2) baseCount = 2;
+    }
+
+    for (i = 0 ; i < docP->count ; i++)
+    {
+        _record_t * recordP = docP->recordArray + i;
+        uint8_t name[PRV_JSON_NAME_MAX_LEN];
+        uint16_t ids[PRV_JSON_MAX_PATH];
+        int count;
+        int first;
+        int j;
+
+        if (docP->baseNameLen + recordP->nameLen > PRV_JSON_NAME_MAX_LEN) return -1;
+        if (docP->baseNameLen > 0) memcpy(name, docP->baseName, docP->baseNameLen);
+        if (recordP->nameLen > 0) memcpy(name + docP->baseNameLen, recordP->name, recordP->nameLen);
+
+        first = 0;
+        switch (prv_parsePath(name, docP->baseNameLen + recordP->nameLen, ids, &count))
+        {
+        case 0:
             break;
-        case _TYPE_TRUE:
-            lwm2m_data_encode_bool(true, targetP);
+        case 1:
+            if (baseCount == 0 || count < baseCount) return -1;
+            for (j = 0 ; j < baseCount ; j++)
+            {
+                if (ids[j] != baseIds[j]) return -1;
+            }
+            first = baseCount;
             break;
-        case _TYPE_FLOAT:
+        default:
+            return -1;
+        }
+        count -= first;
+        // only resources and resource instances carry a value
+        if (baseCount == 1)
         {
-            size_t i;
+            if (count < 2 || count > PRV_JSON_MAX_LEVEL) return -1;
+        }
+        else
+        {
+            if (count < 1 || count > PRV_JSON_MAX_LEVEL - 1) return -1;
+        }
+
+        memcpy(recordP->ids, ids + first, count * sizeof(uint16_t));
+        recordP->idCount = count;
+        recordP->time += docP->baseTime;
+    }
+
+    return (baseCount == 1) ? 1 : 2;
+}
+
+static int prv_compareRecords(const void * first,
+                              const void * second)
+{
+    const _record_t * firstP = (const _record_t *)first;
+    const _record_t * secondP = (const _record_t *)second;
+    int i;
 
-            i = 0;
-            while (i < recordArray[index].valueLen
-                && recordArray[index].value[i] != '.')
+    for (i = 0 ; i < firstP->idCount && i < secondP->idCount ; i++)
+    {
+        if (firstP->ids[i] != secondP->ids[i]) return (int)firstP->ids[i] - (int)secondP->ids[i];
+    }
+    if (firstP->idCount != secondP->idCount) return firstP->idCount - secondP->idCount;
+
+    return firstP->index - secondP->index;
+}
+
+// Returns the count of distinct IDs at depth in recordArray, all sharing the IDs before.
+static int prv_countNodes(_record_t * recordArray,
+                          int count,
+                          int depth)
+{
+    int result;
+    int i;
+
+    result = 0;
+    for (i = 0 ; i < count ; i++)
+    {
+        if (i == 0 || recordArray[i].ids[depth] != recordArray[i - 1].ids[depth]) result++;
+    }
+
+    return result;
+}
+
+// Returns the count of lwm2m_data_t needed for the sorted recordArray.
+static int prv_countTree(_record_t * recordArray,
+                         int count)
+{
+    int result;
+    int i;
+
+    result = 0;
+    for (i = 0 ; i < count ; i++)
+    {
+        int depth = 0;
+
+        if (i > 0)
+        {
+            while (depth < recordArray[i].idCount
+                && depth < recordArray[i - 1].idCount
+                && recordArray[i].ids[depth] == recordArray[i - 1].ids[depth])
             {
-                i++;
+                depth++;
             }
-            if (i == recordArray[index].valueLen)
-            {
-                int64_t value;
+        }
+        result += recordArray[i].idCount - depth;
+    }
 
-                if ( 1 != lwm2m_PlainTextToInt64(recordArray[index].value,
-                                                 recordArray[index].valueLen,
-                                                 &value))
-                {
-                    goto error;
-                }
+    return result;
+}
 
-                lwm2m_data_encode_int(value, targetP);
-            }
-            else
+static int prv_convertValue(_record_t * recordP,
+                            lwm2m_data_t * dataP,
+                            uint8_t ** extraP)
+{
+    dataP->flags = LWM2M_TLV_FLAG_STATIC_DATA | LWM2M_TLV_FLAG_TEXT_FORMAT;
+    dataP->value = recordP->value;
+    dataP->length = recordP->valueLen;
+
+    switch (recordP->type)
+    {
+    case _TYPE_FALSE:
+    case _TYPE_TRUE:
+        dataP->dataType = LWM2M_TYPE_BOOLEAN;
+        dataP->value = (uint8_t *)prv_boolText + (recordP->type == _TYPE_TRUE ? 1 : 0);
+        dataP->length = 1;
+        break;
+
+    case _TYPE_INTEGER:
+        dataP->dataType = LWM2M_TYPE_INTEGER;
+        break;
+
+    case _TYPE_FLOAT:
+        dataP->dataType = LWM2M_TYPE_FLOAT;
+        break;
+
+    case _TYPE_STRING:
+        dataP->dataType = LWM2M_TYPE_STRING;
+        if (recordP->escaped)
+        {
+            uint8_t * src = recordP->value;
+            uint8_t * end = recordP->value + recordP->valueLen;
+            uint8_t * dst = *extraP;
+
+            while (src < end)
             {
-                double value;
+                uint32_t code;
 
-                if ( 1 != lwm2m_PlainTextToFloat64(recordArray[index].value,
-                                                   recordArray[index].valueLen,
-                                                   &value))
+                if (*src != '\\')
+                {
+                    *dst++ = *src++;
+                    continue;
+                }
+                src++;
+                switch (*src)
                 {
-                    goto error;
+                case 'b': *dst++ = '\b'; src++; continue;
+                case 'f': *dst++ = '\f'; src++; continue;
+                case 'n': *dst++ = '\n'; src++; continue;
+                case 'r': *dst++ = '\r'; src++; continue;
+                case 't': *dst++ = '\t'; src++; continue;
+                case 'u': break;
+                default: *dst++ = *src++; continue;
                 }
+                code = (prv_hexValue(src[1]) << 12) | (prv_hexValue(src[2]) << 8) | (prv_hexValue(src[3]) << 4) | prv_hexValue(src[4]);
+                src += 5;
+                if (0xDC00 <= code && code <= 0xDFFF) return -1;
+                if (0xD800 <= code && code <= 0xDBFF)
+                {
+                    uint32_t low;
 
-                lwm2m_data_encode_float(value, targetP);
+                    if (end - src < 6 || src[0] != '\\' || src[1] != 'u') return -1;
+                    low = (prv_hexValue(src[2]) << 12) | (prv_hexValue(src[3]) << 8) | (prv_hexValue(src[4]) << 4) | prv_hexValue(src[5]);
+                    if (low < 0xDC00 || low > 0xDFFF) return -1;
+                    src += 6;
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                if (code < 0x80)
+                {
+                    *dst++ = (uint8_t)code;
+                }
+                else if (code < 0x800)
+                {
+                    *dst++ = (uint8_t)(0xC0 | (code >> 6));
+                    *dst++ = (uint8_t)(0x80 | (code & 0x3F));
+                }
+                else if (code < 0x10000)
+                {
+                    *dst++ = (uint8_t)(0xE0 | (code >> 12));
+                    *dst++ = (uint8_t)(0x80 | ((code >> 6) & 0x3F));
+                    *dst++ = (uint8_t)(0x80 | (code & 0x3F));
+                }
+                else
+                {
+                    *dst++ = (uint8_t)(0xF0 | (code >> 18));
+                    *dst++ = (uint8_t)(0x80 | ((code >> 12) & 0x3F));
+                    *dst++ = (uint8_t)(0x80 | ((code >> 6) & 0x3F));
+                    *dst++ = (uint8_t)(0x80 | (code & 0x3F));
+                }
             }
+            dataP->value = *extraP;
+            dataP->length = dst - *extraP;
+            *extraP = dst;
         }
         break;
 
-            // TODO: Copy string instead of pointing to it
-        case _TYPE_STRING:
-            targetP->flags = LWM2M_TLV_FLAG_STATIC_DATA | LWM2M_TLV_FLAG_TEXT_FORMAT;
-            targetP->dataType = LWM2M_TYPE_STRING;      // or opaque ?
-            targetP->length = recordArray[index].valueLen;
-            targetP->value = recordArray[index].value;
-            break;
+    case _TYPE_LINK:
+    {
+        uint16_t objectId;
+        uint16_t instanceId;
+
+        // same encoding as in TLV
+        prv_readLink(recordP->value, recordP->valueLen, &objectId, &instanceId);
+        dataP->flags = LWM2M_TLV_FLAG_STATIC_DATA;
+        dataP->dataType = LWM2M_TYPE_OBJECT_LINK;
+        dataP->value = *extraP;
+        dataP->length = 4;
+        (*extraP)[0] = (uint8_t)(objectId >> 8);
+        (*extraP)[1] = (uint8_t)objectId;
+        (*extraP)[2] = (uint8_t)(instanceId >> 8);
+        (*extraP)[3] = (uint8_t)instanceId;
+        *extraP += 4;
+    }
+        break;
 
-        case _TYPE_UNSET:
-        default:
-            goto error;
-        }
+    default:
+        return -1;
     }
 
-    *dataP = tlvP;
-    return tlvIndex;
+    return 0;
+}
 
-error:
-    lwm2m_data_free(count, tlvP);
-    return -1;
+// Fills dataP with the nodes at depth of the sorted recordArray, all sharing the IDs before.
+// The children are taken from *nextP.
+static int prv_buildLevel(_record_t * recordArray,
+                          int count,
+                          int depth,
+                          int level,
+                          lwm2m_data_t * dataP,
+                          lwm2m_data_t ** nextP,
+                          uint8_t ** extraP)
+{
+    int i;
+
+    i = 0;
+    while (i < count)
+    {
+        int j;
+
+        j = i + 1;
+        while (j < count && recordArray[j].ids[depth] == recordArray[i].ids[depth]) j++;
+
+        dataP->id = recordArray[i].ids[depth];
+        if (recordArray[i].idCount == depth + 1)
+        {
+            _record_t * recordP;
+            int k;
+
+            // a resource can not also have instances
+            if (recordArray[j - 1].idCount != depth + 1) return -1;
+            // records of the same name are a time series: keep the most recent
+            recordP = recordArray + i;
+            for (k = i + 1 ; k < j ; k++)
+            {
+                if (recordArray[k].time >= recordP->time) recordP = recordArray + k;
+            }
+            dataP->type = (level == 2) ? LWM2M_TYPE_RESOURCE : LWM2M_TYPE_RESOURCE_INSTANCE;
+            if (0 != prv_convertValue(recordP, dataP, extraP)) return -1;
+        }
+        else
+        {
+            int childCount;
+
+            childCount = prv_countNodes(recordArray + i, j - i, depth + 1);
+            dataP->type = (level == 1) ? LWM2M_TYPE_OBJECT_INSTANCE : LWM2M_TYPE_MULTIPLE_RESOURCE;
+            dataP->flags = LWM2M_TLV_FLAG_STATIC_DATA;
+            dataP->length = childCount;
+            dataP->value = (uint8_t *)*nextP;
+            *nextP += childCount;
+            if (0 != prv_buildLevel(recordArray + i, j - i, depth + 1, level + 1, (lwm2m_data_t *)dataP->value, nextP, extraP)) return -1;
+        }
+
+        dataP++;
+        i = j;
+    }
+
+    return 0;
 }
 
-int lwm2m_json_parse(uint8_t * buffer,
+int lwm2m_json_parse(lwm2m_uri_t * uriP,
+                     uint8_t * buffer,
                      size_t bufferLen,
                      lwm2m_data_t ** dataP)
 {
-    size_t index;
-    int count = 0;
-    bool eFound = false;
-    bool bnFound = false;
-    bool btFound = false;
+    _document_t doc;
+    lwm2m_data_t * nextP;
+    uint8_t * extraP;
+    uint8_t * bracketP;
+    int level;
+    int total;
+    int size;
+    int i;
+
+    *dataP = NULL;
+
+    // the records can not outnumber the opening brackets
+    memset(&doc, 0, sizeof(_document_t));
+    bracketP = buffer;
+    while (NULL != (bracketP = (uint8_t *)memchr(bracketP, '{', bufferLen - (bracketP - buffer))))
+    {
+        doc.size++;
+        bracketP++;
+    }
+    if (doc.size < 2) return 0;
+    doc.recordArray = (_record_t *)lwm2m_malloc((doc.size - 1) * sizeof(_record_t));
+    if (doc.recordArray == NULL) return 0;
+    doc.size--;
+
+    size = 0;
+    if (0 != prv_readDocument(buffer, bufferLen, &doc)) goto exit;
+    if (doc.count == 0) goto exit;
+    level = prv_resolveNames(&doc, uriP);
+    if (level < 0) goto exit;
+
+    for (i = 1 ; i < doc.count ; i++)
+    {
+        if (prv_compareRecords(doc.recordArray + i - 1, doc.recordArray + i) > 0)
+        {
+            qsort(doc.recordArray, doc.count, sizeof(_record_t), prv_compareRecords);
+            break;
+        }
+    }
 
-    index = prv_skipSpace(buffer, bufferLen);
-    if (index == bufferLen) return -1;
+    total = prv_countTree(doc.recordArray, doc.count);
+    *dataP = (lwm2m_data_t *)lwm2m_malloc(total * sizeof(lwm2m_data_t) + doc.extraLen);
+    if (*dataP == NULL) goto exit;
+    memset(*dataP, 0, total * sizeof(lwm2m_data_t));
 
-    if (buffer[index] != '{') return -1;
-    _GO_TO_NEXT_CHAR(index, buffer+index, bufferLen-index);
-    if (buffer[index] != '"') return -1;
-    if (index++ >= bufferLen) return -1;
-    switch (buffer[index])
+    size = prv_countNodes(doc.recordArray, doc.count, 0);
+    nextP = *dataP + size;
+    extraP = (uint8_t *)(*dataP + total);
+    if (0 != prv_buildLevel(doc.recordArray, doc.count, 0, level, *dataP, &nextP, &extraP))
     {
-    case 'e':
-    {
-        _record_t * recordArray;
-        int recordIndex;
+        lwm2m_free(*dataP);
+        *dataP = NULL;
+        size = 0;
+    }
 
-        if (eFound == true) return -1;
-        eFound = true;
+exit:
+    lwm2m_free(doc.recordArray);
+    return size;
+}
 
-        if (bufferLen-index < JSON_MIN_ARRAY_LEN) return -1;
-        index++;
-        if (buffer[index] != '"') return -1;
-        _GO_TO_NEXT_CHAR(index, buffer, bufferLen);
-        if (buffer[index] != ':') return -1;
-        _GO_TO_NEXT_CHAR(index, buffer, bufferLen);
-        if (buffer[index] != '[') return -1;
-        _GO_TO_NEXT_CHAR(index, buffer, bufferLen);
-        count = prv_countItems(buffer + index, bufferLen - index);
-        if (count <= 0) return -1;
-        recordArray = (_record_t*)lwm2m_malloc(count * sizeof(_record_t));
-        if (recordArray == NULL) return -1;
-        // at this point we are sure buffer[index] is '{' and all { and } are matching
-        recordIndex = 0;
-        while (recordIndex < count)
-        {
-            int itemLen;
-
-            if (buffer[index] != '{') return -1;
-            itemLen = 0;
-            while (buffer[index + itemLen] != '}') itemLen++;
-            if (0 != prv_parseItem(buffer + index + 1, itemLen - 1, recordArray + recordIndex))
-            {
-                lwm2m_free(recordArray);
-                return -1;
-            }
-            recordIndex++;
-            index += itemLen;
-            _GO_TO_NEXT_CHAR(index, buffer, bufferLen);
-            switch (buffer[index])
-            {
-            case ',':
-                _GO_TO_NEXT_CHAR(index, buffer, bufferLen);
-                break;
-            case ']':
-                if (recordIndex == count) break;
-                // else this is an error
-            default:
-                lwm2m_free(recordArray);
-                return -1;
-            }
+/*
+ * The document is written through a writer. Without callback, its buffer grows to hold the whole
+ * document. With a callback, its buffer is a chunk given to the callback each time it is full.
+ */
+#define PRV_JSON_INITIAL_SIZE       1024
+#define PRV_JSON_RECORD_MAX_SIZE    80      // ,{"n":"65535/65535/65535","v":-1.234567890123456e-308}
+
+typedef struct
+{
+    uint8_t *   buffer;
+    size_t      size;
+    size_t      length;     // used in buffer
+    size_t      total;      // written since the start of the document
+    lwm2m_json_chunk_callback_t callback;
+    void *      userData;
+    bool        first;      // no record written yet
+    bool        error;
+} prv_writer_t;
+
+static void prv_makeRoom(prv_writer_t * writerP)
+{
+    if (NULL != writerP->callback)
+    {
+        if (0 != writerP->callback(writerP->buffer, writerP->length, writerP->userData))
+        {
+            writerP->error = true;
         }
-        if (buffer[index] != ']')
+        writerP->length = 0;
+    }
+    else
+    {
+        uint8_t * bufferP;
+        size_t size;
+
+        size = writerP->size ? writerP->size * 2 : PRV_JSON_INITIAL_SIZE;
+        bufferP = (uint8_t *)lwm2m_malloc(size);
+        if (NULL == bufferP)
         {
-            lwm2m_free(recordArray);
-            return -1;
+            writerP->error = true;
+            return;
+        }
+        if (NULL != writerP->buffer)
+        {
+            memcpy(bufferP, writerP->buffer, writerP->length);
+            lwm2m_free(writerP->buffer);
         }
-        count = prv_convertRecord(recordArray, count, dataP);
-        lwm2m_free(recordArray);
+        writerP->buffer = bufferP;
+        writerP->size = size;
     }
-    break;
+}
 
-    case 'b':
-    default:
-        // TODO: support for basename and base time.
-        return 0;
+static void prv_write(prv_writer_t * writerP,
+                      const void * data,
+                      size_t length)
+{
+    const uint8_t * dataP = (const uint8_t *)data;
+
+    writerP->total += length;
+    while (length > 0 && !writerP->error)
+    {
+        size_t count;
+
+        if (writerP->length == writerP->size)
+        {
+            prv_makeRoom(writerP);
+            if (writerP->error) return;
+        }
+        count = writerP->size - writerP->length;
+        if (count > length) count = length;
+        memcpy(writerP->buffer + writerP->length, dataP, count);
+        writerP->length += count;
+        dataP += count;
+        length -= count;
     }
+}
+
+#define PRV_WRITE_STRING(W, S)  prv_write((W), (S), sizeof(S) - 1)
+
+static void prv_writeEscaped(prv_writer_t * writerP,
+                             uint8_t * buffer,
+                             size_t length)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+    size_t start;
+    size_t i;
+
+    start = 0;
+    for (i = 0 ; i < length ; i++)
+    {
+        uint8_t sign = buffer[i];
 
-    return count;
+        if (sign >= 0x20 && sign != '"' && sign != '\\') continue;
+
+        prv_write(writerP, buffer + start, i - start);
+        start = i + 1;
+        switch (sign)
+        {
+        case '"':
+            PRV_WRITE_STRING(writerP, "\\\"");
+            break;
+        case '\\':
+            PRV_WRITE_STRING(writerP, "\\\\");
+            break;
+        case '\n':
+            PRV_WRITE_STRING(writerP, "\\n");
+            break;
+        case '\r':
+            PRV_WRITE_STRING(writerP, "\\r");
+            break;
+        case '\t':
+            PRV_WRITE_STRING(writerP, "\\t");
+            break;
+        default:
+        {
+            uint8_t escape[6] = {'\\', 'u', '0', '0', 0, 0};
+
+            escape[4] = hexDigits[sign >> 4];
+            escape[5] = hexDigits[sign & 0x0F];
+            prv_write(writerP, escape, sizeof(escape));
+        }
+            break;
+        }
+    }
+    prv_write(writerP, buffer + start, length - start);
 }
 
-static int prv_serializeValue(lwm2m_data_t * tlvP,
-                              uint8_t * buffer,
-                              size_t bufferLen)
+// Writes the record with the name made of the count first IDs. Apart from strings, a record is
+// built in a local buffer and written at once.
+static void prv_writeRecord(prv_writer_t * writerP,
+                            lwm2m_data_t * tlvP,
+                            uint16_t * ids,
+                            int count)
 {
-    int res;
-    int head;
+    uint8_t record[PRV_JSON_RECORD_MAX_SIZE];
+    size_t length;
+    int i;
 
-    res = snprintf((char *)(char *)buffer, bufferLen, JSON_RES_ITEM_TEMPLATE, tlvP->id);
-    if (res <= 0 || res >= bufferLen) return -1;
+    length = 0;
+    if (!writerP->first) record[length++] = ',';
+    writerP->first = false;
 
-    switch (tlvP->dataType)
+    memcpy(record + length, "{\"n\":\"", 6);
+    length += 6;
+    for (i = 0 ; i < count ; i++)
     {
-    case LWM2M_TYPE_STRING:
-        res = snprintf((char *)buffer, bufferLen, JSON_ITEM_STRING_BEGIN);
-        if (res <= 0 || res >= bufferLen) return -1;
-        head = res;
-        if (tlvP->length >= bufferLen - head) return -1;
-        memcpy(buffer + head, tlvP->value, tlvP->length);
-        head += tlvP->length;
-        res = snprintf((char *)buffer + head, bufferLen - head, JSON_ITEM_STRING_END);
-        if (res <= 0 || res >= bufferLen - head) return -1;
-        res += head;
-        break;
+        if (i != 0) record[length++] = '/';
+        length += utils_intToText(ids[i], record + length, sizeof(record) - length);
+    }
+    record[length++] = '"';
+    record[length++] = ',';
 
+    switch (tlvP->dataType)
+    {
     case LWM2M_TYPE_INTEGER:
     case LWM2M_TYPE_TIME:
     {
         int64_t value;
 
-        if (0 == lwm2m_data_decode_int(tlvP, &value)) return -1;
-        res = snprintf((char *)buffer, bufferLen, JSON_ITEM_INTEGER_TEMPLATE, value);
-        if (res <= 0 || res >= bufferLen) return -1;
+        if (0 == lwm2m_data_decode_int(tlvP, &value))
+        {
+            writerP->error = true;
+            return;
+        }
+        memcpy(record + length, "\"v\":", 4);
+        length += 4;
+        length += utils_intToText(value, record + length, sizeof(record) - length);
     }
     break;
 
     case LWM2M_TYPE_FLOAT:
     {
         double value;
+        size_t res;
 
-        if (0 == lwm2m_data_decode_float(tlvP, &value)) return -1;
-        res = snprintf((char *)buffer, bufferLen, JSON_ITEM_FLOAT_TEMPLATE, value);
-        if (res <= 0 || res >= bufferLen) return -1;
+        if (0 == lwm2m_data_decode_float(tlvP, &value))
+        {
+            writerP->error = true;
+            return;
+        }
+        memcpy(record + length, "\"v\":", 4);
+        length += 4;
+        res = utils_floatToText(value, record + length, sizeof(record) - length);
+        if (0 == res)
+        {
+            writerP->error = true;
+            return;
+        }
+        length += res;
     }
     break;
 
@@ -695,133 +1129,166 @@ static int prv_serializeValue(lwm2m_data_t * tlvP,
     {
         bool value;
 
-        if (0 == lwm2m_data_decode_bool(tlvP, &value)) return -1;
-        res = snprintf((char *)buffer, bufferLen, value?JSON_ITEM_BOOL_TRUE:JSON_ITEM_BOOL_FALSE);
-        if (res <= 0 || res >= bufferLen) return -1;
+        if (0 == lwm2m_data_decode_bool(tlvP, &value))
+        {
+            writerP->error = true;
+            return;
+        }
+        if (value)
+        {
+            memcpy(record + length, "\"bv\":true", 9);
+            length += 9;
+        }
+        else
+        {
+            memcpy(record + length, "\"bv\":false", 10);
+            length += 10;
+        }
     }
     break;
 
-    case LWM2M_TYPE_OPAQUE:
-        // TODO: base64 encoding
-        res = snprintf((char *)buffer, bufferLen, JSON_ITEM_STRING_BEGIN);
-        if (res <= 0 || res >= bufferLen) return -1;
-        head = res;
-        if (tlvP->length >= bufferLen - head) return -1;
-        memcpy(buffer + head, tlvP->value, tlvP->length);
-        head += tlvP->length;
-        res = snprintf((char *)buffer + head, bufferLen - head, JSON_ITEM_STRING_END);
-        if (res <= 0 || res >= bufferLen - head) return -1;
-        res += head;
-        break;
-
-    case LWM2M_TYPE_OBJECT_LINK:
-        // TODO: implement
-        return -1;
-
     case LWM2M_TYPE_UNDEFINED:
-        if ((tlvP->flags & LWM2M_TLV_FLAG_TEXT_FORMAT) != 0)
-        {
-            res = snprintf((char *)buffer, bufferLen, JSON_ITEM_STRING_BEGIN);
-            if (res <= 0 || res >= bufferLen) return -1;
-            head = res;
-            if (tlvP->length >= bufferLen - head) return -1;
-            memcpy(buffer + head, tlvP->value, tlvP->length);
-            head += tlvP->length;
-            res = snprintf((char *)buffer + head, bufferLen - head, JSON_ITEM_STRING_END);
-            if (res <= 0 || res >= bufferLen - head) return -1;
-            res += head;
-        } else
+        if ((tlvP->flags & LWM2M_TLV_FLAG_TEXT_FORMAT) == 0)
         {
-            return -1;
+            writerP->error = true;
+            return;
         }
-        break;
+        // fall through
+    case LWM2M_TYPE_STRING:
+    case LWM2M_TYPE_OPAQUE:
+        // TODO: base64 encoding of opaque values
+        memcpy(record + length, "\"sv\":\"", 6);
+        length += 6;
+        prv_write(writerP, record, length);
+        prv_writeEscaped(writerP, tlvP->value, tlvP->length);
+        PRV_WRITE_STRING(writerP, "\"}");
+        return;
 
+    case LWM2M_TYPE_OBJECT_LINK:
     default:
-        break;
+        // TODO: implement
+        writerP->error = true;
+        return;
     }
 
-    return res;
+    record[length++] = '}';
+    prv_write(writerP, record, length);
 }
 
-int lwm2m_json_serialize(int size,
-                         lwm2m_data_t * tlvP,
-                         uint8_t ** bufferP)
+// Writes the records of tlvP, found at level in the tree. The IDs of their ancestors are in ids.
+static void prv_writeLevel(prv_writer_t * writerP,
+                           int size,
+                           lwm2m_data_t * tlvP,
+                           lwm2m_tlv_type_t parentType,
+                           uint16_t * ids,
+                           int level)
 {
-    int index;
-    size_t head;
-    uint8_t bufferJSON[PRV_JSON_BUFFER_SIZE];
+    int i;
 
-    memcpy(bufferJSON, JSON_HEADER, JSON_HEADER_SIZE);
-    head = JSON_HEADER_SIZE;
-
-    // HACK START
-    if (tlvP->type == LWM2M_TYPE_OBJECT_INSTANCE)
-    {
-        if (size == 1)
-        {
-            size = tlvP->length;
-            tlvP = (lwm2m_data_t *)tlvP->value;
-        }
-        else return 0;
-    }
-    // HACK END
-    for (index = 0 ; index < size && head < PRV_JSON_BUFFER_SIZE ; index++)
+    for (i = 0 ; i < size && !writerP->error ; i++)
     {
-        int res;
+        ids[level] = tlvP[i].id;
 
-        // TODO: handle non-text format
-        switch (tlvP[index].type)
+        switch (tlvP[i].type)
         {
-        case LWM2M_TYPE_MULTIPLE_RESOURCE:
-        {
-            lwm2m_data_t * subTlvP;
-            size_t i;
-
-            subTlvP = (lwm2m_data_t *)tlvP[index].value;
-            for (i = 0 ; i < tlvP[index].length ; i++)
+        case LWM2M_TYPE_OBJECT_INSTANCE:
+            if (0 != level)
             {
-                res = snprintf((char *)bufferJSON + head, PRV_JSON_BUFFER_SIZE - head, JSON_INST_ITEM_TEMPLATE, tlvP[index].id, subTlvP[i].id);
-                if (res <= 0 || res >= PRV_JSON_BUFFER_SIZE - head) return 0;
-                head += res;
-
-                res = prv_serializeValue(subTlvP + i, bufferJSON + head, PRV_JSON_BUFFER_SIZE -head);
-                if (res < 0) return -1;
-                head += res;
+                writerP->error = true;
+                return;
             }
-        }
+            prv_writeLevel(writerP, tlvP[i].length, (lwm2m_data_t *)tlvP[i].value, tlvP[i].type, ids, level + 1);
             break;
 
+        case LWM2M_TYPE_MULTIPLE_RESOURCE:
         case LWM2M_TYPE_RESOURCE:
-            res = snprintf((char *)bufferJSON + head, PRV_JSON_BUFFER_SIZE - head, JSON_RES_ITEM_TEMPLATE, tlvP[index].id);
-            if (res <= 0 || res >= PRV_JSON_BUFFER_SIZE - head) return 0;
-            head += res;
-
-            res = prv_serializeValue(tlvP + index, bufferJSON + head, PRV_JSON_BUFFER_SIZE -head);
-            if (res < 0) return 0;
-            head += res;
+            if (0 != level && LWM2M_TYPE_OBJECT_INSTANCE != parentType)
+            {
+                writerP->error = true;
+                return;
+            }
+            if (LWM2M_TYPE_MULTIPLE_RESOURCE == tlvP[i].type)
+            {
+                prv_writeLevel(writerP, tlvP[i].length, (lwm2m_data_t *)tlvP[i].value, tlvP[i].type, ids, level + 1);
+            }
+            else
+            {
+                prv_writeRecord(writerP, tlvP + i, ids, level + 1);
+            }
             break;
 
-        case LWM2M_TYPE_OBJECT_INSTANCE:
-            // TODO: support this. Hacked for now.
+        case LWM2M_TYPE_RESOURCE_INSTANCE:
+            if (0 == level || LWM2M_TYPE_MULTIPLE_RESOURCE != parentType)
+            {
+                writerP->error = true;
+                return;
+            }
+            prv_writeRecord(writerP, tlvP + i, ids, level + 1);
             break;
 
-        case LWM2M_TYPE_RESOURCE_INSTANCE:
         default:
-            return 0;
-            break;
+            writerP->error = true;
+            return;
         }
     }
+}
 
-    if (head + JSON_FOOTER_SIZE - 1 > PRV_JSON_BUFFER_SIZE) return -1;
+static void prv_writeDocument(prv_writer_t * writerP,
+                              int size,
+                              lwm2m_data_t * tlvP)
+{
+    uint16_t ids[PRV_JSON_MAX_LEVEL];
 
-    memcpy(bufferJSON + head - 1, JSON_FOOTER, JSON_FOOTER_SIZE);
-    head = head - 1 + JSON_FOOTER_SIZE;
+    writerP->first = true;
+    PRV_WRITE_STRING(writerP, "{\"e\":[");
+    prv_writeLevel(writerP, size, tlvP, LWM2M_TYPE_OBJECT_INSTANCE, ids, 0);
+    PRV_WRITE_STRING(writerP, "]}");
+}
 
-    *bufferP = (uint8_t *)lwm2m_malloc(head);
-    if (*bufferP == NULL) return 0;
-    memcpy(*bufferP, bufferJSON, head);
+int lwm2m_json_serialize(int size,
+                         lwm2m_data_t * tlvP,
+                         uint8_t ** bufferP)
+{
+    prv_writer_t writer;
+
+    memset(&writer, 0, sizeof(writer));
+    prv_writeDocument(&writer, size, tlvP);
+    if (writer.error)
+    {
+        lwm2m_free(writer.buffer);
+        *bufferP = NULL;
+        return 0;
+    }
+
+    *bufferP = writer.buffer;
+    return (int)writer.length;
+}
+
+int lwm2m_json_serialize_chunks(int size,
+                                lwm2m_data_t * tlvP,
+                                uint8_t * chunk,
+                                size_t chunkSize,
+                                lwm2m_json_chunk_callback_t callback,
+                                void * userData)
+{
+    prv_writer_t writer;
+
+    if (NULL == chunk || 0 == chunkSize || NULL == callback) return 0;
+
+    memset(&writer, 0, sizeof(writer));
+    writer.buffer = chunk;
+    writer.size = chunkSize;
+    writer.callback = callback;
+    writer.userData = userData;
+
+    prv_writeDocument(&writer, size, tlvP);
+    if (!writer.error && 0 != writer.length)
+    {
+        prv_makeRoom(&writer);
+    }
+    if (writer.error) return 0;
 
-    return (int)head;
+    return (int)writer.total;
 }
 
 #endif
@@ -78,8 +78,22 @@ lwm2m_context_t * lwm2m_init(lwm2m_connect_server_callback_t connectCallback,
         contextP->connectCallback = connectCallback;
         contextP->bufferSendCallback = bufferSendCallback;
         contextP->userData = userData;
-        srand(time(NULL));
-        contextP->nextMID = rand();
+        utils_randomSeed(contextP);
+        contextP->nextMID = (uint16_t)utils_random(contextP);
+        contextP->ackTimeout = COAP_RESPONSE_TIMEOUT * 1000;
+        contextP->ackRandomFactor = COAP_ACK_RANDOM_FACTOR;
+        contextP->maxRetransmit = COAP_MAX_RETRANSMIT;
+        if (0 != transaction_init(contextP))
+        {
+            lwm2m_free(contextP);
+            return NULL;
+        }
+#ifdef LWM2M_CLIENT_MODE
+        utils_heapInit(&contextP->watcherHeap, offsetof(lwm2m_watcher_t, nextTime), offsetof(lwm2m_watcher_t, heapIndex));
+#endif
+#ifdef LWM2M_SERVER_MODE
+        utils_heapInit(&contextP->clientHeap, offsetof(lwm2m_client_t, endOfLife), offsetof(lwm2m_client_t, heapIndex));
+#endif
     }
 
     return contextP;
@@ -103,6 +117,7 @@ void delete_server_list(lwm2m_context_t * context)
         lwm2m_server_t * server;
         server = context->serverList;
         context->serverList = server->next;
+        observe_remove_server(context, server);
         if (NULL != server->location)
         {
             lwm2m_free(server->location);
@@ -119,6 +134,13 @@ void delete_bootstrap_server_list(lwm2m_context_t * contextP)
 
 void delete_observed_list(lwm2m_context_t * contextP)
 {
+    lwm2m_server_t * serverP;
+
+    for (serverP = contextP->serverList ; serverP != NULL ; serverP = serverP->next)
+    {
+        observe_clear_server(serverP);
+    }
+
     while (NULL != contextP->observedList)
     {
         lwm2m_observed_t * targetP;
@@ -126,23 +148,62 @@ void delete_observed_list(lwm2m_context_t * contextP)
         targetP = contextP->observedList;
         contextP->observedList = contextP->observedList->next;
 
-        LWM2M_LIST_FREE(targetP->watcherList);
+        while (NULL != targetP->watcherList)
+        {
+            lwm2m_watcher_t * watcherP;
+
+            watcherP = targetP->watcherList;
+            targetP->watcherList = targetP->watcherList->next;
+
+            if (NULL != watcherP->conTransaction)
+            {
+                // the confirmable notification is left to the transaction list
+                lwm2m_free(watcherP->conTransaction->userData);
+                watcherP->conTransaction->userData = NULL;
+                watcherP->conTransaction->callback = NULL;
+            }
+            while (0 != watcherP->queueCount)
+            {
+                lwm2m_free(watcherP->queue[watcherP->queueStart].payload);
+                watcherP->queueStart = (watcherP->queueStart + 1) % watcherP->queueSize;
+                watcherP->queueCount--;
+            }
+            if (NULL != watcherP->queue) lwm2m_free(watcherP->queue);
+            lwm2m_free(watcherP);
+        }
 
         lwm2m_free(targetP);
     }
+    if (NULL != contextP->observedTable)
+    {
+        lwm2m_free(contextP->observedTable);
+        contextP->observedTable = NULL;
+    }
+    contextP->observedTableSize = 0;
+    contextP->observedCount = 0;
+    contextP->changedList = NULL;
+    utils_heapFree(&contextP->watcherHeap);
 }
 #endif
 
 void delete_transaction_list(lwm2m_context_t * context)
 {
-    while (NULL != context->transactionList)
+    size_t i;
+
+    for (i = 0 ; i < context->transactionTableSize ; i++)
     {
-        lwm2m_transaction_t * transaction;
+        while (NULL != context->transactionMidTable[i])
+        {
+            lwm2m_transaction_t * transaction;
 
-        transaction = context->transactionList;
-        context->transactionList = context->transactionList->next;
-        transaction_free(transaction);
+            transaction = context->transactionMidTable[i];
+            context->transactionMidTable[i] = transaction->next;
+            transaction_free(transaction);
+        }
+        context->transactionTokenTable[i] = NULL;
     }
+    context->transactionCount = 0;
+    utils_heapFree(&context->transactionHeap);
 }
 
 void lwm2m_close(lwm2m_context_t * contextP)
@@ -166,18 +227,13 @@ void lwm2m_close(lwm2m_context_t * contextP)
 #endif
 
 #ifdef LWM2M_SERVER_MODE
-    while (NULL != contextP->clientList)
-    {
-        lwm2m_client_t * clientP;
-
-        clientP = contextP->clientList;
-        contextP->clientList = contextP->clientList->next;
-
-        prv_freeClient(clientP);
-    }
+    observe_batch_free(contextP);
+    registration_free_clients(contextP);
 #endif
 
     delete_transaction_list(contextP);
+    lwm2m_free(contextP->transactionMidTable);
+    lwm2m_free(contextP->transactionTokenTable);
     lwm2m_free(contextP);
 }
 
@@ -259,51 +315,32 @@ int lwm2m_configure(lwm2m_context_t * contextP,
 #endif
 
 
+int lwm2m_set_transmission_parameters(lwm2m_context_t * contextP,
+                                      uint32_t ackTimeout,
+                                      uint16_t ackRandomFactor,
+                                      uint8_t maxRetransmit)
+{
+    if (0 == ackTimeout || 100 > ackRandomFactor) return COAP_400_BAD_REQUEST;
+
+    contextP->ackTimeout = ackTimeout;
+    contextP->ackRandomFactor = ackRandomFactor;
+    contextP->maxRetransmit = maxRetransmit;
+
+    return COAP_NO_ERROR;
+}
+
 int lwm2m_step(lwm2m_context_t * contextP,
-               time_t * timeoutP)
+               int64_t * timeoutP)
 {
-    lwm2m_transaction_t * transacP;
-    time_t tv_sec;
+    int64_t tv_ms;
 #ifdef LWM2M_SERVER_MODE
     lwm2m_client_t * clientP;
 #endif
 
-    tv_sec = lwm2m_gettime();
-    if (tv_sec < 0) return COAP_500_INTERNAL_SERVER_ERROR;
-
-    transacP = contextP->transactionList;
-    while (transacP != NULL)
-    {
-        // transaction_send() may remove transaction from the linked list
-        lwm2m_transaction_t * nextP = transacP->next;
-        int removed = 0;
-
-        if (transacP->retrans_time <= tv_sec)
-        {
-            removed = transaction_send(contextP, transacP);
-        }
-
-        if (0 == removed)
-        {
-            time_t interval;
-
-            if (transacP->retrans_time > tv_sec)
-            {
-                interval = transacP->retrans_time - tv_sec;
-            }
-            else
-            {
-                interval = 1;
-            }
-
-            if (*timeoutP > interval)
-            {
-                *timeoutP = interval;
-            }
-        }
+    tv_ms = lwm2m_gettime_ms();
+    if (tv_ms < 0) return COAP_500_INTERNAL_SERVER_ERROR;
 
-        transacP = nextP;
-    }
+    transaction_step(contextP, tv_ms, timeoutP);
 
 #ifdef LWM2M_CLIENT_MODE
 #ifdef LWM2M_BOOTSTRAP
@@ -313,41 +350,39 @@ int lwm2m_step(lwm2m_context_t * contextP,
         (contextP->bsState != BOOTSTRAP_FAILED))
     {
 #endif
-        registration_update(contextP, tv_sec, timeoutP);
+        registration_update(contextP, tv_ms, timeoutP);
+        observe_step(contextP, tv_ms, timeoutP);
 #ifdef LWM2M_BOOTSTRAP
     }
-    update_bootstrap_state(contextP, tv_sec, timeoutP);
+    update_bootstrap_state(contextP, tv_ms, timeoutP);
 #endif
 #endif
 
 #ifdef LWM2M_SERVER_MODE
-    // monitor clients lifetime
-    clientP = contextP->clientList;
-    while (clientP != NULL)
-    {
-        lwm2m_client_t * nextP = clientP->next;
+    observe_batch_step(contextP, tv_ms, timeoutP);
 
-        if (clientP->endOfLife <= tv_sec)
+    // monitor clients lifetime: only the expired ones are visited
+    while (NULL != (clientP = (lwm2m_client_t *)utils_heapTop(&contextP->clientHeap))
+        && clientP->endOfLife <= tv_ms)
+    {
+        registration_remove_client(contextP, clientP);
+        if (contextP->monitorCallback != NULL)
         {
-            contextP->clientList = (lwm2m_client_t *)LWM2M_LIST_RM(contextP->clientList, clientP->internalID, NULL);
-            if (contextP->monitorCallback != NULL)
-            {
-                contextP->monitorCallback(clientP->internalID, NULL, DELETED_2_02, LWM2M_CONTENT_TEXT, NULL, 0, contextP->monitorUserData);
-            }
-            prv_freeClient(clientP);
+            contextP->monitorCallback(clientP->internalID, NULL, DELETED_2_02, LWM2M_CONTENT_TEXT, NULL, 0, contextP->monitorUserData);
         }
-        else
-        {
-            time_t interval;
+        transaction_remove_peer(contextP, &clientP->queue);
+        prv_freeClient(clientP);
+    }
+    if (NULL != clientP)
+    {
+        int64_t interval;
 
-            interval = clientP->endOfLife - tv_sec;
+        interval = clientP->endOfLife - tv_ms;
 
-            if (*timeoutP > interval)
-            {
-                *timeoutP = interval;
-            }
+        if (*timeoutP > interval)
+        {
+            *timeoutP = interval;
         }
-        clientP = nextP;
     }
 #endif
 
@@ -359,8 +394,8 @@ int lwm2m_start(lwm2m_context_t * contextP)
 {
     int result;
     bool cleanup = (NULL != contextP->bootstrapServerList) || (NULL != contextP->serverList);
-    delete_transaction_list(contextP);
     delete_observed_list(contextP);
+    delete_transaction_list(contextP);
     if (cleanup)
     {
         LOG("lwm2m_start: cleanup\n");
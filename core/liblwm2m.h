@@ -92,14 +92,13 @@ int    lwm2m_strncmp(const char * s1, const char * s2, size_t n);
 int    lwm2m_getline(char** line, size_t* length, FILE* f);
 int    lwm2m_strcasecmp(const char * s1, const char * s2);
 #endif
-// This function must return the number of seconds elapsed since origin.
-// The origin (Epoch, system boot, etc...) does not matter as this
-// function is used only to determine the elapsed time since the last
-// call to it.
+// This function must return the number of milliseconds elapsed since origin.
+// The origin (system boot, etc...) does not matter as this function is used
+// only to determine the elapsed time since the last call to it. The clock
+// must be monotonic: it must not jump when the wall clock is adjusted.
 // In case of error, this must return a negative value.
-// Per POSIX specifications, time_t is a signed integer.
 // An implementation for POSIX systems is provided in utils.c
-time_t lwm2m_gettime(void);
+int64_t lwm2m_gettime_ms(void);
 
 /*
  * Error code
@@ -196,6 +195,46 @@ void lwm2m_list_free(lwm2m_list_t * head);
 #define LWM2M_LIST_FIND(H,I) lwm2m_list_find((lwm2m_list_t *)H, I)
 #define LWM2M_LIST_FREE(H) lwm2m_list_free((lwm2m_list_t *)H)
 
+/*
+ * Allocator of the lowest unused ID, for IDs from 0 to LWM2M_MAX_ID included.
+ * Allocation and release take constant time. A zeroed lwm2m_id_set_t is an empty set.
+ */
+
+typedef struct
+{
+    uint64_t *  used;       // bit b of used[w] is set when the ID w * 64 + b is allocated
+    uint64_t *  full;       // bit b of full[w] is set when all the bits of used[w * 64 + b] are set
+    size_t      wordCount;  // size of used, grown on demand
+} lwm2m_id_set_t;
+
+// defined in list.c
+// Allocate the lowest unused ID. Return 0 on success, -1 when all IDs are used or memory is lacking.
+int lwm2m_id_set_alloc(lwm2m_id_set_t * setP, uint16_t * idP);
+// Allocate the given ID. Return 0 on success, -1 when it is already used or memory is lacking.
+int lwm2m_id_set_reserve(lwm2m_id_set_t * setP, uint16_t id);
+// Make 'id' available again
+void lwm2m_id_set_release(lwm2m_id_set_t * setP, uint16_t id);
+// Return the highest allocated ID lower than 'id' or -1 if there is none
+int lwm2m_id_set_previous(lwm2m_id_set_t * setP, uint16_t id);
+// Free the memory used by the set and empty it
+void lwm2m_id_set_clear(lwm2m_id_set_t * setP);
+
+/*
+ * Binary min-heap of the items waiting for a date, such as the transactions waiting for their
+ * retransmission. The items are not copied: the heap keeps pointers and finds the date and the
+ * position of each item at the offsets given at initialization. See utils_heapInit().
+ */
+
+typedef struct
+{
+    void ** items;
+    size_t  count;
+    size_t  size;
+    size_t  reserved;       // slots kept for the items which may be inserted later
+    size_t  timeOffset;     // offset of the int64_t date in the items
+    size_t  indexOffset;    // offset of the size_t position in the heap plus one, 0 when not in the heap
+} lwm2m_heap_t;
+
 
 /*
  *  Resource values
@@ -304,10 +343,34 @@ void lwm2m_data_include(lwm2m_data_t * subDataP, size_t count, lwm2m_data_t * da
 int lwm2m_intToTLV(lwm2m_tlv_type_t type, int64_t data, uint16_t id, uint8_t * buffer, size_t buffer_len);
 int lwm2m_boolToTLV(lwm2m_tlv_type_t type, bool value, uint16_t id, uint8_t * buffer, size_t buffer_len);
 int lwm2m_opaqueToTLV(lwm2m_tlv_type_t type, uint8_t * dataP, size_t data_len, uint16_t id, uint8_t * buffer, size_t buffer_len);
+// Serializes the records of dataP in TLV format in buffer. If buffer is NULL, returns the length needed.
+int lwm2m_dataToTLV(int size, lwm2m_data_t * dataP, uint8_t * buffer, size_t buffer_len);
 int lwm2m_decodeTLV(uint8_t * buffer, size_t buffer_len, lwm2m_tlv_type_t * oType, uint16_t * oID, size_t * oDataIndex, size_t * oDataLen);
 int lwm2m_opaqueToInt(uint8_t * buffer, size_t buffer_len, int64_t * dataP);
 int lwm2m_opaqueToFloat(uint8_t * buffer, size_t buffer_len, double * dataP);
 
+/*
+ * Iterator over the resources of a TLV buffer which does not build any lwm2m_data_t tree. It
+ * steps into the object instances and multiple resources and stops on each resource and resource
+ * instance. instanceId and resourceId are the IDs of the enclosing object instance and multiple
+ * resource, LWM2M_MAX_ID outside of them.
+ */
+typedef struct
+{
+    uint8_t *   buffer;
+    size_t      length;
+    size_t      index;
+    size_t      instanceEnd;
+    size_t      resourceEnd;
+    uint16_t    instanceId;
+    uint16_t    resourceId;
+} lwm2m_tlv_iterator_t;
+
+void lwm2m_tlv_iterator_init(lwm2m_tlv_iterator_t * iteratorP, uint8_t * buffer, size_t length);
+// Returns 1 and the next resource or resource instance in dataP, 0 at the end, -1 if the buffer is malformed.
+// dataP->value points into the buffer.
+int lwm2m_tlv_iterator_next(lwm2m_tlv_iterator_t * iteratorP, lwm2m_data_t * dataP);
+
 /*
  * URI
  *
@@ -399,17 +462,43 @@ typedef enum
     BINDING_UQS  // UDP queue mode plus SMS
 } lwm2m_binding_t;
 
+/*
+ * Outgoing transactions towards a peer
+ *
+ * New requests are started according to the congestion control of RFC 7252 section 4.7:
+ * no more than nstart interactions are outstanding, the others wait in pendingList.
+ * While the peer does not respond, no more than probingRate bytes per second are sent to it.
+ * nstart and probingRate are set to 0 to use the defaults COAP_NSTART and COAP_PROBING_RATE.
+ */
+typedef struct
+{
+    struct _lwm2m_transaction_ * activeList;    // started transactions, chained by peerNext and peerPrev
+    struct _lwm2m_transaction_ * pendingList;   // transactions waiting to be started, oldest first
+    struct _lwm2m_transaction_ * pendingLast;
+    uint8_t     nstart;
+    uint8_t     outstanding;    // number of started interactions not acknowledged yet
+    uint16_t    probingRate;    // in bytes per second
+    bool        unresponsive;   // the last interaction timed out
+    int64_t     probeTime;      // date in milliseconds before which no interaction is started while unresponsive
+} lwm2m_peer_queue_t;
+
 typedef struct _lwm2m_server_
 {
     struct _lwm2m_server_ * next;   // matches lwm2m_list_t::next
     uint16_t          secObjInstID; // matches lwm2m_list_t::id
     uint16_t          shortID;      // servers short ID, may be 0 for bootstrap server
     time_t            lifetime;     // lifetime of the registration in sec or 0 if default value (86400 sec), also used as hold off time for the bootstrap server
-    time_t            registration; // date of the last registration in sec
+    int64_t           registration; // date of the last registration in ms
     lwm2m_binding_t   binding;      // client connection mode with this server
     void *            sessionH;
     lwm2m_status_t    status;
     char *            location;
+    lwm2m_peer_queue_t queue;
+    struct _lwm2m_watcher_ *  watcherList;          // watchers of this server, chained by serverNext
+    struct _lwm2m_watcher_ ** watcherMidTable;      // the same hashed by lastMid, chained by midNext
+    struct _lwm2m_watcher_ ** watcherTokenTable;    // the same hashed by token, chained by tokenNext
+    size_t            watcherTableSize;
+    size_t            watcherCount;
 } lwm2m_server_t;
 
 
@@ -438,8 +527,51 @@ typedef struct _lwm2m_observation_
     lwm2m_status_t          status;
     lwm2m_result_callback_t callback;
     void *                  userData;
+    struct _lwm2m_observation_ *  hashNext;   // next in the bucket of the context's observation table
+    struct _lwm2m_observation_ ** hashPrevP;  // link to this observation in its bucket, NULL when not indexed
+    uint8_t                 token[8];
+    uint8_t                 tokenLen;
+    uint32_t                counter;        // Observe value of the freshest notification
+    int64_t                 counterTime;    // reception date of the freshest notification in ms
 } lwm2m_observation_t;
 
+/*
+ * Batched notifications
+ *
+ * The notifications are decoded in arenas reused from one batch to the next. The dataP trees
+ * point into these arenas and are only valid during the batch callback: they must not be freed.
+ */
+
+typedef struct
+{
+    uint16_t            clientID;
+    lwm2m_uri_t         uri;
+    uint32_t            counter;    // Observe value
+    int64_t             time;       // reception date in ms
+    lwm2m_media_type_t  format;
+    int                 size;       // number of elements in dataP, 0 when the payload could not be decoded
+    lwm2m_data_t *      dataP;
+} lwm2m_notification_t;
+
+typedef void (*lwm2m_notification_callback_t) (lwm2m_notification_t * notifications, size_t count, void * userData);
+
+typedef struct
+{
+    lwm2m_notification_callback_t callback;
+    void *                  userData;
+    size_t                  maxCount;
+    uint32_t                maxDelay;       // in ms
+    lwm2m_notification_t *  items;          // maxCount slots
+    size_t                  count;
+    int64_t                 firstTime;      // reception date of the oldest notification of the batch
+    lwm2m_data_t *          data;           // arena of the decoded elements
+    size_t                  dataCount;
+    size_t                  dataSize;
+    uint8_t *               buffer;         // arena of the payloads
+    size_t                  bufferLength;
+    size_t                  bufferSize;
+} lwm2m_notify_batch_t;
+
 /*
  * LWM2M Clients
  *
@@ -464,10 +596,13 @@ typedef struct _lwm2m_client_
     char *                  msisdn;
     char *                  altPath;
     uint32_t                lifetime;
-    time_t                  endOfLife;
+    int64_t                 endOfLife;  // in ms
+    size_t                  heapIndex;  // position in the context's clientHeap plus one, 0 when absent
     void *                  sessionH;
     lwm2m_client_object_t * objectList;
     lwm2m_observation_t *   observationList;
+    lwm2m_id_set_t          observationIds;
+    lwm2m_peer_queue_t      queue;
 } lwm2m_client_t;
 
 
@@ -492,12 +627,17 @@ struct _lwm2m_transaction_
 {
     lwm2m_transaction_t * next;  // matches lwm2m_list_t::next
     uint16_t              mID;   // matches lwm2m_list_t::id
+    lwm2m_transaction_t * tokenNext;
+    lwm2m_transaction_t * peerNext;
+    lwm2m_transaction_t * peerPrev;
     lwm2m_endpoint_type_t peerType;
     void *                peerP;
     uint8_t               ack_received; // indicates, that the ACK was received
-    time_t                response_timeout; // timeout to wait for response, if token is used. When 0, use calculated acknowledge timeout.
+    uint32_t              response_timeout; // timeout to wait for response in milliseconds, if token is used. When 0, use calculated acknowledge timeout.
     uint8_t  retrans_counter;
-    time_t   retrans_time;
+    uint32_t retrans_timeout;   // current retransmission timeout in milliseconds, doubled at each retransmission
+    int64_t  retrans_time;      // in milliseconds
+    size_t   heapIndex;     // position + 1 in the context's transaction heap, 0 when not scheduled
     char objStringID[LWM2M_STRING_ID_MAX_LEN];
     char instanceStringID[LWM2M_STRING_ID_MAX_LEN];
     char resourceStringID[LWM2M_STRING_ID_MAX_LEN];
@@ -510,24 +650,88 @@ struct _lwm2m_transaction_
 
 /*
  * LWM2M observed resources
+ *
+ * The notification attributes are set by the server with Write-Attributes. Periods are in seconds.
+ * A watcher created by Write-Attributes alone is not active until the server observes the URI.
  */
+#define LWM2M_ATTR_FLAG_MIN_PERIOD      (uint8_t)0x01
+#define LWM2M_ATTR_FLAG_MAX_PERIOD      (uint8_t)0x02
+#define LWM2M_ATTR_FLAG_GREATER_THAN    (uint8_t)0x04
+#define LWM2M_ATTR_FLAG_LESS_THAN       (uint8_t)0x08
+#define LWM2M_ATTR_FLAG_STEP            (uint8_t)0x10
+
+#define LWM2M_ATTR_FLAG_NUMERIC (LWM2M_ATTR_FLAG_GREATER_THAN | LWM2M_ATTR_FLAG_LESS_THAN | LWM2M_ATTR_FLAG_STEP)
+
+typedef struct
+{
+    uint8_t     flags;  // LWM2M_ATTR_FLAG_* of the attributes set
+    uint32_t    minPeriod;
+    uint32_t    maxPeriod;
+    double      greaterThan;
+    double      lessThan;
+    double      step;
+} lwm2m_attributes_t;
+
+struct _lwm2m_observed_;
+
+// Notification waiting for a queue mode server, see lwm2m_set_notification_queue()
+typedef struct
+{
+    lwm2m_media_type_t format;
+    uint8_t *          payload;
+    size_t             length;
+} lwm2m_queued_notification_t;
+
+typedef enum
+{
+    LWM2M_QUEUE_DROP_OLDEST = 0,    // keep the last 'depth' notifications
+    LWM2M_QUEUE_LATEST_ONLY         // keep the last notification only
+} lwm2m_queue_policy_t;
+
 typedef struct _lwm2m_watcher_
 {
     struct _lwm2m_watcher_ * next;
-
+    struct _lwm2m_watcher_ * serverNext;    // indexes of the server, see lwm2m_server_t
+    struct _lwm2m_watcher_ ** serverPrevP;
+    struct _lwm2m_watcher_ * midNext;
+    struct _lwm2m_watcher_ ** midPrevP;
+    struct _lwm2m_watcher_ * tokenNext;
+    struct _lwm2m_watcher_ ** tokenPrevP;
+
+    struct _lwm2m_observed_ * observed;
     lwm2m_server_t * server;
+    bool active;
+    bool update;            // a change is waiting for the minimum period to elapse
     uint8_t token[8];
     size_t tokenLen;
     uint32_t counter;
     uint16_t lastMid;
+    lwm2m_attributes_t attributes;
+    int64_t lastTime;       // date of the last notification in ms
+    double lastValue;       // value of the last notification, for the numerical attributes
+    int64_t nextTime;       // date of the next scheduled notification in ms
+    size_t heapIndex;       // position in the notification heap plus one, 0 when not scheduled
+    uint32_t conCount;      // every conCount-th notification is confirmable, 0 to disable
+    uint32_t conInterval;   // a notification is confirmable when the last one was sent conInterval seconds ago, 0 to disable
+    uint32_t nonCount;      // non-confirmable notifications sent since the last confirmable one
+    int64_t lastConTime;    // date of the last confirmable notification in ms
+    lwm2m_transaction_t * conTransaction;   // confirmable notification waiting for its acknowledgement
+    lwm2m_queued_notification_t * queue;    // ring of the notifications waiting for a queue mode server
+    size_t queueSize;
+    size_t queueStart;
+    size_t queueCount;
 } lwm2m_watcher_t;
 
 typedef struct _lwm2m_observed_
 {
     struct _lwm2m_observed_ * next;
+    struct _lwm2m_observed_ ** prevP;   // the pointer to this one in the context's observedList
+    struct _lwm2m_observed_ * hashNext; // next in the bucket of the observed table
+    struct _lwm2m_observed_ * changedNext; // next in the context's changedList
 
     lwm2m_uri_t uri;
     lwm2m_watcher_t * watcherList;
+    bool changed;                       // in the context's changedList
 } lwm2m_observed_t;
 
 #ifdef LWM2M_BOOTSTRAP
@@ -569,7 +773,7 @@ typedef struct
 #ifdef LWM2M_CLIENT_MODE
 #ifdef LWM2M_BOOTSTRAP
     lwm2m_bootstrap_state_t bsState;
-    time_t              bsStart;
+    int64_t             bsStart;    // in ms
 #endif
     char *              endpointName;
     char *              msisdn;
@@ -579,9 +783,28 @@ typedef struct
     lwm2m_object_t **   objectList;
     uint16_t            numObject;
     lwm2m_observed_t *  observedList;
+    lwm2m_observed_t ** observedTable;      // hash table of the observed URIs, chained by hashNext
+    size_t              observedTableSize;
+    size_t              observedCount;
+    lwm2m_observed_t *  changedList;        // observed URIs to notify at the next lwm2m_step(), chained by changedNext
+    lwm2m_heap_t        watcherHeap;        // the watchers ordered by nextTime
+    uint32_t            notifyConCount;     // confirmable notification settings of the new watchers
+    uint32_t            notifyConInterval;
+    size_t              notifyQueueDepth;   // see lwm2m_set_notification_queue()
+    lwm2m_queue_policy_t notifyQueuePolicy;
 #endif
 #ifdef LWM2M_SERVER_MODE
     lwm2m_client_t *        clientList;
+    lwm2m_id_set_t          clientIds;
+    lwm2m_client_t **       clientNameTable;        // open addressing hash table of the clients by endpoint name
+    lwm2m_client_t **       clientIdTable;          // open addressing hash table of the clients by internalID
+    size_t                  clientTableSize;
+    size_t                  clientCount;
+    lwm2m_heap_t            clientHeap;             // the clients ordered by endOfLife
+    lwm2m_observation_t **  observationTable;       // hash table of the observations by token, chained by hashNext
+    size_t                  observationTableSize;
+    size_t                  observationTableLoad;   // insertions since the table was last sized
+    lwm2m_notify_batch_t    notifyBatch;
     lwm2m_result_callback_t monitorCallback;
     void *                  monitorUserData;
 #endif
@@ -590,7 +813,15 @@ typedef struct
     void *                     bootstrapUserData;
 #endif
     uint16_t                nextMID;
-    lwm2m_transaction_t *   transactionList;
+    uint64_t                randomState;            // state of utils_random()
+    lwm2m_transaction_t **  transactionMidTable;    // hash table of the transactions by mID, chained by next
+    lwm2m_transaction_t **  transactionTokenTable;  // hash table of the requests with a token, chained by tokenNext
+    size_t                  transactionTableSize;
+    size_t                  transactionCount;
+    lwm2m_heap_t            transactionHeap;        // the transactions ordered by retrans_time
+    uint32_t                ackTimeout;             // ACK_TIMEOUT in milliseconds
+    uint16_t                ackRandomFactor;        // ACK_RANDOM_FACTOR in percent
+    uint8_t                 maxRetransmit;          // MAX_RETRANSMIT
     // communication layer callbacks
     lwm2m_connect_server_callback_t connectCallback;
     lwm2m_buffer_send_callback_t    bufferSendCallback;
@@ -603,8 +834,11 @@ lwm2m_context_t * lwm2m_init(lwm2m_connect_server_callback_t connectCallback, lw
 // close a liblwm2m context.
 void lwm2m_close(lwm2m_context_t * contextP);
 
-// perform any required pending operation and adjust timeoutP to the maximal time interval to wait in seconds.
-int lwm2m_step(lwm2m_context_t * contextP, time_t * timeoutP);
+// perform any required pending operation and adjust timeoutP to the maximal time interval to wait in milliseconds.
+int lwm2m_step(lwm2m_context_t * contextP, int64_t * timeoutP);
+// set the CoAP transmission parameters of RFC 7252 section 4.8 used by the new transactions.
+// ackTimeout is in milliseconds, ackRandomFactor in percent (150 for the default 1.5).
+int lwm2m_set_transmission_parameters(lwm2m_context_t * contextP, uint32_t ackTimeout, uint16_t ackRandomFactor, uint8_t maxRetransmit);
 // dispatch received data to liblwm2m
 void lwm2m_handle_packet(lwm2m_context_t * contextP, uint8_t * buffer, int length, void * fromSessionH);
 
@@ -621,7 +855,26 @@ int lwm2m_start(lwm2m_context_t * contextP);
 // send a registration update to the server specified by the server short identifier
 int lwm2m_update_registration(lwm2m_context_t * contextP, uint16_t shortServerID);
 
+// Set the congestion control parameters used towards the server specified by the server short identifier.
+// See lwm2m_set_client_congestion().
+int lwm2m_set_server_congestion(lwm2m_context_t * contextP, uint16_t shortServerID, uint8_t nstart, uint16_t probingRate);
+
+// Report a change of the value of uriP. The observers are notified at the next lwm2m_step(), once per
+// observed URI whatever the number of changes it covers meanwhile.
 void lwm2m_resource_value_changed(lwm2m_context_t * contextP, lwm2m_uri_t * uriP);
+
+// Send every count-th notification as confirmable, and also the first one after interval seconds without any.
+// A value of 0 disables the rule. These settings apply to the current and future observations.
+// A confirmable notification is sent at most once at a time per observation: the changes occurring meanwhile
+// are sent once it is acknowledged. An observation whose confirmable notification is not acknowledged is cancelled.
+void lwm2m_set_notification_confirmable(lwm2m_context_t * contextP, uint32_t count, uint32_t interval);
+// Same for the observation of uriP by the server specified by the server short identifier only.
+int lwm2m_set_watcher_confirmable(lwm2m_context_t * contextP, uint16_t shortServerID, lwm2m_uri_t * uriP, uint32_t count, uint32_t interval);
+// The notifications towards a server in queue mode (UQ, SQ or UQS binding) are kept while the client sleeps and sent
+// in one burst once a registration update succeeds. Up to depth notifications are kept per observation, the oldest
+// being dropped first, or only the latest one. The default is the latest one only. A new depth applies to the
+// observations having no notification pending.
+int lwm2m_set_notification_queue(lwm2m_context_t * contextP, size_t depth, lwm2m_queue_policy_t policy);
 #endif
 
 #ifdef LWM2M_SERVER_MODE
@@ -633,6 +886,11 @@ void lwm2m_resource_value_changed(lwm2m_context_t * contextP, lwm2m_uri_t * uriP
 // The lwm2m_client_t is present in the lwm2m_context_t's clientList when the callback is called. On a deregistration, it deleted when the callback returns.
 void lwm2m_set_monitoring_callback(lwm2m_context_t * contextP, lwm2m_result_callback_t callback, void * userData);
 
+// Set the congestion control parameters used towards a client: the maximum number of simultaneous
+// outstanding requests and the data rate in bytes per second while the client does not respond.
+// 0 means the default value.
+int lwm2m_set_client_congestion(lwm2m_context_t * contextP, uint16_t clientID, uint8_t nstart, uint16_t probingRate);
+
 // Device Management APIs
 int lwm2m_dm_read(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
 int lwm2m_dm_write(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_media_type_t format, uint8_t * buffer, int length, lwm2m_result_callback_t callback, void * userData);
@@ -643,6 +901,23 @@ int lwm2m_dm_delete(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t *
 // Information Reporting APIs
 int lwm2m_observe(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
 int lwm2m_observe_cancel(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
+
+// Give the notifications of all the observations to the callback in batches of up to maxCount, at the latest
+// maxDelay ms after the reception of the oldest one, instead of calling the callback of each observation.
+// The pending notifications are delivered first. A NULL callback restores the per-observation callbacks.
+int lwm2m_set_notification_batch(lwm2m_context_t * contextP, size_t maxCount, uint32_t maxDelay, lwm2m_notification_callback_t callback, void * userData);
+
+// Snapshot of the registered clients and of their acknowledged observations.
+// The session callbacks convert a session handle to and from up to LWM2M_SNAPSHOT_SESSION_MAX_LENGTH bytes,
+// the save callback returning the number of bytes written. The load callback returns NULL on error.
+#define LWM2M_SNAPSHOT_SESSION_MAX_LENGTH 255
+typedef size_t (*lwm2m_session_save_callback_t) (void * sessionH, uint8_t * buffer, size_t length, void * userData);
+typedef void * (*lwm2m_session_load_callback_t) (const uint8_t * buffer, size_t length, void * userData);
+// Return the length of the snapshot, or 0 if it does not fit in buffer. With a NULL buffer, only return the length.
+size_t lwm2m_snapshot_save(lwm2m_context_t * contextP, uint8_t * buffer, size_t length, lwm2m_session_save_callback_t saveCallback, void * userData);
+// Restore a snapshot in a context without any client. The restored observations report to callback.
+// The buffer can be released or unmapped on return.
+int lwm2m_snapshot_restore(lwm2m_context_t * contextP, const uint8_t * buffer, size_t length, lwm2m_session_load_callback_t loadCallback, void * loadUserData, lwm2m_result_callback_t callback, void * userData);
 #endif
 
 #ifdef LWM2M_BOOTSTRAP_SERVER_MODE
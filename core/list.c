@@ -112,6 +112,176 @@ uint16_t lwm2m_list_newId(lwm2m_list_t * head)
     return id;
 }
 
+#define PRV_ID_WORD_COUNT   ((LWM2M_MAX_ID + 1) / 64)
+
+static int prv_lowestZero(uint64_t word)
+{
+#ifdef __GNUC__
+    return __builtin_ctzll(~word);
+#else
+    int bit = 0;
+
+    while (word & 1)
+    {
+        word >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+static int prv_highestOne(uint64_t word)
+{
+#ifdef __GNUC__
+    return 63 - __builtin_clzll(word);
+#else
+    int bit = 63;
+
+    while (0 == (word & ((uint64_t)1 << bit)))
+    {
+        bit--;
+    }
+    return bit;
+#endif
+}
+
+static int prv_growIdSet(lwm2m_id_set_t * setP)
+{
+    uint64_t * used;
+    uint64_t * full;
+    size_t count;
+
+    count = setP->wordCount == 0 ? 1 : setP->wordCount * 2;
+    if (count > PRV_ID_WORD_COUNT) return -1;
+
+    used = (uint64_t *)lwm2m_malloc(count * sizeof(uint64_t));
+    if (NULL == used) return -1;
+    full = (uint64_t *)lwm2m_malloc(((count + 63) / 64) * sizeof(uint64_t));
+    if (NULL == full)
+    {
+        lwm2m_free(used);
+        return -1;
+    }
+    memset(used, 0, count * sizeof(uint64_t));
+    memset(full, 0, ((count + 63) / 64) * sizeof(uint64_t));
+    if (0 != setP->wordCount)
+    {
+        memcpy(used, setP->used, setP->wordCount * sizeof(uint64_t));
+        memcpy(full, setP->full, ((setP->wordCount + 63) / 64) * sizeof(uint64_t));
+        lwm2m_free(setP->used);
+        lwm2m_free(setP->full);
+    }
+    setP->used = used;
+    setP->full = full;
+    setP->wordCount = count;
+
+    return 0;
+}
+
+int lwm2m_id_set_alloc(lwm2m_id_set_t * setP,
+                       uint16_t * idP)
+{
+    size_t word;
+    size_t i;
+    int bit;
+
+    // the first word with a free ID is found from the summary, at most PRV_ID_WORD_COUNT / 64 reads
+    word = setP->wordCount;
+    for (i = 0 ; i < (setP->wordCount + 63) / 64 ; i++)
+    {
+        if (~setP->full[i] != 0)
+        {
+            word = i * 64 + prv_lowestZero(setP->full[i]);
+            break;
+        }
+    }
+    if (word >= setP->wordCount)
+    {
+        word = setP->wordCount;
+        if (0 != prv_growIdSet(setP)) return -1;
+    }
+
+    bit = prv_lowestZero(setP->used[word]);
+    setP->used[word] |= (uint64_t)1 << bit;
+    if (~setP->used[word] == 0)
+    {
+        setP->full[word / 64] |= (uint64_t)1 << (word % 64);
+    }
+
+    *idP = (uint16_t)(word * 64 + bit);
+
+    return 0;
+}
+
+int lwm2m_id_set_reserve(lwm2m_id_set_t * setP,
+                         uint16_t id)
+{
+    size_t word = id / 64;
+    uint64_t bit = (uint64_t)1 << (id % 64);
+
+    while (word >= setP->wordCount)
+    {
+        if (0 != prv_growIdSet(setP)) return -1;
+    }
+    if (0 != (setP->used[word] & bit)) return -1;
+
+    setP->used[word] |= bit;
+    if (~setP->used[word] == 0)
+    {
+        setP->full[word / 64] |= (uint64_t)1 << (word % 64);
+    }
+
+    return 0;
+}
+
+void lwm2m_id_set_release(lwm2m_id_set_t * setP,
+                          uint16_t id)
+{
+    size_t word = id / 64;
+
+    if (word >= setP->wordCount) return;
+
+    setP->used[word] &= ~((uint64_t)1 << (id % 64));
+    setP->full[word / 64] &= ~((uint64_t)1 << (word % 64));
+}
+
+int lwm2m_id_set_previous(lwm2m_id_set_t * setP,
+                          uint16_t id)
+{
+    size_t word = id / 64;
+    uint64_t bits;
+
+    if (word >= setP->wordCount)
+    {
+        if (0 == setP->wordCount) return -1;
+        word = setP->wordCount - 1;
+        bits = setP->used[word];
+    }
+    else
+    {
+        bits = setP->used[word] & ((((uint64_t)1) << (id % 64)) - 1);
+    }
+
+    while (0 == bits)
+    {
+        if (0 == word) return -1;
+        word--;
+        bits = setP->used[word];
+    }
+
+    return (int)(word * 64 + prv_highestOne(bits));
+}
+
+void lwm2m_id_set_clear(lwm2m_id_set_t * setP)
+{
+    if (0 != setP->wordCount)
+    {
+        lwm2m_free(setP->used);
+        lwm2m_free(setP->full);
+    }
+    memset(setP, 0, sizeof(lwm2m_id_set_t));
+}
+
 void lwm2m_list_free(lwm2m_list_t * head)
 {
     if (head != NULL)
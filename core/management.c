@@ -140,7 +140,7 @@ coap_status_t handle_dm_request(lwm2m_context_t * contextP,
             {
                 if (IS_OPTION(message, COAP_OPTION_OBSERVE))
                 {
-                    result = handle_observe_request(contextP, uriP, serverP, message, response);
+                    result = handle_observe_request(contextP, uriP, serverP, message, response, format, buffer, length);
                 }
                 if (COAP_205_CONTENT == result)
                 {
@@ -208,7 +208,11 @@ coap_status_t handle_dm_request(lwm2m_context_t * contextP,
 
     case COAP_PUT:
         {
-            if (LWM2M_URI_IS_SET_INSTANCE(uriP))
+            if (IS_OPTION(message, COAP_OPTION_URI_QUERY))
+            {
+                result = handle_write_attributes(contextP, uriP, serverP, message->uri_query);
+            }
+            else if (LWM2M_URI_IS_SET_INSTANCE(uriP))
             {
 #ifdef LWM2M_BOOTSTRAP
                 if (contextP->bsState == BOOTSTRAP_PENDING && object_isInstanceNew(contextP, uriP->objectId, uriP->instanceId))
@@ -363,7 +367,7 @@ static int prv_make_operation(lwm2m_context_t * contextP,
     lwm2m_transaction_t * transaction;
     dm_data_t * dataP;
 
-    clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, clientID);
+    clientP = registration_find_client(contextP, clientID);
     if (clientP == NULL) return COAP_404_NOT_FOUND;
 
     transaction = transaction_new(COAP_TYPE_CON, method, clientP->altPath, uriP, contextP->nextMID++, 4, NULL, ENDPOINT_CLIENT, (void *)clientP);
@@ -392,11 +396,26 @@ static int prv_make_operation(lwm2m_context_t * contextP,
         transaction->userData = (void *)dataP;
     }
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
+    transaction_add(contextP, transaction);
 
     return transaction_send(contextP, transaction);
 }
 
+int lwm2m_set_client_congestion(lwm2m_context_t * contextP,
+                                uint16_t clientID,
+                                uint8_t nstart,
+                                uint16_t probingRate)
+{
+    lwm2m_client_t * clientP;
+
+    clientP = registration_find_client(contextP, clientID);
+    if (clientP == NULL) return COAP_404_NOT_FOUND;
+
+    transaction_set_congestion(contextP, &clientP->queue, nstart, probingRate);
+
+    return COAP_NO_ERROR;
+}
+
 int lwm2m_dm_read(lwm2m_context_t * contextP,
                   uint16_t clientID,
                   lwm2m_uri_t * uriP,
@@ -84,16 +84,16 @@ static lwm2m_object_t * prv_find_object(lwm2m_context_t * contextP,
     return NULL;
 }
 
-coap_status_t object_read(lwm2m_context_t * contextP,
-                          lwm2m_uri_t * uriP,
-                          lwm2m_media_type_t * formatP,
-                          uint8_t ** bufferP,
-                          size_t * lengthP)
+coap_status_t object_readData(lwm2m_context_t * contextP,
+                              lwm2m_uri_t * uriP,
+                              int * sizeP,
+                              lwm2m_data_t ** dataP)
 {
     coap_status_t result;
     lwm2m_object_t * targetP;
-    lwm2m_data_t * dataP = NULL;
-    int size = 0;
+
+    *sizeP = 0;
+    *dataP = NULL;
 
 #ifdef LWM2M_BOOTSTRAP
     if (contextP->bsState == BOOTSTRAP_PENDING) return METHOD_NOT_ALLOWED_4_05;
@@ -125,34 +125,26 @@ coap_status_t object_read(lwm2m_context_t * contextP,
             lwm2m_list_t * instanceP;
             int i;
 
-            size = 0;
             for (instanceP = targetP->instanceList; instanceP != NULL ; instanceP = instanceP->next)
             {
-                size++;
+                (*sizeP)++;
             }
 
-            dataP = lwm2m_data_new(size);
-            if (dataP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
+            *dataP = lwm2m_data_new(*sizeP);
+            if (*dataP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
 
             result = COAP_205_CONTENT;
             instanceP = targetP->instanceList;
             i = 0;
             while (instanceP != NULL && result == COAP_205_CONTENT)
             {
-                result = targetP->readFunc(instanceP->id, (int*)&(dataP[i].length), (lwm2m_data_t **)&(dataP[i].value), targetP);
-                dataP[i].type = LWM2M_TYPE_OBJECT_INSTANCE;
-                dataP[i].id = instanceP->id;
+                result = targetP->readFunc(instanceP->id, (int*)&((*dataP)[i].length), (lwm2m_data_t **)&((*dataP)[i].value), targetP);
+                (*dataP)[i].type = LWM2M_TYPE_OBJECT_INSTANCE;
+                (*dataP)[i].id = instanceP->id;
                 i++;
                 instanceP = instanceP->next;
             }
 
-            if (result == COAP_205_CONTENT)
-            {
-                *lengthP = lwm2m_data_serialize(size, dataP, formatP, bufferP);
-                if (*lengthP == 0) result = COAP_500_INTERNAL_SERVER_ERROR;
-            }
-            lwm2m_data_free(size, dataP);
-
             return result;
         }
     }
@@ -160,15 +152,29 @@ coap_status_t object_read(lwm2m_context_t * contextP,
     // single instance read
     if (LWM2M_URI_IS_SET_RESOURCE(uriP))
     {
-        size = 1;
-        dataP = lwm2m_data_new(size);
-        if (dataP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
+        *sizeP = 1;
+        *dataP = lwm2m_data_new(*sizeP);
+        if (*dataP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
 
-        dataP->type = LWM2M_TYPE_RESOURCE;
-        dataP->flags = LWM2M_TLV_FLAG_TEXT_FORMAT;
-        dataP->id = uriP->resourceId;
+        (*dataP)->type = LWM2M_TYPE_RESOURCE;
+        (*dataP)->flags = LWM2M_TLV_FLAG_TEXT_FORMAT;
+        (*dataP)->id = uriP->resourceId;
     }
-    result = targetP->readFunc(uriP->instanceId, &size, &dataP, targetP);
+
+    return targetP->readFunc(uriP->instanceId, sizeP, dataP, targetP);
+}
+
+coap_status_t object_read(lwm2m_context_t * contextP,
+                          lwm2m_uri_t * uriP,
+                          lwm2m_media_type_t * formatP,
+                          uint8_t ** bufferP,
+                          size_t * lengthP)
+{
+    coap_status_t result;
+    lwm2m_data_t * dataP = NULL;
+    int size = 0;
+
+    result = object_readData(contextP, uriP, &size, &dataP);
     if (result == COAP_205_CONTENT)
     {
         if (size == 1
@@ -236,7 +242,7 @@ coap_status_t object_write(lwm2m_context_t * contextP,
         }
         else
         {
-            size = lwm2m_data_parse(buffer, length, format, &dataP);
+            size = data_parse(uriP, buffer, length, format, &dataP);
             if (size == 0)
             {
                 result = COAP_500_INTERNAL_SERVER_ERROR;
@@ -296,7 +302,9 @@ coap_status_t object_create(lwm2m_context_t * contextP,
 {
     lwm2m_object_t * targetP;
     lwm2m_data_t * dataP = NULL;
+    lwm2m_data_t * resourceP;
     int size = 0;
+    int resourceCount;
     uint8_t result;
 
     if (length == 0 || buffer == 0)
@@ -315,22 +323,58 @@ coap_status_t object_create(lwm2m_context_t * contextP,
             // Instance already exists
             return COAP_406_NOT_ACCEPTABLE;
         }
+        size = data_parse(uriP, buffer, length, format, &dataP);
     }
     else
+    {
+        size = data_parse(NULL, buffer, length, format, &dataP);
+    }
+    if (size == 0) return COAP_500_INTERNAL_SERVER_ERROR;
+
+    // the payload may hold the new instance instead of its resources
+    resourceP = dataP;
+    resourceCount = size;
+    if (size == 1 && dataP->type == LWM2M_TYPE_OBJECT_INSTANCE)
+    {
+        if (LWM2M_URI_IS_SET_INSTANCE(uriP))
+        {
+            if (dataP->id != uriP->instanceId)
+            {
+                lwm2m_data_free(size, dataP);
+                return BAD_REQUEST_4_00;
+            }
+        }
+        else
+        {
+            if (NULL != lwm2m_list_find(targetP->instanceList, dataP->id))
+            {
+                lwm2m_data_free(size, dataP);
+                return COAP_406_NOT_ACCEPTABLE;
+            }
+            uriP->instanceId = dataP->id;
+            uriP->flag |= LWM2M_URI_FLAG_INSTANCE_ID;
+        }
+        resourceP = (lwm2m_data_t *)dataP->value;
+        resourceCount = (int)dataP->length;
+        if (resourceCount == 0)
+        {
+            lwm2m_data_free(size, dataP);
+            return BAD_REQUEST_4_00;
+        }
+    }
+    if (!LWM2M_URI_IS_SET_INSTANCE(uriP))
     {
         uriP->instanceId = lwm2m_list_newId(targetP->instanceList);
         uriP->flag |= LWM2M_URI_FLAG_INSTANCE_ID;
     }
 
-    size = lwm2m_data_parse(buffer, length, format, &dataP);
-    if (size == 0) return COAP_500_INTERNAL_SERVER_ERROR;
 #ifdef LWM2M_BOOTSTRAP
     if (contextP->bsState == BOOTSTRAP_PENDING)
     {
-        dataP->flags |= LWM2M_TLV_FLAG_BOOTSTRAPPING;
+        resourceP->flags |= LWM2M_TLV_FLAG_BOOTSTRAPPING;
     }
 #endif
-    result = targetP->createFunc(uriP->instanceId, size, dataP, targetP);
+    result = targetP->createFunc(uriP->instanceId, resourceCount, resourceP, targetP);
     lwm2m_data_free(size, dataP);
 
     return result;
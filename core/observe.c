@@ -51,86 +51,357 @@
 #include <stdio.h>
 
 
+
 #ifdef LWM2M_CLIENT_MODE
+
+#define PRV_OBSERVED_TABLE_INITIAL_SIZE 16
+
+// Hash of the identifiers set in the URI
+static size_t prv_hashUri(lwm2m_uri_t * uriP)
+{
+    uint8_t key[9];
+    uint32_t ids[3];
+    size_t i;
+
+    ids[0] = ((uint32_t)(uriP->flag & LWM2M_URI_MASK_ID) << 16) | uriP->objectId;
+    ids[1] = LWM2M_URI_IS_SET_INSTANCE(uriP) ? uriP->instanceId : 0;
+    ids[2] = LWM2M_URI_IS_SET_RESOURCE(uriP) ? uriP->resourceId : 0;
+
+    for (i = 0 ; i < 3 ; i++)
+    {
+        key[3 * i] = ids[i] & 0xFF;
+        key[3 * i + 1] = (ids[i] >> 8) & 0xFF;
+        key[3 * i + 2] = (ids[i] >> 16) & 0xFF;
+    }
+
+    return utils_hash(key, sizeof(key));
+}
+
+static bool prv_matchUri(lwm2m_uri_t * targetP,
+                         lwm2m_uri_t * uriP)
+{
+    return targetP->objectId == uriP->objectId
+        && (targetP->flag & LWM2M_URI_MASK_ID) == (uriP->flag & LWM2M_URI_MASK_ID)
+        && (!LWM2M_URI_IS_SET_INSTANCE(uriP) || targetP->instanceId == uriP->instanceId)
+        && (!LWM2M_URI_IS_SET_RESOURCE(uriP) || targetP->resourceId == uriP->resourceId);
+}
+
 static lwm2m_observed_t * prv_findObserved(lwm2m_context_t * contextP,
                                            lwm2m_uri_t * uriP)
 {
     lwm2m_observed_t * targetP;
 
-    targetP = contextP->observedList;
+    if (0 == contextP->observedTableSize) return NULL;
+
+    targetP = contextP->observedTable[prv_hashUri(uriP) & (contextP->observedTableSize - 1)];
     while (targetP != NULL
-        && (targetP->uri.objectId != uriP->objectId
-         || targetP->uri.flag != uriP->flag
-         || (LWM2M_URI_IS_SET_INSTANCE(uriP) && targetP->uri.instanceId != uriP->instanceId)
-         || (LWM2M_URI_IS_SET_RESOURCE(uriP) && targetP->uri.resourceId != uriP->resourceId)))
+        && !prv_matchUri(&targetP->uri, uriP))
     {
-        targetP = targetP->next;
+        targetP = targetP->hashNext;
     }
 
     return targetP;
 }
 
-static obs_list_t * prv_getObservedList(lwm2m_context_t * contextP,
-                                        lwm2m_uri_t * uriP)
+static int prv_resizeObservedTable(lwm2m_context_t * contextP,
+                                   size_t size)
 {
-    obs_list_t * resultP;
+    lwm2m_observed_t ** tableP;
     lwm2m_observed_t * targetP;
 
-    resultP = NULL;
+    tableP = (lwm2m_observed_t **)lwm2m_malloc(size * sizeof(lwm2m_observed_t *));
+    if (NULL == tableP) return COAP_500_INTERNAL_SERVER_ERROR;
+    memset(tableP, 0, size * sizeof(lwm2m_observed_t *));
 
-    targetP = contextP->observedList;
-    while (targetP != NULL)
+    for (targetP = contextP->observedList ; targetP != NULL ; targetP = targetP->next)
+    {
+        size_t index = prv_hashUri(&targetP->uri) & (size - 1);
+
+        targetP->hashNext = tableP[index];
+        tableP[index] = targetP;
+    }
+
+    if (NULL != contextP->observedTable)
+    {
+        lwm2m_free(contextP->observedTable);
+    }
+    contextP->observedTable = tableP;
+    contextP->observedTableSize = size;
+
+    return 0;
+}
+
+static int prv_linkObserved(lwm2m_context_t * contextP,
+                            lwm2m_observed_t * observedP)
+{
+    size_t index;
+
+    if (contextP->observedCount >= contextP->observedTableSize)
     {
-        if (targetP->uri.objectId == uriP->objectId)
+        size_t size = contextP->observedTableSize == 0 ? PRV_OBSERVED_TABLE_INITIAL_SIZE : 2 * contextP->observedTableSize;
+
+        if (0 != prv_resizeObservedTable(contextP, size)
+         && 0 == contextP->observedTableSize)
         {
-            if (!LWM2M_URI_IS_SET_INSTANCE(uriP)
-             || (targetP->uri.flag & LWM2M_URI_FLAG_INSTANCE_ID) == 0
-             || uriP->instanceId == targetP->uri.instanceId)
-            {
-                if (!LWM2M_URI_IS_SET_RESOURCE(uriP)
-                 || (targetP->uri.flag & LWM2M_URI_FLAG_RESOURCE_ID) == 0
-                 || uriP->resourceId == targetP->uri.resourceId)
-                {
-                    obs_list_t * newP;
-
-                    newP = (obs_list_t *)lwm2m_malloc(sizeof(obs_list_t));
-                    if (newP != NULL)
-                    {
-                        newP->item = targetP;
-                        newP->next = resultP;
-                        resultP = newP;
-                    }
-                }
-            }
+            return COAP_500_INTERNAL_SERVER_ERROR;
         }
-        targetP = targetP->next;
     }
 
-    return resultP;
+    observedP->next = contextP->observedList;
+    if (NULL != observedP->next) observedP->next->prevP = &observedP->next;
+    contextP->observedList = observedP;
+    observedP->prevP = &contextP->observedList;
+
+    index = prv_hashUri(&observedP->uri) & (contextP->observedTableSize - 1);
+    observedP->hashNext = contextP->observedTable[index];
+    contextP->observedTable[index] = observedP;
+    contextP->observedCount++;
+
+    return 0;
 }
 
-static void prv_unlinkObserved(lwm2m_context_t * contextP,
+static void prv_unhashObserved(lwm2m_context_t * contextP,
                                lwm2m_observed_t * observedP)
 {
-    if (contextP->observedList == observedP)
+    lwm2m_observed_t ** bucketP;
+
+    bucketP = contextP->observedTable + (prv_hashUri(&observedP->uri) & (contextP->observedTableSize - 1));
+    while (NULL != *bucketP && *bucketP != observedP)
     {
-        contextP->observedList = contextP->observedList->next;
+        bucketP = &(*bucketP)->hashNext;
     }
-    else
+    if (NULL != *bucketP)
     {
-        lwm2m_observed_t * parentP;
+        *bucketP = observedP->hashNext;
+        contextP->observedCount--;
+    }
+}
+
+static void prv_unlinkObserved(lwm2m_context_t * contextP,
+                               lwm2m_observed_t * observedP)
+{
+    lwm2m_observed_t ** bucketP;
 
-        parentP = contextP->observedList;
-        while (parentP->next != NULL
-            && parentP->next != observedP)
+    prv_unhashObserved(contextP, observedP);
+
+    if (observedP->changed)
+    {
+        bucketP = &contextP->changedList;
+        while (*bucketP != observedP)
         {
-            parentP = parentP->next;
+            bucketP = &(*bucketP)->changedNext;
         }
-        if (parentP->next != NULL)
+        *bucketP = observedP->changedNext;
+    }
+
+    *observedP->prevP = observedP->next;
+    if (NULL != observedP->next) observedP->next->prevP = observedP->prevP;
+}
+
+/*
+ * Watchers waiting for their minimum period to elapse or for their maximum period to expire
+ * are kept in the watcherHeap of the context, ordered by nextTime, so that lwm2m_step() only
+ * looks at the top of the heap.
+ */
+static int64_t prv_minTime(lwm2m_watcher_t * watcherP)
+{
+    if ((watcherP->attributes.flags & LWM2M_ATTR_FLAG_MIN_PERIOD) == 0) return watcherP->lastTime;
+
+    return watcherP->lastTime + (int64_t)watcherP->attributes.minPeriod * 1000;
+}
+
+// Compute the next notification date of the watcher and move it in the heap accordingly. The date
+// is always after currentTime so that a step never handles the same watcher twice.
+static void prv_reschedule(lwm2m_context_t * contextP,
+                           lwm2m_watcher_t * watcherP,
+                           int64_t currentTime)
+{
+    if (!watcherP->active || NULL != watcherP->conTransaction)
+    {
+        utils_heapUnschedule(&contextP->watcherHeap, watcherP);
+        return;
+    }
+
+    if (watcherP->update)
+    {
+        watcherP->nextTime = prv_minTime(watcherP);
+    }
+    else if ((watcherP->attributes.flags & LWM2M_ATTR_FLAG_MAX_PERIOD) != 0)
+    {
+        watcherP->nextTime = watcherP->lastTime + (int64_t)watcherP->attributes.maxPeriod * 1000;
+    }
+    else
+    {
+        utils_heapUnschedule(&contextP->watcherHeap, watcherP);
+        return;
+    }
+    if (watcherP->nextTime <= currentTime) watcherP->nextTime = currentTime + 1;
+
+    // cannot fail: prv_getWatcher() reserved a slot for each watcher
+    utils_heapSchedule(&contextP->watcherHeap, watcherP);
+}
+
+/*
+ * Each server indexes its watchers by the message ID of their last notification, to match the
+ * Reset messages, and by token, to match the cancellations by a GET with Observe=1.
+ * The chains are doubly linked to unlink a watcher in constant time.
+ */
+#define PRV_WATCHER_TABLE_INITIAL_SIZE  16
+
+static void prv_indexMid(lwm2m_server_t * serverP,
+                         lwm2m_watcher_t * watcherP)
+{
+    lwm2m_watcher_t ** bucketP = serverP->watcherMidTable + (watcherP->lastMid & (serverP->watcherTableSize - 1));
+
+    watcherP->midNext = *bucketP;
+    if (NULL != *bucketP) (*bucketP)->midPrevP = &watcherP->midNext;
+    *bucketP = watcherP;
+    watcherP->midPrevP = bucketP;
+}
+
+static void prv_unindexMid(lwm2m_watcher_t * watcherP)
+{
+    if (NULL == watcherP->midPrevP) return;
+
+    *watcherP->midPrevP = watcherP->midNext;
+    if (NULL != watcherP->midNext) watcherP->midNext->midPrevP = watcherP->midPrevP;
+    watcherP->midPrevP = NULL;
+}
+
+static void prv_indexToken(lwm2m_server_t * serverP,
+                           lwm2m_watcher_t * watcherP)
+{
+    lwm2m_watcher_t ** bucketP = serverP->watcherTokenTable + (utils_hash(watcherP->token, watcherP->tokenLen) & (serverP->watcherTableSize - 1));
+
+    watcherP->tokenNext = *bucketP;
+    if (NULL != *bucketP) (*bucketP)->tokenPrevP = &watcherP->tokenNext;
+    *bucketP = watcherP;
+    watcherP->tokenPrevP = bucketP;
+}
+
+static void prv_unindexToken(lwm2m_watcher_t * watcherP)
+{
+    if (NULL == watcherP->tokenPrevP) return;
+
+    *watcherP->tokenPrevP = watcherP->tokenNext;
+    if (NULL != watcherP->tokenNext) watcherP->tokenNext->tokenPrevP = watcherP->tokenPrevP;
+    watcherP->tokenPrevP = NULL;
+}
+
+static int prv_resizeWatcherTables(lwm2m_server_t * serverP,
+                                   size_t size)
+{
+    lwm2m_watcher_t ** tableP;
+    lwm2m_watcher_t * watcherP;
+
+    tableP = (lwm2m_watcher_t **)lwm2m_malloc(2 * size * sizeof(lwm2m_watcher_t *));
+    if (NULL == tableP) return COAP_500_INTERNAL_SERVER_ERROR;
+    memset(tableP, 0, 2 * size * sizeof(lwm2m_watcher_t *));
+
+    // both tables share one allocation
+    if (NULL != serverP->watcherMidTable) lwm2m_free(serverP->watcherMidTable);
+    serverP->watcherMidTable = tableP;
+    serverP->watcherTokenTable = tableP + size;
+    serverP->watcherTableSize = size;
+
+    for (watcherP = serverP->watcherList ; watcherP != NULL ; watcherP = watcherP->serverNext)
+    {
+        prv_indexMid(serverP, watcherP);
+        prv_indexToken(serverP, watcherP);
+    }
+
+    return 0;
+}
+
+static int prv_linkWatcher(lwm2m_server_t * serverP,
+                           lwm2m_watcher_t * watcherP)
+{
+    if (serverP->watcherCount >= serverP->watcherTableSize)
+    {
+        size_t size = serverP->watcherTableSize == 0 ? PRV_WATCHER_TABLE_INITIAL_SIZE : 2 * serverP->watcherTableSize;
+
+        if (0 != prv_resizeWatcherTables(serverP, size)
+         && 0 == serverP->watcherTableSize)
         {
-            parentP->next = parentP->next->next;
+            return COAP_500_INTERNAL_SERVER_ERROR;
         }
     }
+
+    watcherP->serverNext = serverP->watcherList;
+    if (NULL != serverP->watcherList) serverP->watcherList->serverPrevP = &watcherP->serverNext;
+    serverP->watcherList = watcherP;
+    watcherP->serverPrevP = &serverP->watcherList;
+    serverP->watcherCount++;
+
+    prv_indexMid(serverP, watcherP);
+    prv_indexToken(serverP, watcherP);
+
+    return 0;
+}
+
+static void prv_unlinkWatcher(lwm2m_watcher_t * watcherP)
+{
+    *watcherP->serverPrevP = watcherP->serverNext;
+    if (NULL != watcherP->serverNext) watcherP->serverNext->serverPrevP = watcherP->serverPrevP;
+    watcherP->server->watcherCount--;
+
+    prv_unindexMid(watcherP);
+    prv_unindexToken(watcherP);
+}
+
+static void prv_setMid(lwm2m_watcher_t * watcherP,
+                       uint16_t mid)
+{
+    prv_unindexMid(watcherP);
+    watcherP->lastMid = mid;
+    prv_indexMid(watcherP->server, watcherP);
+}
+
+static void prv_setToken(lwm2m_watcher_t * watcherP,
+                         const uint8_t * token,
+                         size_t tokenLen)
+{
+    prv_unindexToken(watcherP);
+    watcherP->tokenLen = tokenLen;
+    memcpy(watcherP->token, token, tokenLen);
+    prv_indexToken(watcherP->server, watcherP);
+}
+
+static lwm2m_watcher_t * prv_findWatcherByMid(lwm2m_server_t * serverP,
+                                              uint16_t mid)
+{
+    lwm2m_watcher_t * watcherP;
+
+    if (0 == serverP->watcherTableSize) return NULL;
+
+    watcherP = serverP->watcherMidTable[mid & (serverP->watcherTableSize - 1)];
+    while (NULL != watcherP
+        && (!watcherP->active || watcherP->lastMid != mid))
+    {
+        watcherP = watcherP->midNext;
+    }
+
+    return watcherP;
+}
+
+static lwm2m_watcher_t * prv_findWatcherByToken(lwm2m_server_t * serverP,
+                                                const uint8_t * token,
+                                                size_t tokenLen)
+{
+    lwm2m_watcher_t * watcherP;
+
+    if (0 == serverP->watcherTableSize) return NULL;
+
+    watcherP = serverP->watcherTokenTable[utils_hash(token, tokenLen) & (serverP->watcherTableSize - 1)];
+    while (NULL != watcherP
+        && (!watcherP->active
+         || watcherP->tokenLen != tokenLen
+         || 0 != memcmp(watcherP->token, token, tokenLen)))
+    {
+        watcherP = watcherP->tokenNext;
+    }
+
+    return watcherP;
 }
 
 static lwm2m_watcher_t * prv_findWatcher(lwm2m_observed_t * observedP,
@@ -148,155 +419,1141 @@ static lwm2m_watcher_t * prv_findWatcher(lwm2m_observed_t * observedP,
     return targetP;
 }
 
-coap_status_t handle_observe_request(lwm2m_context_t * contextP,
-                                     lwm2m_uri_t * uriP,
-                                     lwm2m_server_t * serverP,
-                                     coap_packet_t * message,
-                                     coap_packet_t * response)
+static lwm2m_watcher_t * prv_getWatcher(lwm2m_context_t * contextP,
+                                        lwm2m_uri_t * uriP,
+                                        lwm2m_server_t * serverP)
 {
     lwm2m_observed_t * observedP;
     lwm2m_watcher_t * watcherP;
-    uint32_t count;
-
-    LOG("handle_observe_request()\r\n");
-
-    coap_get_header_observe(message, &count);
 
-    switch (count)
+    observedP = prv_findObserved(contextP, uriP);
+    if (observedP == NULL)
     {
-    case 0:
-        if (!LWM2M_URI_IS_SET_INSTANCE(uriP) && LWM2M_URI_IS_SET_RESOURCE(uriP)) return COAP_400_BAD_REQUEST;
-        if (message->token_len == 0) return COAP_400_BAD_REQUEST;
-
-        observedP = prv_findObserved(contextP, uriP);
-        if (observedP == NULL)
+        observedP = (lwm2m_observed_t *)lwm2m_malloc(sizeof(lwm2m_observed_t));
+        if (observedP == NULL) return NULL;
+        memset(observedP, 0, sizeof(lwm2m_observed_t));
+        memcpy(&(observedP->uri), uriP, sizeof(lwm2m_uri_t));
+        if (0 != prv_linkObserved(contextP, observedP))
         {
-            observedP = (lwm2m_observed_t *)lwm2m_malloc(sizeof(lwm2m_observed_t));
-            if (observedP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
-            memset(observedP, 0, sizeof(lwm2m_observed_t));
-            memcpy(&(observedP->uri), uriP, sizeof(lwm2m_uri_t));
-            observedP->next = contextP->observedList;
-            contextP->observedList = observedP;
+            lwm2m_free(observedP);
+            return NULL;
         }
+    }
 
-        watcherP = prv_findWatcher(observedP, serverP);
+    watcherP = prv_findWatcher(observedP, serverP);
+    if (watcherP == NULL)
+    {
+        // each watcher keeps a slot in the heap so that rescheduling it never fails
+        if (0 != utils_heapReserve(&contextP->watcherHeap))
+        {
+            if (observedP->watcherList == NULL)
+            {
+                prv_unlinkObserved(contextP, observedP);
+                lwm2m_free(observedP);
+            }
+            return NULL;
+        }
+        watcherP = (lwm2m_watcher_t *)lwm2m_malloc(sizeof(lwm2m_watcher_t));
         if (watcherP == NULL)
         {
-            watcherP = (lwm2m_watcher_t *)lwm2m_malloc(sizeof(lwm2m_watcher_t));
-            if (watcherP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
-            memset(watcherP, 0, sizeof(lwm2m_watcher_t));
-            watcherP->server = serverP;
-            watcherP->next = observedP->watcherList;
-            observedP->watcherList = watcherP;
+            utils_heapRelease(&contextP->watcherHeap);
+            if (observedP->watcherList == NULL)
+            {
+                prv_unlinkObserved(contextP, observedP);
+                lwm2m_free(observedP);
+            }
+            return NULL;
+        }
+        memset(watcherP, 0, sizeof(lwm2m_watcher_t));
+        watcherP->observed = observedP;
+        watcherP->server = serverP;
+        watcherP->conCount = contextP->notifyConCount;
+        watcherP->conInterval = contextP->notifyConInterval;
+        if (0 != prv_linkWatcher(serverP, watcherP))
+        {
+            utils_heapRelease(&contextP->watcherHeap);
+            lwm2m_free(watcherP);
+            if (observedP->watcherList == NULL)
+            {
+                prv_unlinkObserved(contextP, observedP);
+                lwm2m_free(observedP);
+            }
+            return NULL;
         }
+        watcherP->next = observedP->watcherList;
+        observedP->watcherList = watcherP;
+    }
 
-        watcherP->tokenLen = message->token_len;
-        memcpy(watcherP->token, message->token, message->token_len);
+    return watcherP;
+}
 
-        coap_set_header_observe(response, watcherP->counter++);
+/*
+ * Queue mode: the notifications towards a server reached in UDP or SMS queue mode wait in a ring
+ * buffer of each watcher until the next successful registration update, when the client is known
+ * to be awake.
+ */
+static bool prv_isQueueMode(lwm2m_server_t * serverP)
+{
+    return BINDING_UQ == serverP->binding
+        || BINDING_SQ == serverP->binding
+        || BINDING_UQS == serverP->binding;
+}
 
-        return COAP_205_CONTENT;
+static void prv_clearQueue(lwm2m_watcher_t * watcherP)
+{
+    while (0 != watcherP->queueCount)
+    {
+        lwm2m_free(watcherP->queue[watcherP->queueStart].payload);
+        watcherP->queueStart = (watcherP->queueStart + 1) % watcherP->queueSize;
+        watcherP->queueCount--;
+    }
+    if (NULL != watcherP->queue)
+    {
+        lwm2m_free(watcherP->queue);
+        watcherP->queue = NULL;
+    }
+    watcherP->queueSize = 0;
+    watcherP->queueStart = 0;
+}
 
-    case 1:
-        // cancellation
-        cancel_observe(contextP, message->mid, serverP->sessionH);
-        return COAP_205_CONTENT;
+/*
+ * Confirmable notifications (RFC 7641 section 4.5). A watcher has at most one in flight: the
+ * changes occurring meanwhile are coalesced and the latest value is sent once it is acknowledged.
+ */
+typedef struct
+{
+    lwm2m_context_t * contextP;
+    lwm2m_watcher_t * watcherP;
+} confirmable_data_t;
 
-    default:
-        return COAP_400_BAD_REQUEST;
+static void prv_dropConfirmable(lwm2m_context_t * contextP,
+                                lwm2m_watcher_t * watcherP)
+{
+    lwm2m_transaction_t * transacP = watcherP->conTransaction;
+
+    if (NULL == transacP) return;
+
+    watcherP->conTransaction = NULL;
+    lwm2m_free(transacP->userData);
+    transaction_remove(contextP, transacP);
+}
+
+static void prv_removeWatcher(lwm2m_context_t * contextP,
+                              lwm2m_watcher_t * watcherP)
+{
+    lwm2m_observed_t * observedP = watcherP->observed;
+
+    prv_dropConfirmable(contextP, watcherP);
+    utils_heapUnschedule(&contextP->watcherHeap, watcherP);
+    prv_unlinkWatcher(watcherP);
+    prv_clearQueue(watcherP);
+    if (observedP->watcherList == watcherP)
+    {
+        observedP->watcherList = watcherP->next;
+    }
+    else
+    {
+        lwm2m_watcher_t * parentP;
+
+        parentP = observedP->watcherList;
+        while (parentP->next != watcherP)
+        {
+            parentP = parentP->next;
+        }
+        parentP->next = watcherP->next;
+    }
+    utils_heapRelease(&contextP->watcherHeap);
+    lwm2m_free(watcherP);
+
+    if (observedP->watcherList == NULL)
+    {
+        prv_unlinkObserved(contextP, observedP);
+        lwm2m_free(observedP);
     }
 }
 
-void cancel_observe(lwm2m_context_t * contextP,
-                    uint16_t mid,
-                    void * fromSessionH)
+static void prv_cancelWatcher(lwm2m_context_t * contextP,
+                              lwm2m_watcher_t * watcherP)
 {
-    lwm2m_observed_t * observedP;
+    if (0 != watcherP->attributes.flags)
+    {
+        // keep the attributes for the next observation
+        prv_dropConfirmable(contextP, watcherP);
+        prv_clearQueue(watcherP);
+        watcherP->active = false;
+        watcherP->update = false;
+        utils_heapUnschedule(&contextP->watcherHeap, watcherP);
+    }
+    else
+    {
+        prv_removeWatcher(contextP, watcherP);
+    }
+}
 
-    LOG("cancel_observe()\r\n");
+// Returns true when the notification content holds a numerical value.
+static bool prv_getValue(lwm2m_watcher_t * watcherP,
+                         lwm2m_media_type_t format,
+                         uint8_t * buffer,
+                         size_t length,
+                         double * valueP)
+{
+    if (!LWM2M_URI_IS_SET_RESOURCE((&watcherP->observed->uri))) return false;
+    if (format != LWM2M_CONTENT_TEXT) return false;
+
+    return 0 != lwm2m_PlainTextToFloat64(buffer, (int)length, valueP);
+}
+
+static bool prv_checkThresholds(lwm2m_watcher_t * watcherP,
+                                lwm2m_media_type_t format,
+                                uint8_t * buffer,
+                                size_t length)
+{
+    lwm2m_attributes_t * attrP = &watcherP->attributes;
+    double value;
+    double delta;
+
+    if ((attrP->flags & LWM2M_ATTR_FLAG_NUMERIC) == 0) return true;
+    if (!prv_getValue(watcherP, format, buffer, length, &value)) return true;
+
+    if ((attrP->flags & LWM2M_ATTR_FLAG_GREATER_THAN) != 0
+     && (watcherP->lastValue <= attrP->greaterThan) != (value <= attrP->greaterThan))
+    {
+        return true;
+    }
+    if ((attrP->flags & LWM2M_ATTR_FLAG_LESS_THAN) != 0
+     && (watcherP->lastValue < attrP->lessThan) != (value < attrP->lessThan))
+    {
+        return true;
+    }
+    if ((attrP->flags & LWM2M_ATTR_FLAG_STEP) != 0)
+    {
+        delta = value - watcherP->lastValue;
+        if (delta < 0) delta = -delta;
+        if (delta >= attrP->step) return true;
+    }
+
+    return false;
+}
+
+/*
+ * Content of the notifications of an observed URI. It is read and serialized once for all the
+ * watchers: only the header, token and Observe option are written for each of them.
+ */
+typedef struct
+{
+    coap_status_t       result;     // COAP_IGNORE until read
+    lwm2m_media_type_t  format;
+    uint8_t *           payload;
+    size_t              payloadLength;
+    bool                inPlace;    // the payload is part of buffer
+    uint8_t *           buffer;     // COAP_NOTIFICATION_PREFIX_SIZE free bytes, then the common part
+    size_t              length;     // of the common part
+    uint8_t             stackBuffer[COAP_NOTIFICATION_PREFIX_SIZE + COAP_MAX_PACKET_SIZE];
+} notification_t;
+
+static coap_status_t prv_allocNotification(notification_t * notifP,
+                                           size_t payloadLength)
+{
+    size_t allocLen;
+
+    allocLen = COAP_NOTIFICATION_PREFIX_SIZE + COAP_MAX_HEADER_SIZE + payloadLength;
+    if (allocLen <= sizeof(notifP->stackBuffer))
+    {
+        notifP->buffer = notifP->stackBuffer;
+    }
+    else
+    {
+        notifP->buffer = (uint8_t *)lwm2m_malloc(allocLen);
+        if (NULL == notifP->buffer)
+        {
+            notifP->result = COAP_500_INTERNAL_SERVER_ERROR;
+        }
+    }
+
+    return notifP->result;
+}
+
+// Serializes the common part of the notification around its payload.
+static coap_status_t prv_serializeNotification(notification_t * notifP)
+{
+    coap_packet_t message[1];
+
+    if (NULL == notifP->buffer
+     && COAP_205_CONTENT != prv_allocNotification(notifP, notifP->payloadLength))
+    {
+        return notifP->result;
+    }
+
+    coap_init_message(message, COAP_TYPE_NON, COAP_205_CONTENT, 0);
+    coap_set_header_content_type(message, notifP->format);
+    coap_set_payload(message, notifP->payload, notifP->payloadLength);
+    notifP->length = coap_serialize_notification(message, notifP->buffer);
+    if (0 == notifP->length)
+    {
+        notifP->result = COAP_500_INTERNAL_SERVER_ERROR;
+    }
+    else if (notifP->inPlace)
+    {
+        // the payload was moved right after the options
+        notifP->payload = notifP->buffer + COAP_NOTIFICATION_PREFIX_SIZE + notifP->length - notifP->payloadLength;
+    }
+
+    return notifP->result;
+}
+
+#ifndef LWM2M_SUPPORT_JSON
+// Serializes the data in TLV directly in the payload area of the notification buffer.
+static coap_status_t prv_serializeNotificationTLV(notification_t * notifP,
+                                                  int size,
+                                                  lwm2m_data_t * dataP)
+{
+    int length;
+
+    notifP->format = LWM2M_CONTENT_TLV;
+    length = lwm2m_dataToTLV(size, dataP, NULL, 0);
+    if (length <= 0)
+    {
+        notifP->result = COAP_500_INTERNAL_SERVER_ERROR;
+        return notifP->result;
+    }
+    if (COAP_205_CONTENT != prv_allocNotification(notifP, length)) return notifP->result;
+
+    notifP->payload = notifP->buffer + COAP_NOTIFICATION_PREFIX_SIZE + COAP_MAX_HEADER_SIZE;
+    notifP->payloadLength = lwm2m_dataToTLV(size, dataP, notifP->payload, length);
+    notifP->inPlace = true;
+
+    return prv_serializeNotification(notifP);
+}
+#endif
+
+static coap_status_t prv_readNotification(lwm2m_context_t * contextP,
+                                          lwm2m_observed_t * observedP,
+                                          notification_t * notifP)
+{
+    lwm2m_data_t * dataP;
+    int size;
+
+    if (COAP_IGNORE != notifP->result) return notifP->result;
+
+    notifP->format = LWM2M_CONTENT_TEXT;
+    notifP->result = object_readData(contextP, &observedP->uri, &size, &dataP);
+    if (COAP_205_CONTENT == notifP->result)
+    {
+#ifndef LWM2M_SUPPORT_JSON
+        if (1 != size || LWM2M_TYPE_RESOURCE != dataP->type)
+        {
+            prv_serializeNotificationTLV(notifP, size, dataP);
+        }
+        else
+#endif
+        {
+            notifP->payloadLength = lwm2m_data_serialize(size, dataP, &notifP->format, &notifP->payload);
+            if (0 == notifP->payloadLength && (1 != size || 0 != dataP->length))
+            {
+                notifP->result = COAP_500_INTERNAL_SERVER_ERROR;
+            }
+            else
+            {
+                prv_serializeNotification(notifP);
+            }
+        }
+    }
+    lwm2m_data_free(size, dataP);
+
+    return notifP->result;
+}
+
+static void prv_freeNotification(notification_t * notifP)
+{
+    if (NULL != notifP->payload && !notifP->inPlace)
+    {
+        lwm2m_free(notifP->payload);
+    }
+    if (NULL != notifP->buffer && notifP->buffer != notifP->stackBuffer)
+    {
+        lwm2m_free(notifP->buffer);
+    }
+}
+
+static void prv_confirmableCallback(lwm2m_transaction_t * transacP,
+                                    void * message)
+{
+    confirmable_data_t * dataP = (confirmable_data_t *)transacP->userData;
+    lwm2m_context_t * contextP = dataP->contextP;
+    lwm2m_watcher_t * watcherP = dataP->watcherP;
+    coap_packet_t * packet = (coap_packet_t *)message;
+
+    lwm2m_free(dataP);
+    transacP->userData = NULL;
+    watcherP->conTransaction = NULL;
+
+    if (NULL == packet || COAP_TYPE_RST == packet->type)
+    {
+        // the server stopped acknowledging the notifications
+        prv_cancelWatcher(contextP, watcherP);
+        return;
+    }
+
+    // a change held back meanwhile is now sent with the latest value
+    prv_reschedule(contextP, watcherP, lwm2m_gettime_ms());
+}
+
+static bool prv_isConfirmable(lwm2m_watcher_t * watcherP,
+                              int64_t currentTime)
+{
+    if (0 != watcherP->conCount && watcherP->nonCount + 1 >= watcherP->conCount) return true;
+    if (0 != watcherP->conInterval && watcherP->lastConTime + (int64_t)watcherP->conInterval * 1000 <= currentTime) return true;
+
+    return false;
+}
+
+static int prv_sendConfirmable(lwm2m_context_t * contextP,
+                               lwm2m_watcher_t * watcherP,
+                               int64_t currentTime,
+                               notification_t * notifP)
+{
+    confirmable_data_t * dataP;
+    lwm2m_transaction_t * transacP;
+    coap_packet_t * messageP;
+
+    dataP = (confirmable_data_t *)lwm2m_malloc(sizeof(confirmable_data_t));
+    if (NULL == dataP) return COAP_500_INTERNAL_SERVER_ERROR;
+
+    transacP = transaction_new(COAP_TYPE_CON, COAP_205_CONTENT, NULL, NULL, watcherP->lastMid,
+                               (uint8_t)watcherP->tokenLen, watcherP->token, ENDPOINT_SERVER, watcherP->server);
+    if (NULL == transacP)
+    {
+        lwm2m_free(dataP);
+        return COAP_500_INTERNAL_SERVER_ERROR;
+    }
+
+    messageP = (coap_packet_t *)transacP->message;
+    coap_set_header_content_type(messageP, notifP->format);
+    coap_set_header_observe(messageP, watcherP->counter);
+    coap_set_payload(messageP, notifP->payload, notifP->payloadLength);
+
+    dataP->contextP = contextP;
+    dataP->watcherP = watcherP;
+    transacP->callback = prv_confirmableCallback;
+    transacP->userData = (void *)dataP;
+
+    transaction_add(contextP, transacP);
+    if (0 != transaction_send(contextP, transacP))
+    {
+        transaction_remove(contextP, transacP);
+        lwm2m_free(dataP);
+        return COAP_500_INTERNAL_SERVER_ERROR;
+    }
+
+    watcherP->counter++;
+    watcherP->conTransaction = transacP;
+    watcherP->nonCount = 0;
+    watcherP->lastConTime = currentTime;
+
+    return 0;
+}
+
+// Sends the notification as confirmable when the rules of the watcher ask for it and allowCon is set.
+static void prv_transmit(lwm2m_context_t * contextP,
+                         lwm2m_watcher_t * watcherP,
+                         int64_t currentTime,
+                         bool allowCon,
+                         notification_t * notifP)
+{
+    prv_setMid(watcherP, contextP->nextMID++);
+    if (!allowCon
+     || !prv_isConfirmable(watcherP, currentTime)
+     || 0 != prv_sendConfirmable(contextP, watcherP, currentTime, notifP))
+    {
+        size_t prefixLength;
+
+        prefixLength = coap_serialize_notification_prefix(notifP->buffer, COAP_TYPE_NON, COAP_205_CONTENT, watcherP->lastMid,
+                                                          watcherP->token, watcherP->tokenLen, watcherP->counter++);
+        (void)contextP->bufferSendCallback(watcherP->server->sessionH,
+                                           notifP->buffer + COAP_NOTIFICATION_PREFIX_SIZE - prefixLength,
+                                           prefixLength + notifP->length,
+                                           contextP->userData);
+        watcherP->nonCount++;
+    }
+}
+
+static void prv_queueNotification(lwm2m_context_t * contextP,
+                                  lwm2m_watcher_t * watcherP,
+                                  notification_t * notifP)
+{
+    lwm2m_queued_notification_t * entryP;
+    uint8_t * payload;
+
+    if (NULL == watcherP->queue)
+    {
+        size_t size;
+
+        size = LWM2M_QUEUE_LATEST_ONLY == contextP->notifyQueuePolicy ? 1 : contextP->notifyQueueDepth;
+        if (0 == size) size = 1;
+        watcherP->queue = (lwm2m_queued_notification_t *)lwm2m_malloc(size * sizeof(lwm2m_queued_notification_t));
+        if (NULL == watcherP->queue) return;
+        watcherP->queueSize = size;
+        watcherP->queueStart = 0;
+    }
+
+    payload = (uint8_t *)lwm2m_malloc(notifP->payloadLength);
+    if (NULL == payload && 0 != notifP->payloadLength) return;
+    if (0 != notifP->payloadLength) memcpy(payload, notifP->payload, notifP->payloadLength);
+
+    if (watcherP->queueCount == watcherP->queueSize)
+    {
+        // drop the oldest one
+        lwm2m_free(watcherP->queue[watcherP->queueStart].payload);
+        watcherP->queueStart = (watcherP->queueStart + 1) % watcherP->queueSize;
+        watcherP->queueCount--;
+    }
+
+    entryP = watcherP->queue + (watcherP->queueStart + watcherP->queueCount) % watcherP->queueSize;
+    entryP->format = notifP->format;
+    entryP->payload = payload;
+    entryP->length = notifP->payloadLength;
+    watcherP->queueCount++;
+}
+
+// Sends the queued notifications of the watcher, the last one following the confirmable rules.
+static void prv_flushQueue(lwm2m_context_t * contextP,
+                           lwm2m_watcher_t * watcherP,
+                           int64_t currentTime)
+{
+    while (0 != watcherP->queueCount)
+    {
+        lwm2m_queued_notification_t * entryP = watcherP->queue + watcherP->queueStart;
+        notification_t notif;
+        bool last;
+
+        watcherP->queueStart = (watcherP->queueStart + 1) % watcherP->queueSize;
+        watcherP->queueCount--;
+        last = (0 == watcherP->queueCount);
+
+        notif.result = COAP_205_CONTENT;
+        notif.format = entryP->format;
+        notif.payload = entryP->payload;
+        notif.payloadLength = entryP->length;
+        notif.inPlace = false;
+        notif.buffer = NULL;
+
+        if (last && NULL != watcherP->conTransaction)
+        {
+            // the latest value is sent once the confirmable notification in flight is acknowledged
+            watcherP->update = true;
+        }
+        else if (COAP_205_CONTENT == prv_serializeNotification(&notif))
+        {
+            prv_transmit(contextP, watcherP, currentTime, last, &notif);
+        }
+        prv_freeNotification(&notif);
+    }
+    prv_clearQueue(watcherP);
+}
+
+// Sends the notification unless the thresholds of the watcher filter it out, then reschedules the watcher.
+static void prv_sendNotification(lwm2m_context_t * contextP,
+                                 lwm2m_watcher_t * watcherP,
+                                 int64_t currentTime,
+                                 bool force,
+                                 notification_t * notifP)
+{
+    if (NULL != watcherP->conTransaction)
+    {
+        // wait for the acknowledgement of the confirmable notification in flight
+        watcherP->update = true;
+        utils_heapUnschedule(&contextP->watcherHeap, watcherP);
+        return;
+    }
+
+    if (force || prv_checkThresholds(watcherP, notifP->format, notifP->payload, notifP->payloadLength))
+    {
+        double value;
+
+        if (prv_isQueueMode(watcherP->server))
+        {
+            prv_queueNotification(contextP, watcherP, notifP);
+        }
+        else
+        {
+            prv_transmit(contextP, watcherP, currentTime, true, notifP);
+        }
+
+        watcherP->lastTime = currentTime;
+        if (prv_getValue(watcherP, notifP->format, notifP->payload, notifP->payloadLength, &value))
+        {
+            watcherP->lastValue = value;
+        }
+    }
+
+    watcherP->update = false;
+    prv_reschedule(contextP, watcherP, currentTime);
+}
+
+coap_status_t handle_observe_request(lwm2m_context_t * contextP,
+                                     lwm2m_uri_t * uriP,
+                                     lwm2m_server_t * serverP,
+                                     coap_packet_t * message,
+                                     coap_packet_t * response,
+                                     lwm2m_media_type_t format,
+                                     uint8_t * buffer,
+                                     size_t length)
+{
+    lwm2m_watcher_t * watcherP;
+    uint32_t count;
+    double value;
+
+    LOG("handle_observe_request()\r\n");
+
+    coap_get_header_observe(message, &count);
+
+    switch (count)
+    {
+    case 0:
+        if (!LWM2M_URI_IS_SET_INSTANCE(uriP) && LWM2M_URI_IS_SET_RESOURCE(uriP)) return COAP_400_BAD_REQUEST;
+        if (message->token_len == 0) return COAP_400_BAD_REQUEST;
+
+        watcherP = prv_getWatcher(contextP, uriP, serverP);
+        if (watcherP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
+
+        prv_setToken(watcherP, message->token, message->token_len);
+        watcherP->active = true;
+        watcherP->update = false;
+        watcherP->lastTime = lwm2m_gettime_ms();
+        watcherP->lastConTime = watcherP->lastTime;
+        if (prv_getValue(watcherP, format, buffer, length, &value))
+        {
+            watcherP->lastValue = value;
+        }
+        prv_reschedule(contextP, watcherP, watcherP->lastTime);
+
+        coap_set_header_observe(response, watcherP->counter++);
+
+        return COAP_205_CONTENT;
+
+    case 1:
+        // cancellation, the request carrying the token of the observation
+        watcherP = prv_findWatcherByToken(serverP, message->token, message->token_len);
+        if (NULL != watcherP && prv_matchUri(&watcherP->observed->uri, uriP))
+        {
+            prv_cancelWatcher(contextP, watcherP);
+        }
+        return COAP_205_CONTENT;
+
+    default:
+        return COAP_400_BAD_REQUEST;
+    }
+}
+
+void cancel_observe(lwm2m_context_t * contextP,
+                    uint16_t mid,
+                    void * fromSessionH)
+{
+    lwm2m_server_t * serverP;
+
+    LOG("cancel_observe()\r\n");
+
+    for (serverP = contextP->serverList ; serverP != NULL ; serverP = serverP->next)
+    {
+        if (serverP->sessionH == fromSessionH)
+        {
+            lwm2m_watcher_t * watcherP;
+
+            watcherP = prv_findWatcherByMid(serverP, mid);
+            if (NULL != watcherP)
+            {
+                prv_cancelWatcher(contextP, watcherP);
+                return;
+            }
+        }
+    }
+}
+
+// Removes all the watchers of the server, as when it deregisters or its session drops.
+void observe_remove_server(lwm2m_context_t * contextP,
+                           lwm2m_server_t * serverP)
+{
+    lwm2m_observed_t ** observedP;
+
+    // the tables outlive the last watcher: always free them
+    if (NULL == serverP->watcherList)
+    {
+        observe_clear_server(serverP);
+        return;
+    }
+
+    while (NULL != serverP->watcherList)
+    {
+        lwm2m_watcher_t * watcherP = serverP->watcherList;
+        lwm2m_watcher_t ** parentP;
+
+        prv_dropConfirmable(contextP, watcherP);
+        utils_heapUnschedule(&contextP->watcherHeap, watcherP);
+        prv_unlinkWatcher(watcherP);
+        prv_clearQueue(watcherP);
+
+        parentP = &watcherP->observed->watcherList;
+        while (*parentP != watcherP)
+        {
+            parentP = &(*parentP)->next;
+        }
+        *parentP = watcherP->next;
+        utils_heapRelease(&contextP->watcherHeap);
+        lwm2m_free(watcherP);
+    }
+    observe_clear_server(serverP);
+
+    // the observed URIs left without watchers are freed in a single pass
+    observedP = &contextP->changedList;
+    while (NULL != *observedP)
+    {
+        if (NULL == (*observedP)->watcherList)
+        {
+            (*observedP)->changed = false;
+            *observedP = (*observedP)->changedNext;
+        }
+        else
+        {
+            observedP = &(*observedP)->changedNext;
+        }
+    }
+    observedP = &contextP->observedList;
+    while (NULL != *observedP)
+    {
+        lwm2m_observed_t * targetP = *observedP;
+
+        if (NULL == targetP->watcherList)
+        {
+            *observedP = targetP->next;
+            if (NULL != targetP->next) targetP->next->prevP = observedP;
+            prv_unhashObserved(contextP, targetP);
+            lwm2m_free(targetP);
+        }
+        else
+        {
+            observedP = &targetP->next;
+        }
+    }
+}
+
+// Sends the notifications queued for the server, as its registration update just succeeded.
+void observe_flush_server(lwm2m_context_t * contextP,
+                          lwm2m_server_t * serverP)
+{
+    lwm2m_watcher_t * watcherP;
+    int64_t currentTime;
+
+    currentTime = lwm2m_gettime_ms();
+
+    for (watcherP = serverP->watcherList ; watcherP != NULL ; watcherP = watcherP->serverNext)
+    {
+        if (0 != watcherP->queueCount)
+        {
+            prv_flushQueue(contextP, watcherP, currentTime);
+            prv_reschedule(contextP, watcherP, currentTime);
+        }
+    }
+}
+
+// Releases the watcher index of the server, its watchers being already freed.
+void observe_clear_server(lwm2m_server_t * serverP)
+{
+    if (NULL != serverP->watcherMidTable) lwm2m_free(serverP->watcherMidTable);
+    serverP->watcherList = NULL;
+    serverP->watcherMidTable = NULL;
+    serverP->watcherTokenTable = NULL;
+    serverP->watcherTableSize = 0;
+    serverP->watcherCount = 0;
+}
+
+static int prv_parseAttributes(multi_option_t * query,
+                               lwm2m_attributes_t * attrP,
+                               uint8_t * toClearP)
+{
+    memset(attrP, 0, sizeof(lwm2m_attributes_t));
+    *toClearP = 0;
+
+    while (query != NULL)
+    {
+        uint8_t flag;
+        size_t nameLen;
+
+        if (lwm2m_strncmp((char *)query->data, ATTR_MIN_PERIOD_STR, ATTR_MIN_PERIOD_LEN) == 0)
+        {
+            flag = LWM2M_ATTR_FLAG_MIN_PERIOD;
+            nameLen = ATTR_MIN_PERIOD_LEN;
+        }
+        else if (lwm2m_strncmp((char *)query->data, ATTR_MAX_PERIOD_STR, ATTR_MAX_PERIOD_LEN) == 0)
+        {
+            flag = LWM2M_ATTR_FLAG_MAX_PERIOD;
+            nameLen = ATTR_MAX_PERIOD_LEN;
+        }
+        else if (lwm2m_strncmp((char *)query->data, ATTR_GREATER_THAN_STR, ATTR_GREATER_THAN_LEN) == 0)
+        {
+            flag = LWM2M_ATTR_FLAG_GREATER_THAN;
+            nameLen = ATTR_GREATER_THAN_LEN;
+        }
+        else if (lwm2m_strncmp((char *)query->data, ATTR_LESS_THAN_STR, ATTR_LESS_THAN_LEN) == 0)
+        {
+            flag = LWM2M_ATTR_FLAG_LESS_THAN;
+            nameLen = ATTR_LESS_THAN_LEN;
+        }
+        else if (lwm2m_strncmp((char *)query->data, ATTR_STEP_STR, ATTR_STEP_LEN) == 0)
+        {
+            flag = LWM2M_ATTR_FLAG_STEP;
+            nameLen = ATTR_STEP_LEN;
+        }
+        else return -1;
+
+        if (((attrP->flags | *toClearP) & flag) != 0) return -1;
+
+        if (query->len == nameLen)
+        {
+            // an attribute without value is removed
+            *toClearP |= flag;
+        }
+        else
+        {
+            uint8_t * valueP = query->data + nameLen + 1;
+            int valueLen = (int)(query->len - nameLen - 1);
+
+            if (query->data[nameLen] != '=') return -1;
+
+            if (flag == LWM2M_ATTR_FLAG_MIN_PERIOD || flag == LWM2M_ATTR_FLAG_MAX_PERIOD)
+            {
+                int64_t period;
+
+                if (1 != lwm2m_PlainTextToInt64(valueP, valueLen, &period)) return -1;
+                if (period < 0 || period > UINT32_MAX) return -1;
+                if (flag == LWM2M_ATTR_FLAG_MAX_PERIOD && period == 0)
+                {
+                    // no maximum period, as without value
+                    *toClearP |= flag;
+                    query = query->next;
+                    continue;
+                }
+                if (flag == LWM2M_ATTR_FLAG_MIN_PERIOD) attrP->minPeriod = (uint32_t)period;
+                else attrP->maxPeriod = (uint32_t)period;
+            }
+            else
+            {
+                double number;
+
+                if (1 != lwm2m_PlainTextToFloat64(valueP, valueLen, &number)) return -1;
+                if (flag == LWM2M_ATTR_FLAG_GREATER_THAN) attrP->greaterThan = number;
+                else if (flag == LWM2M_ATTR_FLAG_LESS_THAN) attrP->lessThan = number;
+                else if (number < 0) return -1;
+                else attrP->step = number;
+            }
+            attrP->flags |= flag;
+        }
+
+        query = query->next;
+    }
+
+    return 0;
+}
+
+coap_status_t handle_write_attributes(lwm2m_context_t * contextP,
+                                      lwm2m_uri_t * uriP,
+                                      lwm2m_server_t * serverP,
+                                      multi_option_t * query)
+{
+    lwm2m_attributes_t newAttr;
+    lwm2m_attributes_t attr;
+    lwm2m_observed_t * observedP;
+    lwm2m_watcher_t * watcherP;
+    uint8_t toClear;
+
+    LOG("handle_write_attributes()\r\n");
+
+    if (NULL == serverP) return COAP_405_METHOD_NOT_ALLOWED;
+    if (!LWM2M_URI_IS_SET_INSTANCE(uriP) && LWM2M_URI_IS_SET_RESOURCE(uriP)) return COAP_400_BAD_REQUEST;
+    if (0 != prv_parseAttributes(query, &newAttr, &toClear)) return COAP_400_BAD_REQUEST;
+
+    // the numerical attributes only apply to resources
+    if (!LWM2M_URI_IS_SET_RESOURCE(uriP) && (newAttr.flags & LWM2M_ATTR_FLAG_NUMERIC) != 0) return COAP_400_BAD_REQUEST;
+
+    watcherP = NULL;
+    memset(&attr, 0, sizeof(lwm2m_attributes_t));
+    observedP = prv_findObserved(contextP, uriP);
+    if (NULL != observedP)
+    {
+        watcherP = prv_findWatcher(observedP, serverP);
+        if (NULL != watcherP)
+        {
+            memcpy(&attr, &watcherP->attributes, sizeof(lwm2m_attributes_t));
+        }
+    }
+
+    attr.flags &= ~toClear;
+    attr.flags |= newAttr.flags;
+    if ((newAttr.flags & LWM2M_ATTR_FLAG_MIN_PERIOD) != 0) attr.minPeriod = newAttr.minPeriod;
+    if ((newAttr.flags & LWM2M_ATTR_FLAG_MAX_PERIOD) != 0) attr.maxPeriod = newAttr.maxPeriod;
+    if ((newAttr.flags & LWM2M_ATTR_FLAG_GREATER_THAN) != 0) attr.greaterThan = newAttr.greaterThan;
+    if ((newAttr.flags & LWM2M_ATTR_FLAG_LESS_THAN) != 0) attr.lessThan = newAttr.lessThan;
+    if ((newAttr.flags & LWM2M_ATTR_FLAG_STEP) != 0) attr.step = newAttr.step;
+
+    // consistency rules of LWM2M TS 5.1.2
+    if ((attr.flags & LWM2M_ATTR_FLAG_MIN_PERIOD) != 0
+     && (attr.flags & LWM2M_ATTR_FLAG_MAX_PERIOD) != 0
+     && attr.maxPeriod < attr.minPeriod)
+    {
+        return COAP_400_BAD_REQUEST;
+    }
+    if ((attr.flags & LWM2M_ATTR_FLAG_GREATER_THAN) != 0
+     && (attr.flags & LWM2M_ATTR_FLAG_LESS_THAN) != 0)
+    {
+        if (attr.lessThan >= attr.greaterThan) return COAP_400_BAD_REQUEST;
+        if ((attr.flags & LWM2M_ATTR_FLAG_STEP) != 0
+         && attr.lessThan + 2 * attr.step >= attr.greaterThan)
+        {
+            return COAP_400_BAD_REQUEST;
+        }
+    }
+
+    if (NULL == watcherP)
+    {
+        if (0 == attr.flags) return COAP_204_CHANGED;
+
+        watcherP = prv_getWatcher(contextP, uriP, serverP);
+        if (NULL == watcherP) return COAP_500_INTERNAL_SERVER_ERROR;
+    }
+
+    memcpy(&watcherP->attributes, &attr, sizeof(lwm2m_attributes_t));
+    if (!watcherP->active && 0 == attr.flags)
+    {
+        prv_removeWatcher(contextP, watcherP);
+    }
+    else
+    {
+        prv_reschedule(contextP, watcherP, lwm2m_gettime_ms());
+    }
+
+    return COAP_204_CHANGED;
+}
+
+static void prv_notifyObserved(lwm2m_context_t * contextP,
+                               lwm2m_observed_t * observedP,
+                               int64_t currentTime)
+{
+    lwm2m_watcher_t * watcherP;
+    notification_t notif;
+
+    notif.result = COAP_IGNORE;
+    notif.payload = NULL;
+    notif.inPlace = false;
+    notif.buffer = NULL;
+
+    for (watcherP = observedP->watcherList ; watcherP != NULL ; watcherP = watcherP->next)
+    {
+        if (!watcherP->active) continue;
+
+        watcherP->update = true;
+        if (currentTime < prv_minTime(watcherP))
+        {
+            // coalesced with the next changes until the minimum period elapses
+            prv_reschedule(contextP, watcherP, currentTime);
+            continue;
+        }
+
+        if (COAP_205_CONTENT == prv_readNotification(contextP, observedP, &notif))
+        {
+            prv_sendNotification(contextP, watcherP, currentTime, false, &notif);
+        }
+        else
+        {
+            watcherP->update = false;
+            prv_reschedule(contextP, watcherP, currentTime);
+        }
+    }
+
+    prv_freeNotification(&notif);
+}
+
+void observe_step(lwm2m_context_t * contextP,
+                  int64_t currentTime,
+                  int64_t * timeoutP)
+{
+    lwm2m_watcher_t * watcherP;
+
+    // the changes reported since the last step, each observed URI once
+    while (NULL != contextP->changedList)
+    {
+        lwm2m_observed_t * observedP = contextP->changedList;
+
+        contextP->changedList = observedP->changedNext;
+        observedP->changed = false;
+        prv_notifyObserved(contextP, observedP, currentTime);
+    }
+
+    while (NULL != (watcherP = (lwm2m_watcher_t *)utils_heapTop(&contextP->watcherHeap))
+        && watcherP->nextTime <= currentTime)
+    {
+        lwm2m_observed_t * observedP = watcherP->observed;
+        notification_t notif;
+
+        notif.result = COAP_IGNORE;
+        notif.payload = NULL;
+        notif.inPlace = false;
+        notif.buffer = NULL;
+
+        // the other watchers of the same URI due now share the content
+        for (watcherP = observedP->watcherList ; watcherP != NULL ; watcherP = watcherP->next)
+        {
+            bool force;
+
+            if (0 == watcherP->heapIndex || watcherP->nextTime > currentTime) continue;
+
+            force = (watcherP->attributes.flags & LWM2M_ATTR_FLAG_MAX_PERIOD) != 0
+                 && watcherP->lastTime + (int64_t)watcherP->attributes.maxPeriod * 1000 <= currentTime;
+
+            if (COAP_205_CONTENT == prv_readNotification(contextP, observedP, &notif))
+            {
+                prv_sendNotification(contextP, watcherP, currentTime, force, &notif);
+            }
+            else
+            {
+                // retry at the next period
+                watcherP->lastTime = currentTime;
+                watcherP->update = false;
+                prv_reschedule(contextP, watcherP, currentTime);
+            }
+        }
+
+        prv_freeNotification(&notif);
+    }
+
+    if (NULL != watcherP)
+    {
+        int64_t interval = watcherP->nextTime - currentTime;
+
+        if (*timeoutP > interval)
+        {
+            *timeoutP = interval;
+        }
+    }
+}
+
+static void prv_markChanged(lwm2m_context_t * contextP,
+                            lwm2m_observed_t * observedP)
+{
+    if (observedP->changed) return;
+
+    observedP->changed = true;
+    observedP->changedNext = contextP->changedList;
+    contextP->changedList = observedP;
+}
+
+void lwm2m_resource_value_changed(lwm2m_context_t * contextP,
+                                  lwm2m_uri_t * uriP)
+{
+    lwm2m_observed_t * targetP;
+
+    if (LWM2M_URI_IS_SET_INSTANCE(uriP) && LWM2M_URI_IS_SET_RESOURCE(uriP))
+    {
+        // Only the resource itself, its instance and its object can cover it:
+        // look them up directly.
+        lwm2m_uri_t keyUri;
+
+        memset(&keyUri, 0, sizeof(lwm2m_uri_t));
+        keyUri.objectId = uriP->objectId;
+        keyUri.instanceId = uriP->instanceId;
+        keyUri.resourceId = uriP->resourceId;
+
+        keyUri.flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID | LWM2M_URI_FLAG_RESOURCE_ID;
+        targetP = prv_findObserved(contextP, &keyUri);
+        if (NULL != targetP) prv_markChanged(contextP, targetP);
+
+        keyUri.flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID;
+        targetP = prv_findObserved(contextP, &keyUri);
+        if (NULL != targetP) prv_markChanged(contextP, targetP);
+
+        keyUri.flag = LWM2M_URI_FLAG_OBJECT_ID;
+        targetP = prv_findObserved(contextP, &keyUri);
+        if (NULL != targetP) prv_markChanged(contextP, targetP);
+
+        return;
+    }
+
+    // A broader change also covers the observed descendants.
+    for (targetP = contextP->observedList ; targetP != NULL ; targetP = targetP->next)
+    {
+        if (targetP->uri.objectId == uriP->objectId
+         && (!LWM2M_URI_IS_SET_INSTANCE(uriP)
+          || (targetP->uri.flag & LWM2M_URI_FLAG_INSTANCE_ID) == 0
+          || uriP->instanceId == targetP->uri.instanceId)
+         && (!LWM2M_URI_IS_SET_RESOURCE(uriP)
+          || (targetP->uri.flag & LWM2M_URI_FLAG_RESOURCE_ID) == 0
+          || uriP->resourceId == targetP->uri.resourceId))
+        {
+            prv_markChanged(contextP, targetP);
+        }
+    }
+}
+
+void lwm2m_set_notification_confirmable(lwm2m_context_t * contextP,
+                                        uint32_t count,
+                                        uint32_t interval)
+{
+    lwm2m_observed_t * observedP;
+
+    contextP->notifyConCount = count;
+    contextP->notifyConInterval = interval;
 
-    for (observedP = contextP->observedList;
-         observedP != NULL;
-         observedP = observedP->next)
+    for (observedP = contextP->observedList ; observedP != NULL ; observedP = observedP->next)
     {
-        lwm2m_watcher_t * targetP = NULL;
+        lwm2m_watcher_t * watcherP;
 
-        if (observedP->watcherList->lastMid == mid
-         && observedP->watcherList->server->sessionH == fromSessionH)
+        for (watcherP = observedP->watcherList ; watcherP != NULL ; watcherP = watcherP->next)
         {
-            targetP = observedP->watcherList;
-            observedP->watcherList = observedP->watcherList->next;
-        }
-        else
-        {
-            lwm2m_watcher_t * parentP;
-
-            parentP = observedP->watcherList;
-            while (parentP->next != NULL
-                && (parentP->next->lastMid != mid
-                 || parentP->next->server->sessionH != fromSessionH))
-            {
-                parentP = parentP->next;
-            }
-            if (parentP->next != NULL)
-            {
-                targetP = parentP->next;
-                parentP->next = parentP->next->next;
-            }
-        }
-        if (targetP != NULL)
-        {
-            lwm2m_free(targetP);
-            if (observedP->watcherList == NULL)
-            {
-                prv_unlinkObserved(contextP, observedP);
-                lwm2m_free(observedP);
-            }
-            return;
+            watcherP->conCount = count;
+            watcherP->conInterval = interval;
         }
     }
 }
 
-void lwm2m_resource_value_changed(lwm2m_context_t * contextP,
-                                  lwm2m_uri_t * uriP)
+int lwm2m_set_watcher_confirmable(lwm2m_context_t * contextP,
+                                  uint16_t shortServerID,
+                                  lwm2m_uri_t * uriP,
+                                  uint32_t count,
+                                  uint32_t interval)
 {
-    int result;
-    obs_list_t * listP;
+    lwm2m_observed_t * observedP;
     lwm2m_watcher_t * watcherP;
+    lwm2m_server_t * serverP;
 
-    listP = prv_getObservedList(contextP, uriP);
-    while (listP != NULL)
+    serverP = contextP->serverList;
+    while (serverP != NULL
+        && serverP->shortID != shortServerID)
     {
-        obs_list_t * targetP;
-        uint8_t * buffer = NULL;
-        size_t length = 0;
-        lwm2m_media_type_t format;
+        serverP = serverP->next;
+    }
+    if (NULL == serverP) return COAP_404_NOT_FOUND;
 
-        format = LWM2M_CONTENT_TEXT;
-        result = object_read(contextP, &listP->item->uri, &format, &buffer, &length);
-        if (result == COAP_205_CONTENT)
-        {
-            coap_packet_t message[1];
+    observedP = prv_findObserved(contextP, uriP);
+    if (NULL == observedP) return COAP_404_NOT_FOUND;
 
-            coap_init_message(message, COAP_TYPE_NON, COAP_205_CONTENT, 0);
-            coap_set_header_content_type(message, format);
-            coap_set_payload(message, buffer, length);
+    watcherP = prv_findWatcher(observedP, serverP);
+    if (NULL == watcherP) return COAP_404_NOT_FOUND;
 
-            for (watcherP = listP->item->watcherList ; watcherP != NULL ; watcherP = watcherP->next)
-            {
-                watcherP->lastMid = contextP->nextMID++;
-                message->mid = watcherP->lastMid;
-                coap_set_header_token(message, watcherP->token, watcherP->tokenLen);
-                coap_set_header_observe(message, watcherP->counter++);
-                (void)message_send(contextP, message, watcherP->server->sessionH);
-            }
-        }
+    watcherP->conCount = count;
+    watcherP->conInterval = interval;
 
-        targetP = listP;
-        listP = listP->next;
-        lwm2m_free(targetP);
-    }
+    return COAP_NO_ERROR;
+}
 
+int lwm2m_set_notification_queue(lwm2m_context_t * contextP,
+                                 size_t depth,
+                                 lwm2m_queue_policy_t policy)
+{
+    if (LWM2M_QUEUE_DROP_OLDEST != policy && LWM2M_QUEUE_LATEST_ONLY != policy) return COAP_400_BAD_REQUEST;
+    if (LWM2M_QUEUE_DROP_OLDEST == policy && 0 == depth) return COAP_400_BAD_REQUEST;
+
+    contextP->notifyQueueDepth = depth;
+    contextP->notifyQueuePolicy = policy;
+
+    return COAP_NO_ERROR;
 }
 #endif
 
@@ -331,13 +1588,170 @@ static lwm2m_observation_t * prv_findObservationByURI(lwm2m_client_t * clientP,
     return targetP;
 }
 
+/*
+ * Observations are indexed by token in a hash table chained by hashNext. Each observation also
+ * points to the link referencing it, so that it can be unlinked without the context. Removals
+ * are not counted: the observations actually indexed are counted again before growing the table.
+ */
+#define PRV_OBSERVATION_TABLE_INITIAL_SIZE  16
+
+// a notification older than the freshest one is still accepted after this delay (RFC 7641 section 3.4)
+#define PRV_OBSERVE_REORDER_DELAY   128000  // ms
+
+static void prv_bucketInsert(lwm2m_observation_t ** bucketP,
+                             lwm2m_observation_t * observationP)
+{
+    observationP->hashNext = *bucketP;
+    if (NULL != *bucketP)
+    {
+        (*bucketP)->hashPrevP = &observationP->hashNext;
+    }
+    observationP->hashPrevP = bucketP;
+    *bucketP = observationP;
+}
+
+static void prv_unlinkObservation(lwm2m_observation_t * observationP)
+{
+    if (NULL == observationP->hashPrevP) return;
+
+    *observationP->hashPrevP = observationP->hashNext;
+    if (NULL != observationP->hashNext)
+    {
+        observationP->hashNext->hashPrevP = observationP->hashPrevP;
+    }
+    observationP->hashNext = NULL;
+    observationP->hashPrevP = NULL;
+}
+
+static int prv_resizeObservationTable(lwm2m_context_t * contextP,
+                                      size_t size)
+{
+    lwm2m_observation_t ** tableP;
+    size_t i;
+
+    tableP = (lwm2m_observation_t **)lwm2m_malloc(size * sizeof(lwm2m_observation_t *));
+    if (NULL == tableP) return COAP_500_INTERNAL_SERVER_ERROR;
+    memset(tableP, 0, size * sizeof(lwm2m_observation_t *));
+
+    for (i = 0 ; i < contextP->observationTableSize ; i++)
+    {
+        while (NULL != contextP->observationTable[i])
+        {
+            lwm2m_observation_t * targetP = contextP->observationTable[i];
+
+            prv_unlinkObservation(targetP);
+            prv_bucketInsert(tableP + (utils_hash(targetP->token, targetP->tokenLen) & (size - 1)), targetP);
+        }
+    }
+
+    if (NULL != contextP->observationTable)
+    {
+        lwm2m_free(contextP->observationTable);
+    }
+    contextP->observationTable = tableP;
+    contextP->observationTableSize = size;
+
+    return 0;
+}
+
+static int prv_linkObservation(lwm2m_context_t * contextP,
+                               lwm2m_observation_t * observationP)
+{
+    if (contextP->observationTableLoad >= contextP->observationTableSize)
+    {
+        size_t count;
+        size_t size;
+        size_t i;
+
+        count = 0;
+        for (i = 0 ; i < contextP->observationTableSize ; i++)
+        {
+            lwm2m_observation_t * targetP;
+
+            for (targetP = contextP->observationTable[i] ; targetP != NULL ; targetP = targetP->hashNext)
+            {
+                count++;
+            }
+        }
+
+        size = PRV_OBSERVATION_TABLE_INITIAL_SIZE;
+        while (size <= 2 * count)
+        {
+            size *= 2;
+        }
+        if (size != contextP->observationTableSize
+         && 0 != prv_resizeObservationTable(contextP, size)
+         && 0 == contextP->observationTableSize)
+        {
+            return COAP_500_INTERNAL_SERVER_ERROR;
+        }
+        contextP->observationTableLoad = count;
+    }
+
+    prv_bucketInsert(contextP->observationTable + (utils_hash(observationP->token, observationP->tokenLen) & (contextP->observationTableSize - 1)),
+                     observationP);
+    contextP->observationTableLoad++;
+
+    return 0;
+}
+
+static lwm2m_observation_t * prv_findObservationByToken(lwm2m_context_t * contextP,
+                                                        const uint8_t * token,
+                                                        size_t length)
+{
+    lwm2m_observation_t * targetP;
+
+    if (0 == contextP->observationTableSize) return NULL;
+
+    targetP = contextP->observationTable[utils_hash(token, length) & (contextP->observationTableSize - 1)];
+    while (targetP != NULL
+        && (targetP->tokenLen != length || memcmp(targetP->token, token, length) != 0))
+    {
+        targetP = targetP->hashNext;
+    }
+
+    return targetP;
+}
+
+// Returns true when the notification is newer than the freshest one received (RFC 7641 section 3.4).
+static bool prv_isFresh(lwm2m_observation_t * observationP,
+                        uint32_t count,
+                        int64_t currentTime)
+{
+    uint32_t last = observationP->counter;
+
+    return (last < count && count - last < ((uint32_t)1 << 23))
+        || (last > count && last - count > ((uint32_t)1 << 23))
+        || currentTime > observationP->counterTime + PRV_OBSERVE_REORDER_DELAY;
+}
+
 void observation_remove(lwm2m_client_t * clientP,
                         lwm2m_observation_t * observationP)
 {
+    prv_unlinkObservation(observationP);
     clientP->observationList = (lwm2m_observation_t *) LWM2M_LIST_RM(clientP->observationList, observationP->id, NULL);
+    lwm2m_id_set_release(&clientP->observationIds, observationP->id);
     lwm2m_free(observationP);
 }
 
+// Indexes an observation keeping its ID and token, as when restoring a snapshot.
+// The caller inserts it in the observation list of its client.
+int observation_restore(lwm2m_context_t * contextP,
+                        lwm2m_observation_t * observationP)
+{
+    lwm2m_client_t * clientP = observationP->clientP;
+
+    if (NULL != prv_findObservationByToken(contextP, observationP->token, observationP->tokenLen)) return COAP_400_BAD_REQUEST;
+    if (0 != lwm2m_id_set_reserve(&clientP->observationIds, observationP->id)) return COAP_400_BAD_REQUEST;
+    if (0 != prv_linkObservation(contextP, observationP))
+    {
+        lwm2m_id_set_release(&clientP->observationIds, observationP->id);
+        return COAP_500_INTERNAL_SERVER_ERROR;
+    }
+
+    return 0;
+}
+
 static void prv_obsRequestCallback(lwm2m_transaction_t * transacP,
                                    void * message)
 {
@@ -385,6 +1799,10 @@ static void prv_obsRequestCallback(lwm2m_transaction_t * transacP,
     }
     else
     {
+        // later notifications must be newer than this first value
+        coap_get_header_observe(packet, &observationP->counter);
+        observationP->counterTime = lwm2m_gettime_ms();
+
         observationP->callback(((lwm2m_client_t*)transacP->peerP)->internalID,
                                &observationP->uri,
                                0,
@@ -446,14 +1864,18 @@ int lwm2m_observe(lwm2m_context_t * contextP,
 
     if (!LWM2M_URI_IS_SET_INSTANCE(uriP) && LWM2M_URI_IS_SET_RESOURCE(uriP)) return COAP_400_BAD_REQUEST;
 
-    clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, clientID);
+    clientP = registration_find_client(contextP, clientID);
     if (clientP == NULL) return COAP_404_NOT_FOUND;
 
     observationP = (lwm2m_observation_t *)lwm2m_malloc(sizeof(lwm2m_observation_t));
     if (observationP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
     memset(observationP, 0, sizeof(lwm2m_observation_t));
 
-    observationP->id = lwm2m_list_newId((lwm2m_list_t *)clientP->observationList);
+    if (0 != lwm2m_id_set_alloc(&clientP->observationIds, &observationP->id))
+    {
+        lwm2m_free(observationP);
+        return COAP_500_INTERNAL_SERVER_ERROR;
+    }
     memcpy(&observationP->uri, uriP, sizeof(lwm2m_uri_t));
     observationP->clientP = clientP;
     observationP->status = STATE_REG_PENDING;
@@ -464,10 +1886,20 @@ int lwm2m_observe(lwm2m_context_t * contextP,
     token[1] = clientP->internalID & 0xFF;
     token[2] = observationP->id >> 8;
     token[3] = observationP->id & 0xFF;
+    memcpy(observationP->token, token, sizeof(token));
+    observationP->tokenLen = sizeof(token);
 
     transactionP = transaction_new(COAP_TYPE_CON, COAP_GET, clientP->altPath, uriP, contextP->nextMID++, 4, token, ENDPOINT_CLIENT, (void *)clientP);
     if (transactionP == NULL)
     {
+        lwm2m_id_set_release(&clientP->observationIds, observationP->id);
+        lwm2m_free(observationP);
+        return COAP_500_INTERNAL_SERVER_ERROR;
+    }
+    if (0 != prv_linkObservation(contextP, observationP))
+    {
+        transaction_free(transactionP);
+        lwm2m_id_set_release(&clientP->observationIds, observationP->id);
         lwm2m_free(observationP);
         return COAP_500_INTERNAL_SERVER_ERROR;
     }
@@ -480,7 +1912,7 @@ int lwm2m_observe(lwm2m_context_t * contextP,
     transactionP->callback = prv_obsRequestCallback;
     transactionP->userData = (void *)observationP;
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transactionP);
+    transaction_add(contextP, transactionP);
 
     return transaction_send(contextP, transactionP);
 }
@@ -494,7 +1926,7 @@ int lwm2m_observe_cancel(lwm2m_context_t * contextP,
     lwm2m_client_t * clientP;
     lwm2m_observation_t * observationP;
 
-    clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, clientID);
+    clientP = registration_find_client(contextP, clientID);
     if (clientP == NULL) return COAP_404_NOT_FOUND;
 
     observationP = prv_findObservationByURI(clientP, uriP);
@@ -528,7 +1960,7 @@ int lwm2m_observe_cancel(lwm2m_context_t * contextP,
         transactionP->callback = prv_obsCancelRequestCallback;
         transactionP->userData = (void *)cancelP;
 
-        contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transactionP);
+        transaction_add(contextP, transactionP);
 
         return transaction_send(contextP, transactionP);
     }
@@ -545,6 +1977,373 @@ int lwm2m_observe_cancel(lwm2m_context_t * contextP,
     return COAP_NO_ERROR;
 }
 
+/*
+ * Batched notifications. Until the batch is delivered, the dataP pointer of a notification holds
+ * the index of its first element in the data arena, and the value pointer of an element holds
+ * the index of its first child for a container or the offset of its value in the payload arena
+ * otherwise: the arenas may move while they grow.
+ */
+#define PRV_BATCH_ARENA_INITIAL_SIZE    64
+
+#define PRV_IS_CONTAINER(D) ((D)->type == LWM2M_TYPE_OBJECT_INSTANCE || (D)->type == LWM2M_TYPE_MULTIPLE_RESOURCE)
+
+// Appends count cleared elements to the data arena. Their first index is stored in indexP.
+static int prv_batchReserve(lwm2m_notify_batch_t * batchP,
+                            size_t count,
+                            size_t * indexP)
+{
+    if (batchP->dataCount + count > batchP->dataSize)
+    {
+        lwm2m_data_t * dataP;
+        size_t size;
+
+        size = batchP->dataSize ? batchP->dataSize : PRV_BATCH_ARENA_INITIAL_SIZE;
+        while (size < batchP->dataCount + count)
+        {
+            size *= 2;
+        }
+        dataP = (lwm2m_data_t *)lwm2m_malloc(size * sizeof(lwm2m_data_t));
+        if (NULL == dataP) return COAP_500_INTERNAL_SERVER_ERROR;
+        if (NULL != batchP->data)
+        {
+            memcpy(dataP, batchP->data, batchP->dataCount * sizeof(lwm2m_data_t));
+            lwm2m_free(batchP->data);
+        }
+        batchP->data = dataP;
+        batchP->dataSize = size;
+    }
+
+    memset(batchP->data + batchP->dataCount, 0, count * sizeof(lwm2m_data_t));
+    *indexP = batchP->dataCount;
+    batchP->dataCount += count;
+
+    return 0;
+}
+
+// Appends the bytes to the payload arena. Their offset is stored in offsetP.
+static int prv_batchCopy(lwm2m_notify_batch_t * batchP,
+                         uint8_t * buffer,
+                         size_t length,
+                         size_t * offsetP)
+{
+    if (batchP->bufferLength + length > batchP->bufferSize)
+    {
+        uint8_t * bufferP;
+        size_t size;
+
+        size = batchP->bufferSize ? batchP->bufferSize : PRV_BATCH_ARENA_INITIAL_SIZE * 16;
+        while (size < batchP->bufferLength + length)
+        {
+            size *= 2;
+        }
+        bufferP = (uint8_t *)lwm2m_malloc(size);
+        if (NULL == bufferP) return COAP_500_INTERNAL_SERVER_ERROR;
+        if (NULL != batchP->buffer)
+        {
+            memcpy(bufferP, batchP->buffer, batchP->bufferLength);
+            lwm2m_free(batchP->buffer);
+        }
+        batchP->buffer = bufferP;
+        batchP->bufferSize = size;
+    }
+
+    if (0 != length)
+    {
+        memcpy(batchP->buffer + batchP->bufferLength, buffer, length);
+    }
+    *offsetP = batchP->bufferLength;
+    batchP->bufferLength += length;
+
+    return 0;
+}
+
+// Decodes the TLV records of buffer, found at offset in the payload arena, in the data arena.
+// The records of a level are contiguous and followed by their children. Returns their count or -1.
+static int prv_batchTLV(lwm2m_notify_batch_t * batchP,
+                        uint8_t * buffer,
+                        size_t length,
+                        size_t offset)
+{
+    lwm2m_tlv_type_t type;
+    uint16_t id;
+    size_t dataIndex;
+    size_t dataLen;
+    size_t index;
+    size_t first;
+    int count;
+    int result;
+    int i;
+
+    count = 0;
+    index = 0;
+    while (index < length
+        && 0 != (result = lwm2m_decodeTLV(buffer + index, length - index, &type, &id, &dataIndex, &dataLen)))
+    {
+        count++;
+        index += result;
+    }
+    if (0 != prv_batchReserve(batchP, count, &first)) return -1;
+
+    index = 0;
+    for (i = 0 ; i < count ; i++)
+    {
+        lwm2m_data_t * dataP;
+
+        result = lwm2m_decodeTLV(buffer + index, length - index, &type, &id, &dataIndex, &dataLen);
+
+        dataP = batchP->data + first + i;
+        dataP->type = type;
+        dataP->id = id;
+        dataP->flags = LWM2M_TLV_FLAG_STATIC_DATA;
+        if (PRV_IS_CONTAINER(dataP))
+        {
+            size_t child = batchP->dataCount;
+            int childCount;
+
+            childCount = prv_batchTLV(batchP, buffer + index + dataIndex, dataLen, offset + index + dataIndex);
+            if (childCount < 0) return -1;
+
+            // the arena may have moved
+            dataP = batchP->data + first + i;
+            dataP->length = (size_t)childCount;
+            dataP->value = (uint8_t *)(uintptr_t)child;
+        }
+        else
+        {
+            dataP->length = dataLen;
+            dataP->value = (uint8_t *)(uintptr_t)(offset + index + dataIndex);
+        }
+        index += result;
+    }
+
+    return count;
+}
+
+// Copies a tree decoded by lwm2m_data_parse() in the arenas. Returns the count of its top-level elements or -1.
+static int prv_batchTree(lwm2m_notify_batch_t * batchP,
+                         lwm2m_data_t * treeP,
+                         int size)
+{
+    size_t first;
+    int i;
+
+    if (0 != prv_batchReserve(batchP, (size_t)size, &first)) return -1;
+
+    for (i = 0 ; i < size ; i++)
+    {
+        lwm2m_data_t * dataP = batchP->data + first + i;
+        size_t index;
+
+        dataP->type = treeP[i].type;
+        dataP->dataType = treeP[i].dataType;
+        dataP->id = treeP[i].id;
+        dataP->flags = LWM2M_TLV_FLAG_STATIC_DATA | (treeP[i].flags & LWM2M_TLV_FLAG_TEXT_FORMAT);
+        if (PRV_IS_CONTAINER(treeP + i))
+        {
+            int childCount;
+
+            index = batchP->dataCount;
+            childCount = prv_batchTree(batchP, (lwm2m_data_t *)treeP[i].value, (int)treeP[i].length);
+            if (childCount < 0) return -1;
+            dataP = batchP->data + first + i;
+            dataP->length = (size_t)childCount;
+        }
+        else
+        {
+            if (0 != prv_batchCopy(batchP, treeP[i].value, treeP[i].length, &index)) return -1;
+            dataP->length = treeP[i].length;
+        }
+        dataP->value = (uint8_t *)(uintptr_t)index;
+    }
+
+    return size;
+}
+
+static void prv_batchFlush(lwm2m_notify_batch_t * batchP)
+{
+    size_t count;
+    size_t i;
+
+    if (0 == batchP->count) return;
+
+    for (i = 0 ; i < batchP->dataCount ; i++)
+    {
+        lwm2m_data_t * dataP = batchP->data + i;
+
+        if (PRV_IS_CONTAINER(dataP))
+        {
+            dataP->value = (uint8_t *)(batchP->data + (uintptr_t)dataP->value);
+        }
+        else
+        {
+            dataP->value = batchP->buffer + (uintptr_t)dataP->value;
+        }
+    }
+    for (i = 0 ; i < batchP->count ; i++)
+    {
+        lwm2m_notification_t * notifP = batchP->items + i;
+
+        notifP->dataP = (0 == notifP->size) ? NULL : batchP->data + (uintptr_t)notifP->dataP;
+    }
+
+    // the arenas are reused by the next batch
+    count = batchP->count;
+    batchP->count = 0;
+    batchP->dataCount = 0;
+    batchP->bufferLength = 0;
+
+    batchP->callback(batchP->items, count, batchP->userData);
+}
+
+static void prv_batchAdd(lwm2m_notify_batch_t * batchP,
+                         lwm2m_observation_t * observationP,
+                         coap_packet_t * message,
+                         uint32_t count,
+                         int64_t currentTime)
+{
+    lwm2m_notification_t * notifP;
+    size_t dataCount;
+    size_t bufferLength;
+    size_t first;
+    size_t offset;
+    int size;
+
+    if (0 == batchP->count) batchP->firstTime = currentTime;
+
+    notifP = batchP->items + batchP->count;
+    notifP->clientID = observationP->clientP->internalID;
+    memcpy(&notifP->uri, &observationP->uri, sizeof(lwm2m_uri_t));
+    notifP->counter = count;
+    notifP->time = currentTime;
+    notifP->format = (lwm2m_media_type_t)message->content_type;
+
+    dataCount = batchP->dataCount;
+    bufferLength = batchP->bufferLength;
+    size = -1;
+    switch (notifP->format)
+    {
+    case LWM2M_CONTENT_TEXT:
+    case LWM2M_CONTENT_OPAQUE:
+        if (0 == prv_batchCopy(batchP, message->payload, message->payload_len, &offset)
+         && 0 == prv_batchReserve(batchP, 1, &first))
+        {
+            lwm2m_data_t * dataP = batchP->data + first;
+
+            dataP->type = LWM2M_TYPE_RESOURCE;
+            dataP->id = LWM2M_URI_IS_SET_RESOURCE((&observationP->uri)) ? observationP->uri.resourceId : 0;
+            dataP->flags = LWM2M_TLV_FLAG_STATIC_DATA;
+            dataP->length = message->payload_len;
+            dataP->value = (uint8_t *)(uintptr_t)offset;
+            size = 1;
+        }
+        break;
+
+    case LWM2M_CONTENT_TLV:
+        if (0 == prv_batchCopy(batchP, message->payload, message->payload_len, &offset))
+        {
+            size = prv_batchTLV(batchP, message->payload, message->payload_len, offset);
+        }
+        break;
+
+    default:
+    {
+        lwm2m_data_t * treeP;
+        int treeSize;
+
+        treeSize = data_parse(&notifP->uri, message->payload, message->payload_len, notifP->format, &treeP);
+        if (0 < treeSize)
+        {
+            size = prv_batchTree(batchP, treeP, treeSize);
+            lwm2m_data_free(treeSize, treeP);
+        }
+    }
+        break;
+    }
+
+    if (size <= 0)
+    {
+        // delivered without its data
+        batchP->dataCount = dataCount;
+        batchP->bufferLength = bufferLength;
+        size = 0;
+    }
+    notifP->size = size;
+    notifP->dataP = (lwm2m_data_t *)(uintptr_t)dataCount;
+
+    batchP->count++;
+    if (batchP->count >= batchP->maxCount)
+    {
+        prv_batchFlush(batchP);
+    }
+}
+
+void observe_batch_step(lwm2m_context_t * contextP,
+                        int64_t currentTime,
+                        int64_t * timeoutP)
+{
+    lwm2m_notify_batch_t * batchP = &contextP->notifyBatch;
+    int64_t interval;
+
+    if (0 == batchP->count) return;
+
+    interval = batchP->firstTime + batchP->maxDelay - currentTime;
+    if (interval <= 0)
+    {
+        prv_batchFlush(batchP);
+    }
+    else if (*timeoutP > interval)
+    {
+        *timeoutP = interval;
+    }
+}
+
+void observe_batch_free(lwm2m_context_t * contextP)
+{
+    lwm2m_notify_batch_t * batchP = &contextP->notifyBatch;
+
+    if (NULL != batchP->callback)
+    {
+        prv_batchFlush(batchP);
+    }
+    if (NULL != batchP->items) lwm2m_free(batchP->items);
+    if (NULL != batchP->data) lwm2m_free(batchP->data);
+    if (NULL != batchP->buffer) lwm2m_free(batchP->buffer);
+    memset(batchP, 0, sizeof(lwm2m_notify_batch_t));
+}
+
+int lwm2m_set_notification_batch(lwm2m_context_t * contextP,
+                                 size_t maxCount,
+                                 uint32_t maxDelay,
+                                 lwm2m_notification_callback_t callback,
+                                 void * userData)
+{
+    lwm2m_notify_batch_t * batchP = &contextP->notifyBatch;
+    lwm2m_notification_t * itemsP;
+
+    if (NULL == callback)
+    {
+        observe_batch_free(contextP);
+        return COAP_NO_ERROR;
+    }
+    if (0 == maxCount) return COAP_400_BAD_REQUEST;
+
+    itemsP = (lwm2m_notification_t *)lwm2m_malloc(maxCount * sizeof(lwm2m_notification_t));
+    if (NULL == itemsP) return COAP_500_INTERNAL_SERVER_ERROR;
+
+    if (NULL != batchP->callback)
+    {
+        prv_batchFlush(batchP);
+    }
+    if (NULL != batchP->items) lwm2m_free(batchP->items);
+    batchP->items = itemsP;
+    batchP->maxCount = maxCount;
+    batchP->maxDelay = maxDelay;
+    batchP->callback = callback;
+    batchP->userData = userData;
+
+    return COAP_NO_ERROR;
+}
+
 bool handle_observe_notify(lwm2m_context_t * contextP,
                            void * fromSessionH,
                            coap_packet_t * message,
@@ -552,24 +2351,16 @@ bool handle_observe_notify(lwm2m_context_t * contextP,
 {
     uint8_t * tokenP;
     int token_len;
-    uint16_t clientID;
-    uint16_t obsID;
-    lwm2m_client_t * clientP;
     lwm2m_observation_t * observationP;
     uint32_t count;
+    int64_t currentTime;
 
     token_len = coap_get_header_token(message, (const uint8_t **)&tokenP);
-    if (token_len != sizeof(uint32_t)) return false;
+    if (token_len == 0) return false;
 
     if (1 != coap_get_header_observe(message, &count)) return false;
 
-    clientID = (tokenP[0] << 8) | tokenP[1];
-    obsID = (tokenP[2] << 8) | tokenP[3];
-
-    clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, clientID);
-    if (clientP == NULL) return false;
-
-    observationP = (lwm2m_observation_t *)lwm2m_list_find((lwm2m_list_t *)clientP->observationList, obsID);
+    observationP = prv_findObservationByToken(contextP, tokenP, token_len);
     if (observationP == NULL)
     {
         coap_init_message(response, COAP_TYPE_RST, 0, message->mid);
@@ -581,11 +2372,26 @@ bool handle_observe_notify(lwm2m_context_t * contextP,
             coap_init_message(response, COAP_TYPE_ACK, 0, message->mid);
             message_send(contextP, response, fromSessionH);
         }
-        observationP->callback(clientID,
-                               &observationP->uri,
-                               (int)count,
-                               message->content_type, message->payload, message->payload_len,
-                               observationP->userData);
+
+        // late notifications reordered by the network are dropped
+        currentTime = lwm2m_gettime_ms();
+        if (prv_isFresh(observationP, count, currentTime))
+        {
+            observationP->counter = count;
+            observationP->counterTime = currentTime;
+            if (NULL != contextP->notifyBatch.callback)
+            {
+                prv_batchAdd(&contextP->notifyBatch, observationP, message, count, currentTime);
+            }
+            else
+            {
+                observationP->callback(observationP->clientP->internalID,
+                                       &observationP->uri,
+                                       (int)count,
+                                       message->content_type, message->payload, message->payload_len,
+                                       observationP->userData);
+            }
+        }
     }
     return true;
 }
@@ -107,13 +107,14 @@ static coap_status_t handle_request(lwm2m_context_t * contextP,
                                     coap_packet_t * message,
                                     coap_packet_t * response)
 {
+    lwm2m_uri_t uri;
     lwm2m_uri_t * uriP;
     coap_status_t result = NOT_FOUND_4_04;
 
 #ifdef LWM2M_CLIENT_MODE
-    uriP = lwm2m_decode_uri(contextP->altPath, message->uri_path);
+    uriP = lwm2m_decode_uri(contextP->altPath, message->uri_path, &uri);
 #else
-    uriP = lwm2m_decode_uri(NULL, message->uri_path);
+    uriP = lwm2m_decode_uri(NULL, message->uri_path, &uri);
 #endif
 
     if (uriP == NULL) return BAD_REQUEST_4_00;
@@ -174,7 +175,6 @@ static coap_status_t handle_request(lwm2m_context_t * contextP,
         result = NO_ERROR;
     }
 
-    lwm2m_free(uriP);
     return result;
 }
 
@@ -188,10 +188,12 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
                         void * fromSessionH)
 {
     coap_status_t coap_error_code = NO_ERROR;
-    static coap_packet_t message[1];
-    static coap_packet_t response[1];
+    coap_packet_t message[1];
+    coap_packet_t response[1];
+    const char * errorMessage = "";
 
     coap_error_code = coap_parse_message(message, buffer, (uint16_t)length);
+    if (NULL != message->error_message) errorMessage = message->error_message;
     if (coap_error_code == NO_ERROR)
     {
 #ifdef WITH_LOGS
@@ -247,7 +249,7 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
                     LOG("Block1 NOT IMPLEMENTED\n");
 
                     coap_error_code = NOT_IMPLEMENTED_5_01;
-                    coap_error_message = "NoBlock1Support";
+                    errorMessage = "NoBlock1Support";
                 }
                 else if ( IS_OPTION(message, COAP_OPTION_BLOCK2) )
                 {
@@ -346,7 +348,7 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
 
     if (coap_error_code != NO_ERROR && coap_error_code != COAP_IGNORE)
     {
-        LOG("ERROR %u: %s\n", coap_error_code, coap_error_message);
+        LOG("ERROR %u: %s\n", coap_error_code, errorMessage);
 
         /* Set to sendable error code. */
         if (coap_error_code >= 192)
@@ -355,7 +357,7 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
         }
         /* Reuse input buffer for error message. */
         coap_init_message(message, COAP_TYPE_ACK, coap_error_code, message->mid);
-        coap_set_payload(message, coap_error_message, strlen(coap_error_message));
+        coap_set_payload(message, errorMessage, strlen(errorMessage));
         message_send(contextP, message, fromSessionH);
     }
 }
@@ -366,12 +368,21 @@ coap_status_t message_send(lwm2m_context_t * contextP,
                            void * sessionH)
 {
     coap_status_t result = INTERNAL_SERVER_ERROR_5_00;
+    uint8_t stackBuffer[COAP_MAX_PACKET_SIZE];
     uint8_t * pktBuffer;
     size_t pktBufferLen = 0;
     size_t allocLen;
 
     allocLen = COAP_MAX_HEADER_SIZE + message->payload_len;
-    pktBuffer = (uint8_t *)lwm2m_malloc(allocLen);
+    if (allocLen <= sizeof(stackBuffer))
+    {
+        // most messages are small: avoid an allocation
+        pktBuffer = stackBuffer;
+    }
+    else
+    {
+        pktBuffer = (uint8_t *)lwm2m_malloc(allocLen);
+    }
     if (pktBuffer != NULL)
     {
         pktBufferLen = coap_serialize_message(message, pktBuffer);
@@ -379,7 +390,10 @@ coap_status_t message_send(lwm2m_context_t * contextP,
         {
             result = contextP->bufferSendCallback(sessionH, pktBuffer, pktBufferLen, contextP->userData);
         }
-        lwm2m_free(pktBuffer);
+        if (pktBuffer != stackBuffer)
+        {
+            lwm2m_free(pktBuffer);
+        }
     }
 
     return result;
@@ -118,10 +118,10 @@ static void prv_handleRegistrationReply(lwm2m_transaction_t * transacP,
     {
     case STATE_REG_PENDING:
     {
-        time_t tv_sec = lwm2m_gettime();
-        if (tv_sec >= 0)
+        int64_t tv_ms = lwm2m_gettime_ms();
+        if (tv_ms >= 0)
         {
-            targetP->registration = tv_sec;
+            targetP->registration = tv_ms;
         }
         if (packet != NULL && packet->code == CREATED_2_01)
         {
@@ -159,6 +159,9 @@ static void prv_register(lwm2m_context_t * contextP,
 
     lwm2m_transaction_t * transaction;
 
+    // a new registration ends the observations of the previous one
+    observe_remove_server(contextP, server);
+
     payload_length = prv_getRegisterPayload(contextP, payload, sizeof(payload));
     if (payload_length == 0) return;
 
@@ -195,7 +198,7 @@ static void prv_register(lwm2m_context_t * contextP,
         transaction->callback = prv_handleRegistrationReply;
         transaction->userData = (void *) server;
 
-        contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
+        transaction_add(contextP, transaction);
         if (transaction_send(contextP, transaction) == 0)
         {
             server->status = STATE_REG_PENDING;
@@ -208,20 +211,24 @@ static void prv_handleRegistrationUpdateReply(lwm2m_transaction_t * transacP,
 {
     coap_packet_t * packet = (coap_packet_t *)message;
     lwm2m_server_t * targetP = (lwm2m_server_t *)(transacP->peerP);
+    lwm2m_context_t * contextP = (lwm2m_context_t *)transacP->userData;
 
     switch(targetP->status)
     {
     case STATE_REG_UPDATE_PENDING:
     {
-        time_t tv_sec = lwm2m_gettime();
-        if (tv_sec >= 0)
+        int64_t tv_ms = lwm2m_gettime_ms();
+        if (tv_ms >= 0)
         {
-            targetP->registration = tv_sec;
+            targetP->registration = tv_ms;
         }
         if (packet != NULL && packet->code == CHANGED_2_04)
         {
             targetP->status = STATE_REGISTERED;
             LOG("    => REGISTERED\r\n");
+
+            // the client is awake: send what was kept for a server in queue mode
+            observe_flush_server(contextP, targetP);
         }
         else
         {
@@ -246,9 +253,9 @@ static int prv_update_registration(lwm2m_context_t * contextP,
     coap_set_header_uri_path(transaction->message, server->location);
 
     transaction->callback = prv_handleRegistrationUpdateReply;
-    transaction->userData = (void *) server;
+    transaction->userData = (void *) contextP;
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
+    transaction_add(contextP, transaction);
 
     if (transaction_send(contextP, transaction) == 0)
     {
@@ -290,13 +297,34 @@ int lwm2m_update_registration(lwm2m_context_t * contextP,
     return NOT_FOUND_4_04;
 }
 
+int lwm2m_set_server_congestion(lwm2m_context_t * contextP,
+                                uint16_t shortServerID,
+                                uint8_t nstart,
+                                uint16_t probingRate)
+{
+    lwm2m_server_t * targetP;
+
+    targetP = contextP->serverList;
+    while (targetP != NULL)
+    {
+        if (targetP->shortID == shortServerID)
+        {
+            transaction_set_congestion(contextP, &targetP->queue, nstart, probingRate);
+            return COAP_NO_ERROR;
+        }
+        targetP = targetP->next;
+    }
+
+    return COAP_404_NOT_FOUND;
+}
+
 // for each server update the registration if needed
 void registration_update(lwm2m_context_t * contextP,
-                         time_t currentTime,
-                         time_t * timeoutP)
+                         int64_t currentTime,
+                         int64_t * timeoutP)
 {
     time_t nextUpdate;
-    time_t interval;
+    int64_t interval;
     lwm2m_server_t * targetP = contextP->serverList;
 #ifdef LWM2M_BOOTSTRAP
     bool allServerFailed = true;
@@ -327,7 +355,7 @@ void registration_update(lwm2m_context_t * contextP,
                     nextUpdate -= 15; // update 15s earlier to have a chance to resend
                 }
 
-                interval = targetP->registration + nextUpdate - currentTime;
+                interval = targetP->registration + (int64_t)nextUpdate * 1000 - currentTime;
                 if (0 >= interval)
                 {
                     LOG("Updating registration...\r\n");
@@ -352,11 +380,13 @@ void registration_update(lwm2m_context_t * contextP,
                 break;
 
             case STATE_REG_FAILED:
+                // the server is unreachable: stop notifying it
+                observe_remove_server(contextP, targetP);
 #ifdef LWM2M_BOOTSTRAP
                 if (serverRegistered || NULL == contextP->bootstrapServerList)
                 {
 #endif
-                    interval = targetP->registration + targetP->lifetime - currentTime;
+                    interval = targetP->registration + (int64_t)targetP->lifetime * 1000 - currentTime;
                     if (0 >= interval)
                     {
                         LOG("Retry registration...\r\n");
@@ -418,6 +448,10 @@ void registration_deregister(lwm2m_context_t * contextP,
             return;
         }
 
+    // do not wait for the interactions still queued for this server
+    transaction_remove_peer(contextP, &serverP->queue);
+    observe_remove_server(contextP, serverP);
+
     lwm2m_transaction_t * transaction;
     transaction = transaction_new(COAP_TYPE_CON, COAP_DELETE, NULL, NULL, contextP->nextMID++, 4, NULL, ENDPOINT_SERVER, (void *)serverP);
     if (transaction == NULL) return;
@@ -427,7 +461,7 @@ void registration_deregister(lwm2m_context_t * contextP,
     transaction->callback = prv_handleDeregistrationReply;
     transaction->userData = (void *) contextP;
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
+    transaction_add(contextP, transaction);
     if (transaction_send(contextP, transaction) == 0)
     {
         serverP->status = STATE_DEREG_PENDING;
@@ -679,18 +713,260 @@ static lwm2m_client_object_t * prv_decodeRegisterPayload(uint8_t * payload,
     return objList;
 }
 
+/*
+ * Clients are indexed by endpoint name and by internalID in two open addressing
+ * hash tables using linear probing. Both have clientTableSize slots, a power of two,
+ * and are kept at most half full. Internal IDs are dense so they are their own hash.
+ */
+#define PRV_CLIENT_TABLE_INITIAL_SIZE   16
+
+static size_t prv_hashName(const char * name)
+{
+    return utils_hash((const uint8_t *)name, strlen(name));
+}
+
+static size_t prv_clientHome(lwm2m_client_t * clientP,
+                             bool byName,
+                             size_t mask)
+{
+    if (byName) return prv_hashName(clientP->name) & mask;
+    return clientP->internalID & mask;
+}
+
+static void prv_tableInsert(lwm2m_client_t ** table,
+                            size_t mask,
+                            lwm2m_client_t * clientP,
+                            bool byName)
+{
+    size_t i;
+
+    i = prv_clientHome(clientP, byName, mask);
+    while (NULL != table[i])
+    {
+        i = (i + 1) & mask;
+    }
+    table[i] = clientP;
+}
+
+// Backward shift deletion: the following entries of the cluster are moved up when their
+// home slot allows it, so that no tombstone is needed.
+static void prv_tableDelete(lwm2m_client_t ** table,
+                            size_t mask,
+                            lwm2m_client_t * clientP,
+                            bool byName)
+{
+    size_t i;
+    size_t j;
+
+    i = prv_clientHome(clientP, byName, mask);
+    while (table[i] != clientP)
+    {
+        if (NULL == table[i]) return;
+        i = (i + 1) & mask;
+    }
+
+    j = i;
+    while (true)
+    {
+        size_t home;
+
+        j = (j + 1) & mask;
+        if (NULL == table[j]) break;
+
+        home = prv_clientHome(table[j], byName, mask);
+        // keep table[j] in place when its home slot is cyclically in ]i, j]
+        if (i <= j ? (i < home && home <= j) : (i < home || home <= j)) continue;
+
+        table[i] = table[j];
+        i = j;
+    }
+    table[i] = NULL;
+}
+
+static int prv_resizeClientTables(lwm2m_context_t * contextP,
+                                  size_t size)
+{
+    lwm2m_client_t ** nameTable;
+    lwm2m_client_t ** idTable;
+    size_t i;
+
+    nameTable = (lwm2m_client_t **)lwm2m_malloc(size * sizeof(lwm2m_client_t *));
+    if (NULL == nameTable) return COAP_500_INTERNAL_SERVER_ERROR;
+    idTable = (lwm2m_client_t **)lwm2m_malloc(size * sizeof(lwm2m_client_t *));
+    if (NULL == idTable)
+    {
+        lwm2m_free(nameTable);
+        return COAP_500_INTERNAL_SERVER_ERROR;
+    }
+    memset(nameTable, 0, size * sizeof(lwm2m_client_t *));
+    memset(idTable, 0, size * sizeof(lwm2m_client_t *));
+
+    for (i = 0 ; i < contextP->clientTableSize ; i++)
+    {
+        if (NULL != contextP->clientIdTable[i])
+        {
+            prv_tableInsert(nameTable, size - 1, contextP->clientIdTable[i], true);
+            prv_tableInsert(idTable, size - 1, contextP->clientIdTable[i], false);
+        }
+    }
+    if (NULL != contextP->clientNameTable) lwm2m_free(contextP->clientNameTable);
+    if (NULL != contextP->clientIdTable) lwm2m_free(contextP->clientIdTable);
+    contextP->clientNameTable = nameTable;
+    contextP->clientIdTable = idTable;
+    contextP->clientTableSize = size;
+
+    return 0;
+}
+
+/*
+ * clientList stays sorted by internalID without being walked: a client is linked after
+ * the client holding the previous allocated ID, found through the ID table.
+ */
+static lwm2m_client_t * prv_getPreviousClient(lwm2m_context_t * contextP,
+                                              uint16_t clientID)
+{
+    int previousID;
+
+    previousID = lwm2m_id_set_previous(&contextP->clientIds, clientID);
+    if (previousID < 0) return NULL;
+
+    return registration_find_client(contextP, (uint16_t)previousID);
+}
+
+// Makes room for one more client in the tables and in the clientHeap, so that it can be
+// scheduled without failure once its endOfLife is known.
+static int prv_reserveClientSlot(lwm2m_context_t * contextP)
+{
+    if ((contextP->clientCount + 1) * 2 > contextP->clientTableSize)
+    {
+        size_t size;
+
+        size = contextP->clientTableSize == 0 ? PRV_CLIENT_TABLE_INITIAL_SIZE : contextP->clientTableSize * 2;
+        if (0 != prv_resizeClientTables(contextP, size)) return COAP_500_INTERNAL_SERVER_ERROR;
+    }
+    if (0 != utils_heapReserve(&contextP->clientHeap)) return COAP_500_INTERNAL_SERVER_ERROR;
+
+    return 0;
+}
+
+// clientP internalID must be allocated in the context's clientIds.
+static void prv_insertClient(lwm2m_context_t * contextP,
+                             lwm2m_client_t * clientP)
+{
+    lwm2m_client_t * previousP;
+
+    previousP = prv_getPreviousClient(contextP, clientP->internalID);
+    if (NULL == previousP)
+    {
+        clientP->next = contextP->clientList;
+        contextP->clientList = clientP;
+    }
+    else
+    {
+        clientP->next = previousP->next;
+        previousP->next = clientP;
+    }
+
+    prv_tableInsert(contextP->clientNameTable, contextP->clientTableSize - 1, clientP, true);
+    prv_tableInsert(contextP->clientIdTable, contextP->clientTableSize - 1, clientP, false);
+    contextP->clientCount++;
+}
+
+// clientP must have its name set. Its internalID is the lowest one available.
+static int prv_addClient(lwm2m_context_t * contextP,
+                         lwm2m_client_t * clientP)
+{
+    if (0 != prv_reserveClientSlot(contextP)) return COAP_500_INTERNAL_SERVER_ERROR;
+    if (0 != lwm2m_id_set_alloc(&contextP->clientIds, &clientP->internalID))
+    {
+        utils_heapRelease(&contextP->clientHeap);
+        return COAP_500_INTERNAL_SERVER_ERROR;
+    }
+
+    prv_insertClient(contextP, clientP);
+
+    return 0;
+}
+
 static lwm2m_client_t * prv_getClientByName(lwm2m_context_t * contextP,
                                             char * name)
 {
-    lwm2m_client_t * targetP;
+    size_t mask;
+    size_t i;
+
+    if (0 == contextP->clientCount) return NULL;
 
-    targetP = contextP->clientList;
-    while (targetP != NULL && strcmp(name, targetP->name) != 0)
+    mask = contextP->clientTableSize - 1;
+    for (i = prv_hashName(name) & mask ; NULL != contextP->clientNameTable[i] ; i = (i + 1) & mask)
     {
-        targetP = targetP->next;
+        if (0 == strcmp(name, contextP->clientNameTable[i]->name))
+        {
+            return contextP->clientNameTable[i];
+        }
+    }
+
+    return NULL;
+}
+
+// Adds a client keeping its internalID, as when restoring a snapshot.
+int registration_restore_client(lwm2m_context_t * contextP,
+                                lwm2m_client_t * clientP)
+{
+    if (NULL != prv_getClientByName(contextP, clientP->name)) return COAP_400_BAD_REQUEST;
+    if (0 != prv_reserveClientSlot(contextP)) return COAP_500_INTERNAL_SERVER_ERROR;
+    if (0 != lwm2m_id_set_reserve(&contextP->clientIds, clientP->internalID))
+    {
+        utils_heapRelease(&contextP->clientHeap);
+        return COAP_400_BAD_REQUEST;
     }
 
-    return targetP;
+    prv_insertClient(contextP, clientP);
+    utils_heapSchedule(&contextP->clientHeap, clientP);
+
+    return 0;
+}
+
+lwm2m_client_t * registration_find_client(lwm2m_context_t * contextP,
+                                          uint16_t clientID)
+{
+    size_t mask;
+    size_t i;
+
+    if (0 == contextP->clientCount) return NULL;
+
+    mask = contextP->clientTableSize - 1;
+    for (i = clientID & mask ; NULL != contextP->clientIdTable[i] ; i = (i + 1) & mask)
+    {
+        if (clientID == contextP->clientIdTable[i]->internalID)
+        {
+            return contextP->clientIdTable[i];
+        }
+    }
+
+    return NULL;
+}
+
+void registration_remove_client(lwm2m_context_t * contextP,
+                                lwm2m_client_t * clientP)
+{
+    lwm2m_client_t * previousP;
+
+    previousP = prv_getPreviousClient(contextP, clientP->internalID);
+    if (NULL == previousP)
+    {
+        contextP->clientList = clientP->next;
+    }
+    else
+    {
+        previousP->next = clientP->next;
+    }
+    lwm2m_id_set_release(&contextP->clientIds, clientP->internalID);
+    utils_heapUnschedule(&contextP->clientHeap, clientP);
+    utils_heapRelease(&contextP->clientHeap);
+
+    prv_tableDelete(contextP->clientNameTable, contextP->clientTableSize - 1, clientP, true);
+    prv_tableDelete(contextP->clientIdTable, contextP->clientTableSize - 1, clientP, false);
+    contextP->clientCount--;
 }
 
 static void prv_freeClientObjectList(lwm2m_client_object_t * objects)
@@ -722,15 +998,37 @@ void prv_freeClient(lwm2m_client_t * clientP)
     prv_freeClientObjectList(clientP->objectList);
     while(clientP->observationList != NULL)
     {
-        lwm2m_observation_t * targetP;
-
-        targetP = clientP->observationList;
-        clientP->observationList = clientP->observationList->next;
-        lwm2m_free(targetP);
+        observation_remove(clientP, clientP->observationList);
     }
+    lwm2m_id_set_clear(&clientP->observationIds);
     lwm2m_free(clientP);
 }
 
+void registration_free_clients(lwm2m_context_t * contextP)
+{
+    while (NULL != contextP->clientList)
+    {
+        lwm2m_client_t * clientP;
+
+        clientP = contextP->clientList;
+        contextP->clientList = contextP->clientList->next;
+
+        prv_freeClient(clientP);
+    }
+    if (NULL != contextP->clientNameTable) lwm2m_free(contextP->clientNameTable);
+    if (NULL != contextP->clientIdTable) lwm2m_free(contextP->clientIdTable);
+    contextP->clientNameTable = NULL;
+    contextP->clientIdTable = NULL;
+    contextP->clientTableSize = 0;
+    contextP->clientCount = 0;
+    utils_heapFree(&contextP->clientHeap);
+    if (NULL != contextP->observationTable) lwm2m_free(contextP->observationTable);
+    contextP->observationTable = NULL;
+    contextP->observationTableSize = 0;
+    contextP->observationTableLoad = 0;
+    lwm2m_id_set_clear(&contextP->clientIds);
+}
+
 static int prv_getLocationString(uint16_t id,
                                  char location[MAX_LOCATION_LENGTH])
 {
@@ -754,10 +1052,10 @@ coap_status_t handle_registration_request(lwm2m_context_t * contextP,
                                           coap_packet_t * response)
 {
     coap_status_t result;
-    time_t tv_sec;
+    int64_t tv_ms;
 
-    tv_sec = lwm2m_gettime();
-    if (tv_sec < 0) return COAP_500_INTERNAL_SERVER_ERROR;
+    tv_ms = lwm2m_gettime_ms();
+    if (tv_ms < 0) return COAP_500_INTERNAL_SERVER_ERROR;
 
     switch(message->code)
     {
@@ -828,25 +1126,32 @@ coap_status_t handle_registration_request(lwm2m_context_t * contextP,
                     return COAP_500_INTERNAL_SERVER_ERROR;
                 }
                 memset(clientP, 0, sizeof(lwm2m_client_t));
-                clientP->internalID = lwm2m_list_newId((lwm2m_list_t *)contextP->clientList);
-                contextP->clientList = (lwm2m_client_t *)LWM2M_LIST_ADD(contextP->clientList, clientP);
+                clientP->name = name;
+                if (0 != prv_addClient(contextP, clientP))
+                {
+                    lwm2m_free(clientP);
+                    lwm2m_free(name);
+                    lwm2m_free(altPath);
+                    if (msisdn != NULL) lwm2m_free(msisdn);
+                    prv_freeClientObjectList(objects);
+                    return COAP_500_INTERNAL_SERVER_ERROR;
+                }
             }
             clientP->name = name;
             clientP->binding = binding;
             clientP->msisdn = msisdn;
             clientP->altPath = altPath;
             clientP->lifetime = lifetime;
-            clientP->endOfLife = tv_sec + lifetime;
+            clientP->endOfLife = tv_ms + (int64_t)lifetime * 1000;
+            utils_heapSchedule(&contextP->clientHeap, clientP);
             clientP->objectList = objects;
             clientP->sessionH = fromSessionH;
 
-            if (prv_getLocationString(clientP->internalID, location) == 0)
-            {
-                prv_freeClient(clientP);
-                return COAP_500_INTERNAL_SERVER_ERROR;
-            }
-            if (coap_set_header_location_path(response, location) == 0)
+            if (prv_getLocationString(clientP->internalID, location) == 0
+             || coap_set_header_location_path(response, location) == 0)
             {
+                registration_remove_client(contextP, clientP);
+                transaction_remove_peer(contextP, &clientP->queue);
                 prv_freeClient(clientP);
                 return COAP_500_INTERNAL_SERVER_ERROR;
             }
@@ -859,7 +1164,7 @@ coap_status_t handle_registration_request(lwm2m_context_t * contextP,
             break;
 
         case LWM2M_URI_FLAG_OBJECT_ID:
-            clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, uriP->objectId);
+            clientP = registration_find_client(contextP, uriP->objectId);
             if (clientP == NULL) return COAP_404_NOT_FOUND;
 
             // Endpoint client name MUST NOT be present
@@ -932,7 +1237,8 @@ coap_status_t handle_registration_request(lwm2m_context_t * contextP,
                 clientP->objectList = objects;
             }
 
-            clientP->endOfLife = tv_sec + clientP->lifetime;
+            clientP->endOfLife = tv_ms + (int64_t)clientP->lifetime * 1000;
+            utils_heapSchedule(&contextP->clientHeap, clientP);
 
             if (contextP->monitorCallback != NULL)
             {
@@ -953,12 +1259,14 @@ coap_status_t handle_registration_request(lwm2m_context_t * contextP,
 
         if ((uriP->flag & LWM2M_URI_MASK_ID) != LWM2M_URI_FLAG_OBJECT_ID) return COAP_400_BAD_REQUEST;
 
-        contextP->clientList = (lwm2m_client_t *)LWM2M_LIST_RM(contextP->clientList, uriP->objectId, &clientP);
+        clientP = registration_find_client(contextP, uriP->objectId);
         if (clientP == NULL) return COAP_400_BAD_REQUEST;
+        registration_remove_client(contextP, clientP);
         if (contextP->monitorCallback != NULL)
         {
             contextP->monitorCallback(clientP->internalID, NULL, DELETED_2_02, LWM2M_CONTENT_TEXT, NULL, 0, contextP->monitorUserData);
         }
+        transaction_remove_peer(contextP, &clientP->queue);
         prv_freeClient(clientP);
         result = COAP_202_DELETED;
     }
@@ -0,0 +1,464 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2015 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - initial API and implementation
+ *
+ *******************************************************************************/
+
+/*
+ * Snapshot of the registered clients and of their observations, so that a restarted server
+ * accepts the notifications of the existing observations without any exchange with the clients.
+ *
+ * All the integers are stored in network byte order:
+ *
+ *  header:       "LWS" version(1) clientCount(4)
+ *  client:       internalID(2) binding(1) lifetime(4) remaining lifetime in ms(8)
+ *                name(string) msisdn(string) altPath(string) session(1 + length)
+ *                objectCount(2) { objectID(2) instanceCount(2) { instanceID(2) } }
+ *                observationCount(2) { observation }
+ *  observation:  id(2) uri flag(1) objectId(2) instanceId(2) resourceId(2)
+ *                token(1 + length) counter(4) age of the counter in ms(8)
+ *  string:       length(2) bytes, the length 0xFFFF standing for NULL
+ *
+ * Dates are saved relatively to the time of the snapshot, as lwm2m_gettime_ms() may
+ * restart from another origin.
+ */
+
+#include "internals.h"
+
+#ifdef LWM2M_SERVER_MODE
+
+#define PRV_SNAPSHOT_VERSION    1
+#define PRV_NULL_STRING         0xFFFF
+
+typedef struct
+{
+    uint8_t *   buffer;     // NULL when only measuring
+    size_t      length;
+    size_t      index;      // may go beyond length, the snapshot is then too large
+} prv_writer_t;
+
+typedef struct
+{
+    const uint8_t * buffer;
+    size_t          length;
+    size_t          index;
+    bool            error;  // set on the first read beyond length
+} prv_reader_t;
+
+static void prv_writeBytes(prv_writer_t * writerP,
+                           const uint8_t * data,
+                           size_t length)
+{
+    if (NULL != writerP->buffer && writerP->index + length <= writerP->length)
+    {
+        memcpy(writerP->buffer + writerP->index, data, length);
+    }
+    writerP->index += length;
+}
+
+static void prv_writeInt(prv_writer_t * writerP,
+                         uint64_t value,
+                         size_t length)
+{
+    uint8_t data[8];
+    size_t i;
+
+    for (i = 0 ; i < length ; i++)
+    {
+        data[length - 1 - i] = (uint8_t)(value >> (8 * i));
+    }
+    prv_writeBytes(writerP, data, length);
+}
+
+static void prv_writeString(prv_writer_t * writerP,
+                            const char * string)
+{
+    size_t length;
+
+    if (NULL == string)
+    {
+        prv_writeInt(writerP, PRV_NULL_STRING, 2);
+        return;
+    }
+
+    length = strlen(string);
+    if (length >= PRV_NULL_STRING) length = PRV_NULL_STRING - 1;
+    prv_writeInt(writerP, length, 2);
+    prv_writeBytes(writerP, (const uint8_t *)string, length);
+}
+
+static const uint8_t * prv_readBytes(prv_reader_t * readerP,
+                                     size_t length)
+{
+    const uint8_t * data;
+
+    if (readerP->error || readerP->index + length > readerP->length)
+    {
+        readerP->error = true;
+        return NULL;
+    }
+    data = readerP->buffer + readerP->index;
+    readerP->index += length;
+
+    return data;
+}
+
+static uint64_t prv_readInt(prv_reader_t * readerP,
+                            size_t length)
+{
+    const uint8_t * data;
+    uint64_t value;
+    size_t i;
+
+    data = prv_readBytes(readerP, length);
+    if (NULL == data) return 0;
+
+    value = 0;
+    for (i = 0 ; i < length ; i++)
+    {
+        value = (value << 8) | data[i];
+    }
+
+    return value;
+}
+
+// Returns false on error. A NULL string is returned as such.
+static bool prv_readString(prv_reader_t * readerP,
+                           char ** stringP)
+{
+    const uint8_t * data;
+    size_t length;
+
+    *stringP = NULL;
+
+    length = (size_t)prv_readInt(readerP, 2);
+    if (readerP->error) return false;
+    if (PRV_NULL_STRING == length) return true;
+
+    data = prv_readBytes(readerP, length);
+    if (NULL == data) return false;
+
+    *stringP = (char *)lwm2m_malloc(length + 1);
+    if (NULL == *stringP) return false;
+    memcpy(*stringP, data, length);
+    (*stringP)[length] = 0;
+
+    return true;
+}
+
+static void prv_saveClient(prv_writer_t * writerP,
+                           lwm2m_client_t * clientP,
+                           int64_t currentTime,
+                           lwm2m_session_save_callback_t saveCallback,
+                           void * userData)
+{
+    lwm2m_client_object_t * objectP;
+    lwm2m_observation_t * observationP;
+    uint8_t session[LWM2M_SNAPSHOT_SESSION_MAX_LENGTH];
+    size_t sessionLength;
+    size_t count;
+
+    prv_writeInt(writerP, clientP->internalID, 2);
+    prv_writeInt(writerP, clientP->binding, 1);
+    prv_writeInt(writerP, clientP->lifetime, 4);
+    prv_writeInt(writerP, (uint64_t)(clientP->endOfLife > currentTime ? clientP->endOfLife - currentTime : 0), 8);
+    prv_writeString(writerP, clientP->name);
+    prv_writeString(writerP, clientP->msisdn);
+    prv_writeString(writerP, clientP->altPath);
+
+    sessionLength = saveCallback(clientP->sessionH, session, sizeof(session), userData);
+    if (sessionLength > sizeof(session)) sessionLength = 0;
+    prv_writeInt(writerP, sessionLength, 1);
+    prv_writeBytes(writerP, session, sessionLength);
+
+    count = 0;
+    for (objectP = clientP->objectList ; objectP != NULL ; objectP = objectP->next) count++;
+    prv_writeInt(writerP, count, 2);
+    for (objectP = clientP->objectList ; objectP != NULL ; objectP = objectP->next)
+    {
+        lwm2m_list_t * instanceP;
+
+        prv_writeInt(writerP, objectP->id, 2);
+        count = 0;
+        for (instanceP = objectP->instanceList ; instanceP != NULL ; instanceP = instanceP->next) count++;
+        prv_writeInt(writerP, count, 2);
+        for (instanceP = objectP->instanceList ; instanceP != NULL ; instanceP = instanceP->next)
+        {
+            prv_writeInt(writerP, instanceP->id, 2);
+        }
+    }
+
+    // the observations not acknowledged yet are dropped: their request is lost with the transactions
+    count = 0;
+    for (observationP = clientP->observationList ; observationP != NULL ; observationP = observationP->next)
+    {
+        if (STATE_REGISTERED == observationP->status) count++;
+    }
+    prv_writeInt(writerP, count, 2);
+    for (observationP = clientP->observationList ; observationP != NULL ; observationP = observationP->next)
+    {
+        if (STATE_REGISTERED != observationP->status) continue;
+
+        prv_writeInt(writerP, observationP->id, 2);
+        prv_writeInt(writerP, observationP->uri.flag, 1);
+        prv_writeInt(writerP, observationP->uri.objectId, 2);
+        prv_writeInt(writerP, observationP->uri.instanceId, 2);
+        prv_writeInt(writerP, observationP->uri.resourceId, 2);
+        prv_writeInt(writerP, observationP->tokenLen, 1);
+        prv_writeBytes(writerP, observationP->token, observationP->tokenLen);
+        prv_writeInt(writerP, observationP->counter, 4);
+        prv_writeInt(writerP, (uint64_t)(currentTime - observationP->counterTime), 8);
+    }
+}
+
+size_t lwm2m_snapshot_save(lwm2m_context_t * contextP,
+                           uint8_t * buffer,
+                           size_t length,
+                           lwm2m_session_save_callback_t saveCallback,
+                           void * userData)
+{
+    prv_writer_t writer;
+    lwm2m_client_t * clientP;
+    int64_t currentTime;
+
+    currentTime = lwm2m_gettime_ms();
+    if (currentTime < 0) return 0;
+
+    writer.buffer = buffer;
+    writer.length = length;
+    writer.index = 0;
+
+    prv_writeBytes(&writer, (const uint8_t *)"LWS", 3);
+    prv_writeInt(&writer, PRV_SNAPSHOT_VERSION, 1);
+    prv_writeInt(&writer, contextP->clientCount, 4);
+    for (clientP = contextP->clientList ; clientP != NULL ; clientP = clientP->next)
+    {
+        prv_saveClient(&writer, clientP, currentTime, saveCallback, userData);
+    }
+
+    if (NULL != buffer && writer.index > length) return 0;
+
+    return writer.index;
+}
+
+static int prv_restoreObjects(prv_reader_t * readerP,
+                              lwm2m_client_t * clientP)
+{
+    lwm2m_client_object_t * lastObjectP = NULL;
+    size_t objectCount;
+
+    objectCount = (size_t)prv_readInt(readerP, 2);
+    while (0 < objectCount-- && !readerP->error)
+    {
+        lwm2m_client_object_t * objectP;
+        lwm2m_list_t * lastInstanceP = NULL;
+        size_t instanceCount;
+
+        objectP = (lwm2m_client_object_t *)lwm2m_malloc(sizeof(lwm2m_client_object_t));
+        if (NULL == objectP) return COAP_500_INTERNAL_SERVER_ERROR;
+        memset(objectP, 0, sizeof(lwm2m_client_object_t));
+        if (NULL == lastObjectP) clientP->objectList = objectP;
+        else lastObjectP->next = objectP;
+        lastObjectP = objectP;
+
+        objectP->id = (uint16_t)prv_readInt(readerP, 2);
+        instanceCount = (size_t)prv_readInt(readerP, 2);
+        while (0 < instanceCount-- && !readerP->error)
+        {
+            lwm2m_list_t * instanceP;
+
+            instanceP = (lwm2m_list_t *)lwm2m_malloc(sizeof(lwm2m_list_t));
+            if (NULL == instanceP) return COAP_500_INTERNAL_SERVER_ERROR;
+            instanceP->next = NULL;
+            instanceP->id = (uint16_t)prv_readInt(readerP, 2);
+            if (NULL == lastInstanceP) objectP->instanceList = instanceP;
+            else lastInstanceP->next = instanceP;
+            lastInstanceP = instanceP;
+        }
+    }
+
+    return readerP->error ? COAP_400_BAD_REQUEST : 0;
+}
+
+static int prv_restoreObservations(lwm2m_context_t * contextP,
+                                   prv_reader_t * readerP,
+                                   lwm2m_client_t * clientP,
+                                   int64_t currentTime,
+                                   lwm2m_result_callback_t callback,
+                                   void * userData)
+{
+    lwm2m_observation_t * lastP = NULL;
+    size_t count;
+
+    count = (size_t)prv_readInt(readerP, 2);
+    while (0 < count-- && !readerP->error)
+    {
+        lwm2m_observation_t * observationP;
+        const uint8_t * tokenP;
+        int result;
+
+        observationP = (lwm2m_observation_t *)lwm2m_malloc(sizeof(lwm2m_observation_t));
+        if (NULL == observationP) return COAP_500_INTERNAL_SERVER_ERROR;
+        memset(observationP, 0, sizeof(lwm2m_observation_t));
+
+        observationP->id = (uint16_t)prv_readInt(readerP, 2);
+        observationP->uri.flag = (uint8_t)prv_readInt(readerP, 1);
+        observationP->uri.objectId = (uint16_t)prv_readInt(readerP, 2);
+        observationP->uri.instanceId = (uint16_t)prv_readInt(readerP, 2);
+        observationP->uri.resourceId = (uint16_t)prv_readInt(readerP, 2);
+        observationP->tokenLen = (uint8_t)prv_readInt(readerP, 1);
+        if (observationP->tokenLen > sizeof(observationP->token))
+        {
+            lwm2m_free(observationP);
+            return COAP_400_BAD_REQUEST;
+        }
+        tokenP = prv_readBytes(readerP, observationP->tokenLen);
+        if (NULL != tokenP) memcpy(observationP->token, tokenP, observationP->tokenLen);
+        observationP->counter = (uint32_t)prv_readInt(readerP, 4);
+        observationP->counterTime = currentTime - (int64_t)prv_readInt(readerP, 8);
+
+        // the list is kept ordered by ID
+        if (readerP->error
+         || (NULL != lastP && lastP->id >= observationP->id))
+        {
+            lwm2m_free(observationP);
+            return COAP_400_BAD_REQUEST;
+        }
+
+        observationP->clientP = clientP;
+        observationP->status = STATE_REGISTERED;
+        observationP->callback = callback;
+        observationP->userData = userData;
+
+        result = observation_restore(contextP, observationP);
+        if (0 != result)
+        {
+            lwm2m_free(observationP);
+            return result;
+        }
+        if (NULL == lastP) clientP->observationList = observationP;
+        else lastP->next = observationP;
+        lastP = observationP;
+    }
+
+    return readerP->error ? COAP_400_BAD_REQUEST : 0;
+}
+
+static int prv_restoreClient(lwm2m_context_t * contextP,
+                             prv_reader_t * readerP,
+                             int64_t currentTime,
+                             lwm2m_session_load_callback_t loadCallback,
+                             void * loadUserData,
+                             lwm2m_result_callback_t callback,
+                             void * userData)
+{
+    lwm2m_client_t * clientP;
+    const uint8_t * sessionP;
+    size_t sessionLength;
+    int result;
+
+    clientP = (lwm2m_client_t *)lwm2m_malloc(sizeof(lwm2m_client_t));
+    if (NULL == clientP) return COAP_500_INTERNAL_SERVER_ERROR;
+    memset(clientP, 0, sizeof(lwm2m_client_t));
+
+    clientP->internalID = (uint16_t)prv_readInt(readerP, 2);
+    clientP->binding = (lwm2m_binding_t)prv_readInt(readerP, 1);
+    clientP->lifetime = (uint32_t)prv_readInt(readerP, 4);
+    clientP->endOfLife = currentTime + (int64_t)prv_readInt(readerP, 8);
+    if (!prv_readString(readerP, &clientP->name)
+     || !prv_readString(readerP, &clientP->msisdn)
+     || !prv_readString(readerP, &clientP->altPath)
+     || NULL == clientP->name)
+    {
+        prv_freeClient(clientP);
+        return COAP_400_BAD_REQUEST;
+    }
+
+    sessionLength = (size_t)prv_readInt(readerP, 1);
+    sessionP = prv_readBytes(readerP, sessionLength);
+    if (NULL == sessionP)
+    {
+        prv_freeClient(clientP);
+        return COAP_400_BAD_REQUEST;
+    }
+    clientP->sessionH = loadCallback(sessionP, sessionLength, loadUserData);
+    if (NULL == clientP->sessionH)
+    {
+        prv_freeClient(clientP);
+        return COAP_500_INTERNAL_SERVER_ERROR;
+    }
+
+    result = prv_restoreObjects(readerP, clientP);
+    if (0 != result)
+    {
+        prv_freeClient(clientP);
+        return result;
+    }
+
+    // the client is indexed first so that it is freed with the context on error
+    result = registration_restore_client(contextP, clientP);
+    if (0 != result)
+    {
+        prv_freeClient(clientP);
+        return result;
+    }
+
+    return prv_restoreObservations(contextP, readerP, clientP, currentTime, callback, userData);
+}
+
+int lwm2m_snapshot_restore(lwm2m_context_t * contextP,
+                           const uint8_t * buffer,
+                           size_t length,
+                           lwm2m_session_load_callback_t loadCallback,
+                           void * loadUserData,
+                           lwm2m_result_callback_t callback,
+                           void * userData)
+{
+    prv_reader_t reader;
+    const uint8_t * magicP;
+    size_t count;
+    int64_t currentTime;
+    int result;
+
+    if (0 != contextP->clientCount) return COAP_405_METHOD_NOT_ALLOWED;
+
+    currentTime = lwm2m_gettime_ms();
+    if (currentTime < 0) return COAP_500_INTERNAL_SERVER_ERROR;
+
+    reader.buffer = buffer;
+    reader.length = length;
+    reader.index = 0;
+    reader.error = false;
+
+    magicP = prv_readBytes(&reader, 3);
+    if (NULL == magicP || 0 != memcmp(magicP, "LWS", 3)) return COAP_400_BAD_REQUEST;
+    if (PRV_SNAPSHOT_VERSION != prv_readInt(&reader, 1)) return COAP_400_BAD_REQUEST;
+
+    result = 0;
+    count = (size_t)prv_readInt(&reader, 4);
+    while (0 == result && 0 < count-- && !reader.error)
+    {
+        result = prv_restoreClient(contextP, &reader, currentTime, loadCallback, loadUserData, callback, userData);
+    }
+    if (0 == result && reader.error) result = COAP_400_BAD_REQUEST;
+
+    if (0 != result)
+    {
+        registration_free_clients(contextP);
+    }
+
+    return result;
+}
+
+#endif
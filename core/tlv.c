@@ -369,71 +369,218 @@ lwm2m_data_t * lwm2m_data_new(int size)
     return dataP;
 }
 
-static int prv_parseTLV(uint8_t * buffer,
-                        size_t bufferLen,
-                        lwm2m_data_t ** dataP)
+// Counts the TLV records of buffer up to the first invalid one.
+static int prv_countTLV(uint8_t * buffer,
+                        size_t bufferLen)
 {
     lwm2m_tlv_type_t type;
     uint16_t id;
     size_t dataIndex;
     size_t dataLen;
-    int index = 0;
+    size_t index = 0;
     int result;
-    int size = 0;
-
-    *dataP = NULL;
+    int count = 0;
 
-    while (0 != (result = lwm2m_decodeTLV((uint8_t*)buffer + index, bufferLen - index, &type, &id, &dataIndex, &dataLen)))
+    while (index < bufferLen
+        && 0 != (result = lwm2m_decodeTLV(buffer + index, bufferLen - index, &type, &id, &dataIndex, &dataLen)))
     {
-        lwm2m_data_t * newTlvP;
+        count++;
+        index += result;
+    }
+
+    return count;
+}
 
-        newTlvP = lwm2m_data_new(size + 1);
-        if (size >= 1)
+// Adds the count of the TLV records of buffer and of all their children to totalP.
+// Returns the count of the top-level records or -1 if a container holds no valid record.
+static int prv_countTree(uint8_t * buffer,
+                         size_t bufferLen,
+                         size_t * totalP)
+{
+    lwm2m_tlv_type_t type;
+    uint16_t id;
+    size_t dataIndex;
+    size_t dataLen;
+    size_t index = 0;
+    int result;
+    int count = 0;
+
+    while (index < bufferLen
+        && 0 != (result = lwm2m_decodeTLV(buffer + index, bufferLen - index, &type, &id, &dataIndex, &dataLen)))
+    {
+        if (type == LWM2M_TYPE_OBJECT_INSTANCE || type == LWM2M_TYPE_MULTIPLE_RESOURCE)
         {
-            if (newTlvP == NULL)
-            {
-                lwm2m_data_free(size, *dataP);
-                return 0;
-            }
-            else
-            {
-                memcpy(newTlvP, *dataP, size * sizeof(lwm2m_data_t));
-                lwm2m_free(*dataP);
-            }
+            int childCount;
+
+            childCount = prv_countTree(buffer + index + dataIndex, dataLen, totalP);
+            if (childCount < 0 || (childCount == 0 && dataLen != 0)) return -1;
         }
-        *dataP = newTlvP;
+        count++;
+        index += result;
+    }
+    *totalP += count;
+
+    return count;
+}
+
+// Decodes the first count TLV records of buffer in dataP. The records of a level are contiguous
+// and the children of the containers are stored from nextP.
+static void prv_decodeTree(uint8_t * buffer,
+                           size_t bufferLen,
+                           int count,
+                           lwm2m_data_t * dataP,
+                           lwm2m_data_t ** nextP)
+{
+    lwm2m_tlv_type_t type;
+    uint16_t id;
+    size_t dataIndex;
+    size_t dataLen;
+    size_t index = 0;
+    int i;
+
+    for (i = 0 ; i < count ; i++)
+    {
+        int result;
+
+        result = lwm2m_decodeTLV(buffer + index, bufferLen - index, &type, &id, &dataIndex, &dataLen);
 
-        (*dataP)[size].type = type;
-        (*dataP)[size].id = id;
+        dataP[i].type = type;
+        dataP[i].id = id;
+        // the values are in buffer and the children in the same allocation as the top-level records
+        dataP[i].flags = LWM2M_TLV_FLAG_STATIC_DATA;
         if (type == LWM2M_TYPE_OBJECT_INSTANCE || type == LWM2M_TYPE_MULTIPLE_RESOURCE)
         {
-            (*dataP)[size].length = prv_parseTLV(buffer + index + dataIndex,
-                                                 dataLen,
-                                                 (lwm2m_data_t **)&((*dataP)[size].value));
-            if ((*dataP)[size].length == 0)
-            {
-                lwm2m_data_free(size + 1, *dataP);
-                return 0;
-            }
+            lwm2m_data_t * childP = *nextP;
+            int childCount;
+
+            childCount = prv_countTLV(buffer + index + dataIndex, dataLen);
+            *nextP += childCount;
+            dataP[i].length = childCount;
+            dataP[i].value = childCount ? (uint8_t *)childP : NULL;
+            prv_decodeTree(buffer + index + dataIndex, dataLen, childCount, childP, nextP);
         }
         else
         {
-            (*dataP)[size].flags = LWM2M_TLV_FLAG_STATIC_DATA;
-            (*dataP)[size].length = dataLen;
-            (*dataP)[size].value = (uint8_t*)buffer + index + dataIndex;
+            dataP[i].length = dataLen;
+            dataP[i].value = buffer + index + dataIndex;
         }
-        size++;
         index += result;
     }
+}
+
+// The whole tree is decoded in a single allocation, sized by a first pass.
+static int prv_parseTLV(uint8_t * buffer,
+                        size_t bufferLen,
+                        lwm2m_data_t ** dataP)
+{
+    lwm2m_data_t * nextP;
+    size_t total = 0;
+    int size;
+
+    *dataP = NULL;
+
+    size = prv_countTree(buffer, bufferLen, &total);
+    if (size <= 0) return 0;
+
+    *dataP = lwm2m_data_new(total);
+    if (*dataP == NULL) return 0;
+
+    nextP = *dataP + size;
+    prv_decodeTree(buffer, bufferLen, size, *dataP, &nextP);
 
     return size;
 }
 
+void lwm2m_tlv_iterator_init(lwm2m_tlv_iterator_t * iteratorP,
+                             uint8_t * buffer,
+                             size_t length)
+{
+    memset(iteratorP, 0, sizeof(lwm2m_tlv_iterator_t));
+    iteratorP->buffer = buffer;
+    iteratorP->length = length;
+    iteratorP->instanceId = LWM2M_MAX_ID;
+    iteratorP->resourceId = LWM2M_MAX_ID;
+}
+
+int lwm2m_tlv_iterator_next(lwm2m_tlv_iterator_t * iteratorP,
+                            lwm2m_data_t * dataP)
+{
+    while (1)
+    {
+        lwm2m_tlv_type_t type;
+        uint16_t id;
+        size_t dataIndex;
+        size_t dataLen;
+        size_t end;
+        int result;
+
+        // leave the containers ending here
+        if (0 != iteratorP->resourceEnd && iteratorP->index == iteratorP->resourceEnd)
+        {
+            iteratorP->resourceEnd = 0;
+            iteratorP->resourceId = LWM2M_MAX_ID;
+        }
+        if (0 != iteratorP->instanceEnd && iteratorP->index == iteratorP->instanceEnd)
+        {
+            iteratorP->instanceEnd = 0;
+            iteratorP->instanceId = LWM2M_MAX_ID;
+        }
+        if (iteratorP->index == iteratorP->length) return 0;
+
+        if (0 != iteratorP->resourceEnd) end = iteratorP->resourceEnd;
+        else if (0 != iteratorP->instanceEnd) end = iteratorP->instanceEnd;
+        else end = iteratorP->length;
+
+        result = lwm2m_decodeTLV(iteratorP->buffer + iteratorP->index, end - iteratorP->index, &type, &id, &dataIndex, &dataLen);
+        if (0 == result) return -1;
+
+        switch (type)
+        {
+        case LWM2M_TYPE_OBJECT_INSTANCE:
+            if (0 != iteratorP->instanceEnd || 0 != iteratorP->resourceEnd) return -1;
+            iteratorP->instanceId = id;
+            iteratorP->instanceEnd = iteratorP->index + result;
+            iteratorP->index += dataIndex;
+            break;
+
+        case LWM2M_TYPE_MULTIPLE_RESOURCE:
+            if (0 != iteratorP->resourceEnd) return -1;
+            iteratorP->resourceId = id;
+            iteratorP->resourceEnd = iteratorP->index + result;
+            iteratorP->index += dataIndex;
+            break;
+
+        default:
+            memset(dataP, 0, sizeof(lwm2m_data_t));
+            dataP->type = type;
+            dataP->id = id;
+            dataP->flags = LWM2M_TLV_FLAG_STATIC_DATA;
+            dataP->length = dataLen;
+            dataP->value = iteratorP->buffer + iteratorP->index + dataIndex;
+            iteratorP->index += result;
+            return 1;
+        }
+    }
+}
+
 int lwm2m_data_parse(uint8_t * buffer,
                      size_t bufferLen,
                      lwm2m_media_type_t format,
                      lwm2m_data_t ** dataP)
 {
+    return data_parse(NULL, buffer, bufferLen, format, dataP);
+}
+
+int data_parse(lwm2m_uri_t * uriP,
+               uint8_t * buffer,
+               size_t bufferLen,
+               lwm2m_media_type_t format,
+               lwm2m_data_t ** dataP)
+{
+#ifndef LWM2M_SUPPORT_JSON
+    (void)uriP;
+#endif
+
     switch (format)
     {
     case LWM2M_CONTENT_TEXT:
@@ -450,7 +597,7 @@ int lwm2m_data_parse(uint8_t * buffer,
 
 #ifdef LWM2M_SUPPORT_JSON
     case LWM2M_CONTENT_JSON:
-        return lwm2m_json_parse(buffer, bufferLen, dataP);
+        return lwm2m_json_parse(uriP, buffer, bufferLen, dataP);
 #endif
 
     default:
@@ -500,24 +647,20 @@ static int prv_getLength(int size,
 }
 
 
-static int prv_serializeTLV(int size,
-                            lwm2m_data_t * dataP,
-                            uint8_t ** bufferP)
+// Writes the TLV records backwards so that they end at end. Each container is written after its
+// children, once their length is known. Returns the length written or -1 if start is reached.
+static int prv_writeTLV(int size,
+                        lwm2m_data_t * dataP,
+                        uint8_t * start,
+                        uint8_t * end)
 {
-    int length;
-    int index;
+    uint8_t * current;
     int i;
 
-    *bufferP = NULL;
-    length = prv_getLength(size, dataP);
-    if (length <= 0) return length;
-
-    *bufferP = (uint8_t *)lwm2m_malloc(length);
-    if (*bufferP == NULL) return 0;
-
-    index = 0;
-    for (i = 0 ; i < size && length != 0 ; i++)
+    current = end;
+    for (i = size - 1 ; i >= 0 ; i--)
     {
+        size_t dataLen;
         int headerLen;
 
         switch (dataP[i].type)
@@ -525,52 +668,71 @@ static int prv_serializeTLV(int size,
         case LWM2M_TYPE_OBJECT_INSTANCE:
         case LWM2M_TYPE_MULTIPLE_RESOURCE:
             {
-                uint8_t * tmpBuffer;
-                int tmpLength;
+                int subLength;
 
-                tmpLength = prv_serializeTLV(dataP[i].length, (lwm2m_data_t *)dataP[i].value, &tmpBuffer);
-                if (tmpLength == 0)
-                {
-                    length = 0;
-                }
-                else
-                {
-                    headerLen = prv_create_header((uint8_t*)(*bufferP) + index, dataP[i].type, dataP[i].id, tmpLength);
-                    index += headerLen;
-                    memcpy(*bufferP + index, tmpBuffer, tmpLength);
-                    index += tmpLength;
-                    lwm2m_free(tmpBuffer);
-                }
+                subLength = prv_writeTLV(dataP[i].length, (lwm2m_data_t *)(dataP[i].value), start, current);
+                if (subLength < 0) return -1;
+                dataLen = subLength;
+                current -= subLength;
             }
             break;
 
         case LWM2M_TYPE_RESOURCE_INSTANCE:
         case LWM2M_TYPE_RESOURCE:
-            {
-                headerLen = prv_create_header((uint8_t*)(*bufferP) + index, dataP[i].type, dataP[i].id, dataP[i].length);
-                if (headerLen == 0)
-                {
-                    length = 0;
-                }
-                else
-                {
-                    index += headerLen;
-                    memcpy(*bufferP + index, dataP[i].value, dataP[i].length);
-                    index += dataP[i].length;
-                }
-            }
+            dataLen = dataP[i].length;
+            if ((size_t)(current - start) < dataLen) return -1;
+            current -= dataLen;
+            memcpy(current, dataP[i].value, dataLen);
             break;
 
         default:
-            length = 0;
-            break;
+            return -1;
         }
+
+        headerLen = prv_getHeaderLength(dataP[i].id, dataLen);
+        if (current - start < headerLen) return -1;
+        current -= headerLen;
+        prv_create_header(current, dataP[i].type, dataP[i].id, dataLen);
     }
 
-    if (length == 0)
+    return end - current;
+}
+
+int lwm2m_dataToTLV(int size,
+                    lwm2m_data_t * dataP,
+                    uint8_t * buffer,
+                    size_t buffer_len)
+{
+    int length;
+
+    length = prv_getLength(size, dataP);
+    if (length <= 0) return 0;
+    if (NULL == buffer) return length;
+    if (buffer_len < (size_t)length) return 0;
+
+    return prv_writeTLV(size, dataP, buffer, buffer + length);
+}
+
+static int prv_serializeTLV(int size,
+                            lwm2m_data_t * dataP,
+                            uint8_t ** bufferP)
+{
+    int length;
+
+    *bufferP = NULL;
+    length = prv_getLength(size, dataP);
+    if (length <= 0) return length;
+
+    *bufferP = (uint8_t *)lwm2m_malloc(length);
+    if (*bufferP == NULL) return 0;
+
+    if (length != prv_writeTLV(size, dataP, *bufferP, *bufferP + length))
     {
         lwm2m_free(*bufferP);
+        *bufferP = NULL;
+        length = 0;
     }
+
     return length;
 }
 
@@ -108,11 +108,276 @@ Contains code snippets which are:
 
 
 /*
- * Modulo mask (+1 and +0.5 for rounding) for a random number to get the tick number for the random
- * retransmission time between COAP_RESPONSE_TIMEOUT and COAP_RESPONSE_TIMEOUT*COAP_RESPONSE_RANDOM_FACTOR.
+ * Retransmissions follow RFC 7252 section 4.2: the initial timeout is a random duration between
+ * ACK_TIMEOUT and ACK_TIMEOUT * ACK_RANDOM_FACTOR, and is doubled at each retransmission. The
+ * random part spreads the retransmissions of peers which sent their requests at the same time.
+ * All transaction times are in milliseconds.
+ *
+ * Transactions waiting for a (re)transmission or a response are kept in the transactionHeap
+ * of the context, ordered by retrans_time. lwm2m_step() only looks at the top of the heap so
+ * its cost does not depend on the number of transactions in flight.
  */
-#define COAP_RESPONSE_TIMEOUT_TICKS         (CLOCK_SECOND * COAP_RESPONSE_TIMEOUT)
-#define COAP_RESPONSE_TIMEOUT_BACKOFF_MASK  ((CLOCK_SECOND * COAP_RESPONSE_TIMEOUT * (COAP_RESPONSE_RANDOM_FACTOR - 1)) + 1.5)
+
+/*
+ * Transactions are hashed by mID and, for the requests carrying a token, by token so that
+ * incoming ACKs, RSTs and separate responses are matched without scanning all of them.
+ * The session is compared when walking a bucket rather than hashed as a client may change
+ * its session handle with a registration update while transactions are in flight.
+ * Both tables have transactionTableSize buckets, a power of two, and grow with
+ * transactionCount.
+ */
+#define PRV_TABLE_INITIAL_SIZE  16
+
+static bool prv_hasToken(lwm2m_transaction_t * transacP)
+{
+    coap_packet_t * messageP = (coap_packet_t *)transacP->message;
+
+    // only requests are matched by token, see prv_transaction_check_finished()
+    return (COAP_DELETE >= messageP->code && 0 < messageP->token_len);
+}
+
+static void prv_tableAdd(lwm2m_context_t * contextP,
+                         lwm2m_transaction_t * transacP)
+{
+    size_t mask = contextP->transactionTableSize - 1;
+
+    transacP->next = contextP->transactionMidTable[transacP->mID & mask];
+    contextP->transactionMidTable[transacP->mID & mask] = transacP;
+
+    if (prv_hasToken(transacP))
+    {
+        coap_packet_t * messageP = (coap_packet_t *)transacP->message;
+        size_t index = utils_hash(messageP->token, messageP->token_len) & mask;
+
+        transacP->tokenNext = contextP->transactionTokenTable[index];
+        contextP->transactionTokenTable[index] = transacP;
+    }
+}
+
+static int prv_resizeTables(lwm2m_context_t * contextP,
+                            size_t size)
+{
+    lwm2m_transaction_t ** midTable;
+    lwm2m_transaction_t ** tokenTable;
+    lwm2m_transaction_t ** oldMidTable;
+    size_t oldSize;
+    size_t i;
+
+    midTable = (lwm2m_transaction_t **)lwm2m_malloc(size * sizeof(lwm2m_transaction_t *));
+    if (NULL == midTable) return COAP_500_INTERNAL_SERVER_ERROR;
+    tokenTable = (lwm2m_transaction_t **)lwm2m_malloc(size * sizeof(lwm2m_transaction_t *));
+    if (NULL == tokenTable)
+    {
+        lwm2m_free(midTable);
+        return COAP_500_INTERNAL_SERVER_ERROR;
+    }
+    memset(midTable, 0, size * sizeof(lwm2m_transaction_t *));
+    memset(tokenTable, 0, size * sizeof(lwm2m_transaction_t *));
+
+    oldMidTable = contextP->transactionMidTable;
+    oldSize = contextP->transactionTableSize;
+    if (NULL != contextP->transactionTokenTable)
+    {
+        lwm2m_free(contextP->transactionTokenTable);
+    }
+    contextP->transactionMidTable = midTable;
+    contextP->transactionTokenTable = tokenTable;
+    contextP->transactionTableSize = size;
+
+    for (i = 0 ; i < oldSize ; i++)
+    {
+        while (NULL != oldMidTable[i])
+        {
+            lwm2m_transaction_t * transacP = oldMidTable[i];
+
+            oldMidTable[i] = transacP->next;
+            prv_tableAdd(contextP, transacP);
+        }
+    }
+    if (NULL != oldMidTable)
+    {
+        lwm2m_free(oldMidTable);
+    }
+
+    return 0;
+}
+
+static void * prv_getSession(lwm2m_transaction_t * transacP)
+{
+    switch (transacP->peerType)
+    {
+#ifdef LWM2M_BOOTSTRAP_SERVER_MODE
+    case ENDPOINT_UNKNOWN:
+        return transacP->peerP;
+#endif
+#ifdef LWM2M_SERVER_MODE
+    case ENDPOINT_CLIENT:
+        return ((lwm2m_client_t *)transacP->peerP)->sessionH;
+#endif
+#ifdef LWM2M_CLIENT_MODE
+    case ENDPOINT_SERVER:
+        if (NULL != transacP->peerP)
+        {
+            return ((lwm2m_server_t *)transacP->peerP)->sessionH;
+        }
+        return NULL;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+static lwm2m_peer_queue_t * prv_getQueue(lwm2m_transaction_t * transacP)
+{
+    switch (transacP->peerType)
+    {
+#ifdef LWM2M_SERVER_MODE
+    case ENDPOINT_CLIENT:
+        return &((lwm2m_client_t *)transacP->peerP)->queue;
+#endif
+#ifdef LWM2M_CLIENT_MODE
+    case ENDPOINT_SERVER:
+        if (NULL != transacP->peerP)
+        {
+            return &((lwm2m_server_t *)transacP->peerP)->queue;
+        }
+        return NULL;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+// Time in milliseconds needed to send length bytes at the probing rate of the peer
+static int64_t prv_probingInterval(lwm2m_peer_queue_t * queueP,
+                                   size_t length)
+{
+    uint16_t rate = queueP->probingRate ? queueP->probingRate : COAP_PROBING_RATE;
+
+    return ((int64_t)length * 1000 + rate - 1) / rate;
+}
+
+static uint32_t prv_initialTimeout(lwm2m_context_t * contextP)
+{
+    uint32_t range;
+
+    range = (uint32_t)(((uint64_t)contextP->ackTimeout * (contextP->ackRandomFactor - 100)) / 100);
+    if (0 == range) return contextP->ackTimeout;
+
+    return contextP->ackTimeout + (uint32_t)(((uint64_t)utils_random(contextP) * (range + 1)) >> 32);
+}
+
+static void prv_unlinkFromQueue(lwm2m_peer_queue_t * queueP,
+                                lwm2m_transaction_t * transacP)
+{
+    if (NULL != transacP->peerPrev)
+    {
+        transacP->peerPrev->peerNext = transacP->peerNext;
+    }
+    else if (0 == transacP->retrans_counter)
+    {
+        queueP->pendingList = transacP->peerNext;
+    }
+    else
+    {
+        queueP->activeList = transacP->peerNext;
+    }
+
+    if (NULL != transacP->peerNext)
+    {
+        transacP->peerNext->peerPrev = transacP->peerPrev;
+    }
+    else if (0 == transacP->retrans_counter)
+    {
+        queueP->pendingLast = transacP->peerPrev;
+    }
+
+    transacP->peerNext = NULL;
+    transacP->peerPrev = NULL;
+}
+
+// Returns true if the transaction can be sent now. Otherwise it stays in the pending list of its peer
+// and is started by prv_startPending() when an outstanding interaction ends, or by lwm2m_step() when
+// the probing rate allows it.
+static bool prv_startInteraction(lwm2m_context_t * contextP,
+                                 lwm2m_transaction_t * transacP,
+                                 int64_t currentTime)
+{
+    lwm2m_peer_queue_t * queueP = prv_getQueue(transacP);
+
+    if (NULL == queueP) return true;
+
+    if (queueP->pendingList != transacP
+     || queueP->outstanding >= (queueP->nstart ? queueP->nstart : COAP_NSTART))
+    {
+        utils_heapUnschedule(&contextP->transactionHeap, transacP);
+        return false;
+    }
+    if (queueP->unresponsive && currentTime < queueP->probeTime)
+    {
+        transacP->retrans_time = queueP->probeTime;
+        utils_heapSchedule(&contextP->transactionHeap, transacP);
+        return false;
+    }
+
+    prv_unlinkFromQueue(queueP, transacP);
+    transacP->peerNext = queueP->activeList;
+    if (NULL != queueP->activeList)
+    {
+        queueP->activeList->peerPrev = transacP;
+    }
+    queueP->activeList = transacP;
+    queueP->outstanding++;
+    if (queueP->unresponsive)
+    {
+        queueP->probeTime = currentTime + prv_probingInterval(queueP, transacP->buffer_len);
+    }
+
+    return true;
+}
+
+static void prv_resend(lwm2m_context_t * contextP,
+                       lwm2m_transaction_t * transacP)
+{
+    if (0 < transaction_send(contextP, transacP))
+    {
+        // the transaction can not be sent anymore, report it as timed out
+        if (transacP->callback)
+        {
+            transacP->callback(transacP, NULL);
+        }
+        transaction_remove(contextP, transacP);
+    }
+}
+
+static void prv_startPending(lwm2m_context_t * contextP,
+                             lwm2m_peer_queue_t * queueP)
+{
+    while (NULL != queueP->pendingList
+        && queueP->outstanding < (queueP->nstart ? queueP->nstart : COAP_NSTART))
+    {
+        lwm2m_transaction_t * transacP = queueP->pendingList;
+
+        prv_resend(contextP, transacP);
+        if (queueP->pendingList == transacP)
+        {
+            // waiting for the probing rate
+            break;
+        }
+    }
+}
+
+static void prv_acknowledge(lwm2m_transaction_t * transacP)
+{
+    lwm2m_peer_queue_t * queueP = prv_getQueue(transacP);
+
+    transacP->ack_received = true;
+    if (NULL != queueP)
+    {
+        if (queueP->outstanding > 0) queueP->outstanding--;
+        queueP->unresponsive = false;
+    }
+}
 
 static int prv_check_addr(void * leftSessionH,
                           void * rightSessionH)
@@ -154,6 +419,52 @@ static int prv_transaction_check_finished(lwm2m_transaction_t * transacP,
     return 0;
 }
 
+// Only the transactions already sent can be answered: the ones still waiting in the pendingList
+// of their peer are never matched, whatever a stray or late message carries.
+static lwm2m_transaction_t * prv_findByMid(lwm2m_context_t * contextP,
+                                           void * fromSessionH,
+                                           uint16_t mID)
+{
+    lwm2m_transaction_t * transacP;
+
+    transacP = contextP->transactionMidTable[mID & (contextP->transactionTableSize - 1)];
+    while (NULL != transacP
+        && (transacP->mID != mID
+         || 0 == transacP->retrans_counter
+         || !prv_check_addr(fromSessionH, prv_getSession(transacP))))
+    {
+        transacP = transacP->next;
+    }
+
+    return transacP;
+}
+
+static lwm2m_transaction_t * prv_findByToken(lwm2m_context_t * contextP,
+                                             void * fromSessionH,
+                                             coap_packet_t * receivedMessage)
+{
+    lwm2m_transaction_t * transacP;
+    const uint8_t * token;
+    int len;
+
+    len = coap_get_header_token(receivedMessage, &token);
+    if (0 == len) return NULL;
+
+    transacP = contextP->transactionTokenTable[utils_hash(token, len) & (contextP->transactionTableSize - 1)];
+    while (NULL != transacP)
+    {
+        if (0 != transacP->retrans_counter
+         && prv_check_addr(fromSessionH, prv_getSession(transacP))
+         && prv_transaction_check_finished(transacP, receivedMessage))
+        {
+            return transacP;
+        }
+        transacP = transacP->tokenNext;
+    }
+
+    return NULL;
+}
+
 lwm2m_transaction_t * transaction_new(coap_message_type_t type,
                                       coap_method_t method,
                                       char * altPath,
@@ -236,15 +547,15 @@ lwm2m_transaction_t * transaction_new(coap_message_type_t type,
         else {
             // generate a token
             uint8_t temp_token[COAP_TOKEN_LEN];
-            time_t tv_sec = lwm2m_gettime();
+            int64_t tv_ms = lwm2m_gettime_ms();
 
             // initialize first 6 bytes, leave the last 2 random
             temp_token[0] = mID;
             temp_token[1] = mID >> 8;
-            temp_token[2] = tv_sec;
-            temp_token[3] = tv_sec >> 8;
-            temp_token[4] = tv_sec >> 16;
-            temp_token[5] = tv_sec >> 24;
+            temp_token[2] = tv_ms;
+            temp_token[3] = tv_ms >> 8;
+            temp_token[4] = tv_ms >> 16;
+            temp_token[5] = tv_ms >> 24;
             // use just the provided amount of bytes
             coap_set_header_token(transacP->message, temp_token, token_len);
         }
@@ -264,11 +575,124 @@ void transaction_free(lwm2m_transaction_t * transacP)
     lwm2m_free(transacP);
 }
 
+void transaction_add(lwm2m_context_t * contextP,
+                     lwm2m_transaction_t * transacP)
+{
+    lwm2m_peer_queue_t * queueP;
+
+    if (contextP->transactionCount >= contextP->transactionTableSize)
+    {
+        // on failure, keep the current tables with longer buckets
+        prv_resizeTables(contextP, 2 * contextP->transactionTableSize);
+    }
+    prv_tableAdd(contextP, transacP);
+    contextP->transactionCount++;
+
+    queueP = prv_getQueue(transacP);
+    if (NULL != queueP)
+    {
+        transacP->peerNext = NULL;
+        transacP->peerPrev = queueP->pendingLast;
+        if (NULL == queueP->pendingLast)
+        {
+            queueP->pendingList = transacP;
+        }
+        else
+        {
+            queueP->pendingLast->peerNext = transacP;
+        }
+        queueP->pendingLast = transacP;
+    }
+}
+
 void transaction_remove(lwm2m_context_t * contextP,
                         lwm2m_transaction_t * transacP)
 {
-    contextP->transactionList = (lwm2m_transaction_t *) LWM2M_LIST_RM(contextP->transactionList, transacP->mID, NULL);
+    lwm2m_transaction_t ** bucketP;
+    lwm2m_peer_queue_t * queueP;
+
+    utils_heapUnschedule(&contextP->transactionHeap, transacP);
+
+    bucketP = contextP->transactionMidTable + (transacP->mID & (contextP->transactionTableSize - 1));
+    while (NULL != *bucketP && *bucketP != transacP)
+    {
+        bucketP = &(*bucketP)->next;
+    }
+    if (NULL != *bucketP)
+    {
+        *bucketP = transacP->next;
+        contextP->transactionCount--;
+    }
+
+    if (prv_hasToken(transacP))
+    {
+        coap_packet_t * messageP = (coap_packet_t *)transacP->message;
+
+        bucketP = contextP->transactionTokenTable + (utils_hash(messageP->token, messageP->token_len) & (contextP->transactionTableSize - 1));
+        while (NULL != *bucketP && *bucketP != transacP)
+        {
+            bucketP = &(*bucketP)->tokenNext;
+        }
+        if (NULL != *bucketP)
+        {
+            *bucketP = transacP->tokenNext;
+        }
+    }
+
+    queueP = prv_getQueue(transacP);
+    if (NULL != queueP)
+    {
+        if (0 != transacP->retrans_counter && !transacP->ack_received)
+        {
+            queueP->outstanding--;
+        }
+        prv_unlinkFromQueue(queueP, transacP);
+    }
+
     transaction_free(transacP);
+
+    if (NULL != queueP)
+    {
+        prv_startPending(contextP, queueP);
+    }
+}
+
+void transaction_set_congestion(lwm2m_context_t * contextP,
+                                lwm2m_peer_queue_t * queueP,
+                                uint8_t nstart,
+                                uint16_t probingRate)
+{
+    queueP->nstart = nstart;
+    queueP->probingRate = probingRate;
+
+    // a larger nstart may allow to start some pending transactions now
+    prv_startPending(contextP, queueP);
+}
+
+void transaction_remove_peer(lwm2m_context_t * contextP,
+                             lwm2m_peer_queue_t * queueP)
+{
+    // pending transactions first so that none is started when removing the active ones
+    while (NULL != queueP->pendingList)
+    {
+        lwm2m_transaction_t * transacP = queueP->pendingList;
+
+        if (transacP->callback)
+        {
+            transacP->callback(transacP, NULL);
+        }
+        transaction_remove(contextP, transacP);
+    }
+    while (NULL != queueP->activeList)
+    {
+        lwm2m_transaction_t * transacP = queueP->activeList;
+
+        if (transacP->callback)
+        {
+            transacP->callback(transacP, NULL);
+        }
+        transaction_remove(contextP, transacP);
+    }
 }
 
 bool transaction_handle_response(lwm2m_context_t * contextP,
@@ -278,106 +702,87 @@ bool transaction_handle_response(lwm2m_context_t * contextP,
 {
     bool found = false;
     bool reset = false;
-    lwm2m_transaction_t * transacP;
-
-    transacP = contextP->transactionList;
+    lwm2m_transaction_t * transacP = NULL;
+    lwm2m_peer_queue_t * queueP;
 
-    while (NULL != transacP)
+    if ((COAP_TYPE_ACK == message->type) || (COAP_TYPE_RST == message->type))
     {
-        void * targetSessionH;
-
-        targetSessionH = NULL;
-        switch (transacP->peerType)
+        transacP = prv_findByMid(contextP, fromSessionH, message->mid);
+        if (NULL != transacP && !transacP->ack_received)
         {
-#ifdef LWM2M_BOOTSTRAP_SERVER_MODE
-        case ENDPOINT_UNKNOWN:
-            targetSessionH = transacP->peerP;
-            break;
-#endif
-#ifdef LWM2M_SERVER_MODE
-        case ENDPOINT_CLIENT:
-            targetSessionH = ((lwm2m_client_t *)transacP->peerP)->sessionH;
-            break;
-#endif
-
-#ifdef LWM2M_CLIENT_MODE
-        case ENDPOINT_SERVER:
-            if (NULL != transacP->peerP) 
-            {
-                targetSessionH = ((lwm2m_server_t *)transacP->peerP)->sessionH;
-            }
-            break;
-#endif
-
-        default:
-            break;
+            found = true;
+            prv_acknowledge(transacP);
+            reset = COAP_TYPE_RST == message->type;
         }
+    }
 
-        if (prv_check_addr(fromSessionH, targetSessionH))
+    if (NULL == transacP || !(reset || prv_transaction_check_finished(transacP, message)))
+    {
+        if (found)
         {
-            if (!transacP->ack_received)
+            // separate response: wait for it
+            int64_t tv_ms = lwm2m_gettime_ms();
+            if (0 <= tv_ms)
             {
-                if ((COAP_TYPE_ACK == message->type) || (COAP_TYPE_RST == message->type))
-                {
-                    if (transacP->mID == message->mid)
-	                {
-    	                found = true;
-        	            transacP->ack_received = true;
-            	        reset = COAP_TYPE_RST == message->type;
-            	    }
-                }
+                transacP->retrans_time = tv_ms;
             }
-
-            if (reset || prv_transaction_check_finished(transacP, message))
+            if (transacP->response_timeout)
             {
-                // HACK: If a message is sent from the monitor callback,
-                // it will arrive before the registration ACK.
-                // So we resend transaction that were denied for authentication reason.
-                if (!reset)
-                {
-                    if (COAP_TYPE_CON == message->type && NULL != response)
-                    {
-                        coap_init_message(response, COAP_TYPE_ACK, 0, message->mid);
-                        message_send(contextP, response, fromSessionH);
-                    }
-                
-	                if ((COAP_401_UNAUTHORIZED == message->code) && (COAP_MAX_RETRANSMIT > transacP->retrans_counter))
-    	            {
-        	            transacP->ack_received = false;
-            	        transacP->retrans_time += COAP_RESPONSE_TIMEOUT;
-                	    return true;
-                	}
-				}       
-                if (transacP->callback != NULL)
-                {
-                    transacP->callback(transacP, message);
-                }
-                transaction_remove(contextP, transacP);
-                return true;
+                transacP->retrans_time += transacP->response_timeout;
             }
-            // if we found our guy, exit
-            if (found)
+            else
             {
-                time_t tv_sec = lwm2m_gettime();
-                if (0 <= tv_sec)
-                {
-                    transacP->retrans_time = tv_sec;
-                }
-                if (transacP->response_timeout)
-                {
-                    transacP->retrans_time += transacP->response_timeout;
-                }
-                else
-                {
-                    transacP->retrans_time += COAP_RESPONSE_TIMEOUT * transacP->retrans_counter;
-                }
-                return true;
+                transacP->retrans_time += transacP->retrans_timeout;
             }
+            utils_heapSchedule(&contextP->transactionHeap, transacP);
+
+            queueP = prv_getQueue(transacP);
+            if (NULL != queueP)
+            {
+                prv_startPending(contextP, queueP);
+            }
+            return true;
         }
 
-        transacP = transacP->next;
+        transacP = prv_findByToken(contextP, fromSessionH, message);
+        if (NULL == transacP) return false;
     }
-    return false;
+
+    queueP = prv_getQueue(transacP);
+    if (NULL != queueP)
+    {
+        queueP->unresponsive = false;
+    }
+
+    // HACK: If a message is sent from the monitor callback,
+    // it will arrive before the registration ACK.
+    // So we resend transaction that were denied for authentication reason.
+    if (!reset)
+    {
+        if (COAP_TYPE_CON == message->type && NULL != response)
+        {
+            coap_init_message(response, COAP_TYPE_ACK, 0, message->mid);
+            message_send(contextP, response, fromSessionH);
+        }
+
+        if ((COAP_401_UNAUTHORIZED == message->code) && (contextP->maxRetransmit >= transacP->retrans_counter))
+        {
+            if (transacP->ack_received && NULL != queueP)
+            {
+                queueP->outstanding++;
+            }
+            transacP->ack_received = false;
+            transacP->retrans_time += contextP->ackTimeout;
+            utils_heapSchedule(&contextP->transactionHeap, transacP);
+            return true;
+        }
+    }
+    if (transacP->callback != NULL)
+    {
+        transacP->callback(transacP, message);
+    }
+    transaction_remove(contextP, transacP);
+    return true;
 }
 
 int transaction_send(lwm2m_context_t * contextP,
@@ -402,27 +807,29 @@ int transaction_send(lwm2m_context_t * contextP,
 
     if (!transacP->ack_received)
     {
-        long unsigned timeout = COAP_RESPONSE_TIMEOUT;
-
         if (0 == transacP->retrans_counter)
         {
-            time_t tv_sec = lwm2m_gettime();
-            if (0 <= tv_sec)
+            int64_t tv_ms = lwm2m_gettime_ms();
+            if (0 <= tv_ms)
             {
-                transacP->retrans_time = tv_sec;
+                if (!prv_startInteraction(contextP, transacP, tv_ms)) return 0;
+
+                transacP->retrans_time = tv_ms;
                 transacP->retrans_counter = 1;
+                transacP->retrans_timeout = prv_initialTimeout(contextP);
             }
             else
             {
-                maxRetriesReached = true;
+                return COAP_500_INTERNAL_SERVER_ERROR;
             }
         }
-        else
+        else if (transacP->retrans_timeout <= UINT32_MAX / 2)
         {
-            timeout = COAP_RESPONSE_TIMEOUT * transacP->retrans_counter;
+            transacP->retrans_timeout *= 2;
         }
 
-        if (COAP_MAX_RETRANSMIT >= transacP->retrans_counter)
+        // the initial transmission and up to MAX_RETRANSMIT retransmissions
+        if ((uint16_t)contextP->maxRetransmit + 1 >= transacP->retrans_counter)
         {
             void * targetSessionH = NULL;
 
@@ -450,14 +857,23 @@ int transaction_send(lwm2m_context_t * contextP,
                 return COAP_500_INTERNAL_SERVER_ERROR;
             }
 
+            transacP->retrans_time += transacP->retrans_timeout;
+            if (0 != utils_heapSchedule(&contextP->transactionHeap, transacP)) return COAP_500_INTERNAL_SERVER_ERROR;
+
             contextP->bufferSendCallback(targetSessionH,
                                          transacP->buffer, transacP->buffer_len, contextP->userData);
 
-            transacP->retrans_time += timeout;
             ++transacP->retrans_counter;
         }
         else
         {
+            lwm2m_peer_queue_t * queueP = prv_getQueue(transacP);
+
+            if (NULL != queueP)
+            {
+                queueP->unresponsive = true;
+                queueP->probeTime = transacP->retrans_time + prv_probingInterval(queueP, transacP->buffer_len);
+            }
             maxRetriesReached = true;
         }
     }
@@ -474,3 +890,37 @@ int transaction_send(lwm2m_context_t * contextP,
 
     return 0;
 }
+
+void transaction_step(lwm2m_context_t * contextP,
+                      int64_t currentTime,
+                      int64_t * timeoutP)
+{
+    lwm2m_transaction_t * transacP;
+
+    while (NULL != (transacP = (lwm2m_transaction_t *)utils_heapTop(&contextP->transactionHeap)))
+    {
+        int64_t interval;
+
+        if (transacP->retrans_time <= currentTime)
+        {
+            // A late step must not send the retransmissions which fell behind in a burst.
+            transacP->retrans_time = currentTime;
+            prv_resend(contextP, transacP);
+            continue;
+        }
+
+        interval = transacP->retrans_time - currentTime;
+        if (*timeoutP > interval)
+        {
+            *timeoutP = interval;
+        }
+        break;
+    }
+}
+
+int transaction_init(lwm2m_context_t * contextP)
+{
+    utils_heapInit(&contextP->transactionHeap, offsetof(lwm2m_transaction_t, retrans_time), offsetof(lwm2m_transaction_t, heapIndex));
+
+    return prv_resizeTables(contextP, PRV_TABLE_INITIAL_SIZE);
+}
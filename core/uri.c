@@ -95,14 +95,11 @@ int prv_get_number(uint8_t * uriString,
 
 
 lwm2m_uri_t * lwm2m_decode_uri(char * altPath,
-                               multi_option_t *uriPath)
+                               multi_option_t *uriPath,
+                               lwm2m_uri_t * uriP)
 {
-    lwm2m_uri_t * uriP;
     int readNum;
 
-    uriP = (lwm2m_uri_t *)lwm2m_malloc(sizeof(lwm2m_uri_t));
-    if (NULL == uriP) return NULL;
-
     memset(uriP, 0, sizeof(lwm2m_uri_t));
 
     // Read object ID
@@ -130,18 +127,10 @@ lwm2m_uri_t * lwm2m_decode_uri(char * altPath,
         if (altPath != NULL)
         {
             int i;
-            if (NULL == uriPath)
-            {
-                lwm2m_free(uriP);
-                return NULL;
-            }
+            if (NULL == uriPath) return NULL;
             for (i = 0 ; i < uriPath->len ; i++)
             {
-                if (uriPath->data[i] != altPath[i+1])
-                {
-                    lwm2m_free(uriP);
-                    return NULL;
-                }
+                if (uriPath->data[i] != altPath[i+1]) return NULL;
             }
             uriPath = uriPath->next;
         }
@@ -195,7 +184,6 @@ lwm2m_uri_t * lwm2m_decode_uri(char * altPath,
     if (NULL == uriPath->next) return uriP;
 
 error:
-    lwm2m_free(uriP);
     return NULL;
 }
 
@@ -97,182 +97,860 @@ int lwm2m_PlainTextToInt64(uint8_t * buffer,
     return 1;
 }
 
-int lwm2m_PlainTextToFloat64(uint8_t * buffer,
-                             int length,
-                             double * dataP)
+/*
+ * Floating point conversions work on a 64-bit significand and a binary exponent (f * 2^e). The
+ * powers of ten from 1e-348 to 1e340 by steps of 8 are cached normalized and rounded, that is
+ * with an error below half a unit in the last place. They are used to print the shortest text
+ * reading back to the same value (Grisu2) and to read text with a bounded error, falling back to
+ * strtod() in the rare cases too close to the middle of two doubles.
+ */
+typedef struct
 {
-    double result;
-    int sign;
-    int i;
+    uint64_t    f;
+    int         e;
+} prv_fp_t;
+
+#define PRV_FP_SIGNIFICAND_MASK     0x000FFFFFFFFFFFFFULL
+#define PRV_FP_HIDDEN_BIT           0x0010000000000000ULL
+#define PRV_FP_EXPONENT_BIAS        1075    // 1023 + 52
+#define PRV_FP_DENORMAL_EXPONENT    (1 - PRV_FP_EXPONENT_BIAS)
+#define PRV_FP_MAX_EXPONENT         (0x7FF - PRV_FP_EXPONENT_BIAS)
+#define PRV_FP_FIRST_CACHED_POWER   (-348)
+#define PRV_FP_CACHED_POWER_STEP    8
+#define PRV_FP_ERROR_UNIT           8       // errors are counted in eighths of the last place
+#define PRV_FLOAT_MAX_LEN           26      // -0.00000xxxxxxxxxxxxxxxxx
+#define PRV_FLOAT_MAX_DIGITS        19      // in an uint64_t
+
+static const prv_fp_t prv_cachedPowers[] = {
+{ 0xFA8FD5A0081C0288, -1220 }, // 1e-348
+    { 0xBAAEE17FA23EBF76, -1193 }, // 1e-340
+    { 0x8B16FB203055AC76, -1166 }, // 1e-332
+    { 0xCF42894A5DCE35EA, -1140 }, // 1e-324
+    { 0x9A6BB0AA55653B2D, -1113 }, // 1e-316
+    { 0xE61ACF033D1A45DF, -1087 }, // 1e-308
+    { 0xAB70FE17C79AC6CA, -1060 }, // 1e-300
+    { 0xFF77B1FCBEBCDC4F, -1034 }, // 1e-292
+    { 0xBE5691EF416BD60C, -1007 }, // 1e-284
+    { 0x8DD01FAD907FFC3C,  -980 }, // 1e-276
+    { 0xD3515C2831559A83,  -954 }, // 1e-268
+    { 0x9D71AC8FADA6C9B5,  -927 }, // 1e-260
+    { 0xEA9C227723EE8BCB,  -901 }, // 1e-252
+    { 0xAECC49914078536D,  -874 }, // 1e-244
+    { 0x823C12795DB6CE57,  -847 }, // 1e-236
+    { 0xC21094364DFB5637,  -821 }, // 1e-228
+    { 0x9096EA6F3848984F,  -794 }, // 1e-220
+    { 0xD77485CB25823AC7,  -768 }, // 1e-212
+    { 0xA086CFCD97BF97F4,  -741 }, // 1e-204
+    { 0xEF340A98172AACE5,  -715 }, // 1e-196
+    { 0xB23867FB2A35B28E,  -688 }, // 1e-188
+    { 0x84C8D4DFD2C63F3B,  -661 }, // 1e-180
+    { 0xC5DD44271AD3CDBA,  -635 }, // 1e-172
+    { 0x936B9FCEBB25C996,  -608 }, // 1e-164
+    { 0xDBAC6C247D62A584,  -582 }, // 1e-156
+    { 0xA3AB66580D5FDAF6,  -555 }, // 1e-148
+    { 0xF3E2F893DEC3F126,  -529 }, // 1e-140
+    { 0xB5B5ADA8AAFF80B8,  -502 }, // 1e-132
+    { 0x87625F056C7C4A8B,  -475 }, // 1e-124
+    { 0xC9BCFF6034C13053,  -449 }, // 1e-116
+    { 0x964E858C91BA2655,  -422 }, // 1e-108
+    { 0xDFF9772470297EBD,  -396 }, // 1e-100
+    { 0xA6DFBD9FB8E5B88F,  -369 }, // 1e-92
+    { 0xF8A95FCF88747D94,  -343 }, // 1e-84
+    { 0xB94470938FA89BCF,  -316 }, // 1e-76
+    { 0x8A08F0F8BF0F156B,  -289 }, // 1e-68
+    { 0xCDB02555653131B6,  -263 }, // 1e-60
+    { 0x993FE2C6D07B7FAC,  -236 }, // 1e-52
+    { 0xE45C10C42A2B3B06,  -210 }, // 1e-44
+    { 0xAA242499697392D3,  -183 }, // 1e-36
+    { 0xFD87B5F28300CA0E,  -157 }, // 1e-28
+    { 0xBCE5086492111AEB,  -130 }, // 1e-20
+    { 0x8CBCCC096F5088CC,  -103 }, // 1e-12
+    { 0xD1B71758E219652C,   -77 }, // 1e-4
+    { 0x9C40000000000000,   -50 }, // 1e4
+    { 0xE8D4A51000000000,   -24 }, // 1e12
+    { 0xAD78EBC5AC620000,     3 }, // 1e20
+    { 0x813F3978F8940984,    30 }, // 1e28
+    { 0xC097CE7BC90715B3,    56 }, // 1e36
+    { 0x8F7E32CE7BEA5C70,    83 }, // 1e44
+    { 0xD5D238A4ABE98068,   109 }, // 1e52
+    { 0x9F4F2726179A2245,   136 }, // 1e60
+    { 0xED63A231D4C4FB27,   162 }, // 1e68
+    { 0xB0DE65388CC8ADA8,   189 }, // 1e76
+    { 0x83C7088E1AAB65DB,   216 }, // 1e84
+    { 0xC45D1DF942711D9A,   242 }, // 1e92
+    { 0x924D692CA61BE758,   269 }, // 1e100
+    { 0xDA01EE641A708DEA,   295 }, // 1e108
+    { 0xA26DA3999AEF774A,   322 }, // 1e116
+    { 0xF209787BB47D6B85,   348 }, // 1e124
+    { 0xB454E4A179DD1877,   375 }, // 1e132
+    { 0x865B86925B9BC5C2,   402 }, // 1e140
+    { 0xC83553C5C8965D3D,   428 }, // 1e148
+    { 0x952AB45CFA97A0B3,   455 }, // 1e156
+    { 0xDE469FBD99A05FE3,   481 }, // 1e164
+    { 0xA59BC234DB398C25,   508 }, // 1e172
+    { 0xF6C69A72A3989F5C,   534 }, // 1e180
+    { 0xB7DCBF5354E9BECE,   561 }, // 1e188
+    { 0x88FCF317F22241E2,   588 }, // 1e196
+    { 0xCC20CE9BD35C78A5,   614 }, // 1e204
+    { 0x98165AF37B2153DF,   641 }, // 1e212
+    { 0xE2A0B5DC971F303A,   667 }, // 1e220
+    { 0xA8D9D1535CE3B396,   694 }, // 1e228
+    { 0xFB9B7CD9A4A7443C,   720 }, // 1e236
+    { 0xBB764C4CA7A44410,   747 }, // 1e244
+    { 0x8BAB8EEFB6409C1A,   774 }, // 1e252
+    { 0xD01FEF10A657842C,   800 }, // 1e260
+    { 0x9B10A4E5E9913129,   827 }, // 1e268
+    { 0xE7109BFBA19C0C9D,   853 }, // 1e276
+    { 0xAC2820D9623BF429,   880 }, // 1e284
+    { 0x80444B5E7AA7CF85,   907 }, // 1e292
+    { 0xBF21E44003ACDD2D,   933 }, // 1e300
+    { 0x8E679C2F5E44FF8F,   960 }, // 1e308
+    { 0xD433179D9C8CB841,   986 }, // 1e316
+    { 0x9E19DB92B4E31BA9,  1013 }, // 1e324
+    { 0xEB96BF6EBADF77D9,  1039 }, // 1e332
+    { 0xAF87023B9BF0EE6B,  1066 }, // 1e340
+};
+
+static const uint64_t prv_powersOfTen[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+    1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+    1000000000000000000ULL, 10000000000000000000ULL
+};
+
+// exactly representable as doubles
+static const double prv_exactPowersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static const char prv_digitPairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static uint64_t prv_doubleToBits(double value)
+{
+    uint64_t bits;
 
-    if (0 == length) return 0;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
 
-    if (buffer[0] == '-')
+static double prv_bitsToDouble(uint64_t bits)
+{
+    double value;
+
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static prv_fp_t prv_fpNormalize(prv_fp_t x)
+{
+    while ((x.f & 0xFFFFFFFF00000000ULL) == 0)
     {
-        sign = -1;
-        i = 1;
+        x.f <<= 32;
+        x.e -= 32;
+    }
+    while ((x.f & 0x8000000000000000ULL) == 0)
+    {
+        x.f <<= 1;
+        x.e--;
+    }
+
+    return x;
+}
+
+// Returns the upper half of the 128-bit product, rounded.
+static prv_fp_t prv_fpMultiply(prv_fp_t x,
+                               prv_fp_t y)
+{
+    prv_fp_t result;
+    uint64_t a = x.f >> 32;
+    uint64_t b = x.f & 0xFFFFFFFF;
+    uint64_t c = y.f >> 32;
+    uint64_t d = y.f & 0xFFFFFFFF;
+    uint64_t ac = a * c;
+    uint64_t bc = b * c;
+    uint64_t ad = a * d;
+    uint64_t bd = b * d;
+    uint64_t tmp;
+
+    tmp = (bd >> 32) + (ad & 0xFFFFFFFF) + (bc & 0xFFFFFFFF);
+    tmp += 1U << 31;
+    result.f = ac + (ad >> 32) + (bc >> 32) + (tmp >> 32);
+    result.e = x.e + y.e + 64;
+
+    return result;
+}
+
+static int prv_countDigits(uint64_t value)
+{
+    int count;
+
+    count = 1;
+    while (count < 20 && value >= prv_powersOfTen[count]) count++;
+
+    return count;
+}
+
+// Writes the count digits of value ending at string + count.
+static void prv_writeDigits(uint64_t value,
+                            uint8_t * string,
+                            int count)
+{
+    while (value >= 100)
+    {
+        unsigned int pair = (unsigned int)(value % 100) * 2;
+
+        value /= 100;
+        count -= 2;
+        string[count] = prv_digitPairs[pair];
+        string[count + 1] = prv_digitPairs[pair + 1];
+    }
+    if (value >= 10)
+    {
+        string[count - 2] = prv_digitPairs[value * 2];
+        string[count - 1] = prv_digitPairs[value * 2 + 1];
     }
     else
     {
-        sign = 1;
-        i = 0;
+        string[count - 1] = (uint8_t)('0' + value);
     }
+}
 
-    result = 0;
-    while (i < length && buffer[i] != '.')
+static void prv_grisuRound(uint8_t * digits,
+                           int count,
+                           uint64_t delta,
+                           uint64_t rest,
+                           uint64_t tenKappa,
+                           uint64_t distance)
+{
+    while (rest < distance
+        && delta - rest >= tenKappa
+        && (rest + tenKappa < distance || distance - rest > rest + tenKappa - distance))
     {
-        if ('0' <= buffer[i] && buffer[i] <= '9')
+        digits[count - 1]--;
+        rest += tenKappa;
+    }
+}
+
+// Writes the shortest digits of a positive value and their decimal exponent.
+static int prv_grisu2(double value,
+                      uint8_t * digits,
+                      int * exponentP)
+{
+    uint64_t bits;
+    prv_fp_t v;
+    prv_fp_t plus;
+    prv_fp_t minus;
+    prv_fp_t cached;
+    prv_fp_t w;
+    prv_fp_t one;
+    double dk;
+    uint64_t delta;
+    uint64_t distance;
+    uint64_t part2;
+    uint32_t part1;
+    int index;
+    int kappa;
+    int count;
+
+    bits = prv_doubleToBits(value);
+    v.f = bits & PRV_FP_SIGNIFICAND_MASK;
+    if ((bits & ~PRV_FP_SIGNIFICAND_MASK) != 0)
+    {
+        v.f += PRV_FP_HIDDEN_BIT;
+        v.e = (int)((bits >> 52) & 0x7FF) - PRV_FP_EXPONENT_BIAS;
+    }
+    else
+    {
+        v.e = PRV_FP_DENORMAL_EXPONENT;
+    }
+
+    // boundaries of the values rounding to v, normalized to the same exponent
+    plus.f = (v.f << 1) + 1;
+    plus.e = v.e - 1;
+    while ((plus.f & (PRV_FP_HIDDEN_BIT << 1)) == 0)
+    {
+        plus.f <<= 1;
+        plus.e--;
+    }
+    plus.f <<= 10;
+    plus.e -= 10;
+    if (v.f == PRV_FP_HIDDEN_BIT)
+    {
+        minus.f = (v.f << 2) - 1;
+        minus.e = v.e - 2;
+    }
+    else
+    {
+        minus.f = (v.f << 1) - 1;
+        minus.e = v.e - 1;
+    }
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+
+    // the cached power bringing the exponent of plus in [-60, -32]
+    dk = (-61 - plus.e) * 0.30102999566398114 + 347;
+    index = (int)dk;
+    if (dk - index > 0.0) index++;
+    index = (index >> 3) + 1;
+    cached = prv_cachedPowers[index];
+    *exponentP = -(PRV_FP_FIRST_CACHED_POWER + index * PRV_FP_CACHED_POWER_STEP);
+
+    w = prv_fpMultiply(prv_fpNormalize(v), cached);
+    plus = prv_fpMultiply(plus, cached);
+    minus = prv_fpMultiply(minus, cached);
+    minus.f++;
+    plus.f--;
+    delta = plus.f - minus.f;
+    distance = plus.f - w.f;
+
+    // generate the digits of plus until they are inside [minus, plus]
+    one.f = 1ULL << -plus.e;
+    one.e = plus.e;
+    part1 = (uint32_t)(plus.f >> -one.e);
+    part2 = plus.f & (one.f - 1);
+    kappa = prv_countDigits(part1);
+    count = 0;
+    while (kappa > 0)
+    {
+        uint32_t digit;
+        uint64_t rest;
+
+        digit = part1 / (uint32_t)prv_powersOfTen[kappa - 1];
+        part1 %= (uint32_t)prv_powersOfTen[kappa - 1];
+        if (digit != 0 || count != 0) digits[count++] = (uint8_t)('0' + digit);
+        kappa--;
+        rest = ((uint64_t)part1 << -one.e) + part2;
+        if (rest <= delta)
         {
-            if (result > (DBL_MAX / 10)) return 0;
-            result *= 10;
-            result += (buffer[i] - '0');
+            *exponentP += kappa;
+            prv_grisuRound(digits, count, delta, rest, prv_powersOfTen[kappa] << -one.e, distance);
+            return count;
+        }
+    }
+    while (1)
+    {
+        uint8_t digit;
+
+        part2 *= 10;
+        delta *= 10;
+        digit = (uint8_t)(part2 >> -one.e);
+        if (digit != 0 || count != 0) digits[count++] = (uint8_t)('0' + digit);
+        part2 &= one.f - 1;
+        kappa--;
+        if (part2 < delta)
+        {
+            *exponentP += kappa;
+            index = -kappa;
+            prv_grisuRound(digits, count, delta, part2, one.f, distance * (index < 20 ? prv_powersOfTen[index] : 0));
+            return count;
+        }
+    }
+}
+
+static double prv_fpToDouble(prv_fp_t x)
+{
+    uint64_t exponent;
+
+    while (x.f > PRV_FP_HIDDEN_BIT + PRV_FP_SIGNIFICAND_MASK)
+    {
+        x.f >>= 1;
+        x.e++;
+    }
+    if (x.e >= PRV_FP_MAX_EXPONENT) return prv_bitsToDouble(0x7FF0000000000000ULL);
+    if (x.e < PRV_FP_DENORMAL_EXPONENT) return 0.0;
+    while (x.e > PRV_FP_DENORMAL_EXPONENT && (x.f & PRV_FP_HIDDEN_BIT) == 0)
+    {
+        x.f <<= 1;
+        x.e--;
+    }
+    if (x.e == PRV_FP_DENORMAL_EXPONENT && (x.f & PRV_FP_HIDDEN_BIT) == 0)
+    {
+        exponent = 0;
+    }
+    else
+    {
+        exponent = (uint64_t)(x.e + PRV_FP_EXPONENT_BIAS);
+    }
+
+    return prv_bitsToDouble((x.f & PRV_FP_SIGNIFICAND_MASK) | (exponent << 52));
+}
+
+// Computes significand * 10^exponent with an error below one unit. Returns 0 if the result may
+// be rounded the wrong way. error is the one of significand, in PRV_FP_ERROR_UNIT.
+static int prv_fpFromDecimal(uint64_t significand,
+                             int digits,
+                             int exponent,
+                             int error,
+                             double * resultP)
+{
+    prv_fp_t input;
+    prv_fp_t adjusted;
+    uint64_t precisionMask;
+    uint64_t precisionBits;
+    uint64_t halfWay;
+    int oldE;
+    int index;
+    int adjustment;
+    int magnitude;
+    int precision;
+
+    input.f = significand;
+    input.e = 0;
+    input = prv_fpNormalize(input);
+    if (error != 0) error <<= -input.e;
+
+    index = (exponent - PRV_FP_FIRST_CACHED_POWER) / PRV_FP_CACHED_POWER_STEP;
+    adjustment = exponent - (PRV_FP_FIRST_CACHED_POWER + index * PRV_FP_CACHED_POWER_STEP);
+    if (adjustment != 0)
+    {
+        prv_fp_t power;
+
+        power.f = prv_powersOfTen[adjustment];
+        power.e = 0;
+        input = prv_fpMultiply(input, prv_fpNormalize(power));
+        // the product is exact when it fits in 64 bits
+        if (PRV_FLOAT_MAX_DIGITS - digits < adjustment) error += PRV_FP_ERROR_UNIT / 2;
+    }
+    input = prv_fpMultiply(input, prv_cachedPowers[index]);
+    // half a unit for the cached power, half a unit for the rounding of the product, and one
+    // eighth for the product of the errors
+    error += PRV_FP_ERROR_UNIT / 2 + PRV_FP_ERROR_UNIT / 2 + (error == 0 ? 0 : 1);
+
+    oldE = input.e;
+    input = prv_fpNormalize(input);
+    error <<= oldE - input.e;
+
+    // the count of low bits lost when rounding to a double, more for denormals
+    magnitude = 64 + input.e;
+    if (magnitude >= PRV_FP_DENORMAL_EXPONENT + 53)
+    {
+        precision = 64 - 53;
+    }
+    else if (magnitude <= PRV_FP_DENORMAL_EXPONENT)
+    {
+        precision = 64;
+    }
+    else
+    {
+        precision = 64 - (magnitude - PRV_FP_DENORMAL_EXPONENT);
+    }
+    if (precision + 3 >= 64)
+    {
+        int shift;
+
+        // very small denormals: make room for the error unit
+        shift = precision + 3 - 64 + 1;
+        input.f >>= shift;
+        input.e += shift;
+        error = (error >> shift) + 1 + PRV_FP_ERROR_UNIT;
+        precision -= shift;
+    }
+
+    precisionMask = (1ULL << precision) - 1;
+    precisionBits = (input.f & precisionMask) * PRV_FP_ERROR_UNIT;
+    halfWay = (1ULL << (precision - 1)) * PRV_FP_ERROR_UNIT;
+    adjusted.f = input.f >> precision;
+    adjusted.e = input.e + precision;
+    if (precisionBits >= halfWay + error) adjusted.f++;
+
+    *resultP = prv_fpToDouble(adjusted);
+
+    return (halfWay - error >= precisionBits || precisionBits >= halfWay + error);
+}
+
+// Computes significand * 10^exponent. Returns 0 if the result may be rounded the wrong way.
+static int prv_decimalToDouble(uint64_t significand,
+                               int digits,
+                               int exponent,
+                               int error,
+                               double * resultP)
+{
+    if (exponent + digits < -324)
+    {
+        *resultP = 0.0;
+        return 1;
+    }
+    if (error == 0
+     && significand <= (1ULL << 53)
+     && exponent >= -22
+     && exponent <= 22)
+    {
+        // both operands are exact so the result is correctly rounded
+        *resultP = (double)significand;
+        if (exponent < 0)
+        {
+            *resultP /= prv_exactPowersOfTen[-exponent];
         }
         else
         {
-            return 0;
+            *resultP *= prv_exactPowersOfTen[exponent];
         }
-        i++;
+        return 1;
     }
-    if (buffer[i] == '.')
+
+    return prv_fpFromDecimal(significand, digits, exponent, error, resultP);
+}
+
+// Reads the digits in buffer times 10^exponent with strtod(). Other characters like the decimal
+// point are skipped so the result does not depend on the locale. Returns a negative value on error.
+static double prv_strtod(const uint8_t * buffer,
+                         int length,
+                         int exponent)
+{
+    char text[64];
+    char * textP;
+    double result;
+    int count;
+    int i;
+
+    textP = (length + PRV_FLOAT_MAX_LEN < (int)sizeof(text)) ? text : (char *)lwm2m_malloc(length + PRV_FLOAT_MAX_LEN);
+    if (NULL == textP) return -1.0;
+
+    count = 0;
+    for (i = 0 ; i < length ; i++)
     {
-        double dec;
+        if ('0' <= buffer[i] && buffer[i] <= '9') textP[count++] = buffer[i];
+    }
+    textP[count++] = 'e';
+    count += utils_intToText(exponent, (uint8_t *)textP + count, PRV_FLOAT_MAX_LEN - 2);
+    textP[count] = 0;
 
-        i++;
-        if (i == length) return 0;
+    result = strtod(textP, NULL);
+    if (textP != text) lwm2m_free(textP);
 
-        dec = 0.1;
-        while (i < length)
+    return result;
+}
+
+// Grisu2 may write a digit more than needed for long outputs. Drop the last digit as long as one
+// of the two closest shorter values still reads back as value.
+static int prv_shortenDigits(double value,
+                             uint8_t * digits,
+                             int count,
+                             int * exponentP)
+{
+    while (count >= 16)
+    {
+        uint64_t candidates[2];
+        uint64_t low;
+        double result;
+        int found;
+        int i;
+
+        low = 0;
+        for (i = 0 ; i < count - 1 ; i++)
         {
-            if ('0' <= buffer[i] && buffer[i] <= '9')
-            {
-                if (result > (DBL_MAX - 1)) return 0;
-                result += (buffer[i] - '0') * dec;
-                dec /= 10;
-            }
-            else
+            low = low * 10 + (digits[i] - '0');
+        }
+        candidates[0] = (digits[count - 1] >= '5') ? low + 1 : low;
+        candidates[1] = (digits[count - 1] >= '5') ? low : low + 1;
+
+        found = -1;
+        for (i = 0 ; i < 2 && found < 0 ; i++)
+        {
+            if (candidates[i] == 0) continue;
+            if (0 == prv_decimalToDouble(candidates[i], count - 1, *exponentP + 1, 0, &result))
             {
-                return 0;
+                uint8_t text[PRV_FLOAT_MAX_DIGITS + 1];
+                int textLen;
+
+                // too close to the middle of two doubles
+                textLen = prv_countDigits(candidates[i]);
+                prv_writeDigits(candidates[i], text, textLen);
+                result = prv_strtod(text, textLen, *exponentP + 1);
             }
-            i++;
+            if (result == value) found = i;
+        }
+        if (found < 0) break;
+
+        *exponentP += 1;
+        count = prv_countDigits(candidates[found]);
+        prv_writeDigits(candidates[found], digits, count);
+        while (count > 1 && digits[count - 1] == '0')
+        {
+            count--;
+            *exponentP += 1;
         }
     }
 
-    *dataP = result * sign;
-    return 1;
+    return count;
 }
 
-static size_t prv_intToText(int64_t data,
-                            uint8_t * string,
-                            size_t length)
+int lwm2m_PlainTextToFloat64(uint8_t * buffer,
+                             int length,
+                             double * dataP)
 {
-    int index;
-    bool minus;
+    uint64_t significand;
+    double result;
+    int digits;
+    int exponent;
+    bool negative;
+    bool truncated;
+    bool found;
+    bool fraction;
+    int fractionCount;
+    int mantissaEnd;
+    int i;
 
-    if (data < 0)
+    if (length <= 0) return 0;
+
+    i = 0;
+    negative = false;
+    if (buffer[0] == '-')
     {
-        minus = true;
-        data = 0 - data;
+        negative = true;
+        i = 1;
     }
-    else
+
+    // keep the PRV_FLOAT_MAX_DIGITS first significant digits
+    significand = 0;
+    digits = 0;
+    exponent = 0;
+    truncated = false;
+    found = false;
+    fraction = false;
+    fractionCount = 0;
+    while (i < length)
     {
-        minus = false;
-    }
+        if ('0' <= buffer[i] && buffer[i] <= '9')
+        {
+            uint8_t digit = buffer[i] - '0';
 
-    index = length - 1;
-    do
+            if (digits < PRV_FLOAT_MAX_DIGITS)
+            {
+                if (significand != 0 || digit != 0)
+                {
+                    significand = significand * 10 + digit;
+                    digits++;
+                }
+                if (fraction) exponent--;
+            }
+            else
+            {
+                if (digit != 0) truncated = true;
+                if (!fraction) exponent++;
+            }
+            if (fraction) fractionCount++;
+            found = true;
+        }
+        else if (buffer[i] == '.' && !fraction)
+        {
+            fraction = true;
+            // at least one digit after the dot
+            if (i + 1 == length || buffer[i + 1] < '0' || buffer[i + 1] > '9') return 0;
+        }
+        else
+        {
+            break;
+        }
+        i++;
+    }
+    if (!found) return 0;
+    mantissaEnd = i;
+    if (i < length)
     {
-        string[index] = '0' + data%10;
-        data /= 10;
-        index --;
-    } while (index >= 0 && data > 0);
+        int sign;
+        int value;
 
-    if (data > 0) return 0;
+        if (buffer[i] != 'e' && buffer[i] != 'E') return 0;
+        i++;
+        sign = 1;
+        if (i < length && (buffer[i] == '+' || buffer[i] == '-'))
+        {
+            if (buffer[i] == '-') sign = -1;
+            i++;
+        }
+        if (i == length) return 0;
+        value = 0;
+        while (i < length)
+        {
+            if (buffer[i] < '0' || buffer[i] > '9') return 0;
+            if (value < 100000) value = value * 10 + (buffer[i] - '0');
+            i++;
+        }
+        exponent += sign * value;
+        fractionCount -= sign * value;
+    }
 
-    if (minus == true)
+    if (significand == 0)
     {
-        if (index == 0) return 0;
-        string[index] = '-';
+        *dataP = negative ? -0.0 : 0.0;
+        return 1;
     }
-    else
+    // above DBL_MAX
+    if (exponent + digits > 309) return 0;
+
+    if (0 == prv_decimalToDouble(significand, digits, exponent, truncated ? PRV_FP_ERROR_UNIT : 0, &result))
     {
-        index++;
+        // too close to the middle of two doubles
+        result = prv_strtod(buffer + (negative ? 1 : 0), mantissaEnd - (negative ? 1 : 0), -fractionCount);
+        if (result < 0) return 0;
     }
 
-    return length - index;
+    if (result > DBL_MAX) return 0;
+
+    *dataP = negative ? -result : result;
+    return 1;
 }
 
 size_t lwm2m_int64ToPlainText(int64_t data,
                               uint8_t ** bufferP)
 {
-#define _PRV_STR_LENGTH 32
-    uint8_t string[_PRV_STR_LENGTH];
+    uint8_t string[PRV_FLOAT_MAX_LEN];
     size_t length;
 
-    length = prv_intToText(data, string, _PRV_STR_LENGTH);
+    length = utils_intToText(data, string, sizeof(string));
     if (length == 0) return 0;
 
     *bufferP = (uint8_t *)lwm2m_malloc(length);
     if (NULL == *bufferP) return 0;
 
-    memcpy(*bufferP, string + _PRV_STR_LENGTH - length, length);
+    memcpy(*bufferP, string, length);
 
     return length;
 }
 
-
 size_t lwm2m_float64ToPlainText(double data,
                                 uint8_t ** bufferP)
 {
-#define _PRV_PRECISION 16
-    uint8_t intString[_PRV_STR_LENGTH];
-    size_t intLength;
-    uint8_t decString[_PRV_STR_LENGTH];
-    size_t decLength;
-    int64_t intPart;
-    double decPart;
-    int i;
+    uint8_t string[PRV_FLOAT_MAX_LEN];
+    size_t length;
+
+    length = utils_floatToText(data, string, sizeof(string));
+    if (length == 0) return 0;
+
+    *bufferP = (uint8_t *)lwm2m_malloc(length);
+    if (NULL == *bufferP) return 0;
+
+    memcpy(*bufferP, string, length);
 
-    intPart = (int64_t)data;
-    decPart = data - intPart;
-    if (decPart < 0)
+    return length;
+}
+
+size_t utils_intToText(int64_t data,
+                       uint8_t * string,
+                       size_t length)
+{
+    uint64_t value;
+    size_t index;
+    int count;
+
+    index = 0;
+    value = (uint64_t)data;
+    if (data < 0)
     {
-        decPart = 1 - decPart;
+        if (length == 0) return 0;
+        string[index++] = '-';
+        value = 0 - value;
     }
-    else
+    count = prv_countDigits(value);
+    if (length - index < (size_t)count) return 0;
+    prv_writeDigits(value, string + index, count);
+
+    return index + count;
+}
+
+size_t utils_floatToText(double data,
+                         uint8_t * string,
+                         size_t length)
+{
+    uint8_t text[PRV_FLOAT_MAX_LEN];
+    uint8_t digits[PRV_FLOAT_MAX_DIGITS];
+    uint64_t bits;
+    size_t index;
+    int count;
+    int exponent;
+    int point;
+
+    bits = prv_doubleToBits(data);
+    // infinities and NaN have no text representation
+    if (((bits >> 52) & 0x7FF) == 0x7FF) return 0;
+
+    index = 0;
+    if ((bits >> 63) != 0)
     {
-        decPart = 1 + decPart;
+        text[index++] = '-';
+        data = -data;
     }
-
-    if (decPart <= 1 + FLT_EPSILON)
+    if (data == 0)
     {
-        return lwm2m_int64ToPlainText(intPart, bufferP);
+        text[index++] = '0';
     }
-
-    intLength = prv_intToText(intPart, intString, _PRV_STR_LENGTH);
-    if (intLength == 0) return 0;
-
-    i = 0;
-    do
+    else if (data < 9007199254740992.0 && data == (double)(uint64_t)data)
     {
-        decPart *= 10;
-        i++;
-    } while ((decPart - (int64_t)decPart > 0)
-          && (i < _PRV_PRECISION));
-
-    decLength = prv_intToText(decPart, decString, _PRV_STR_LENGTH);
-    if (decLength <= 1) return 0;
-
-    *bufferP = (uint8_t *)lwm2m_malloc(intLength + 1 + decLength);
-    if (NULL == *bufferP) return 0;
+        // integral values below 2^53 are their own shortest representation
+        count = prv_countDigits((uint64_t)data);
+        prv_writeDigits((uint64_t)data, text + index, count);
+        index += count;
+    }
+    else
+    {
+        count = prv_grisu2(data, digits, &exponent);
+        count = prv_shortenDigits(data, digits, count, &exponent);
+        point = count + exponent;   // 10^(point - 1) <= data < 10^point
+        if (0 <= exponent && point <= 21)
+        {
+            // 1234e7 -> 12340000000
+            memcpy(text + index, digits, count);
+            memset(text + index + count, '0', exponent);
+            index += point;
+        }
+        else if (0 < point && point <= 21)
+        {
+            // 1234e-2 -> 12.34
+            memcpy(text + index, digits, point);
+            text[index + point] = '.';
+            memcpy(text + index + point + 1, digits + point, count - point);
+            index += count + 1;
+        }
+        else if (-6 < point && point <= 0)
+        {
+            // 1234e-6 -> 0.001234
+            text[index] = '0';
+            text[index + 1] = '.';
+            memset(text + index + 2, '0', -point);
+            memcpy(text + index + 2 - point, digits, count);
+            index += 2 - point + count;
+        }
+        else
+        {
+            // 1234e30 -> 1.234e33
+            text[index++] = digits[0];
+            if (count > 1)
+            {
+                text[index++] = '.';
+                memcpy(text + index, digits + 1, count - 1);
+                index += count - 1;
+            }
+            text[index++] = 'e';
+            point--;
+            if (point < 0)
+            {
+                text[index++] = '-';
+                point = -point;
+            }
+            count = prv_countDigits((uint64_t)point);
+            prv_writeDigits((uint64_t)point, text + index, count);
+            index += count;
+        }
+    }
 
-    memcpy(*bufferP, intString + _PRV_STR_LENGTH - intLength, intLength);
-    (*bufferP)[intLength] = '.';
-    memcpy(*bufferP + intLength + 1, decString + _PRV_STR_LENGTH - decLength + 1, decLength - 1);
+    if (index > length) return 0;
+    memcpy(string, text, index);
 
-    return intLength + decLength;   // +1 for dot, -1 for extra "1" in decPart
+    return index;
 }
 
-
 size_t lwm2m_boolToPlainText(bool data,
                              uint8_t ** bufferP)
 {
@@ -405,16 +1083,224 @@ int prv_isAltPathValid(const char * altPath)
     return 1;
 }
 
+// FNV-1a
+size_t utils_hash(const uint8_t * buffer,
+                  size_t length)
+{
+    uint32_t hash = 2166136261u;
+    size_t i;
+
+    for (i = 0 ; i < length ; i++)
+    {
+        hash ^= buffer[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/*
+ * Timer heap: a binary min-heap of items ordered by the int64_t date found at timeOffset in each
+ * item. Each item also stores its position in the heap plus one as a size_t at indexOffset, 0 when
+ * not in the heap, so that it can be moved or removed without a search. The owner of the heap
+ * only looks at its top to find the next due item.
+ */
+#define PRV_HEAP_INITIAL_SIZE   16
+
+#define PRV_HEAP_TIME(heapP, itemP)     (*(int64_t *)((uint8_t *)(itemP) + (heapP)->timeOffset))
+#define PRV_HEAP_INDEX(heapP, itemP)    (*(size_t *)((uint8_t *)(itemP) + (heapP)->indexOffset))
+
+static void prv_heapSet(lwm2m_heap_t * heapP,
+                        size_t index,
+                        void * itemP)
+{
+    heapP->items[index] = itemP;
+    PRV_HEAP_INDEX(heapP, itemP) = index + 1;
+}
+
+static void prv_heapUp(lwm2m_heap_t * heapP,
+                       size_t index)
+{
+    void * itemP = heapP->items[index];
+    int64_t time = PRV_HEAP_TIME(heapP, itemP);
+
+    while (0 < index)
+    {
+        size_t parent = (index - 1) / 2;
+
+        if (PRV_HEAP_TIME(heapP, heapP->items[parent]) <= time) break;
+
+        prv_heapSet(heapP, index, heapP->items[parent]);
+        index = parent;
+    }
+    prv_heapSet(heapP, index, itemP);
+}
+
+static void prv_heapDown(lwm2m_heap_t * heapP,
+                         size_t index)
+{
+    void * itemP = heapP->items[index];
+    int64_t time = PRV_HEAP_TIME(heapP, itemP);
+
+    while (1)
+    {
+        size_t child = 2 * index + 1;
+
+        if (child >= heapP->count) break;
+        if (child + 1 < heapP->count
+         && PRV_HEAP_TIME(heapP, heapP->items[child + 1]) < PRV_HEAP_TIME(heapP, heapP->items[child]))
+        {
+            child++;
+        }
+        if (time <= PRV_HEAP_TIME(heapP, heapP->items[child])) break;
+
+        prv_heapSet(heapP, index, heapP->items[child]);
+        index = child;
+    }
+    prv_heapSet(heapP, index, itemP);
+}
+
+static int prv_heapGrow(lwm2m_heap_t * heapP,
+                        size_t count)
+{
+    void ** itemsP;
+    size_t size;
+
+    if (count <= heapP->size) return 0;
+
+    size = heapP->size ? heapP->size : PRV_HEAP_INITIAL_SIZE;
+    while (size < count) size *= 2;
+    itemsP = (void **)lwm2m_malloc(size * sizeof(void *));
+    if (NULL == itemsP) return COAP_500_INTERNAL_SERVER_ERROR;
+    if (NULL != heapP->items)
+    {
+        memcpy(itemsP, heapP->items, heapP->count * sizeof(void *));
+        lwm2m_free(heapP->items);
+    }
+    heapP->items = itemsP;
+    heapP->size = size;
+
+    return 0;
+}
+
+void utils_heapInit(lwm2m_heap_t * heapP,
+                    size_t timeOffset,
+                    size_t indexOffset)
+{
+    memset(heapP, 0, sizeof(lwm2m_heap_t));
+    heapP->timeOffset = timeOffset;
+    heapP->indexOffset = indexOffset;
+}
+
+void utils_heapFree(lwm2m_heap_t * heapP)
+{
+    if (NULL != heapP->items) lwm2m_free(heapP->items);
+    heapP->items = NULL;
+    heapP->count = 0;
+    heapP->size = 0;
+    heapP->reserved = 0;
+}
+
+int utils_heapReserve(lwm2m_heap_t * heapP)
+{
+    if (0 != prv_heapGrow(heapP, heapP->reserved + 1)) return COAP_500_INTERNAL_SERVER_ERROR;
+    heapP->reserved++;
+
+    return 0;
+}
+
+void utils_heapRelease(lwm2m_heap_t * heapP)
+{
+    if (0 < heapP->reserved) heapP->reserved--;
+}
+
+int utils_heapSchedule(lwm2m_heap_t * heapP,
+                       void * itemP)
+{
+    size_t index = PRV_HEAP_INDEX(heapP, itemP);
+
+    if (0 == index)
+    {
+        if (0 != prv_heapGrow(heapP, heapP->count + 1)) return COAP_500_INTERNAL_SERVER_ERROR;
+        prv_heapSet(heapP, heapP->count, itemP);
+        heapP->count++;
+        index = heapP->count;
+    }
+
+    prv_heapUp(heapP, index - 1);
+    prv_heapDown(heapP, PRV_HEAP_INDEX(heapP, itemP) - 1);
+
+    return 0;
+}
+
+void utils_heapUnschedule(lwm2m_heap_t * heapP,
+                          void * itemP)
+{
+    size_t index = PRV_HEAP_INDEX(heapP, itemP);
+
+    if (0 == index) return;
+
+    index--;
+    PRV_HEAP_INDEX(heapP, itemP) = 0;
+    heapP->count--;
+
+    if (index != heapP->count)
+    {
+        void * lastP = heapP->items[heapP->count];
+
+        prv_heapSet(heapP, index, lastP);
+        prv_heapUp(heapP, index);
+        prv_heapDown(heapP, PRV_HEAP_INDEX(heapP, lastP) - 1);
+    }
+}
+
+void * utils_heapTop(lwm2m_heap_t * heapP)
+{
+    return (0 < heapP->count) ? heapP->items[0] : NULL;
+}
+
+/*
+ * xorshift64* generator used for the retransmission jitter and the first message ID. Each context
+ * keeps its own state, so contexts running in different threads do not share the one of rand().
+ * The seed mixes the context address, so contexts created within the same second still differ.
+ */
+void utils_randomSeed(lwm2m_context_t * contextP)
+{
+    uint64_t seed;
+
+    seed = ((uint64_t)time(NULL) << 20) ^ (uint64_t)lwm2m_gettime_ms() ^ (uint64_t)(uintptr_t)contextP;
+
+    // splitmix64 finalizer: close seeds give unrelated states
+    seed += 0x9E3779B97F4A7C15ULL;
+    seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+    seed ^= seed >> 31;
+
+    contextP->randomState = (0 != seed) ? seed : 1;
+}
+
+uint32_t utils_random(lwm2m_context_t * contextP)
+{
+    uint64_t state = contextP->randomState;
+
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    contextP->randomState = state;
+
+    return (uint32_t)((state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
 #ifndef LWM2M_EMBEDDED_MODE
-time_t lwm2m_gettime(void)
+int64_t lwm2m_gettime_ms(void)
 {
-    struct timeval tv;
+    struct timespec ts;
 
-    if (0 != gettimeofday(&tv, NULL))
+    if (0 != clock_gettime(CLOCK_MONOTONIC, &ts))
     {
         return -1;
     }
 
-    return tv.tv_sec;
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 #endif
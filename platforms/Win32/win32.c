@@ -31,9 +31,9 @@ int lwm2m_strcasecmp(const char * s1, const char * s2)
     return _stricmp(s1, s2);
 }
 
-time_t lwm2m_gettime(void)
+int64_t lwm2m_gettime_ms(void)
 {
-    return time(NULL);
+    return (int64_t)GetTickCount64();
 }
 
 int lwm2m_getline(char** line, size_t* length, FILE* fd)
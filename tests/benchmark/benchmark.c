@@ -0,0 +1,218 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2015 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - initial API and implementation
+ *
+ *******************************************************************************/
+
+/*
+ * Performance benchmarks of the core.
+ *
+ * The core is built in LWM2M_EMBEDDED_MODE so that this file provides the platform
+ * functions, including a virtual clock which lets the benchmarks simulate long
+ * periods of time instantly.
+ *
+ * Usage: lwm2mbenchmark [name]
+ */
+
+#include "internals.h"
+#include "benchmark.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+int64_t bench_time = 1000000;
+_Thread_local unsigned long bench_sent = 0;
+_Thread_local unsigned long bench_allocations = 0;
+void (*bench_send_hook)(void * sessionH, uint8_t * buffer, size_t length) = NULL;
+
+static _Thread_local uint16_t bench_mid = 0;
+static _Thread_local int bench_lastClientID = -1;
+
+static struct BenchTable table[] = {
+        { "transaction_step", bench_transaction_step },
+        { "transaction_match", bench_transaction_match },
+        { "transaction_queue", bench_transaction_queue },
+        { "registration_storm", bench_registration_storm },
+        { "registration_rate", bench_registration_rate },
+        { "packet_receive", bench_packet_receive },
+        { "packet_threads", bench_packet_threads },
+        { "shard_engine", bench_shard_engine },
+        { "observe_fanout", bench_observe_fanout },
+        { "observe_attributes", bench_observe_attributes },
+        { "observe_watchers", bench_observe_watchers },
+        { "observe_confirmable", bench_observe_confirmable },
+        { "observe_notify", bench_observe_notify },
+        { "observe_snapshot", bench_observe_snapshot },
+        { "observe_coalesce", bench_observe_coalesce },
+        { "observe_cancel", bench_observe_cancel },
+        { "observe_queue", bench_observe_queue },
+        { "data_tlv_serialize", bench_data_tlv_serialize },
+        { "data_tlv_parse", bench_data_tlv_parse },
+        { "data_json_serialize", bench_data_json_serialize },
+        { "data_json_parse", bench_data_json_parse },
+        { "data_text", bench_data_text },
+        { NULL, NULL },
+};
+
+
+/*
+ * Platform functions
+ */
+
+void * lwm2m_malloc(size_t s)
+{
+    bench_allocations++;
+    return malloc(s);
+}
+
+void lwm2m_free(void * p)
+{
+    free(p);
+}
+
+char * lwm2m_strdup(const char * str)
+{
+    bench_allocations++;
+    return strdup(str);
+}
+
+int lwm2m_strncmp(const char * s1,
+                  const char * s2,
+                  size_t n)
+{
+    return strncmp(s1, s2, n);
+}
+
+int lwm2m_getline(char ** line,
+                  size_t * length,
+                  FILE * f)
+{
+    return getline(line, length, f);
+}
+
+int lwm2m_strcasecmp(const char * s1,
+                     const char * s2)
+{
+    return strcasecmp(s1, s2);
+}
+
+int64_t lwm2m_gettime_ms(void)
+{
+    return bench_time;
+}
+
+
+/*
+ * Helpers
+ */
+
+uint64_t bench_clock(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void * prv_connect(uint16_t secObjInstID,
+                          void * userData)
+{
+    return NULL;
+}
+
+static uint8_t prv_send(void * sessionH,
+                        uint8_t * buffer,
+                        size_t length,
+                        void * userData)
+{
+    bench_sent++;
+    if (NULL != bench_send_hook)
+    {
+        bench_send_hook(sessionH, buffer, length);
+    }
+    return COAP_NO_ERROR;
+}
+
+static void prv_monitor(uint16_t clientID,
+                        lwm2m_uri_t * uriP,
+                        int status,
+                        lwm2m_media_type_t format,
+                        uint8_t * data,
+                        int dataLength,
+                        void * userData)
+{
+    if (COAP_201_CREATED == status)
+    {
+        bench_lastClientID = clientID;
+    }
+}
+
+lwm2m_context_t * bench_server_new(void)
+{
+    lwm2m_context_t * contextP;
+
+    contextP = lwm2m_init(prv_connect, prv_send, NULL);
+    if (NULL != contextP)
+    {
+        lwm2m_set_monitoring_callback(contextP, prv_monitor, NULL);
+    }
+
+    return contextP;
+}
+
+int bench_register_client(lwm2m_context_t * contextP,
+                          void * sessionH,
+                          const char * name)
+{
+    coap_packet_t message[1];
+    uint8_t buffer[COAP_MAX_HEADER_SIZE + 64];
+    char query[64];
+    const char * payload = "</1/0>,</3/0>";
+    size_t length;
+
+    snprintf(query, sizeof(query), "ep=%s", name);
+
+    coap_init_message(message, COAP_TYPE_CON, COAP_POST, bench_mid++);
+    coap_set_header_uri_path(message, "/"URI_REGISTRATION_SEGMENT);
+    coap_set_header_uri_query(message, query);
+    coap_set_header_content_type(message, LWM2M_CONTENT_LINK);
+    coap_set_payload(message, payload, strlen(payload));
+    length = coap_serialize_message(message, buffer);
+    if (0 == length) return -1;
+
+    bench_lastClientID = -1;
+    lwm2m_handle_packet(contextP, buffer, length, sessionH);
+
+    return bench_lastClientID;
+}
+
+int main(int argc, char *argv[])
+{
+    int i;
+
+    for (i = 0; NULL != table[i].name; i++)
+    {
+        if (argc > 1 && strcmp(argv[1], table[i].name) != 0) continue;
+
+        printf("%s:\r\n", table[i].name);
+        table[i].function();
+        printf("\r\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2015 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - initial API and implementation
+ *
+ *******************************************************************************/
+
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include "liblwm2m.h"
+
+struct BenchTable {
+    const char* name;
+    void (*function)(void);
+};
+
+// Value in milliseconds returned by lwm2m_gettime_ms(). Benchmarks move it forward by hand.
+extern int64_t bench_time;
+// Number of buffers given to the send callback by the calling thread.
+extern _Thread_local unsigned long bench_sent;
+// Number of calls to lwm2m_malloc() by the calling thread.
+extern _Thread_local unsigned long bench_allocations;
+// When set, called with every buffer given to the send callback.
+extern void (*bench_send_hook)(void * sessionH, uint8_t * buffer, size_t length);
+
+// Monotonic wall clock in nanoseconds, used for the measurements.
+uint64_t bench_clock(void);
+
+// Returns a context working in server mode.
+lwm2m_context_t * bench_server_new(void);
+// Registers a client through lwm2m_handle_packet(). Returns its internal ID or -1.
+int bench_register_client(lwm2m_context_t * contextP, void * sessionH, const char * name);
+
+void bench_transaction_step(void);
+void bench_transaction_match(void);
+void bench_transaction_queue(void);
+void bench_registration_storm(void);
+void bench_registration_rate(void);
+void bench_packet_receive(void);
+void bench_packet_threads(void);
+void bench_shard_engine(void);
+void bench_observe_fanout(void);
+void bench_observe_attributes(void);
+void bench_observe_watchers(void);
+void bench_observe_confirmable(void);
+void bench_observe_notify(void);
+void bench_observe_snapshot(void);
+void bench_observe_coalesce(void);
+void bench_observe_cancel(void);
+void bench_observe_queue(void);
+void bench_data_tlv_serialize(void);
+void bench_data_tlv_parse(void);
+void bench_data_json_serialize(void);
+void bench_data_json_parse(void);
+void bench_data_text(void);
+
+#endif /* BENCHMARK_H_ */
@@ -0,0 +1,463 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2015 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - initial API and implementation
+ *
+ *******************************************************************************/
+#include "internals.h"
+#include "benchmark.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#define BENCH_DATA_INSTANCES        4
+#define BENCH_DATA_RESOURCES        500     // per instance
+#define BENCH_DATA_MULTIPLE         10      // every 10th resource is a multiple resource...
+#define BENCH_DATA_RESOURCE_INST    8       // ...of 8 resource instances
+#define BENCH_DATA_ROUNDS           2000
+
+// Builds the content of a read of the whole object: BENCH_DATA_INSTANCES object instances of
+// BENCH_DATA_RESOURCES resources.
+static lwm2m_data_t * prv_objectNew(void)
+{
+    lwm2m_data_t * dataP;
+    int i;
+
+    dataP = lwm2m_data_new(BENCH_DATA_INSTANCES);
+    for (i = 0; i < BENCH_DATA_INSTANCES; i++)
+    {
+        lwm2m_data_t * resourceP;
+        int j;
+
+        resourceP = lwm2m_data_new(BENCH_DATA_RESOURCES);
+        for (j = 0; j < BENCH_DATA_RESOURCES; j++)
+        {
+            resourceP[j].id = j;
+            if (0 == j % BENCH_DATA_MULTIPLE)
+            {
+                lwm2m_data_t * instanceP;
+                int k;
+
+                instanceP = lwm2m_data_new(BENCH_DATA_RESOURCE_INST);
+                for (k = 0; k < BENCH_DATA_RESOURCE_INST; k++)
+                {
+                    instanceP[k].type = LWM2M_TYPE_RESOURCE_INSTANCE;
+                    instanceP[k].id = k;
+                    lwm2m_data_encode_int(k * 1000, instanceP + k);
+                }
+                lwm2m_data_include(instanceP, BENCH_DATA_RESOURCE_INST, resourceP + j);
+            }
+            else
+            {
+                resourceP[j].type = LWM2M_TYPE_RESOURCE;
+                lwm2m_data_encode_int((int64_t)j * 100003, resourceP + j);
+            }
+        }
+        lwm2m_data_include(resourceP, BENCH_DATA_RESOURCES, dataP + i);
+        dataP[i].type = LWM2M_TYPE_OBJECT_INSTANCE;
+        dataP[i].id = i;
+    }
+
+    return dataP;
+}
+
+static void prv_report(const char * name,
+                       uint64_t duration,
+                       unsigned long allocations,
+                       int length)
+{
+    printf("  %-36s %9.1f ns/object, %.2f allocations/object, %d bytes\r\n",
+           name, (double)duration / BENCH_DATA_ROUNDS, (double)allocations / BENCH_DATA_ROUNDS, length);
+}
+
+/*
+ * TLV serialization of a multi-instance object of 500 resources per instance, some of them
+ * multiple, into an allocated buffer and into a buffer given by the caller.
+ */
+void bench_data_tlv_serialize(void)
+{
+    lwm2m_data_t * dataP;
+    uint8_t * bufferP;
+    uint8_t * expectedP;
+    unsigned long allocations;
+    uint64_t start;
+    int length;
+    int i;
+
+    dataP = prv_objectNew();
+
+    allocations = bench_allocations;
+    start = bench_clock();
+    for (i = 0; i < BENCH_DATA_ROUNDS; i++)
+    {
+        lwm2m_media_type_t format = LWM2M_CONTENT_TLV;
+
+        length = lwm2m_data_serialize(BENCH_DATA_INSTANCES, dataP, &format, &bufferP);
+        lwm2m_free(bufferP);
+    }
+    prv_report("lwm2m_data_serialize():", bench_clock() - start, bench_allocations - allocations, length);
+
+    expectedP = (uint8_t *)lwm2m_malloc(length);
+    bufferP = (uint8_t *)lwm2m_malloc(length);
+    lwm2m_dataToTLV(BENCH_DATA_INSTANCES, dataP, expectedP, length);
+
+    allocations = bench_allocations;
+    start = bench_clock();
+    for (i = 0; i < BENCH_DATA_ROUNDS; i++)
+    {
+        length = lwm2m_dataToTLV(BENCH_DATA_INSTANCES, dataP, bufferP, length);
+    }
+    prv_report("lwm2m_dataToTLV():", bench_clock() - start, bench_allocations - allocations, length);
+    if (0 != memcmp(bufferP, expectedP, length)) printf("  error: the serializations differ\r\n");
+
+    lwm2m_free(bufferP);
+    lwm2m_free(expectedP);
+    lwm2m_data_free(BENCH_DATA_INSTANCES, dataP);
+}
+
+/*
+ * TLV parsing of the same object, as received by a bootstrap write, and of one of its instances,
+ * as received by a write on the instance. The iterator goes through the resources without
+ * building the tree.
+ */
+static void prv_parse(const char * name,
+                      uint8_t * buffer,
+                      int length)
+{
+    lwm2m_tlv_iterator_t iterator;
+    lwm2m_data_t * dataP;
+    lwm2m_data_t data;
+    unsigned long allocations;
+    uint64_t start;
+    char label[64];
+    int size;
+    int count;
+    int i;
+
+    allocations = bench_allocations;
+    start = bench_clock();
+    for (i = 0; i < BENCH_DATA_ROUNDS; i++)
+    {
+        size = lwm2m_data_parse(buffer, length, LWM2M_CONTENT_TLV, &dataP);
+        lwm2m_data_free(size, dataP);
+    }
+    snprintf(label, sizeof(label), "%s lwm2m_data_parse():", name);
+    prv_report(label, bench_clock() - start, bench_allocations - allocations, length);
+    if (0 == size) printf("  error: the parsing failed\r\n");
+
+    allocations = bench_allocations;
+    start = bench_clock();
+    for (i = 0; i < BENCH_DATA_ROUNDS; i++)
+    {
+        lwm2m_tlv_iterator_init(&iterator, buffer, length);
+        count = 0;
+        while (1 == lwm2m_tlv_iterator_next(&iterator, &data))
+        {
+            count++;
+        }
+    }
+    snprintf(label, sizeof(label), "%s iterator:", name);
+    prv_report(label, bench_clock() - start, bench_allocations - allocations, length);
+    if (BENCH_DATA_INSTANCES * BENCH_DATA_RESOURCES * (BENCH_DATA_MULTIPLE - 1 + BENCH_DATA_RESOURCE_INST) / BENCH_DATA_MULTIPLE != count
+     && BENCH_DATA_RESOURCES * (BENCH_DATA_MULTIPLE - 1 + BENCH_DATA_RESOURCE_INST) / BENCH_DATA_MULTIPLE != count)
+    {
+        printf("  error: the iterator found %d resources\r\n", count);
+    }
+}
+
+void bench_data_tlv_parse(void)
+{
+    lwm2m_data_t * dataP;
+    uint8_t * bufferP;
+    int length;
+
+    dataP = prv_objectNew();
+
+    length = lwm2m_dataToTLV(BENCH_DATA_INSTANCES, dataP, NULL, 0);
+    bufferP = (uint8_t *)lwm2m_malloc(length);
+    lwm2m_dataToTLV(BENCH_DATA_INSTANCES, dataP, bufferP, length);
+    prv_parse("object:", bufferP, length);
+    lwm2m_free(bufferP);
+
+    length = lwm2m_dataToTLV(dataP->length, (lwm2m_data_t *)dataP->value, NULL, 0);
+    bufferP = (uint8_t *)lwm2m_malloc(length);
+    lwm2m_dataToTLV(dataP->length, (lwm2m_data_t *)dataP->value, bufferP, length);
+    prv_parse("instance:", bufferP, length);
+    lwm2m_free(bufferP);
+
+    lwm2m_data_free(BENCH_DATA_INSTANCES, dataP);
+}
+
+/*
+ * JSON serialization of an instance of 32 resources of all types, which the former encoder could
+ * handle in its fixed buffer, then of the whole multi-instance object, in a single buffer and in
+ * chunks of the size of a CoAP block.
+ */
+#define BENCH_JSON_RESOURCES    32
+#define BENCH_JSON_CHUNK_SIZE   1024
+
+static int prv_jsonChunk(uint8_t * chunk,
+                         size_t length,
+                         void * userData)
+{
+    (*(int *)userData)++;
+    return 0;
+}
+
+static lwm2m_data_t * prv_jsonInstanceNew(void)
+{
+    lwm2m_data_t * dataP;
+    int i;
+
+    dataP = lwm2m_data_new(BENCH_JSON_RESOURCES);
+    for (i = 0; i < BENCH_JSON_RESOURCES; i++)
+    {
+        dataP[i].type = LWM2M_TYPE_RESOURCE;
+        dataP[i].id = i;
+        switch (i % 4)
+        {
+        case 0:
+            lwm2m_data_encode_int((int64_t)i * -7919, dataP + i);
+            break;
+        case 1:
+            lwm2m_data_encode_float(i * 3.14159, dataP + i);
+            break;
+        case 2:
+            lwm2m_data_encode_bool(i % 8 == 2, dataP + i);
+            break;
+        default:
+            dataP[i].dataType = LWM2M_TYPE_STRING;
+            dataP[i].flags = LWM2M_TLV_FLAG_STATIC_DATA;
+            dataP[i].value = (uint8_t *)"Open Mobile \"Alliance\"";
+            dataP[i].length = 22;
+            break;
+        }
+    }
+
+    return dataP;
+}
+
+void bench_data_json_serialize(void)
+{
+    lwm2m_data_t * dataP;
+    uint8_t chunk[BENCH_JSON_CHUNK_SIZE];
+    uint8_t * bufferP;
+    unsigned long allocations;
+    uint64_t start;
+    int chunks;
+    int length;
+    int i;
+
+    dataP = prv_jsonInstanceNew();
+    allocations = bench_allocations;
+    start = bench_clock();
+    for (i = 0; i < BENCH_DATA_ROUNDS; i++)
+    {
+        bufferP = NULL;
+        length = lwm2m_json_serialize(BENCH_JSON_RESOURCES, dataP, &bufferP);
+        lwm2m_free(bufferP);
+    }
+    prv_report("32 resources:", bench_clock() - start, bench_allocations - allocations, length);
+    if (0 == length) printf("  error: the serialization failed\r\n");
+    lwm2m_data_free(BENCH_JSON_RESOURCES, dataP);
+
+    dataP = prv_objectNew();
+    allocations = bench_allocations;
+    start = bench_clock();
+    for (i = 0; i < BENCH_DATA_ROUNDS; i++)
+    {
+        bufferP = NULL;
+        length = lwm2m_json_serialize(BENCH_DATA_INSTANCES, dataP, &bufferP);
+        lwm2m_free(bufferP);
+    }
+    prv_report("object:", bench_clock() - start, bench_allocations - allocations, length);
+    if (0 == length) printf("  error: the serialization failed\r\n");
+
+    allocations = bench_allocations;
+    start = bench_clock();
+    for (i = 0; i < BENCH_DATA_ROUNDS; i++)
+    {
+        chunks = 0;
+        length = lwm2m_json_serialize_chunks(BENCH_DATA_INSTANCES, dataP, chunk, sizeof(chunk), prv_jsonChunk, &chunks);
+    }
+    prv_report("object in chunks:", bench_clock() - start, bench_allocations - allocations, length);
+    printf("  %d chunks of %d bytes\r\n", chunks, BENCH_JSON_CHUNK_SIZE);
+    lwm2m_data_free(BENCH_DATA_INSTANCES, dataP);
+}
+
+/*
+ * JSON parsing of the documents written above: the instance of 32 resources, as received by a
+ * write on the instance, and the whole object, as received in a notification of the object.
+ */
+static void prv_jsonParse(const char * name,
+                          lwm2m_uri_t * uriP,
+                          uint8_t * buffer,
+                          int length)
+{
+    lwm2m_data_t * dataP;
+    unsigned long allocations;
+    uint64_t start;
+    uint64_t duration;
+    int size;
+    int i;
+
+    allocations = bench_allocations;
+    start = bench_clock();
+    for (i = 0; i < BENCH_DATA_ROUNDS; i++)
+    {
+        size = lwm2m_json_parse(uriP, buffer, length, &dataP);
+        lwm2m_data_free(size, dataP);
+    }
+    duration = bench_clock() - start;
+    prv_report(name, duration, bench_allocations - allocations, length);
+    printf("  %.1f MB/s\r\n", (double)length * BENCH_DATA_ROUNDS * 1000 / duration);
+    if (0 == size) printf("  error: the parsing failed\r\n");
+}
+
+void bench_data_json_parse(void)
+{
+    lwm2m_data_t * dataP;
+    lwm2m_uri_t uri;
+    uint8_t * bufferP;
+    int length;
+
+    memset(&uri, 0, sizeof(lwm2m_uri_t));
+    uri.objectId = 3;
+    uri.instanceId = 0;
+    uri.flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID;
+
+    dataP = prv_jsonInstanceNew();
+    bufferP = NULL;
+    length = lwm2m_json_serialize(BENCH_JSON_RESOURCES, dataP, &bufferP);
+    prv_jsonParse("32 resources:", &uri, bufferP, length);
+    lwm2m_free(bufferP);
+    lwm2m_data_free(BENCH_JSON_RESOURCES, dataP);
+
+    uri.flag = LWM2M_URI_FLAG_OBJECT_ID;
+    dataP = prv_objectNew();
+    bufferP = NULL;
+    length = lwm2m_json_serialize(BENCH_DATA_INSTANCES, dataP, &bufferP);
+    prv_jsonParse("object:", &uri, bufferP, length);
+    lwm2m_free(bufferP);
+    lwm2m_data_free(BENCH_DATA_INSTANCES, dataP);
+}
+
+#define BENCH_TEXT_VALUES       1024
+#define BENCH_TEXT_ROUNDS       200
+
+static void prv_textReport(const char * name,
+                           uint64_t duration,
+                           unsigned long allocations,
+                           size_t length)
+{
+    printf("  %-36s %9.1f ns/value, %.2f allocations/value, %.1f bytes/value\r\n",
+           name, (double)duration / (BENCH_TEXT_VALUES * BENCH_TEXT_ROUNDS),
+           (double)allocations / (BENCH_TEXT_VALUES * BENCH_TEXT_ROUNDS), (double)length / BENCH_TEXT_VALUES);
+}
+
+/*
+ * Conversions between numbers and their text representation used by the text and JSON formats:
+ * integers of all magnitudes, sensor like values with a few decimals and arbitrary doubles.
+ */
+void bench_data_text(void)
+{
+    int64_t * integers;
+    double * floats;
+    uint8_t * texts;
+    size_t * lengths;
+    uint64_t state;
+    unsigned long allocations;
+    uint64_t start;
+    uint64_t duration;
+    size_t length;
+    double result;
+    int failures;
+    int round;
+    int i;
+
+    integers = (int64_t *)lwm2m_malloc(BENCH_TEXT_VALUES * sizeof(int64_t));
+    floats = (double *)lwm2m_malloc(BENCH_TEXT_VALUES * sizeof(double));
+    texts = (uint8_t *)lwm2m_malloc(BENCH_TEXT_VALUES * 32);
+    lengths = (size_t *)lwm2m_malloc(BENCH_TEXT_VALUES * sizeof(size_t));
+    if (NULL == integers || NULL == floats || NULL == texts || NULL == lengths) goto exit;
+
+    state = 0x2545F4914F6CDD1DULL;
+    for (i = 0; i < BENCH_TEXT_VALUES; i++)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        integers[i] = (int64_t)(state >> (i % 64));
+        if (i % 2 == 0)
+        {
+            floats[i] = (double)(int64_t)(state % 2000000 - 1000000) / 1000;
+        }
+        else
+        {
+            floats[i] = (double)(state >> 11) / (1ULL << 53) * 1e6;
+        }
+    }
+
+    length = 0;
+    allocations = bench_allocations;
+    start = bench_clock();
+    for (round = 0; round < BENCH_TEXT_ROUNDS; round++)
+    {
+        length = 0;
+        for (i = 0; i < BENCH_TEXT_VALUES; i++)
+        {
+            length += utils_intToText(integers[i], texts + i * 32, 32);
+        }
+    }
+    duration = bench_clock() - start;
+    prv_textReport("integer to text:", duration, bench_allocations - allocations, length);
+
+    allocations = bench_allocations;
+    start = bench_clock();
+    for (round = 0; round < BENCH_TEXT_ROUNDS; round++)
+    {
+        length = 0;
+        for (i = 0; i < BENCH_TEXT_VALUES; i++)
+        {
+            lengths[i] = utils_floatToText(floats[i], texts + i * 32, 32);
+            length += lengths[i];
+        }
+    }
+    duration = bench_clock() - start;
+    prv_textReport("float to text:", duration, bench_allocations - allocations, length);
+
+    failures = 0;
+    allocations = bench_allocations;
+    start = bench_clock();
+    for (round = 0; round < BENCH_TEXT_ROUNDS; round++)
+    {
+        for (i = 0; i < BENCH_TEXT_VALUES; i++)
+        {
+            if (1 != lwm2m_PlainTextToFloat64(texts + i * 32, (int)lengths[i], &result)
+             || result != floats[i])
+            {
+                failures++;
+            }
+        }
+    }
+    duration = bench_clock() - start;
+    prv_textReport("text to float:", duration, bench_allocations - allocations, length);
+    if (0 != failures) printf("  error: %d values did not read back\r\n", failures / BENCH_TEXT_ROUNDS);
+
+exit:
+    lwm2m_free(integers);
+    lwm2m_free(floats);
+    lwm2m_free(texts);
+    lwm2m_free(lengths);
+}
@@ -0,0 +1,1011 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2015 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - initial API and implementation
+ *
+ *******************************************************************************/
+
+#include "internals.h"
+#include "benchmark.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_OBSERVE_OBJECT_ID     1024
+#define BENCH_OBSERVE_RESOURCES     10
+#define BENCH_OBSERVE_CHANGES       10000
+
+// value of every resource of the test object, or an opaque value of sensorLength bytes when not 0
+static int64_t sensorValue = 0;
+static size_t sensorLength = 0;
+
+static uint8_t prv_read(uint16_t instanceId,
+                        int * numDataP,
+                        lwm2m_data_t ** dataArrayP,
+                        lwm2m_object_t * objectP)
+{
+    int i;
+
+    if (0 == *numDataP)
+    {
+        *dataArrayP = lwm2m_data_new(BENCH_OBSERVE_RESOURCES);
+        if (NULL == *dataArrayP) return COAP_500_INTERNAL_SERVER_ERROR;
+        *numDataP = BENCH_OBSERVE_RESOURCES;
+        for (i = 0 ; i < BENCH_OBSERVE_RESOURCES ; i++)
+        {
+            (*dataArrayP)[i].type = LWM2M_TYPE_RESOURCE;
+            (*dataArrayP)[i].id = (uint16_t)i;
+        }
+    }
+
+    for (i = 0 ; i < *numDataP ; i++)
+    {
+        if ((*dataArrayP)[i].id >= BENCH_OBSERVE_RESOURCES) return COAP_404_NOT_FOUND;
+        if (0 != sensorLength)
+        {
+            (*dataArrayP)[i].value = (uint8_t *)lwm2m_malloc(sensorLength);
+            if (NULL == (*dataArrayP)[i].value) return COAP_500_INTERNAL_SERVER_ERROR;
+            memset((*dataArrayP)[i].value, 'x', sensorLength);
+            (*dataArrayP)[i].length = sensorLength;
+        }
+        else
+        {
+            lwm2m_data_encode_int(sensorValue, (*dataArrayP) + i);
+        }
+    }
+
+    return COAP_205_CONTENT;
+}
+
+// Sends a request from the server to the client, as an Observe when query is NULL and a Write-Attributes otherwise.
+// A resourceId of LWM2M_MAX_ID targets the instance.
+static void prv_request(lwm2m_context_t * contextP,
+                        void * sessionH,
+                        uint16_t instanceId,
+                        uint16_t resourceId,
+                        const char * query,
+                        uint16_t mid)
+{
+    coap_packet_t message[1];
+    uint8_t buffer[COAP_MAX_HEADER_SIZE + 64];
+    uint8_t token[2];
+    char path[32];
+    size_t length;
+
+    token[0] = (uint8_t)(mid >> 8);
+    token[1] = (uint8_t)mid;
+    if (LWM2M_MAX_ID == resourceId)
+    {
+        snprintf(path, sizeof(path), "/%d/%hu", BENCH_OBSERVE_OBJECT_ID, instanceId);
+    }
+    else
+    {
+        snprintf(path, sizeof(path), "/%d/%hu/%hu", BENCH_OBSERVE_OBJECT_ID, instanceId, resourceId);
+    }
+    if (NULL == query)
+    {
+        coap_init_message(message, COAP_TYPE_CON, COAP_GET, mid);
+        coap_set_header_observe(message, 0);
+    }
+    else
+    {
+        coap_init_message(message, COAP_TYPE_CON, COAP_PUT, mid);
+        coap_set_header_uri_query(message, query);
+    }
+    coap_set_header_uri_path(message, path);
+    coap_set_header_token(message, token, sizeof(token));
+    length = coap_serialize_message(message, buffer);
+
+    lwm2m_handle_packet(contextP, buffer, length, sessionH);
+}
+
+// Returns a client context holding the test object, registered to servers connected on sessions 1 to serverCount.
+static lwm2m_context_t * prv_clientNew(lwm2m_object_t * objectP,
+                                       lwm2m_list_t * instances,
+                                       int instanceCount,
+                                       int serverCount)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_server_t * serverP;
+    int i;
+
+    contextP = bench_server_new();
+
+    for (i = 0 ; i < instanceCount ; i++)
+    {
+        instances[i].id = (uint16_t)i;
+        instances[i].next = (i + 1 < instanceCount) ? instances + i + 1 : NULL;
+    }
+    memset(objectP, 0, sizeof(lwm2m_object_t));
+    objectP->objID = BENCH_OBSERVE_OBJECT_ID;
+    objectP->instanceList = instances;
+    objectP->readFunc = prv_read;
+
+    contextP->objectList = (lwm2m_object_t **)lwm2m_malloc(sizeof(lwm2m_object_t *));
+    contextP->objectList[0] = objectP;
+    contextP->numObject = 1;
+
+    for (i = serverCount ; i > 0 ; i--)
+    {
+        serverP = (lwm2m_server_t *)lwm2m_malloc(sizeof(lwm2m_server_t));
+        memset(serverP, 0, sizeof(lwm2m_server_t));
+        serverP->shortID = (uint16_t)i;
+        serverP->sessionH = (void *)(intptr_t)i;
+        serverP->status = STATE_REGISTERED;
+        serverP->lifetime = 86400;
+        serverP->registration = bench_time;
+        serverP->next = contextP->serverList;
+        contextP->serverList = serverP;
+    }
+
+    return contextP;
+}
+
+/*
+ * Cost of lwm2m_resource_value_changed() and of the notification sent by the next lwm2m_step()
+ * on the client side as the number of observed resources grows. Every resource of the test
+ * object is observed by the same server.
+ */
+
+static void prv_fanout(int observedCount)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_object_t object;
+    lwm2m_list_t * instances;
+    lwm2m_uri_t uri;
+    unsigned long allocations;
+    unsigned long sent;
+    uint64_t start;
+    uint64_t elapsed;
+    int instanceCount;
+    int i;
+
+    instanceCount = observedCount / BENCH_OBSERVE_RESOURCES;
+    instances = (lwm2m_list_t *)calloc(instanceCount, sizeof(lwm2m_list_t));
+    contextP = prv_clientNew(&object, instances, instanceCount, 1);
+
+    for (i = 0 ; i < observedCount ; i++)
+    {
+        prv_request(contextP, (void *)1, (uint16_t)(i / BENCH_OBSERVE_RESOURCES), (uint16_t)(i % BENCH_OBSERVE_RESOURCES), NULL, (uint16_t)i);
+    }
+
+    // the changed resources are spread over the whole object
+    memset(&uri, 0, sizeof(lwm2m_uri_t));
+    uri.flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID | LWM2M_URI_FLAG_RESOURCE_ID;
+    uri.objectId = BENCH_OBSERVE_OBJECT_ID;
+    bench_sent = 0;
+    bench_allocations = 0;
+    elapsed = 0;
+    for (i = 0 ; i < BENCH_OBSERVE_CHANGES ; i++)
+    {
+        int index = (int)(((uint64_t)i * 7919) % observedCount);
+        int64_t timeout = 60000;
+
+        uri.instanceId = (uint16_t)(index / BENCH_OBSERVE_RESOURCES);
+        uri.resourceId = (uint16_t)(index % BENCH_OBSERVE_RESOURCES);
+        start = bench_clock();
+        lwm2m_resource_value_changed(contextP, &uri);
+        lwm2m_step(contextP, &timeout);
+        elapsed += bench_clock() - start;
+    }
+    sent = bench_sent;
+    allocations = bench_allocations;
+
+    printf("  %6d observed: %8.0f ns/change, %.2f notifications/change, %.2f allocations/change\r\n",
+           observedCount,
+           (double)elapsed / BENCH_OBSERVE_CHANGES,
+           (double)sent / BENCH_OBSERVE_CHANGES,
+           (double)allocations / BENCH_OBSERVE_CHANGES);
+    if ((size_t)observedCount != contextP->observedCount) printf("  error: %d observe requests failed\r\n", observedCount - (int)contextP->observedCount);
+
+    lwm2m_close(contextP);
+    free(instances);
+}
+
+void bench_observe_fanout(void)
+{
+    prv_fanout(100);
+    prv_fanout(1000);
+    prv_fanout(10000);
+}
+
+/*
+ * Notifications sent for a sensor resource changing every 100 ms during 10 minutes, depending
+ * on the notification attributes written by the server. The value follows a random walk.
+ */
+
+#define BENCH_SENSOR_PERIOD     100         // ms
+#define BENCH_SENSOR_DURATION   600000      // ms
+
+static void prv_attributes(const char * query)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_object_t object;
+    lwm2m_list_t instance;
+    lwm2m_uri_t uri;
+    unsigned long sent;
+    int64_t end;
+
+    contextP = prv_clientNew(&object, &instance, 1, 1);
+    srand(1);
+    sensorValue = 0;
+
+    prv_request(contextP, (void *)1, 0, 0, NULL, 1);
+    if (NULL != query) prv_request(contextP, (void *)1, 0, 0, query, 2);
+
+    memset(&uri, 0, sizeof(lwm2m_uri_t));
+    uri.flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID | LWM2M_URI_FLAG_RESOURCE_ID;
+    uri.objectId = BENCH_OBSERVE_OBJECT_ID;
+
+    sent = bench_sent;
+    end = bench_time + BENCH_SENSOR_DURATION;
+    while (bench_time < end)
+    {
+        int64_t timeout = 60000;
+
+        bench_time += BENCH_SENSOR_PERIOD;
+        sensorValue += rand() % 3 - 1;
+        lwm2m_resource_value_changed(contextP, &uri);
+        lwm2m_step(contextP, &timeout);
+    }
+
+    printf("  %-20s %5lu notifications\r\n", NULL == query ? "no attributes" : query, bench_sent - sent);
+
+    lwm2m_close(contextP);
+}
+
+void bench_observe_attributes(void)
+{
+    prv_attributes(NULL);
+    prv_attributes("pmin=1");
+    prv_attributes("pmin=10");
+    prv_attributes("pmin=10&pmax=60");
+    prv_attributes("st=5");
+    prv_attributes("pmin=60&pmax=300");
+    // same as no attributes: no maximum period
+    prv_attributes("pmax=0");
+}
+
+/*
+ * Cost of the notifications of one resource observed by a growing number of servers.
+ */
+
+static void prv_watchers(int serverCount,
+                         size_t payloadLength)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_object_t object;
+    lwm2m_list_t instance;
+    lwm2m_uri_t uri;
+    unsigned long sent;
+    uint64_t start;
+    uint64_t elapsed;
+    int changes;
+    int i;
+
+    contextP = prv_clientNew(&object, &instance, 1, serverCount);
+    for (i = 1 ; i <= serverCount ; i++)
+    {
+        prv_request(contextP, (void *)(intptr_t)i, 0, 0, NULL, (uint16_t)i);
+    }
+
+    memset(&uri, 0, sizeof(lwm2m_uri_t));
+    uri.flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID | LWM2M_URI_FLAG_RESOURCE_ID;
+    uri.objectId = BENCH_OBSERVE_OBJECT_ID;
+
+    sensorLength = payloadLength;
+    changes = BENCH_OBSERVE_CHANGES * 10 / serverCount;
+    sent = bench_sent;
+    start = bench_clock();
+    for (i = 0 ; i < changes ; i++)
+    {
+        int64_t timeout = 60000;
+
+        lwm2m_resource_value_changed(contextP, &uri);
+        lwm2m_step(contextP, &timeout);
+    }
+    elapsed = bench_clock() - start;
+    sent = bench_sent - sent;
+    sensorLength = 0;
+
+    printf("  %4d servers, %4d B payload: %8.0f ns/change, %6.0f ns/notification\r\n",
+           serverCount, (int)payloadLength,
+           (double)elapsed / changes,
+           (double)elapsed / sent);
+
+    lwm2m_close(contextP);
+}
+
+void bench_observe_watchers(void)
+{
+    prv_watchers(1, 0);
+    prv_watchers(10, 0);
+    prv_watchers(100, 0);
+    prv_watchers(100, 512);
+}
+
+/*
+ * Notifications of the sensor resource sent every 10th as confirmable, when the server acknowledges
+ * them after a growing delay. The confirmable notifications in flight stay bounded by one, the
+ * changes occurring meanwhile being coalesced.
+ */
+
+static uint16_t conMid;
+static int64_t conTime;
+static unsigned long conSent;
+
+static void prv_conHook(void * sessionH,
+                        uint8_t * buffer,
+                        size_t length)
+{
+    coap_packet_t message[1];
+
+    (void)sessionH;
+    if (COAP_NO_ERROR != coap_parse_message(message, buffer, (uint16_t)length)) return;
+    if (COAP_TYPE_CON != message->type) return;
+
+    // the retransmissions do not restart the acknowledgement delay
+    if (0 == conTime || conMid != message->mid)
+    {
+        conMid = message->mid;
+        conTime = bench_time;
+        conSent++;
+    }
+}
+
+static void prv_confirmable(int64_t ackDelay)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_object_t object;
+    lwm2m_list_t instance;
+    lwm2m_uri_t uri;
+    unsigned long sent;
+    size_t maxTransactions;
+    int64_t end;
+    int64_t cancelTime;
+
+    contextP = prv_clientNew(&object, &instance, 1, 1);
+    lwm2m_set_notification_confirmable(contextP, 10, 0);
+    sensorValue = 0;
+    prv_request(contextP, (void *)1, 0, 0, NULL, 1);
+
+    memset(&uri, 0, sizeof(lwm2m_uri_t));
+    uri.flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID | LWM2M_URI_FLAG_RESOURCE_ID;
+    uri.objectId = BENCH_OBSERVE_OBJECT_ID;
+
+    conTime = 0;
+    conSent = 0;
+    maxTransactions = 0;
+    cancelTime = 0;
+    bench_send_hook = prv_conHook;
+    sent = bench_sent;
+    end = bench_time + BENCH_SENSOR_DURATION;
+    while (bench_time < end)
+    {
+        int64_t timeout = 60000;
+
+        bench_time += BENCH_SENSOR_PERIOD;
+        sensorValue++;
+        lwm2m_resource_value_changed(contextP, &uri);
+        if (0 != conTime && 0 <= ackDelay && bench_time >= conTime + ackDelay)
+        {
+            coap_packet_t message[1];
+            uint8_t buffer[COAP_HEADER_LEN];
+            size_t length;
+
+            coap_init_message(message, COAP_TYPE_ACK, 0, conMid);
+            length = coap_serialize_message(message, buffer);
+            conTime = 0;
+            lwm2m_handle_packet(contextP, buffer, length, (void *)1);
+        }
+        lwm2m_step(contextP, &timeout);
+        if (contextP->transactionCount > maxTransactions) maxTransactions = contextP->transactionCount;
+
+        if (0 == cancelTime && 0 == contextP->observedCount) cancelTime = bench_time - (end - BENCH_SENSOR_DURATION);
+    }
+    bench_send_hook = NULL;
+
+    if (0 <= ackDelay)
+    {
+        printf("  ack after %5d ms: ", (int)ackDelay);
+    }
+    else
+    {
+        printf("  no ack:            ");
+    }
+    printf("%5lu datagrams, %4lu confirmable, %lu in flight at most", bench_sent - sent, conSent, (unsigned long)maxTransactions);
+    if (0 != cancelTime) printf(", cancelled after %d s", (int)(cancelTime / 1000));
+    printf("\r\n");
+
+    lwm2m_close(contextP);
+}
+
+void bench_observe_confirmable(void)
+{
+    prv_confirmable(0);
+    prv_confirmable(1000);
+    prv_confirmable(10000);
+    prv_confirmable(-1);
+}
+
+/*
+ * Cost of a notification received by the server, depending on the number of observations of each
+ * client, and share of the notifications given to the application when the network reorders them.
+ * The application decodes the values, one notification at a time or by batches.
+ */
+
+#define BENCH_NOTIFY_OBSERVATIONS   10000
+#define BENCH_NOTIFY_COUNT          100000
+
+static uint8_t (*notifyTokens)[4];
+static int notifyTokenCount;
+static unsigned long notifyCallbacks;
+static int64_t notifySum;
+
+static void prv_notifyCallback(uint16_t clientID,
+                               lwm2m_uri_t * uriP,
+                               int count,
+                               lwm2m_media_type_t format,
+                               uint8_t * data,
+                               int dataLength,
+                               void * userData)
+{
+    lwm2m_data_t * dataP;
+    int64_t value;
+    int size;
+
+    notifyCallbacks++;
+    size = lwm2m_data_parse(data, dataLength, format, &dataP);
+    if (1 == size && 1 == lwm2m_opaqueToInt(dataP->value, dataP->length, &value)) notifySum += value;
+    lwm2m_data_free(size, dataP);
+}
+
+static void prv_notifyBatchCallback(lwm2m_notification_t * notifications,
+                                    size_t count,
+                                    void * userData)
+{
+    size_t i;
+
+    for (i = 0 ; i < count ; i++)
+    {
+        int64_t value;
+
+        notifyCallbacks++;
+        if (1 == notifications[i].size
+         && 1 == lwm2m_opaqueToInt(notifications[i].dataP->value, notifications[i].dataP->length, &value))
+        {
+            notifySum += value;
+        }
+    }
+}
+
+static void prv_notify(int clientCount,
+                       int reorderPercent,
+                       size_t batchCount)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_observation_t * observationP;
+    lwm2m_uri_t uri;
+    coap_packet_t message[1];
+    uint8_t buffer[COAP_MAX_HEADER_SIZE + 16];
+    uint8_t payload[16];
+    uint32_t * counters;
+    uint64_t start;
+    uint64_t elapsed;
+    int perClient;
+    int i;
+
+    contextP = bench_server_new();
+    notifyTokens = (uint8_t (*)[4])malloc(BENCH_NOTIFY_OBSERVATIONS * 4);
+    counters = (uint32_t *)calloc(BENCH_NOTIFY_OBSERVATIONS, sizeof(uint32_t));
+    notifyTokenCount = 0;
+
+    perClient = BENCH_NOTIFY_OBSERVATIONS / clientCount;
+    memset(&uri, 0, sizeof(lwm2m_uri_t));
+    uri.flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID | LWM2M_URI_FLAG_RESOURCE_ID;
+    uri.objectId = 3;
+    for (i = 0 ; i < clientCount ; i++)
+    {
+        char name[16];
+        int clientID;
+        int j;
+
+        snprintf(name, sizeof(name), "notify%d", i);
+        clientID = bench_register_client(contextP, (void *)(intptr_t)(i + 1), name);
+        for (j = 0 ; j < perClient ; j++)
+        {
+            uri.resourceId = (uint16_t)j;
+            lwm2m_observe(contextP, (uint16_t)clientID, &uri, prv_notifyCallback, NULL);
+        }
+
+        // the token of an observation holds the internal IDs of the client and of the observation
+        for (observationP = registration_find_client(contextP, (uint16_t)clientID)->observationList ; observationP != NULL ; observationP = observationP->next)
+        {
+            notifyTokens[notifyTokenCount][0] = (uint8_t)(clientID >> 8);
+            notifyTokens[notifyTokenCount][1] = (uint8_t)clientID;
+            notifyTokens[notifyTokenCount][2] = (uint8_t)(observationP->id >> 8);
+            notifyTokens[notifyTokenCount][3] = (uint8_t)observationP->id;
+            notifyTokenCount++;
+        }
+    }
+
+    if (0 != batchCount) lwm2m_set_notification_batch(contextP, batchCount, 1000, prv_notifyBatchCallback, NULL);
+
+    srand(1);
+    notifyCallbacks = 0;
+    notifySum = 0;
+    bench_allocations = 0;
+    elapsed = 0;
+    for (i = 0 ; i < BENCH_NOTIFY_COUNT ; i++)
+    {
+        int index = (int)(((uint64_t)i * 7919) % notifyTokenCount);
+        uint32_t count;
+        size_t length;
+
+        // a reordered notification is older than the last one received
+        counters[index] += 2;
+        count = counters[index];
+        if (rand() % 100 < reorderPercent) count -= 3;
+
+        coap_init_message(message, COAP_TYPE_NON, COAP_205_CONTENT, (uint16_t)i);
+        coap_set_header_token(message, notifyTokens[index], 4);
+        coap_set_header_observe(message, count);
+        coap_set_header_content_type(message, LWM2M_CONTENT_TLV);
+        coap_set_payload(message, payload, lwm2m_intToTLV(LWM2M_TYPE_RESOURCE, count, (uint16_t)(index % perClient), payload, sizeof(payload)));
+        length = coap_serialize_message(message, buffer);
+
+        start = bench_clock();
+        lwm2m_handle_packet(contextP, buffer, length, (void *)(intptr_t)(index / perClient + 1));
+        elapsed += bench_clock() - start;
+    }
+    start = bench_clock();
+    lwm2m_set_notification_batch(contextP, 0, 0, NULL, NULL);
+    elapsed += bench_clock() - start;
+
+    printf("  %5d clients, %5d observations each, %2d%% reordered, ", clientCount, perClient, reorderPercent);
+    if (0 != batchCount) printf("batches of %4d: ", (int)batchCount);
+    else printf("no batch:        ");
+    printf("%6.0f ns/notification, %5.2f allocations/notification, %5.1f%% delivered\r\n",
+           (double)elapsed / BENCH_NOTIFY_COUNT,
+           (double)bench_allocations / BENCH_NOTIFY_COUNT,
+           100.0 * notifyCallbacks / BENCH_NOTIFY_COUNT);
+
+    free(counters);
+    free(notifyTokens);
+    lwm2m_close(contextP);
+}
+
+void bench_observe_notify(void)
+{
+    prv_notify(1000, 0, 0);
+    prv_notify(100, 0, 0);
+    prv_notify(10, 0, 0);
+    prv_notify(10, 10, 0);
+    prv_notify(10, 0, 64);
+    prv_notify(10, 0, 1024);
+}
+
+/*
+ * Observation snapshot: size of the snapshot of a server, time to save it and to restore it in a
+ * new server, and share of the notifications the new server accepts without any exchange with
+ * the clients.
+ */
+
+#define BENCH_SNAPSHOT_OBSERVATIONS 10
+
+static size_t prv_sessionSave(void * sessionH,
+                              uint8_t * buffer,
+                              size_t length,
+                              void * userData)
+{
+    uint32_t session = (uint32_t)(intptr_t)sessionH;
+
+    if (length < sizeof(session)) return 0;
+    memcpy(buffer, &session, sizeof(session));
+
+    return sizeof(session);
+}
+
+static void * prv_sessionLoad(const uint8_t * buffer,
+                              size_t length,
+                              void * userData)
+{
+    uint32_t session;
+
+    if (length != sizeof(session)) return NULL;
+    memcpy(&session, buffer, sizeof(session));
+
+    return (void *)(intptr_t)session;
+}
+
+static void prv_sendNotification(lwm2m_context_t * contextP,
+                                 lwm2m_client_t * clientP,
+                                 lwm2m_observation_t * observationP,
+                                 uint32_t count)
+{
+    coap_packet_t message[1];
+    uint8_t buffer[COAP_MAX_HEADER_SIZE + 16];
+    uint8_t payload[16];
+    size_t length;
+
+    coap_init_message(message, COAP_TYPE_NON, COAP_205_CONTENT, (uint16_t)count);
+    coap_set_header_token(message, observationP->token, observationP->tokenLen);
+    coap_set_header_observe(message, count);
+    coap_set_header_content_type(message, LWM2M_CONTENT_TLV);
+    coap_set_payload(message, payload, lwm2m_intToTLV(LWM2M_TYPE_RESOURCE, count, observationP->uri.resourceId, payload, sizeof(payload)));
+    length = coap_serialize_message(message, buffer);
+    lwm2m_handle_packet(contextP, buffer, length, clientP->sessionH);
+}
+
+static void prv_snapshot(int clientCount)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_client_t * clientP;
+    lwm2m_observation_t * observationP;
+    lwm2m_uri_t uri;
+    uint8_t * buffer;
+    size_t length;
+    uint64_t saveTime;
+    uint64_t restoreTime;
+    unsigned long observationCount;
+    int result;
+    int i;
+
+    contextP = bench_server_new();
+    memset(&uri, 0, sizeof(lwm2m_uri_t));
+    uri.flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID | LWM2M_URI_FLAG_RESOURCE_ID;
+    uri.objectId = 3;
+    for (i = 0 ; i < clientCount ; i++)
+    {
+        char name[16];
+        int clientID;
+        int j;
+
+        snprintf(name, sizeof(name), "snapshot%d", i);
+        clientID = bench_register_client(contextP, (void *)(intptr_t)(i + 1), name);
+        for (j = 0 ; j < BENCH_SNAPSHOT_OBSERVATIONS ; j++)
+        {
+            uri.resourceId = (uint16_t)j;
+            lwm2m_observe(contextP, (uint16_t)clientID, &uri, prv_notifyCallback, NULL);
+        }
+    }
+    // the first notifications acknowledge the observations
+    for (clientP = contextP->clientList ; clientP != NULL ; clientP = clientP->next)
+    {
+        for (observationP = clientP->observationList ; observationP != NULL ; observationP = observationP->next)
+        {
+            prv_sendNotification(contextP, clientP, observationP, 1);
+        }
+    }
+
+    saveTime = bench_clock();
+    length = lwm2m_snapshot_save(contextP, NULL, 0, prv_sessionSave, NULL);
+    buffer = (uint8_t *)malloc(length);
+    length = lwm2m_snapshot_save(contextP, buffer, length, prv_sessionSave, NULL);
+    saveTime = bench_clock() - saveTime;
+    lwm2m_close(contextP);
+
+    bench_time += 60000;
+    contextP = bench_server_new();
+    bench_allocations = 0;
+    restoreTime = bench_clock();
+    result = lwm2m_snapshot_restore(contextP, buffer, length, prv_sessionLoad, NULL, prv_notifyCallback, NULL);
+    restoreTime = bench_clock() - restoreTime;
+    free(buffer);
+
+    notifyCallbacks = 0;
+    observationCount = 0;
+    bench_sent = 0;
+    for (clientP = contextP->clientList ; clientP != NULL ; clientP = clientP->next)
+    {
+        for (observationP = clientP->observationList ; observationP != NULL ; observationP = observationP->next)
+        {
+            prv_sendNotification(contextP, clientP, observationP, 2);
+            observationCount++;
+        }
+    }
+
+    printf("  %6d clients, %2d observations each: %8d bytes, save %7.2f ms, restore %7.2f ms (%5.1f allocations/client, result 0x%02X), %5.1f%% notifications accepted, %lu packets sent\r\n",
+           clientCount, BENCH_SNAPSHOT_OBSERVATIONS, (int)length,
+           (double)saveTime / 1000000, (double)restoreTime / 1000000,
+           (double)bench_allocations / clientCount, result,
+           100.0 * notifyCallbacks / (clientCount * BENCH_SNAPSHOT_OBSERVATIONS),
+           bench_sent);
+
+    lwm2m_close(contextP);
+}
+
+void bench_observe_snapshot(void)
+{
+    prv_snapshot(1000);
+    prv_snapshot(10000);
+}
+
+/*
+ * Notifications per second sent by the update loops of the test client: every second, the
+ * device instance updates its battery level, free memory and current time, and the location
+ * instance its latitude, longitude, altitude and timestamp, the timestamp being reported twice.
+ * The server observes both instances, or every changed resource.
+ */
+
+#define BENCH_COALESCE_DURATION 600     // s
+
+static const uint16_t deviceResources[] = { 9, 10, 13 };
+static const uint16_t locationResources[] = { 0, 1, 2, 5, 5 };
+
+static void prv_coalesce(bool observeResources)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_object_t object;
+    lwm2m_list_t instances[2];
+    lwm2m_uri_t uri;
+    unsigned long sent;
+    int i;
+
+    contextP = prv_clientNew(&object, instances, 2, 1);
+    if (observeResources)
+    {
+        for (i = 0 ; i < (int)(sizeof(deviceResources) / sizeof(uint16_t)) ; i++)
+        {
+            prv_request(contextP, (void *)1, 0, deviceResources[i], NULL, (uint16_t)i);
+        }
+        for (i = 0 ; i < (int)(sizeof(locationResources) / sizeof(uint16_t)) ; i++)
+        {
+            prv_request(contextP, (void *)1, 1, locationResources[i], NULL, (uint16_t)(10 + i));
+        }
+    }
+    else
+    {
+        prv_request(contextP, (void *)1, 0, LWM2M_MAX_ID, NULL, 1);
+        prv_request(contextP, (void *)1, 1, LWM2M_MAX_ID, NULL, 2);
+    }
+
+    memset(&uri, 0, sizeof(lwm2m_uri_t));
+    uri.flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID | LWM2M_URI_FLAG_RESOURCE_ID;
+    uri.objectId = BENCH_OBSERVE_OBJECT_ID;
+    sent = bench_sent;
+    for (i = 0 ; i < BENCH_COALESCE_DURATION ; i++)
+    {
+        int64_t timeout = 60000;
+        size_t j;
+
+        bench_time += 1000;
+        sensorValue++;
+        uri.instanceId = 0;
+        for (j = 0 ; j < sizeof(deviceResources) / sizeof(uint16_t) ; j++)
+        {
+            uri.resourceId = deviceResources[j];
+            lwm2m_resource_value_changed(contextP, &uri);
+        }
+        uri.instanceId = 1;
+        for (j = 0 ; j < sizeof(locationResources) / sizeof(uint16_t) ; j++)
+        {
+            uri.resourceId = locationResources[j];
+            lwm2m_resource_value_changed(contextP, &uri);
+        }
+        lwm2m_step(contextP, &timeout);
+    }
+
+    printf("  %-22s %5.2f notifications/s\r\n",
+           observeResources ? "resources observed:" : "instances observed:",
+           (double)(bench_sent - sent) / BENCH_COALESCE_DURATION);
+
+    lwm2m_close(contextP);
+}
+
+void bench_observe_coalesce(void)
+{
+    prv_coalesce(false);
+    prv_coalesce(true);
+}
+
+/*
+ * Cost of the cancellation of the observations by the server, one by one, either by a Reset
+ * answering their last notification or by a GET with Observe=1 carrying their token.
+ */
+
+static uint16_t * cancelMids;
+static int cancelMidCount;
+
+static void prv_cancelHook(void * sessionH,
+                           uint8_t * buffer,
+                           size_t length)
+{
+    cancelMids[cancelMidCount++] = (uint16_t)((buffer[2] << 8) | buffer[3]);
+}
+
+static void prv_cancel(int observedCount,
+                       bool reset)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_object_t object;
+    lwm2m_list_t * instances;
+    lwm2m_uri_t uri;
+    uint64_t start;
+    uint64_t elapsed;
+    int64_t timeout = 60000;
+    int i;
+
+    instances = (lwm2m_list_t *)calloc(observedCount / BENCH_OBSERVE_RESOURCES, sizeof(lwm2m_list_t));
+    cancelMids = (uint16_t *)malloc(observedCount * sizeof(uint16_t));
+    contextP = prv_clientNew(&object, instances, observedCount / BENCH_OBSERVE_RESOURCES, 1);
+    for (i = 0 ; i < observedCount ; i++)
+    {
+        prv_request(contextP, (void *)1, (uint16_t)(i / BENCH_OBSERVE_RESOURCES), (uint16_t)(i % BENCH_OBSERVE_RESOURCES), NULL, (uint16_t)i);
+    }
+
+    // every observation sends a notification, whose message ID is kept for the Reset
+    memset(&uri, 0, sizeof(lwm2m_uri_t));
+    uri.flag = LWM2M_URI_FLAG_OBJECT_ID;
+    uri.objectId = BENCH_OBSERVE_OBJECT_ID;
+    cancelMidCount = 0;
+    bench_send_hook = prv_cancelHook;
+    lwm2m_resource_value_changed(contextP, &uri);
+    lwm2m_step(contextP, &timeout);
+    bench_send_hook = NULL;
+
+    elapsed = 0;
+    for (i = 0 ; i < cancelMidCount ; i++)
+    {
+        coap_packet_t message[1];
+        uint8_t buffer[COAP_MAX_HEADER_SIZE + 32];
+        size_t length;
+
+        if (reset)
+        {
+            coap_init_message(message, COAP_TYPE_RST, 0, cancelMids[i]);
+            length = coap_serialize_message(message, buffer);
+        }
+        else
+        {
+            uint8_t token[2];
+            char path[32];
+
+            token[0] = (uint8_t)(i >> 8);
+            token[1] = (uint8_t)i;
+            snprintf(path, sizeof(path), "/%d/%d/%d", BENCH_OBSERVE_OBJECT_ID, i / BENCH_OBSERVE_RESOURCES, i % BENCH_OBSERVE_RESOURCES);
+            coap_init_message(message, COAP_TYPE_CON, COAP_GET, (uint16_t)(observedCount + i));
+            coap_set_header_observe(message, 1);
+            coap_set_header_uri_path(message, path);
+            coap_set_header_token(message, token, sizeof(token));
+            length = coap_serialize_message(message, buffer);
+        }
+
+        start = bench_clock();
+        lwm2m_handle_packet(contextP, buffer, length, (void *)1);
+        elapsed += bench_clock() - start;
+    }
+
+    printf("  %6d observed, %-19s %8.0f ns/cancellation, %d left\r\n",
+           observedCount, reset ? "Reset:" : "GET with Observe=1:",
+           (double)elapsed / cancelMidCount, (int)contextP->observedCount);
+
+    lwm2m_close(contextP);
+    free(cancelMids);
+    free(instances);
+}
+
+void bench_observe_cancel(void)
+{
+    prv_cancel(1000, true);
+    prv_cancel(10000, true);
+    prv_cancel(1000, false);
+    prv_cancel(10000, false);
+}
+
+/*
+ * Datagrams and radio wake-ups of a client in queue mode during one hour: the sensor resource
+ * changes every 10 s and the registration is updated every 285 s. A wake-up is a second in which
+ * the client sends something.
+ */
+
+#define BENCH_QUEUE_PERIOD      10000       // ms
+#define BENCH_QUEUE_DURATION    3600000     // ms
+
+static coap_packet_t queueUpdate[1];
+static bool queueUpdatePending;
+static int64_t queueLastSecond;
+static unsigned long queueWakeUps;
+static unsigned long queueNotifications;
+
+static void prv_queueHook(void * sessionH,
+                          uint8_t * buffer,
+                          size_t length)
+{
+    coap_packet_t message[1];
+
+    if (bench_time / 1000 != queueLastSecond)
+    {
+        queueLastSecond = bench_time / 1000;
+        queueWakeUps++;
+    }
+    if (0 != coap_parse_message(message, buffer, (uint16_t)length)) return;
+    if (COAP_POST == message->code)
+    {
+        memcpy(queueUpdate, message, sizeof(coap_packet_t));
+        queueUpdatePending = true;
+    }
+    else
+    {
+        queueNotifications++;
+    }
+}
+
+static void prv_queue(lwm2m_binding_t binding,
+                      size_t depth,
+                      lwm2m_queue_policy_t policy)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_object_t object;
+    lwm2m_list_t instance;
+    lwm2m_uri_t uri;
+    unsigned long sent;
+    int64_t end;
+
+    contextP = prv_clientNew(&object, &instance, 1, 1);
+    contextP->serverList->binding = binding;
+    contextP->serverList->lifetime = 300;
+    contextP->serverList->location = lwm2m_strdup("/rd/0");
+    lwm2m_set_notification_queue(contextP, depth, policy);
+    prv_request(contextP, (void *)1, 0, 0, NULL, 1);
+
+    memset(&uri, 0, sizeof(lwm2m_uri_t));
+    uri.flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID | LWM2M_URI_FLAG_RESOURCE_ID;
+    uri.objectId = BENCH_OBSERVE_OBJECT_ID;
+
+    queueLastSecond = -1;
+    queueWakeUps = 0;
+    queueNotifications = 0;
+    queueUpdatePending = false;
+    bench_send_hook = prv_queueHook;
+    sent = bench_sent;
+    end = bench_time + BENCH_QUEUE_DURATION;
+    while (bench_time < end)
+    {
+        int64_t timeout = 60000;
+
+        bench_time += BENCH_QUEUE_PERIOD;
+        sensorValue++;
+        lwm2m_resource_value_changed(contextP, &uri);
+        lwm2m_step(contextP, &timeout);
+        if (queueUpdatePending)
+        {
+            coap_packet_t message[1];
+            uint8_t buffer[COAP_MAX_HEADER_SIZE];
+            size_t length;
+
+            queueUpdatePending = false;
+            coap_init_message(message, COAP_TYPE_ACK, COAP_204_CHANGED, queueUpdate->mid);
+            coap_set_header_token(message, queueUpdate->token, queueUpdate->token_len);
+            length = coap_serialize_message(message, buffer);
+            lwm2m_handle_packet(contextP, buffer, length, (void *)1);
+        }
+    }
+    bench_send_hook = NULL;
+
+    if (BINDING_U == binding) printf("  U:                      ");
+    else if (LWM2M_QUEUE_LATEST_ONLY == policy) printf("  UQ, latest only:        ");
+    else printf("  UQ, drop oldest, %3d:   ", (int)depth);
+    printf("%4lu datagrams, %4lu notifications, %4lu wake-ups\r\n", bench_sent - sent, queueNotifications, queueWakeUps);
+
+    lwm2m_close(contextP);
+}
+
+void bench_observe_queue(void)
+{
+    prv_queue(BINDING_U, 0, LWM2M_QUEUE_LATEST_ONLY);
+    prv_queue(BINDING_UQ, 0, LWM2M_QUEUE_LATEST_ONLY);
+    prv_queue(BINDING_UQ, 8, LWM2M_QUEUE_DROP_OLDEST);
+    prv_queue(BINDING_UQ, 32, LWM2M_QUEUE_DROP_OLDEST);
+}
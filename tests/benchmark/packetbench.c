@@ -0,0 +1,98 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2015 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - initial API and implementation
+ *
+ *******************************************************************************/
+
+#include "internals.h"
+#include "benchmark.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#define BENCH_PACKETS   100000
+
+static size_t prv_request(coap_method_t method,
+                          const char * path,
+                          const char * query,
+                          uint8_t * buffer)
+{
+    coap_packet_t message[1];
+    uint8_t token[4] = {1, 2, 3, 4};
+
+    coap_init_message(message, COAP_TYPE_CON, method, 0);
+    coap_set_header_token(message, token, sizeof(token));
+    coap_set_header_uri_path(message, path);
+    if (NULL != query)
+    {
+        coap_set_header_uri_query(message, query);
+    }
+
+    return coap_serialize_message(message, buffer);
+}
+
+static void prv_receive(lwm2m_context_t * contextP,
+                        const char * name,
+                        uint8_t * buffer,
+                        size_t length)
+{
+    unsigned long allocations;
+    uint64_t start;
+    uint64_t duration;
+    int i;
+
+    allocations = bench_allocations;
+    start = bench_clock();
+    for (i = 0; i < BENCH_PACKETS; i++)
+    {
+        // the mID changes so that the packets are not seen as duplicates
+        buffer[2] = (uint8_t)(i >> 8);
+        buffer[3] = (uint8_t)i;
+        lwm2m_handle_packet(contextP, buffer, length, (void *)1);
+    }
+    duration = bench_clock() - start;
+    allocations = bench_allocations - allocations;
+
+    printf("  %-28s %8.1f ns/request, %.2f allocations/request\r\n",
+           name, (double)duration / BENCH_PACKETS, (double)allocations / BENCH_PACKETS);
+    if (0 != allocations) printf("  error: the receive path allocates\r\n");
+}
+
+/*
+ * Requests which do not change the state of the server must be handled without any allocation.
+ */
+void bench_packet_receive(void)
+{
+    lwm2m_context_t * contextP;
+    uint8_t buffer[COAP_MAX_PACKET_SIZE];
+    char location[16];
+    size_t length;
+    int clientID;
+
+    contextP = bench_server_new();
+    clientID = bench_register_client(contextP, (void *)1, "client");
+    snprintf(location, sizeof(location), "/"URI_REGISTRATION_SEGMENT"/%d", clientID);
+
+    length = prv_request(COAP_POST, location, NULL, buffer);
+    prv_receive(contextP, "registration update:", buffer, length);
+
+    length = prv_request(COAP_POST, location, "lt=300&b=U", buffer);
+    prv_receive(contextP, "update with parameters:", buffer, length);
+
+    length = prv_request(COAP_GET, "/3/0/0", NULL, buffer);
+    prv_receive(contextP, "request to an unknown path:", buffer, length);
+
+    lwm2m_close(contextP);
+}
@@ -0,0 +1,213 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2015 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - initial API and implementation
+ *
+ *******************************************************************************/
+
+#include "internals.h"
+#include "benchmark.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+/*
+ * Simulation of BENCH_STORM_CLIENTS clients sending their registration at the same millisecond
+ * to a server which does not answer. Each client is a lwm2m_server_t entry of a single context:
+ * the transactions do not share anything but the random generator, so this behaves as
+ * BENCH_STORM_CLIENTS separate contexts would.
+ */
+
+#define BENCH_STORM_CLIENTS 10000
+#define BENCH_STORM_SLOT    100     // ms
+#define BENCH_STORM_SLOTS   1200    // 120 s, more than MAX_TRANSMIT_WAIT
+
+static int64_t stormStart;
+static unsigned long * stormSlots;
+
+static void prv_recordSend(void * sessionH,
+                           uint8_t * buffer,
+                           size_t length)
+{
+    int64_t slot = (bench_time - stormStart) / BENCH_STORM_SLOT;
+
+    if (slot < BENCH_STORM_SLOTS) stormSlots[slot]++;
+}
+
+static void prv_storm(uint16_t ackRandomFactor)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_server_t * servers;
+    lwm2m_transaction_t * transacP;
+    unsigned long peak;
+    int used;
+    int i;
+
+    contextP = bench_server_new();
+    lwm2m_set_transmission_parameters(contextP, COAP_RESPONSE_TIMEOUT * 1000, ackRandomFactor, COAP_MAX_RETRANSMIT);
+    servers = (lwm2m_server_t *)calloc(BENCH_STORM_CLIENTS, sizeof(lwm2m_server_t));
+    stormSlots = (unsigned long *)calloc(BENCH_STORM_SLOTS, sizeof(unsigned long));
+    stormStart = bench_time;
+    bench_sent = 0;
+    bench_send_hook = prv_recordSend;
+
+    for (i = 0; i < BENCH_STORM_CLIENTS; i++)
+    {
+        char query[32];
+
+        servers[i].sessionH = (void *)(intptr_t)(i + 1);
+        transacP = transaction_new(COAP_TYPE_CON, COAP_POST, NULL, NULL, contextP->nextMID++, 4, NULL, ENDPOINT_SERVER, servers + i);
+        snprintf(query, sizeof(query), "ep=client%d", i);
+        coap_set_header_uri_path(transacP->message, "/"URI_REGISTRATION_SEGMENT);
+        coap_set_header_uri_query(transacP->message, query);
+        transaction_add(contextP, transacP);
+        transaction_send(contextP, transacP);
+    }
+
+    // jump from one deadline to the next
+    while (NULL != (transacP = (lwm2m_transaction_t *)utils_heapTop(&contextP->transactionHeap)))
+    {
+        int64_t timeout = 60000;
+
+        bench_time = transacP->retrans_time;
+        lwm2m_step(contextP, &timeout);
+    }
+    bench_send_hook = NULL;
+
+    // the first slot holds the initial transmissions
+    peak = 0;
+    used = 0;
+    for (i = 1; i < BENCH_STORM_SLOTS; i++)
+    {
+        if (stormSlots[i] > peak) peak = stormSlots[i];
+        if (0 != stormSlots[i]) used++;
+    }
+
+    printf("  ACK_RANDOM_FACTOR %d.%02d: %lu messages, retransmissions: peak %5lu per %d ms, spread over %4d slots, last timeout after %.1f s\r\n",
+           ackRandomFactor / 100, ackRandomFactor % 100,
+           bench_sent, peak, BENCH_STORM_SLOT, used,
+           (double)(bench_time - stormStart) / 1000);
+
+    lwm2m_close(contextP);
+    free(stormSlots);
+    free(servers);
+}
+
+void bench_registration_storm(void)
+{
+    // without randomization all the retransmissions of a round leave together
+    prv_storm(100);
+    prv_storm(COAP_ACK_RANDOM_FACTOR);
+}
+
+/*
+ * Cost of registrations, re-registrations after an outage, updates and lwm2m_step() as the fleet
+ * grows. The fleet then expires in a single lwm2m_step().
+ */
+
+#define BENCH_RATE_SAMPLE   1000
+
+static uint64_t prv_update(lwm2m_context_t * contextP,
+                           uint16_t clientID,
+                           uint16_t mid)
+{
+    coap_packet_t message[1];
+    uint8_t buffer[COAP_MAX_HEADER_SIZE];
+    char location[16];
+    size_t length;
+    uint64_t start;
+
+    snprintf(location, sizeof(location), "/"URI_REGISTRATION_SEGMENT"/%hu", clientID);
+    coap_init_message(message, COAP_TYPE_CON, COAP_POST, mid);
+    coap_set_header_uri_path(message, location);
+    length = coap_serialize_message(message, buffer);
+
+    start = bench_clock();
+    lwm2m_handle_packet(contextP, buffer, length, (void *)1);
+
+    return bench_clock() - start;
+}
+
+static void prv_rate(int fleetSize)
+{
+    lwm2m_context_t * contextP;
+    char name[16];
+    uint64_t start;
+    uint64_t registration;
+    uint64_t reregistration;
+    uint64_t update;
+    uint64_t step;
+    int64_t timeout;
+    int errors;
+    int i;
+
+    contextP = bench_server_new();
+    errors = 0;
+
+    // only the registrations of the last clients are timed
+    registration = 0;
+    for (i = 0; i < fleetSize; i++)
+    {
+        snprintf(name, sizeof(name), "client%d", i);
+        start = bench_clock();
+        if (bench_register_client(contextP, (void *)1, name) < 0) errors++;
+        if (i >= fleetSize - BENCH_RATE_SAMPLE) registration += bench_clock() - start;
+    }
+
+    // every client registers again, as after a network outage
+    start = bench_clock();
+    for (i = 0; i < fleetSize; i++)
+    {
+        snprintf(name, sizeof(name), "client%d", i);
+        if (bench_register_client(contextP, (void *)1, name) < 0) errors++;
+    }
+    reregistration = bench_clock() - start;
+
+    update = 0;
+    for (i = 0; i < BENCH_RATE_SAMPLE; i++)
+    {
+        update += prv_update(contextP, (uint16_t)(rand() % fleetSize), (uint16_t)i);
+    }
+
+    // no client is near the end of its lifetime
+    start = bench_clock();
+    for (i = 0; i < BENCH_RATE_SAMPLE; i++)
+    {
+        timeout = 60000;
+        lwm2m_step(contextP, &timeout);
+    }
+    step = bench_clock() - start;
+
+    printf("  %6d clients: %8.0f ns/registration, %8.0f ns/re-registration, %8.0f ns/update, %8.0f ns/step\r\n",
+           fleetSize,
+           (double)registration / BENCH_RATE_SAMPLE,
+           (double)reregistration / fleetSize,
+           (double)update / BENCH_RATE_SAMPLE,
+           (double)step / BENCH_RATE_SAMPLE);
+    if (0 != errors) printf("  error: %d registrations failed\r\n", errors);
+
+    bench_time += (int64_t)LWM2M_DEFAULT_LIFETIME * 1000;
+    timeout = 60000;
+    lwm2m_step(contextP, &timeout);
+    if (0 != contextP->clientCount) printf("  error: %d clients left after their lifetime\r\n", (int)contextP->clientCount);
+
+    lwm2m_close(contextP);
+}
+
+void bench_registration_rate(void)
+{
+    prv_rate(1000);
+    prv_rate(10000);
+    prv_rate(60000);
+}
@@ -0,0 +1,267 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2015 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - initial API and implementation
+ *
+ *******************************************************************************/
+
+/*
+ * Registration throughput of the sharded server engine over the loopback interface.
+ *
+ * Each simulated client has its own UDP socket, hence its own source port, so that the
+ * clients spread over the shards. The engine is checked by counting the registered
+ * clients through jobs submitted to every shard.
+ */
+
+#include "internals.h"
+#include "benchmark.h"
+#include "shardengine.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define BENCH_CLIENTS   256
+#define BENCH_ROUNDS    50
+#define BENCH_SHARDS    4
+#define BENCH_WAIT_MS   5000
+
+typedef struct
+{
+    int     sock;
+    char    location[16];
+} bench_client_t;
+
+static atomic_int bench_clientCount;
+static atomic_int bench_shardDone;
+
+static int prv_socket(struct sockaddr_in * addrP)
+{
+    socklen_t addrLen;
+    int sock;
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) return -1;
+
+    memset(addrP, 0, sizeof(struct sockaddr_in));
+    addrP->sin_family = AF_INET;
+    addrP->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addrLen = sizeof(struct sockaddr_in);
+    if (0 != bind(sock, (struct sockaddr *)addrP, addrLen)
+     || 0 != getsockname(sock, (struct sockaddr *)addrP, &addrLen))
+    {
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+static int prv_send(bench_client_t * clientP,
+                    uint16_t mid,
+                    const char * query)
+{
+    coap_packet_t message[1];
+    uint8_t buffer[COAP_MAX_HEADER_SIZE + 32];
+    const char * payload = "</1/0>,</3/0>";
+    size_t length;
+
+    coap_init_message(message, COAP_TYPE_CON, COAP_POST, mid);
+    coap_set_header_uri_path(message, clientP->location);
+    if (NULL != query)
+    {
+        coap_set_header_uri_query(message, query);
+        coap_set_header_content_type(message, LWM2M_CONTENT_LINK);
+        coap_set_payload(message, payload, strlen(payload));
+    }
+    length = coap_serialize_message(message, buffer);
+    if (0 == length) return -1;
+
+    return (int)send(clientP->sock, buffer, length, 0);
+}
+
+// Waits for one response per client. The first registration stores the location of the client.
+static int prv_receive(bench_client_t * clients,
+                       uint8_t expectedCode)
+{
+    struct pollfd pfd[BENCH_CLIENTS];
+    bool received[BENCH_CLIENTS];
+    int count;
+    int i;
+
+    memset(received, 0, sizeof(received));
+    count = 0;
+    while (count < BENCH_CLIENTS)
+    {
+        int nfds = 0;
+
+        for (i = 0; i < BENCH_CLIENTS; i++)
+        {
+            pfd[i].fd = received[i] ? -1 : clients[i].sock;
+            pfd[i].events = POLLIN;
+            pfd[i].revents = 0;
+        }
+        nfds = poll(pfd, BENCH_CLIENTS, BENCH_WAIT_MS);
+        if (nfds <= 0) return count;
+
+        for (i = 0; i < BENCH_CLIENTS; i++)
+        {
+            coap_packet_t message[1];
+            uint8_t buffer[COAP_MAX_PACKET_SIZE];
+            ssize_t length;
+
+            if (0 == (pfd[i].revents & POLLIN)) continue;
+
+            length = recv(clients[i].sock, buffer, sizeof(buffer), 0);
+            if (length <= 0) continue;
+            if (NO_ERROR != coap_parse_message(message, buffer, (uint16_t)length)) continue;
+            if (message->code == expectedCode)
+            {
+                if (COAP_201_CREATED == expectedCode
+                 && NULL != message->location_path
+                 && NULL != message->location_path->next)
+                {
+                    multi_option_t * idP = message->location_path->next;
+
+                    snprintf(clients[i].location, sizeof(clients[i].location), "/"URI_REGISTRATION_SEGMENT"/%.*s", idP->len, idP->data);
+                }
+                received[i] = true;
+                count++;
+            }
+            coap_free_header(message);
+        }
+    }
+
+    return count;
+}
+
+static void prv_count_clients(lwm2m_context_t * contextP,
+                              int shardIndex,
+                              void * userData)
+{
+    int * perShard = (int *)userData;
+    lwm2m_client_t * clientP;
+    int count = 0;
+
+    for (clientP = contextP->clientList; NULL != clientP; clientP = clientP->next)
+    {
+        count++;
+    }
+    perShard[shardIndex] = count;
+    atomic_fetch_add(&bench_clientCount, count);
+    atomic_fetch_add(&bench_shardDone, 1);
+}
+
+static void prv_run(int shardCount)
+{
+    bench_client_t clients[BENCH_CLIENTS];
+    int perShard[BENCH_SHARDS];
+    struct sockaddr_in serverAddr;
+    shard_engine_t * engineP;
+    uint64_t start;
+    uint64_t duration;
+    uint16_t mid;
+    int serverSock;
+    int received;
+    int round;
+    int i;
+
+    serverSock = prv_socket(&serverAddr);
+    if (serverSock < 0)
+    {
+        printf("  error: cannot open the server socket\r\n");
+        return;
+    }
+    engineP = shard_engine_new(serverSock, shardCount, NULL, NULL);
+    if (NULL == engineP)
+    {
+        printf("  error: cannot start the engine\r\n");
+        close(serverSock);
+        return;
+    }
+
+    for (i = 0; i < BENCH_CLIENTS; i++)
+    {
+        struct sockaddr_in addr;
+
+        clients[i].sock = prv_socket(&addr);
+        if (clients[i].sock < 0
+         || 0 != connect(clients[i].sock, (struct sockaddr *)&serverAddr, sizeof(serverAddr)))
+        {
+            printf("  error: cannot open the client socket %d\r\n", i);
+            goto exit;
+        }
+        strcpy(clients[i].location, "/"URI_REGISTRATION_SEGMENT);
+    }
+
+    mid = 0;
+    start = bench_clock();
+    for (i = 0; i < BENCH_CLIENTS; i++)
+    {
+        char query[32];
+
+        snprintf(query, sizeof(query), "ep=client%d", i);
+        prv_send(clients + i, mid++, query);
+    }
+    received = prv_receive(clients, COAP_201_CREATED);
+    duration = bench_clock() - start;
+    printf("  %d shard(s): %d registrations in %.2f ms\r\n", shardCount, received, duration / 1000000.0);
+    if (received != BENCH_CLIENTS) printf("  error: %d registrations were not answered\r\n", BENCH_CLIENTS - received);
+
+    start = bench_clock();
+    received = 0;
+    for (round = 0; round < BENCH_ROUNDS; round++)
+    {
+        for (i = 0; i < BENCH_CLIENTS; i++)
+        {
+            prv_send(clients + i, mid++, NULL);
+        }
+        received += prv_receive(clients, COAP_204_CHANGED);
+    }
+    duration = bench_clock() - start;
+    printf("  %d shard(s): %10.0f updates/s\r\n", shardCount, received * 1000000000.0 / duration);
+    if (received != BENCH_CLIENTS * BENCH_ROUNDS) printf("  error: %d updates were not answered\r\n", BENCH_CLIENTS * BENCH_ROUNDS - received);
+
+    atomic_store(&bench_clientCount, 0);
+    atomic_store(&bench_shardDone, 0);
+    for (i = 0; i < shardCount; i++)
+    {
+        shard_engine_submit(engineP, i, prv_count_clients, perShard);
+    }
+    while (atomic_load(&bench_shardDone) < shardCount) usleep(1000);
+
+    printf("  %d shard(s): clients per shard:", shardCount);
+    for (i = 0; i < shardCount; i++) printf(" %d", perShard[i]);
+    printf("\r\n");
+    if (atomic_load(&bench_clientCount) != BENCH_CLIENTS) printf("  error: the shards hold %d clients\r\n", atomic_load(&bench_clientCount));
+
+exit:
+    shard_engine_free(engineP);
+    close(serverSock);
+    for (i = 0; i < BENCH_CLIENTS; i++)
+    {
+        if (clients[i].sock >= 0) close(clients[i].sock);
+    }
+}
+
+void bench_shard_engine(void)
+{
+    prv_run(1);
+    prv_run(BENCH_SHARDS);
+}
@@ -0,0 +1,148 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2015 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - initial API and implementation
+ *
+ *******************************************************************************/
+
+/*
+ * Independent server contexts handling packets on their own thread.
+ *
+ * The core keeps no global state, so this benchmark must stay clean when built with
+ * ThreadSanitizer:
+ *    cmake -DCMAKE_C_FLAGS=-fsanitize=thread <path to tests/benchmark>
+ */
+
+#include "internals.h"
+#include "benchmark.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define BENCH_THREADS   8
+#define BENCH_CLIENTS   64
+#define BENCH_ROUNDS    2000
+
+typedef struct
+{
+    pthread_t   thread;
+    bool        ok;
+    uint64_t    duration;
+} bench_worker_t;
+
+static size_t prv_update(uint8_t * buffer,
+                         int clientID,
+                         uint16_t mid)
+{
+    coap_packet_t message[1];
+    char location[16];
+
+    snprintf(location, sizeof(location), "/"URI_REGISTRATION_SEGMENT"/%d", clientID);
+    coap_init_message(message, COAP_TYPE_CON, COAP_POST, mid);
+    coap_set_header_uri_path(message, location);
+
+    return coap_serialize_message(message, buffer);
+}
+
+static void * prv_worker(void * arg)
+{
+    bench_worker_t * workerP = (bench_worker_t *)arg;
+    lwm2m_context_t * contextP;
+    uint8_t buffer[BENCH_CLIENTS][COAP_MAX_HEADER_SIZE + 16];
+    size_t length[BENCH_CLIENTS];
+    char name[16];
+    uint64_t start;
+    uint16_t mid;
+    int round;
+    int i;
+
+    workerP->ok = false;
+    contextP = bench_server_new();
+    if (NULL == contextP) return NULL;
+
+    for (i = 0; i < BENCH_CLIENTS; i++)
+    {
+        int clientID;
+
+        snprintf(name, sizeof(name), "client%d", i);
+        clientID = bench_register_client(contextP, (void *)(intptr_t)(i + 1), name);
+        if (clientID < 0)
+        {
+            lwm2m_close(contextP);
+            return NULL;
+        }
+        length[i] = prv_update(buffer[i], clientID, 0);
+    }
+
+    bench_sent = 0;
+    mid = 0;
+    start = bench_clock();
+    for (round = 0; round < BENCH_ROUNDS; round++)
+    {
+        for (i = 0; i < BENCH_CLIENTS; i++)
+        {
+            buffer[i][2] = (uint8_t)(mid >> 8);
+            buffer[i][3] = (uint8_t)mid;
+            mid++;
+            lwm2m_handle_packet(contextP, buffer[i], length[i], (void *)(intptr_t)(i + 1));
+        }
+    }
+    workerP->duration = bench_clock() - start;
+
+    // every update must have been acknowledged by this context
+    workerP->ok = (bench_sent == (unsigned long)BENCH_ROUNDS * BENCH_CLIENTS);
+
+    lwm2m_close(contextP);
+
+    return NULL;
+}
+
+static void prv_run(int threadCount)
+{
+    bench_worker_t workers[BENCH_THREADS];
+    uint64_t start;
+    uint64_t duration;
+    double requests;
+    bool ok;
+    int i;
+
+    start = bench_clock();
+    for (i = 0; i < threadCount; i++)
+    {
+        if (0 != pthread_create(&workers[i].thread, NULL, prv_worker, workers + i))
+        {
+            printf("  error: cannot create thread %d\r\n", i);
+            threadCount = i;
+            break;
+        }
+    }
+    ok = true;
+    for (i = 0; i < threadCount; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+        ok = ok && workers[i].ok;
+    }
+    duration = bench_clock() - start;
+
+    requests = (double)threadCount * BENCH_ROUNDS * BENCH_CLIENTS;
+    printf("  %d thread(s): %10.0f requests/s\r\n", threadCount, requests * 1000000000.0 / duration);
+    if (!ok) printf("  error: a context did not answer every request\r\n");
+}
+
+void bench_packet_threads(void)
+{
+    prv_run(1);
+    prv_run(BENCH_THREADS);
+}
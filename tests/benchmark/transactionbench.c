@@ -0,0 +1,281 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2015 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - initial API and implementation
+ *
+ *******************************************************************************/
+
+#include "internals.h"
+#include "benchmark.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#define BENCH_CLIENTS   100
+#define BENCH_NSTART    200
+#define BENCH_STEPS     10000
+
+typedef struct
+{
+    void *   sessionH;
+    uint16_t mid;
+    uint8_t  token[8];
+    uint8_t  tokenLen;
+} bench_request_t;
+
+typedef struct
+{
+    uint8_t buffer[32];
+    size_t  length;
+} bench_packet_t;
+
+static bench_request_t * requests;
+static int requestCount;
+
+static void prv_recordRequest(void * sessionH,
+                              uint8_t * buffer,
+                              size_t length)
+{
+    coap_packet_t message[1];
+
+    if (NO_ERROR != coap_parse_message(message, buffer, length)) return;
+    if (message->code >= COAP_GET && message->code <= COAP_DELETE)
+    {
+        requests[requestCount].sessionH = sessionH;
+        requests[requestCount].mid = message->mid;
+        memcpy(requests[requestCount].token, message->token, message->token_len);
+        requests[requestCount].tokenLen = message->token_len;
+        requestCount++;
+    }
+    coap_free_header(message);
+}
+
+// Creates a server context with enough clients to have count read requests outstanding at once
+// (at least BENCH_CLIENTS, each accepting BENCH_NSTART requests) and sends the requests to them.
+static lwm2m_context_t * prv_setup(int count)
+{
+    lwm2m_context_t * contextP;
+    int * clientID;
+    int clientCount;
+    lwm2m_uri_t uri;
+    int i;
+
+    clientCount = (count + BENCH_NSTART - 1) / BENCH_NSTART;
+    if (clientCount < BENCH_CLIENTS) clientCount = BENCH_CLIENTS;
+    clientID = (int *)malloc(clientCount * sizeof(int));
+
+    contextP = bench_server_new();
+    for (i = 0; i < clientCount; i++)
+    {
+        char name[16];
+
+        snprintf(name, sizeof(name), "client%d", i);
+        clientID[i] = bench_register_client(contextP, (void *)(intptr_t)(i + 1), name);
+        lwm2m_set_client_congestion(contextP, clientID[i], BENCH_NSTART, 0);
+    }
+
+    lwm2m_stringToUri("/3/0/0", 6, &uri);
+    for (i = 0; i < count; i++)
+    {
+        lwm2m_dm_read(contextP, clientID[i % clientCount], &uri, NULL, NULL);
+    }
+
+    free(clientID);
+
+    return contextP;
+}
+
+static size_t prv_serialize(coap_message_type_t type,
+                            uint8_t code,
+                            uint16_t mid,
+                            bench_request_t * requestP,
+                            uint8_t * buffer)
+{
+    coap_packet_t message[1];
+
+    coap_init_message(message, type, code, mid);
+    if (NULL != requestP)
+    {
+        coap_set_header_token(message, requestP->token, requestP->tokenLen);
+        coap_set_payload(message, "1", 1);
+    }
+
+    return coap_serialize_message(message, buffer);
+}
+
+// Handles the packets and returns the average duration in ns.
+static double prv_replay(lwm2m_context_t * contextP,
+                         bench_packet_t * packets,
+                         int count)
+{
+    uint64_t start;
+    int i;
+
+    start = bench_clock();
+    for (i = 0; i < count; i++)
+    {
+        lwm2m_handle_packet(contextP, packets[i].buffer, packets[i].length, requests[i].sessionH);
+    }
+
+    return (double)(bench_clock() - start) / count;
+}
+
+/*
+ * Matching of replayed ACKs and responses against pending transactions.
+ */
+void bench_transaction_match(void)
+{
+    int sizes[] = {1000, 10000, 100000};
+    size_t s;
+
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        lwm2m_context_t * contextP;
+        bench_packet_t * packets;
+        double piggybacked;
+        double emptyAck;
+        double separate;
+        int i;
+
+        requests = (bench_request_t *)malloc(sizes[s] * sizeof(bench_request_t));
+        packets = (bench_packet_t *)malloc(sizes[s] * sizeof(bench_packet_t));
+
+        // piggybacked responses
+        requestCount = 0;
+        bench_send_hook = prv_recordRequest;
+        contextP = prv_setup(sizes[s]);
+        bench_send_hook = NULL;
+        for (i = 0; i < requestCount; i++)
+        {
+            packets[i].length = prv_serialize(COAP_TYPE_ACK, COAP_205_CONTENT, requests[i].mid, requests + i, packets[i].buffer);
+        }
+        piggybacked = prv_replay(contextP, packets, requestCount);
+        if (0 != contextP->transactionCount) printf("  error: %d transactions left\r\n", (int)contextP->transactionCount);
+        lwm2m_close(contextP);
+
+        // empty ACKs followed by separate responses
+        requestCount = 0;
+        bench_send_hook = prv_recordRequest;
+        contextP = prv_setup(sizes[s]);
+        bench_send_hook = NULL;
+        for (i = 0; i < requestCount; i++)
+        {
+            packets[i].length = prv_serialize(COAP_TYPE_ACK, 0, requests[i].mid, NULL, packets[i].buffer);
+        }
+        emptyAck = prv_replay(contextP, packets, requestCount);
+        for (i = 0; i < requestCount; i++)
+        {
+            packets[i].length = prv_serialize(COAP_TYPE_CON, COAP_205_CONTENT, (uint16_t)(i + 1), requests + i, packets[i].buffer);
+        }
+        separate = prv_replay(contextP, packets, requestCount);
+        if (0 != contextP->transactionCount) printf("  error: %d transactions left\r\n", (int)contextP->transactionCount);
+        lwm2m_close(contextP);
+
+        printf("  %6d pending: %8.1f ns/piggybacked ACK, %8.1f ns/empty ACK, %8.1f ns/separate response\r\n",
+               sizes[s], piggybacked, emptyAck, separate);
+
+        free(packets);
+        free(requests);
+    }
+}
+
+/*
+ * Cost of a lwm2m_step() when nothing is due, with an increasing number of
+ * transactions in flight.
+ */
+void bench_transaction_step(void)
+{
+    int sizes[] = {10, 100, 1000, 10000, 100000};
+    size_t s;
+
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        lwm2m_context_t * contextP;
+        uint64_t start;
+        uint64_t setup;
+        uint64_t duration;
+        int i;
+
+        start = bench_clock();
+        contextP = prv_setup(sizes[s]);
+        setup = bench_clock() - start;
+
+        start = bench_clock();
+        for (i = 0; i < BENCH_STEPS; i++)
+        {
+            int64_t timeout = 60000;
+
+            lwm2m_step(contextP, &timeout);
+        }
+        duration = bench_clock() - start;
+
+        printf("  %6d transactions: %8.1f ns/step (setup: %.1f ms)\r\n",
+               sizes[s],
+               (double)duration / BENCH_STEPS,
+               (double)setup / 1000000);
+
+        lwm2m_close(contextP);
+    }
+}
+
+/*
+ * Requests queued towards a single client with the default NSTART of 1: each ACK starts the next request.
+ */
+void bench_transaction_queue(void)
+{
+    int sizes[] = {100, 1000, 10000};
+    size_t s;
+
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        lwm2m_context_t * contextP;
+        lwm2m_uri_t uri;
+        uint64_t start;
+        uint64_t duration;
+        int clientID;
+        int i;
+
+        requests = (bench_request_t *)malloc(sizes[s] * sizeof(bench_request_t));
+        requestCount = 0;
+
+        contextP = bench_server_new();
+        clientID = bench_register_client(contextP, (void *)1, "client");
+        bench_send_hook = prv_recordRequest;
+        lwm2m_stringToUri("/3/0/0", 6, &uri);
+        for (i = 0; i < sizes[s]; i++)
+        {
+            lwm2m_dm_read(contextP, clientID, &uri, NULL, NULL);
+        }
+        if (1 != requestCount) printf("  error: %d requests sent at once\r\n", requestCount);
+
+        start = bench_clock();
+        for (i = 0; i < requestCount; i++)
+        {
+            uint8_t buffer[32];
+            size_t length;
+
+            length = prv_serialize(COAP_TYPE_ACK, COAP_205_CONTENT, requests[i].mid, requests + i, buffer);
+            lwm2m_handle_packet(contextP, buffer, length, requests[i].sessionH);
+        }
+        duration = bench_clock() - start;
+        bench_send_hook = NULL;
+
+        if (sizes[s] != requestCount) printf("  error: %d requests sent\r\n", requestCount);
+        if (0 != contextP->transactionCount) printf("  error: %d transactions left\r\n", (int)contextP->transactionCount);
+        printf("  %6d queued: %8.1f ns/interaction\r\n", sizes[s], (double)duration / requestCount);
+
+        lwm2m_close(contextP);
+        free(requests);
+    }
+}
@@ -402,6 +402,7 @@ int main(int argc, char *argv[])
     int sock;
     fd_set readfds;
     struct timeval tv;
+    int64_t timeout;
     int result;
     connection_t * connList = NULL;
     char * port = "5685";
@@ -488,15 +489,16 @@ int main(int argc, char *argv[])
         FD_SET(sock, &readfds);
         FD_SET(STDIN_FILENO, &readfds);
 
-        tv.tv_sec = 60;
-        tv.tv_usec = 0;
+        timeout = 60000;
 
-        result = lwm2m_step(data.lwm2mH, (time_t*)&(tv.tv_sec));
+        result = lwm2m_step(data.lwm2mH, &timeout);
         if (result != 0)
         {
             fprintf(stderr, "lwm2m_step() failed: 0x%X\r\n", result);
             return -1;
         }
+        tv.tv_sec = timeout / 1000;
+        tv.tv_usec = (timeout % 1000) * 1000;
 
         result = select(FD_SETSIZE, &readfds, 0, 0, &tv);
 
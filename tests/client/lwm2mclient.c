@@ -467,13 +467,13 @@ syntax_error:
 
 static void update_battery_level(lwm2m_context_t * context)
 {
-    static time_t next_change_time = 0;
-    time_t tv_sec;
+    static int64_t next_change_time = 0;
+    int64_t tv_ms;
 
-    tv_sec = lwm2m_gettime();
-    if (tv_sec < 0) return;
+    tv_ms = lwm2m_gettime_ms();
+    if (tv_ms < 0) return;
 
-    if (next_change_time < tv_sec)
+    if (next_change_time < tv_ms)
     {
         char value[15];
         int valueLength;
@@ -489,7 +489,7 @@ static void update_battery_level(lwm2m_context_t * context)
         }
         level = rand() % 20;
         if (0 > level) level = -level;
-        next_change_time = tv_sec + level + 10;
+        next_change_time = tv_ms + (level + 10) * 1000;
     }
 }
 
@@ -777,7 +777,7 @@ int main(int argc, char *argv[])
     char * name = "testlwm2mclient";
     int lifetime = 300;
     int batterylevelchanging = 0;
-    time_t reboot_time = 0;
+    int64_t reboot_time = 0;
     int opt;
     bool bootstrapRequested = false;
 #ifdef LWM2M_BOOTSTRAP
@@ -1027,19 +1027,20 @@ int main(int argc, char *argv[])
     while (0 == g_quit)
     {
         struct timeval tv;
+        int64_t timeout;
         fd_set readfds;
 
         if (g_reboot)
         {
-            time_t tv_sec;
+            int64_t tv_ms;
 
-            tv_sec = lwm2m_gettime();
+            tv_ms = lwm2m_gettime_ms();
 
             if (0 == reboot_time)
             {
-                reboot_time = tv_sec + 5;
+                reboot_time = tv_ms + 5000;
             }
-            if (reboot_time < tv_sec)
+            if (reboot_time < tv_ms)
             {
                 /*
                  * Message should normally be lost with reboot ...
@@ -1049,19 +1050,18 @@ int main(int argc, char *argv[])
             }
             else
             {
-                tv.tv_sec = reboot_time - tv_sec;
+                timeout = reboot_time - tv_ms;
             }
         }
         else if (batterylevelchanging) 
         {
             update_battery_level(lwm2mH);
-            tv.tv_sec = 5;
+            timeout = 5000;
         }
         else 
         {
-            tv.tv_sec = 60;
+            timeout = 60000;
         }
-        tv.tv_usec = 0;
 
         FD_ZERO(&readfds);
         FD_SET(data.sock, &readfds);
@@ -1070,15 +1070,17 @@ int main(int argc, char *argv[])
         /*
          * This function does two things:
          *  - first it does the work needed by liblwm2m (eg. (re)sending some packets).
-         *  - Secondly it adjusts the timeout value (default 60s) depending on the state of the transaction
+         *  - Secondly it adjusts the timeout value (in milliseconds) depending on the state of the transaction
          *    (eg. retransmission) and the time between the next operation
          */
-        result = lwm2m_step(lwm2mH, (time_t*)&(tv.tv_sec));
+        result = lwm2m_step(lwm2mH, &timeout);
         if (result != 0)
         {
             fprintf(stderr, "lwm2m_step() failed: 0x%X\r\n", result);
             return -1;
         }
+        tv.tv_sec = timeout / 1000;
+        tv.tv_usec = (timeout % 1000) * 1000;
 #ifdef LWM2M_BOOTSTRAP
         update_bootstrap_info(&previousBootstrapState, lwm2mH);
 #endif
@@ -325,10 +325,10 @@ int main(int argc, char *argv[])
     while (0 == g_quit)
     {
         struct timeval tv;
+        int64_t timeout;
         fd_set readfds;
 
-        tv.tv_sec = 10;
-        tv.tv_usec = 0;
+        timeout = 10000;
 
         FD_ZERO(&readfds);
         FD_SET(data.sock, &readfds);
@@ -336,15 +336,17 @@ int main(int argc, char *argv[])
         /*
          * This function does two things:
          *  - first it does the work needed by liblwm2m (eg. (re)sending some packets).
-         *  - Secondly it adjusts the timeout value (default 60s) depending on the state of the transaction
+         *  - Secondly it adjusts the timeout value (in milliseconds) depending on the state of the transaction
          *    (eg. retransmission) and the time before the next operation
          */
-        result = lwm2m_step(lwm2mH, &(tv.tv_sec));
+        result = lwm2m_step(lwm2mH, &timeout);
         if (result != 0)
         {
             fprintf(stderr, "lwm2m_step() failed: 0x%X\r\n", result);
             return -1;
         }
+        tv.tv_sec = timeout / 1000;
+        tv.tv_usec = (timeout % 1000) * 1000;
 
         /*
          * This part wait for an event on the socket until "tv" timed out (set
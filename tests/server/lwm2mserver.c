@@ -69,6 +69,8 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #else
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
@@ -81,10 +83,30 @@ typedef USHORT in_port_t;
 
 #include "commandline.h"
 #include "connection.h"
+#ifndef _WIN32
+#include "shardengine.h"
+#endif
 
 #define MAX_PACKET_SIZE 1024
+#define MAX_SHARDS      64
+
+// A context and the clients it serves. Without sharding, the single context is shard 0.
+typedef struct
+{
+    lwm2m_context_t *   lwm2mH;
+    int                 index;
+} server_shard_t;
 
 static int g_quit = 0;
+static int g_shardCount = 1;
+static server_shard_t g_shards[MAX_SHARDS];
+
+// Client numbers shown to the user are unique over the shards.
+static int prv_client_number(server_shard_t * shardP,
+                             uint16_t clientID)
+{
+    return clientID * g_shardCount + shardP->index;
+}
 
 static void prv_print_error(uint8_t status)
 {
@@ -130,11 +152,12 @@ static char * prv_dump_binding(lwm2m_binding_t binding)
     }
 }
 
-static void prv_dump_client(lwm2m_client_t * targetP)
+static void prv_dump_client(server_shard_t * shardP,
+                            lwm2m_client_t * targetP)
 {
     lwm2m_client_object_t * objectP;
 
-    fprintf(stdout, "Client #%d:\r\n", targetP->internalID);
+    fprintf(stdout, "Client #%d:\r\n", prv_client_number(shardP, targetP->internalID));
     fprintf(stdout, "\tname: \"%s\"\r\n", targetP->name);
     fprintf(stdout, "\tbinding: \"%s\"\r\n", prv_dump_binding(targetP->binding));
     if (targetP->msisdn) fprintf(stdout, "\tmsisdn: \"%s\"\r\n", targetP->msisdn);
@@ -163,20 +186,20 @@ static void prv_dump_client(lwm2m_client_t * targetP)
 static void prv_output_clients(char * buffer,
                                void * user_data)
 {
-    lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
+    server_shard_t * shardP = (server_shard_t *) user_data;
     lwm2m_client_t * targetP;
 
-    targetP = lwm2mH->clientList;
+    targetP = shardP->lwm2mH->clientList;
 
     if (targetP == NULL)
     {
-        fprintf(stdout, "No client.\r\n");
+        if (g_shardCount == 1) fprintf(stdout, "No client.\r\n");
         return;
     }
 
-    for (targetP = lwm2mH->clientList ; targetP != NULL ; targetP = targetP->next)
+    for (targetP = shardP->lwm2mH->clientList ; targetP != NULL ; targetP = targetP->next)
     {
-        prv_dump_client(targetP);
+        prv_dump_client(shardP, targetP);
     }
 }
 
@@ -189,13 +212,13 @@ static int prv_read_id(char * buffer,
     nb = sscanf(buffer, "%d", &value);
     if (nb == 1)
     {
-        if (value < 0 || value > LWM2M_MAX_ID)
+        if (value < 0 || value / g_shardCount > LWM2M_MAX_ID)
         {
             nb = 0;
         }
         else
         {
-            *idP = value;
+            *idP = value / g_shardCount;
         }
     }
 
@@ -211,7 +234,7 @@ static void prv_result_callback(uint16_t clientID,
                                 int dataLength,
                                 void * userData)
 {
-    fprintf(stdout, "\r\nClient #%d %d", clientID, uriP->objectId);
+    fprintf(stdout, "\r\nClient #%d %d", prv_client_number((server_shard_t *)userData, clientID), uriP->objectId);
     if (LWM2M_URI_IS_SET_INSTANCE(uriP))
         fprintf(stdout, "/%d", uriP->instanceId);
     else if (LWM2M_URI_IS_SET_RESOURCE(uriP))
@@ -236,7 +259,7 @@ static void prv_notify_callback(uint16_t clientID,
                                 int dataLength,
                                 void * userData)
 {
-    fprintf(stdout, "\r\nNotify from client #%d /%d", clientID, uriP->objectId);
+    fprintf(stdout, "\r\nNotify from client #%d /%d", prv_client_number((server_shard_t *)userData, clientID), uriP->objectId);
     if (LWM2M_URI_IS_SET_INSTANCE(uriP))
         fprintf(stdout, "/%d", uriP->instanceId);
     else if (LWM2M_URI_IS_SET_RESOURCE(uriP))
@@ -254,7 +277,7 @@ static void prv_notify_callback(uint16_t clientID,
 static void prv_read_client(char * buffer,
                             void * user_data)
 {
-    lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
+    server_shard_t * shardP = (server_shard_t *) user_data;
     uint16_t clientId;
     lwm2m_uri_t uri;
     char* end = NULL;
@@ -271,7 +294,7 @@ static void prv_read_client(char * buffer,
 
     if (!check_end_of_args(end)) goto syntax_error;
 
-    result = lwm2m_dm_read(lwm2mH, clientId, &uri, prv_result_callback, NULL);
+    result = lwm2m_dm_read(shardP->lwm2mH, clientId, &uri, prv_result_callback, shardP);
 
     if (result == 0)
     {
@@ -290,7 +313,7 @@ syntax_error:
 static void prv_write_client(char * buffer,
                              void * user_data)
 {
-    lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
+    server_shard_t * shardP = (server_shard_t *) user_data;
     uint16_t clientId;
     lwm2m_uri_t uri;
     char * end = NULL;
@@ -310,7 +333,7 @@ static void prv_write_client(char * buffer,
 
     if (!check_end_of_args(end)) goto syntax_error;
 
-    result = lwm2m_dm_write(lwm2mH, clientId, &uri, LWM2M_CONTENT_TEXT, (uint8_t *)buffer, end - buffer, prv_result_callback, NULL);
+    result = lwm2m_dm_write(shardP->lwm2mH, clientId, &uri, LWM2M_CONTENT_TEXT, (uint8_t *)buffer, end - buffer, prv_result_callback, shardP);
 
     if (result == 0)
     {
@@ -330,7 +353,7 @@ syntax_error:
 static void prv_exec_client(char * buffer,
                             void * user_data)
 {
-    lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
+    server_shard_t * shardP = (server_shard_t *) user_data;
     uint16_t clientId;
     lwm2m_uri_t uri;
     char * end = NULL;
@@ -350,13 +373,13 @@ static void prv_exec_client(char * buffer,
 
     if (buffer[0] == 0)
     {
-        result = lwm2m_dm_execute(lwm2mH, clientId, &uri, 0, NULL, 0, prv_result_callback, NULL);
+        result = lwm2m_dm_execute(shardP->lwm2mH, clientId, &uri, 0, NULL, 0, prv_result_callback, shardP);
     }
     else
     {
         if (!check_end_of_args(end)) goto syntax_error;
 
-        result = lwm2m_dm_execute(lwm2mH, clientId, &uri, LWM2M_CONTENT_TEXT, (uint8_t *)buffer, end - buffer, prv_result_callback, NULL);
+        result = lwm2m_dm_execute(shardP->lwm2mH, clientId, &uri, LWM2M_CONTENT_TEXT, (uint8_t *)buffer, end - buffer, prv_result_callback, shardP);
     }
 
     if (result == 0)
@@ -376,7 +399,7 @@ syntax_error:
 static void prv_create_client(char * buffer,
                               void * user_data)
 {
-    lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
+    server_shard_t * shardP = (server_shard_t *) user_data;
     uint16_t clientId;
     lwm2m_uri_t uri;
     char * end = NULL;
@@ -416,7 +439,7 @@ static void prv_create_client(char * buffer,
    /* End Client dependent part*/
 
     //Create
-    result = lwm2m_dm_create(lwm2mH, clientId, &uri, format, temp_buffer, temp_length, prv_result_callback, NULL);
+    result = lwm2m_dm_create(shardP->lwm2mH, clientId, &uri, format, temp_buffer, temp_length, prv_result_callback, shardP);
 
     if (result == 0)
     {
@@ -435,7 +458,7 @@ syntax_error:
 static void prv_delete_client(char * buffer,
                               void * user_data)
 {
-    lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
+    server_shard_t * shardP = (server_shard_t *) user_data;
     uint16_t clientId;
     lwm2m_uri_t uri;
     char* end = NULL;
@@ -452,7 +475,7 @@ static void prv_delete_client(char * buffer,
 
     if (!check_end_of_args(end)) goto syntax_error;
 
-    result = lwm2m_dm_delete(lwm2mH, clientId, &uri, prv_result_callback, NULL);
+    result = lwm2m_dm_delete(shardP->lwm2mH, clientId, &uri, prv_result_callback, shardP);
 
     if (result == 0)
     {
@@ -471,7 +494,7 @@ syntax_error:
 static void prv_observe_client(char * buffer,
                                void * user_data)
 {
-    lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
+    server_shard_t * shardP = (server_shard_t *) user_data;
     uint16_t clientId;
     lwm2m_uri_t uri;
     char* end = NULL;
@@ -488,7 +511,7 @@ static void prv_observe_client(char * buffer,
 
     if (!check_end_of_args(end)) goto syntax_error;
 
-    result = lwm2m_observe(lwm2mH, clientId, &uri, prv_notify_callback, NULL);
+    result = lwm2m_observe(shardP->lwm2mH, clientId, &uri, prv_notify_callback, shardP);
 
     if (result == 0)
     {
@@ -507,7 +530,7 @@ syntax_error:
 static void prv_cancel_client(char * buffer,
                               void * user_data)
 {
-    lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
+    server_shard_t * shardP = (server_shard_t *) user_data;
     uint16_t clientId;
     lwm2m_uri_t uri;
     char* end = NULL;
@@ -524,7 +547,7 @@ static void prv_cancel_client(char * buffer,
 
     if (!check_end_of_args(end)) goto syntax_error;
 
-    result = lwm2m_observe_cancel(lwm2mH, clientId, &uri, prv_result_callback, NULL);
+    result = lwm2m_observe_cancel(shardP->lwm2mH, clientId, &uri, prv_result_callback, shardP);
 
     if (result == 0)
     {
@@ -548,29 +571,29 @@ static void prv_monitor_callback(uint16_t clientID,
                                  int dataLength,
                                  void * userData)
 {
-    lwm2m_context_t * lwm2mH = (lwm2m_context_t *) userData;
+    server_shard_t * shardP = (server_shard_t *) userData;
     lwm2m_client_t * targetP;
 
     switch (status)
     {
     case COAP_201_CREATED:
-        fprintf(stdout, "\r\nNew client #%d registered.\r\n", clientID);
+        fprintf(stdout, "\r\nNew client #%d registered.\r\n", prv_client_number(shardP, clientID));
 
-        targetP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)lwm2mH->clientList, clientID);
+        targetP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)shardP->lwm2mH->clientList, clientID);
 
-        prv_dump_client(targetP);
+        prv_dump_client(shardP, targetP);
         break;
 
     case COAP_202_DELETED:
-        fprintf(stdout, "\r\nClient #%d unregistered.\r\n", clientID);
+        fprintf(stdout, "\r\nClient #%d unregistered.\r\n", prv_client_number(shardP, clientID));
         break;
 
     case COAP_204_CHANGED:
-        fprintf(stdout, "\r\nClient #%d updated.\r\n", clientID);
+        fprintf(stdout, "\r\nClient #%d updated.\r\n", prv_client_number(shardP, clientID));
 
-        targetP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)lwm2mH->clientList, clientID);
+        targetP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)shardP->lwm2mH->clientList, clientID);
 
-        prv_dump_client(targetP);
+        prv_dump_client(shardP, targetP);
         break;
 
     default:
@@ -589,6 +612,188 @@ static void prv_quit(char * buffer,
     g_quit = 1;
 }
 
+static void prv_init_shard(lwm2m_context_t * lwm2mH,
+                           int index,
+                           void * userData)
+{
+    g_shards[index].lwm2mH = lwm2mH;
+    g_shards[index].index = index;
+    lwm2m_set_monitoring_callback(lwm2mH, prv_monitor_callback, g_shards + index);
+}
+
+#ifndef _WIN32
+// A command line handled by the shard engine instead of the main thread.
+typedef struct
+{
+    shard_engine_t *    engineP;
+    command_handler_t   callback;
+} server_command_t;
+
+typedef struct
+{
+    command_handler_t   callback;
+    char *              args;
+} server_job_t;
+
+static void prv_run_job(lwm2m_context_t * lwm2mH,
+                        int index,
+                        void * userData)
+{
+    server_job_t * jobP = (server_job_t *)userData;
+
+    // the shard is found from its index
+    (void)lwm2mH;
+
+    jobP->callback(jobP->args, g_shards + index);
+    fprintf(stdout, "\r\n> ");
+    fflush(stdout);
+
+    free(jobP->args);
+    free(jobP);
+}
+
+static void prv_submit_job(shard_engine_t * engineP,
+                           int index,
+                           command_handler_t callback,
+                           char * args)
+{
+    server_job_t * jobP;
+
+    jobP = (server_job_t *)malloc(sizeof(server_job_t));
+    if (jobP == NULL) return;
+    jobP->callback = callback;
+    jobP->args = strdup(args);
+    if (jobP->args == NULL
+     || 0 != shard_engine_submit(engineP, index, prv_run_job, jobP))
+    {
+        free(jobP->args);
+        free(jobP);
+    }
+}
+
+// Runs a command in the thread of the shard owning the client, or of every shard for "list".
+static void prv_shard_command(char * buffer,
+                              void * user_data)
+{
+    server_command_t * commandP = (server_command_t *)user_data;
+    int number;
+    int i;
+
+    if (commandP->callback == prv_output_clients)
+    {
+        for (i = 0 ; i < g_shardCount ; i++)
+        {
+            prv_submit_job(commandP->engineP, i, commandP->callback, buffer);
+        }
+        return;
+    }
+
+    if (sscanf(buffer, "%d", &number) != 1 || number < 0)
+    {
+        fprintf(stdout, "Syntax error !");
+        return;
+    }
+    prv_submit_job(commandP->engineP, number % g_shardCount, commandP->callback, buffer);
+}
+#endif
+
+#ifndef _WIN32
+// Sessions are saved in snapshots as the client's address.
+typedef struct
+{
+    connection_t *  connList;
+    int             sock;
+} session_list_t;
+
+static size_t prv_session_save(void * sessionH,
+                               uint8_t * buffer,
+                               size_t length,
+                               void * userData)
+{
+    connection_t * connP = (connection_t *)sessionH;
+
+    if (connP->addrLen > length) return 0;
+    memcpy(buffer, &connP->addr, connP->addrLen);
+
+    return connP->addrLen;
+}
+
+static void * prv_session_load(const uint8_t * buffer,
+                               size_t length,
+                               void * userData)
+{
+    session_list_t * sessionsP = (session_list_t *)userData;
+    struct sockaddr_storage addr;
+    connection_t * connP;
+
+    if (length > sizeof(addr)) return NULL;
+    memcpy(&addr, buffer, length);
+
+    connP = connection_find(sessionsP->connList, &addr, length);
+    if (connP == NULL)
+    {
+        connP = connection_new_incoming(sessionsP->connList, sessionsP->sock, (struct sockaddr *)&addr, length);
+        if (connP != NULL)
+        {
+            sessionsP->connList = connP;
+        }
+    }
+
+    return connP;
+}
+
+static int prv_snapshot_restore(lwm2m_context_t * lwm2mH,
+                                const char * fileName,
+                                session_list_t * sessionsP)
+{
+    struct stat fileStat;
+    void * mapP;
+    int fd;
+    int result;
+
+    fd = open(fileName, O_RDONLY);
+    if (fd < 0) return errno == ENOENT ? 0 : -1;
+    if (0 != fstat(fd, &fileStat) || 0 == fileStat.st_size)
+    {
+        close(fd);
+        return -1;
+    }
+    mapP = mmap(NULL, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == mapP) return -1;
+
+    result = lwm2m_snapshot_restore(lwm2mH, (const uint8_t *)mapP, fileStat.st_size, prv_session_load, sessionsP, prv_notify_callback, g_shards);
+    munmap(mapP, fileStat.st_size);
+
+    return result;
+}
+
+static int prv_snapshot_save(lwm2m_context_t * lwm2mH,
+                             const char * fileName)
+{
+    uint8_t * buffer;
+    size_t length;
+    FILE * fileP;
+    int result;
+
+    length = lwm2m_snapshot_save(lwm2mH, NULL, 0, prv_session_save, NULL);
+    buffer = (uint8_t *)malloc(length);
+    if (NULL == buffer) return -1;
+    length = lwm2m_snapshot_save(lwm2mH, buffer, length, prv_session_save, NULL);
+
+    result = -1;
+    fileP = fopen(fileName, "wb");
+    if (NULL != fileP)
+    {
+        if (0 != length && fwrite(buffer, 1, length, fileP) == length) result = 0;
+        if (0 != fclose(fileP)) result = -1;
+    }
+    free(buffer);
+
+    return result;
+}
+#endif
+
 void handle_sigint(int signum)
 {
     g_quit = 2;
@@ -596,8 +801,14 @@ void handle_sigint(int signum)
 
 void print_usage(void)
 {
-    fprintf(stderr, "Usage: lwm2mserver\r\n");
+    fprintf(stderr, "Usage: lwm2mserver [OPTION]\r\n");
     fprintf(stderr, "Launch a LWM2M server on localhost port "LWM2M_STANDARD_PORT_STR".\r\n\n");
+    fprintf(stderr, "Options:\r\n");
+#ifndef _WIN32
+    fprintf(stderr, "  -s SHARDS\tSpread the clients over SHARDS threads (max %d).\r\n", MAX_SHARDS);
+    fprintf(stderr, "  -f FILE\tRestore the clients and observations from FILE and save them to it on exit. Not with -s.\r\n");
+#endif
+    fprintf(stderr, "\r\n");
 }
 
 
@@ -606,10 +817,15 @@ int main(int argc, char *argv[])
     int sock;
     fd_set readfds;
     struct timeval tv;
+    int64_t timeout;
     int result;
     lwm2m_context_t * lwm2mH = NULL;
     int i;
     connection_t * connList = NULL;
+#ifndef _WIN32
+    shard_engine_t * engineP = NULL;
+    const char * snapshotFile = NULL;
+#endif
 
     command_desc_t commands[] =
     {
@@ -649,6 +865,34 @@ int main(int argc, char *argv[])
 
             COMMAND_END_LIST
     };
+#ifndef _WIN32
+    server_command_t shardCommands[sizeof(commands) / sizeof(command_desc_t)];
+#endif
+
+    for (i = 1 ; i < argc ; i++)
+    {
+#ifndef _WIN32
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+        {
+            g_shardCount = atoi(argv[++i]);
+            if (g_shardCount >= 1 && g_shardCount <= MAX_SHARDS) continue;
+        }
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+        {
+            snapshotFile = argv[++i];
+            continue;
+        }
+#endif
+        print_usage();
+        return 0;
+    }
+#ifndef _WIN32
+    if (g_shardCount > 1 && NULL != snapshotFile)
+    {
+        print_usage();
+        return 0;
+    }
+#endif
 
 #ifdef _WIN32
     wstdinselect_init(40001);
@@ -667,38 +911,83 @@ int main(int argc, char *argv[])
         return -1;
     }
 
-    lwm2mH = lwm2m_init(NULL, prv_buffer_send, NULL);
-    if (NULL == lwm2mH)
+#ifndef _WIN32
+    if (g_shardCount > 1)
     {
-        fprintf(stderr, "lwm2m_init() failed\r\n");
-        return -1;
+        engineP = shard_engine_new(sock, g_shardCount, prv_init_shard, NULL);
+        if (NULL == engineP)
+        {
+            fprintf(stderr, "shard_engine_new() failed\r\n");
+            return -1;
+        }
+    }
+    else
+#endif
+    {
+        lwm2mH = lwm2m_init(NULL, prv_buffer_send, NULL);
+        if (NULL == lwm2mH)
+        {
+            fprintf(stderr, "lwm2m_init() failed\r\n");
+            return -1;
+        }
+        prv_init_shard(lwm2mH, 0, NULL);
+#ifndef _WIN32
+        if (NULL != snapshotFile)
+        {
+            session_list_t sessions;
+
+            sessions.connList = connList;
+            sessions.sock = sock;
+            result = prv_snapshot_restore(lwm2mH, snapshotFile, &sessions);
+            connList = sessions.connList;
+            if (result != 0)
+            {
+                fprintf(stderr, "Restoring %s failed: 0x%X\r\n", snapshotFile, result);
+                return -1;
+            }
+        }
+#endif
     }
 
     signal(SIGINT, handle_sigint);
 
     for (i = 0 ; commands[i].name != NULL ; i++)
     {
-        commands[i].userData = (void *)lwm2mH;
+#ifndef _WIN32
+        if (NULL != engineP && commands[i].callback != prv_quit)
+        {
+            shardCommands[i].engineP = engineP;
+            shardCommands[i].callback = commands[i].callback;
+            commands[i].callback = prv_shard_command;
+            commands[i].userData = shardCommands + i;
+            continue;
+        }
+#endif
+        commands[i].userData = (void *)g_shards;
     }
     fprintf(stdout, "> "); fflush(stdout);
 
-    lwm2m_set_monitoring_callback(lwm2mH, prv_monitor_callback, lwm2mH);
-
     while (0 == g_quit)
     {
         FD_ZERO(&readfds);
-        FD_SET(sock, &readfds);
         FD_SET(STDIN_FILENO, &readfds);
 
-        tv.tv_sec = 60;
-        tv.tv_usec = 0;
+        timeout = 60000;
 
-        result = lwm2m_step(lwm2mH, (time_t*)&(tv.tv_sec));
-        if (result != 0)
+        // with sharding, the socket and the contexts are handled by the engine threads
+        if (NULL != lwm2mH)
         {
-            fprintf(stderr, "lwm2m_step() failed: 0x%X\r\n", result);
-            return -1;
+            FD_SET(sock, &readfds);
+
+            result = lwm2m_step(lwm2mH, &timeout);
+            if (result != 0)
+            {
+                fprintf(stderr, "lwm2m_step() failed: 0x%X\r\n", result);
+                return -1;
+            }
         }
+        tv.tv_sec = timeout / 1000;
+        tv.tv_usec = (timeout % 1000) * 1000;
 
         result = select(FD_SETSIZE, &readfds, 0, 0, &tv);
 
@@ -789,7 +1078,14 @@ int main(int argc, char *argv[])
         }
     }
 
-    lwm2m_close(lwm2mH);
+#ifndef _WIN32
+    if (NULL != engineP) shard_engine_free(engineP);
+    if (NULL != lwm2mH && NULL != snapshotFile && 0 != prv_snapshot_save(lwm2mH, snapshotFile))
+    {
+        fprintf(stderr, "Saving %s failed: %d\r\n", snapshotFile, errno);
+    }
+#endif
+    if (NULL != lwm2mH) lwm2m_close(lwm2mH);
 #ifndef _WIN32
     close(sock);
 #else
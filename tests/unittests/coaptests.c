@@ -0,0 +1,164 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2015 Bosch Software Innovations GmbH, Germany.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Bosch Software Innovations GmbH - Please refer to git log
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "liblwm2m.h"
+#include "internals.h"
+#include "memtest.h"
+
+#include <string.h>
+
+static size_t prv_build_request(uint8_t * buffer, int segments)
+{
+    coap_packet_t message[1];
+    char path[64];
+    int i;
+    size_t length;
+
+    path[0] = 0;
+    for (i = 0; i < segments; i++)
+    {
+        strcat(path, i == 0 ? "1" : "/1");
+    }
+
+    coap_init_message(message, COAP_TYPE_CON, COAP_POST, 1234);
+    coap_set_header_uri_path(message, path);
+    coap_set_header_uri_query(message, "ep=test&lt=300");
+    // frees the options of message
+    length = coap_serialize_message(message, buffer);
+
+    return length;
+}
+
+static void test_coap_parse_no_alloc(void)
+{
+    uint8_t buffer[COAP_MAX_PACKET_SIZE];
+    coap_packet_t message[1];
+    lwm2m_uri_t uri;
+    size_t length;
+
+    length = prv_build_request(buffer, 3);
+    CU_ASSERT_FATAL(0 < length);
+
+    MEMORY_TRACE_BEFORE;
+    CU_ASSERT_EQUAL_FATAL(coap_parse_message(message, buffer, length), NO_ERROR);
+    // options are views into the buffer
+    MEMORY_TRACE_AFTER_EQ;
+    CU_ASSERT_PTR_NOT_NULL_FATAL(message->uri_query);
+    CU_ASSERT_EQUAL(message->uri_query->len, 7);
+    CU_ASSERT_NSTRING_EQUAL(message->uri_query->data, "ep=test", 7);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(message->uri_query->next);
+    CU_ASSERT_NSTRING_EQUAL(message->uri_query->next->data, "lt=300", 6);
+    CU_ASSERT_PTR_NULL(message->uri_query->next->next);
+
+    CU_ASSERT_PTR_NOT_NULL(lwm2m_decode_uri(NULL, message->uri_path, &uri));
+    CU_ASSERT_EQUAL(uri.flag, LWM2M_URI_FLAG_DM | LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID | LWM2M_URI_FLAG_RESOURCE_ID);
+    CU_ASSERT_EQUAL(uri.objectId, 1);
+    CU_ASSERT_EQUAL(uri.instanceId, 1);
+    CU_ASSERT_EQUAL(uri.resourceId, 1);
+    MEMORY_TRACE_AFTER_EQ;
+
+    coap_free_header(message);
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_coap_parse_many_options(void)
+{
+    uint8_t buffer[COAP_MAX_PACKET_SIZE];
+    coap_packet_t message[1];
+    multi_option_t * optionP;
+    size_t length;
+    int count;
+
+    // more options than COAP_MAX_OPTION_VIEWS
+    length = prv_build_request(buffer, COAP_MAX_OPTION_VIEWS + 2);
+    CU_ASSERT_FATAL(0 < length);
+
+    MEMORY_TRACE_BEFORE;
+    CU_ASSERT_EQUAL_FATAL(coap_parse_message(message, buffer, length), NO_ERROR);
+    count = 0;
+    for (optionP = message->uri_path; optionP != NULL; optionP = optionP->next)
+    {
+        CU_ASSERT_EQUAL(optionP->len, 1);
+        count++;
+    }
+    CU_ASSERT_EQUAL(count, COAP_MAX_OPTION_VIEWS + 2);
+    count = 0;
+    for (optionP = message->uri_query; optionP != NULL; optionP = optionP->next)
+    {
+        count++;
+    }
+    CU_ASSERT_EQUAL(count, 2);
+
+    coap_free_header(message);
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_coap_serialize_notification(void)
+{
+    uint8_t expected[COAP_MAX_PACKET_SIZE];
+    uint8_t buffer[COAP_NOTIFICATION_PREFIX_SIZE + COAP_MAX_PACKET_SIZE];
+    uint8_t token[COAP_TOKEN_LEN] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    const char * payload = "42";
+    coap_packet_t message[1];
+    uint32_t observe[3] = { 0, 300, 0x1234567 };
+    size_t length;
+    size_t expectedLength;
+    size_t prefixLength;
+    int i;
+
+    coap_init_message(message, COAP_TYPE_NON, COAP_205_CONTENT, 0);
+    coap_set_header_content_type(message, LWM2M_CONTENT_TEXT);
+    coap_set_payload(message, payload, strlen(payload));
+    length = coap_serialize_notification(message, buffer);
+    CU_ASSERT_FATAL(0 < length);
+
+    // the common part followed by each prefix is the message coap_serialize_message() would build
+    for (i = 0; i < 3; i++)
+    {
+        coap_init_message(message, COAP_TYPE_NON, COAP_205_CONTENT, 1000 + i);
+        coap_set_header_token(message, token, i * 4);
+        coap_set_header_observe(message, observe[i]);
+        coap_set_header_content_type(message, LWM2M_CONTENT_TEXT);
+        coap_set_payload(message, payload, strlen(payload));
+        expectedLength = coap_serialize_message(message, expected);
+
+        prefixLength = coap_serialize_notification_prefix(buffer, COAP_TYPE_NON, COAP_205_CONTENT, 1000 + i, token, i * 4, observe[i]);
+        CU_ASSERT_EQUAL(prefixLength + length, expectedLength);
+        CU_ASSERT_EQUAL(memcmp(buffer + COAP_NOTIFICATION_PREFIX_SIZE - prefixLength, expected, expectedLength), 0);
+    }
+}
+
+static struct TestTable table[] = {
+        { "test of coap_parse_message() without allocation", test_coap_parse_no_alloc },
+        { "test of coap_parse_message() with many options", test_coap_parse_many_options },
+        { "test of coap_serialize_notification()", test_coap_serialize_notification },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_coap_suit()
+{
+   CU_pSuite pSuite = NULL;
+
+   pSuite = CU_add_suite("Suite_CoAP", NULL, NULL);
+   if (NULL == pSuite) {
+      return CU_get_error();
+   }
+
+   return add_tests(pSuite, table);
+}
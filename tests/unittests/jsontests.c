@@ -0,0 +1,399 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2015 Bosch Software Innovations GmbH, Germany.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Bosch Software Innovations GmbH - Please refer to git log
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "liblwm2m.h"
+#include "internals.h"
+#include "memtest.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define JSON_FUZZ_ROUNDS        20000
+#define JSON_SPEED_RECORDS      2000
+#define JSON_SPEED_ROUNDS       200
+
+static int json_parse(const char * text, lwm2m_data_t ** dataP)
+{
+    return lwm2m_data_parse((uint8_t *)text, strlen(text), LWM2M_CONTENT_JSON, dataP);
+}
+
+static void test_json_parse(void)
+{
+    MEMORY_TRACE_BEFORE;
+    const char * text = "{\"bn\":\"/3/0/\",\"e\":["
+                        "{\"n\":\"0\",\"sv\":\"Open Mobile Alliance\"},"
+                        "{\"n\":\"6/0\",\"v\":1},"
+                        "{\"n\":\"6/1\",\"v\":5},"
+                        "{\"n\":\"9\",\"v\":-100},"
+                        "{\"n\":\"13\",\"v\":1367491215.5},"
+                        "{\"n\":\"16\",\"bv\":true},"
+                        "{\"n\":\"18\",\"ov\":\"3:1\"}]}";
+    lwm2m_data_t * dataP;
+    lwm2m_data_t * subP;
+    int64_t intValue;
+    double floatValue;
+    bool boolValue;
+    int result;
+
+    result = json_parse(text, &dataP);
+    CU_ASSERT_EQUAL_FATAL(result, 6);
+
+    CU_ASSERT_EQUAL(dataP[0].type, LWM2M_TYPE_RESOURCE);
+    CU_ASSERT_EQUAL(dataP[0].dataType, LWM2M_TYPE_STRING);
+    CU_ASSERT_EQUAL(dataP[0].id, 0);
+    CU_ASSERT_EQUAL(dataP[0].length, 20);
+    CU_ASSERT_NSTRING_EQUAL(dataP[0].value, "Open Mobile Alliance", 20);
+
+    CU_ASSERT_EQUAL(dataP[1].type, LWM2M_TYPE_MULTIPLE_RESOURCE);
+    CU_ASSERT_EQUAL(dataP[1].id, 6);
+    CU_ASSERT_EQUAL_FATAL(dataP[1].length, 2);
+    // the whole tree is in a single allocation
+    subP = (lwm2m_data_t *)dataP[1].value;
+    CU_ASSERT_PTR_EQUAL(subP, dataP + 6);
+    CU_ASSERT_EQUAL(subP[0].type, LWM2M_TYPE_RESOURCE_INSTANCE);
+    CU_ASSERT_EQUAL(subP[1].id, 1);
+    CU_ASSERT_EQUAL(lwm2m_data_decode_int(subP + 1, &intValue), 1);
+    CU_ASSERT_EQUAL(intValue, 5);
+
+    CU_ASSERT_EQUAL(dataP[2].dataType, LWM2M_TYPE_INTEGER);
+    CU_ASSERT_EQUAL(lwm2m_data_decode_int(dataP + 2, &intValue), 1);
+    CU_ASSERT_EQUAL(intValue, -100);
+
+    CU_ASSERT_EQUAL(dataP[3].dataType, LWM2M_TYPE_FLOAT);
+    CU_ASSERT_EQUAL(lwm2m_data_decode_float(dataP + 3, &floatValue), 1);
+    CU_ASSERT_DOUBLE_EQUAL(floatValue, 1367491215.5, 0.01);
+
+    CU_ASSERT_EQUAL(dataP[4].dataType, LWM2M_TYPE_BOOLEAN);
+    CU_ASSERT_EQUAL(lwm2m_data_decode_bool(dataP + 4, &boolValue), 1);
+    CU_ASSERT_EQUAL(boolValue, true);
+
+    CU_ASSERT_EQUAL(dataP[5].dataType, LWM2M_TYPE_OBJECT_LINK);
+    CU_ASSERT_EQUAL_FATAL(dataP[5].length, 4);
+    CU_ASSERT_EQUAL(dataP[5].value[1], 3);
+    CU_ASSERT_EQUAL(dataP[5].value[3], 1);
+
+    lwm2m_data_free(result, dataP);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_json_parse_instances(void)
+{
+    MEMORY_TRACE_BEFORE;
+    // the names are out of order and the instances are found from the base name
+    const char * text = "{\"e\":[{\"n\":\"1/5700\",\"v\":-3},"
+                        "{\"n\":\"0/5701\",\"sv\":\"Cel\"},"
+                        "{\"n\":\"0/5700\",\"v\":21.5}],"
+                        "\"bn\":\"/3303/\"}";
+    lwm2m_data_t * dataP;
+    lwm2m_data_t * subP;
+    lwm2m_uri_t uri;
+    int result;
+
+    result = json_parse(text, &dataP);
+    CU_ASSERT_EQUAL_FATAL(result, 2);
+    CU_ASSERT_EQUAL(dataP[0].type, LWM2M_TYPE_OBJECT_INSTANCE);
+    CU_ASSERT_EQUAL(dataP[0].id, 0);
+    CU_ASSERT_EQUAL_FATAL(dataP[0].length, 2);
+    CU_ASSERT_EQUAL(dataP[1].id, 1);
+    CU_ASSERT_EQUAL_FATAL(dataP[1].length, 1);
+    subP = (lwm2m_data_t *)dataP[0].value;
+    CU_ASSERT_EQUAL(subP[0].type, LWM2M_TYPE_RESOURCE);
+    CU_ASSERT_EQUAL(subP[0].id, 5700);
+    CU_ASSERT_EQUAL(subP[1].id, 5701);
+    subP = (lwm2m_data_t *)dataP[1].value;
+    CU_ASSERT_EQUAL(subP[0].id, 5700);
+    lwm2m_data_free(result, dataP);
+
+    // absolute names must match the request URI and are relative to it
+    memset(&uri, 0, sizeof(lwm2m_uri_t));
+    uri.flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID;
+    uri.objectId = 3303;
+    uri.instanceId = 1;
+    result = lwm2m_json_parse(&uri, (uint8_t *)text, strlen(text), &dataP);
+    CU_ASSERT_EQUAL(result, 0);
+
+    text = "{\"bn\":\"/3303/1/\",\"e\":[{\"n\":\"5700\",\"v\":-3}]}";
+    result = lwm2m_json_parse(&uri, (uint8_t *)text, strlen(text), &dataP);
+    CU_ASSERT_EQUAL_FATAL(result, 1);
+    CU_ASSERT_EQUAL(dataP[0].type, LWM2M_TYPE_RESOURCE);
+    CU_ASSERT_EQUAL(dataP[0].id, 5700);
+    lwm2m_data_free(result, dataP);
+
+    // a resource can not also have instances
+    result = json_parse("{\"e\":[{\"n\":\"1\",\"v\":1},{\"n\":\"1/0\",\"v\":2}]}", &dataP);
+    CU_ASSERT_EQUAL(result, 0);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_json_parse_time(void)
+{
+    MEMORY_TRACE_BEFORE;
+    // records of the same name are a time series of which the most recent value is kept
+    const char * text = "{\"bt\":100,\"e\":["
+                        "{\"n\":\"1\",\"v\":1,\"t\":5},"
+                        "{\"n\":\"1\",\"v\":2,\"t\":-5},"
+                        "{\"t\":1.5,\"n\":\"2\",\"v\":3},"
+                        "{\"n\":\"2\",\"v\":4,\"t\":1.5}]}";
+    lwm2m_data_t * dataP;
+    int64_t value;
+    int result;
+
+    result = json_parse(text, &dataP);
+    CU_ASSERT_EQUAL_FATAL(result, 2);
+    CU_ASSERT_EQUAL(lwm2m_data_decode_int(dataP, &value), 1);
+    CU_ASSERT_EQUAL(value, 1);
+    // on the same time, the last record wins
+    CU_ASSERT_EQUAL(lwm2m_data_decode_int(dataP + 1, &value), 1);
+    CU_ASSERT_EQUAL(value, 4);
+    lwm2m_data_free(result, dataP);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_json_parse_string(void)
+{
+    MEMORY_TRACE_BEFORE;
+    const char * text = "{ \"e\" : [ { \"n\" : \"0\" , \"sv\" : \"a\\\"b\\\\c\\/\\n\\u00e9\\u20ac\\ud83d\\ude00\" } ,\n"
+                        "\t{ \"bv\" : false , \"n\" : \"1\" } ] }\r\n";
+    const uint8_t expected[] = {'a', '"', 'b', '\\', 'c', '/', '\n', 0xC3, 0xA9, 0xE2, 0x82, 0xAC, 0xF0, 0x9F, 0x98, 0x80};
+    lwm2m_data_t * dataP;
+    bool value;
+    int result;
+
+    result = json_parse(text, &dataP);
+    CU_ASSERT_EQUAL_FATAL(result, 2);
+    CU_ASSERT_EQUAL_FATAL(dataP[0].length, sizeof(expected));
+    CU_ASSERT_EQUAL(memcmp(dataP[0].value, expected, sizeof(expected)), 0);
+    CU_ASSERT_EQUAL(lwm2m_data_decode_bool(dataP + 1, &value), 1);
+    CU_ASSERT_EQUAL(value, false);
+    lwm2m_data_free(result, dataP);
+
+    // a lone low surrogate
+    result = json_parse("{\"e\":[{\"n\":\"0\",\"sv\":\"\\udc00\"}]}", &dataP);
+    CU_ASSERT_EQUAL(result, 0);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_json_parse_invalid(void)
+{
+    MEMORY_TRACE_BEFORE;
+    const char * texts[] = {
+        "",
+        "{}",
+        "{\"e\":[]}",
+        "{\"e\":[{}]}",
+        "{\"e\":[{\"n\":\"0\"}]}",
+        "{\"e\":[{\"n\":\"0\",\"v\":1,\"sv\":\"a\"}]}",
+        "{\"e\":[{\"n\":\"0\",\"v\":01}]}",
+        "{\"e\":[{\"n\":\"0\",\"v\":1.}]}",
+        "{\"e\":[{\"n\":\"0\",\"v\":-}]}",
+        "{\"e\":[{\"n\":\"0\",\"bv\":1}]}",
+        "{\"e\":[{\"n\":\"0\",\"sv\":\"\\x\"}]}",
+        "{\"e\":[{\"n\":\"0\",\"ov\":\"3\"}]}",
+        "{\"e\":[{\"n\":\"0\",\"ov\":\"3:70000\"}]}",
+        "{\"e\":[{\"n\":\"65535\",\"v\":1}]}",
+        "{\"e\":[{\"n\":\"0/1/2\",\"v\":1}]}",
+        "{\"e\":[{\"n\":\"0//1\",\"v\":1}]}",
+        "{\"e\":[{\"n\":\"/3/0/1\",\"v\":1}]}",
+        "{\"bn\":\"/3/0/\",\"e\":[{\"n\":\"0\",\"v\":1}],\"bn\":\"/3/0/\"}",
+        "{\"e\":[{\"n\":\"0\",\"v\":1}],\"x\":1}",
+        "{\"e\":[{\"n\":\"0\",\"v\":1}]}}",
+        "{\"e\":[{\"n\":\"0\",\"v\":1},]}",
+        "{\"e\":[{\"n\":\"0\",\"v\":1}",
+        "{\"e\":[{\"n\":\"0\",\"sv\":\"a",
+        NULL
+    };
+    lwm2m_data_t * dataP;
+    int i;
+
+    for (i = 0 ; texts[i] != NULL ; i++)
+    {
+        CU_ASSERT_EQUAL(json_parse(texts[i], &dataP), 0);
+    }
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+// Checks the tree is consistent with the buffer it was parsed from.
+static void check_tree(int size, lwm2m_data_t * dataP, size_t bufferLen, int depth)
+{
+    int i;
+
+    CU_ASSERT_FATAL(depth < 3);
+    for (i = 0 ; i < size ; i++)
+    {
+        switch (dataP[i].type)
+        {
+        case LWM2M_TYPE_OBJECT_INSTANCE:
+        case LWM2M_TYPE_MULTIPLE_RESOURCE:
+            CU_ASSERT(dataP[i].length > 0);
+            CU_ASSERT(dataP[i].length <= bufferLen);
+            check_tree(dataP[i].length, (lwm2m_data_t *)dataP[i].value, bufferLen, depth + 1);
+            break;
+        default:
+            CU_ASSERT(dataP[i].length <= bufferLen);
+            CU_ASSERT(dataP[i].length == 0 || dataP[i].value != NULL);
+            break;
+        }
+        CU_ASSERT(dataP[i].id < LWM2M_MAX_ID);
+    }
+}
+
+static void test_json_fuzz(void)
+{
+    MEMORY_TRACE_BEFORE;
+    const char * text = "{\"bn\":\"/3/\",\"bt\":25.5,\"e\":["
+                        "{\"n\":\"0/0\",\"sv\":\"Open \\\"Mobile\\\" Alliance\\u00e9\"},"
+                        "{\"n\":\"0/6/0\",\"v\":1,\"t\":-2},"
+                        "{\"n\":\"0/6/1\",\"v\":-5.25e3},"
+                        "{\"n\":\"1/16\",\"bv\":true},"
+                        "{\"n\":\"1/18\",\"ov\":\"3:1\"}]}";
+    uint8_t buffer[256];
+    size_t length;
+    uint32_t seed;
+    int parsed;
+    int i;
+
+    length = strlen(text);
+    seed = 42;
+    parsed = 0;
+    for (i = 0 ; i < JSON_FUZZ_ROUNDS ; i++)
+    {
+        lwm2m_data_t * dataP;
+        size_t fuzzLength;
+        int mutations;
+        int result;
+
+        memcpy(buffer, text, length);
+        fuzzLength = length;
+        for (mutations = 1 + i % 3 ; mutations > 0 ; mutations--)
+        {
+            size_t position;
+
+            seed = seed * 1103515245 + 12345;
+            position = (seed >> 8) % fuzzLength;
+            switch ((seed >> 4) % 4)
+            {
+            case 0:
+                // truncate
+                fuzzLength = position + 1;
+                break;
+            case 1:
+                // copy a structural character somewhere else
+                buffer[position] = "{}[]\":,\\/0-.e"[(seed >> 24) % 13];
+                break;
+            default:
+                buffer[position] = (uint8_t)(seed >> 16);
+                break;
+            }
+        }
+
+        result = lwm2m_data_parse(buffer, fuzzLength, LWM2M_CONTENT_JSON, &dataP);
+        CU_ASSERT(result >= 0);
+        if (result > 0)
+        {
+            check_tree(result, dataP, fuzzLength, 0);
+            lwm2m_data_free(result, dataP);
+            parsed++;
+        }
+    }
+    // some mutations keep the document valid
+    CU_ASSERT(parsed > 0);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_json_speed(void)
+{
+    MEMORY_TRACE_BEFORE;
+    uint8_t * buffer;
+    size_t length;
+    clock_t start;
+    double seconds;
+    int i;
+
+    buffer = (uint8_t *)lwm2m_malloc(JSON_SPEED_RECORDS * 48 + 32);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(buffer);
+    length = sprintf((char *)buffer, "{\"bn\":\"/3/0/\",\"e\":[");
+    for (i = 0 ; i < JSON_SPEED_RECORDS ; i++)
+    {
+        switch (i % 4)
+        {
+        case 0:
+            length += sprintf((char *)buffer + length, "{\"n\":\"%d\",\"v\":%d},", i, i * -7919);
+            break;
+        case 1:
+            length += sprintf((char *)buffer + length, "{\"n\":\"%d\",\"v\":%d.125},", i, i);
+            break;
+        case 2:
+            length += sprintf((char *)buffer + length, "{\"n\":\"%d/%d\",\"bv\":true},", i, i % 7);
+            break;
+        default:
+            length += sprintf((char *)buffer + length, "{\"n\":\"%d\",\"sv\":\"Alliance\"},", i);
+            break;
+        }
+    }
+    length += sprintf((char *)buffer + length - 1, "]}") - 1;
+
+    start = clock();
+    for (i = 0 ; i < JSON_SPEED_ROUNDS ; i++)
+    {
+        lwm2m_data_t * dataP;
+        int result;
+
+        result = lwm2m_data_parse(buffer, length, LWM2M_CONTENT_JSON, &dataP);
+        CU_ASSERT_EQUAL_FATAL(result, JSON_SPEED_RECORDS);
+        lwm2m_data_free(result, dataP);
+    }
+    seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    if (seconds > 0)
+    {
+        printf("\n    %lu bytes parsed at %.1f MB/s ", (unsigned long)length, length * JSON_SPEED_ROUNDS / seconds / 1000000);
+    }
+    lwm2m_free(buffer);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static struct TestTable table[] = {
+        { "test of lwm2m_data_parse() with JSON", test_json_parse },
+        { "test of lwm2m_json_parse() with object instances", test_json_parse_instances },
+        { "test of lwm2m_json_parse() with base time", test_json_parse_time },
+        { "test of lwm2m_json_parse() with escaped strings", test_json_parse_string },
+        { "test of lwm2m_json_parse() with invalid documents", test_json_parse_invalid },
+        { "test of lwm2m_json_parse() with mutated documents", test_json_fuzz },
+        { "test of lwm2m_json_parse() throughput", test_json_speed },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_json_suit()
+{
+   CU_pSuite pSuite = NULL;
+
+   pSuite = CU_add_suite("Suite_JSON", NULL, NULL);
+   if (NULL == pSuite) {
+      return CU_get_error();
+   }
+
+   return add_tests(pSuite, table);
+}
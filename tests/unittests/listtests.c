@@ -0,0 +1,132 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2015 Bosch Software Innovations GmbH, Germany.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Bosch Software Innovations GmbH - Please refer to git log
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "liblwm2m.h"
+#include "memtest.h"
+
+#include <string.h>
+
+static void test_id_set_lowest(void)
+{
+    lwm2m_id_set_t set;
+    uint16_t id;
+    int i;
+
+    memset(&set, 0, sizeof(set));
+    MEMORY_TRACE_BEFORE;
+
+    for (i = 0; i < 200; i++)
+    {
+        CU_ASSERT_EQUAL_FATAL(lwm2m_id_set_alloc(&set, &id), 0);
+        CU_ASSERT_EQUAL(id, i);
+    }
+
+    lwm2m_id_set_release(&set, 130);
+    lwm2m_id_set_release(&set, 5);
+    lwm2m_id_set_release(&set, 64);
+    CU_ASSERT_EQUAL(lwm2m_id_set_previous(&set, 6), 4);
+    CU_ASSERT_EQUAL(lwm2m_id_set_previous(&set, 65), 63);
+    CU_ASSERT_EQUAL(lwm2m_id_set_previous(&set, 0), -1);
+    CU_ASSERT_EQUAL(lwm2m_id_set_previous(&set, 1000), 199);
+
+    // released IDs are reused lowest first
+    CU_ASSERT_EQUAL(lwm2m_id_set_alloc(&set, &id), 0);
+    CU_ASSERT_EQUAL(id, 5);
+    CU_ASSERT_EQUAL(lwm2m_id_set_alloc(&set, &id), 0);
+    CU_ASSERT_EQUAL(id, 64);
+    CU_ASSERT_EQUAL(lwm2m_id_set_alloc(&set, &id), 0);
+    CU_ASSERT_EQUAL(id, 130);
+    CU_ASSERT_EQUAL(lwm2m_id_set_alloc(&set, &id), 0);
+    CU_ASSERT_EQUAL(id, 200);
+
+    lwm2m_id_set_clear(&set);
+    MEMORY_TRACE_AFTER_EQ;
+    CU_ASSERT_EQUAL(lwm2m_id_set_previous(&set, 10), -1);
+}
+
+static void test_id_set_full(void)
+{
+    lwm2m_id_set_t set;
+    uint16_t id;
+    int i;
+
+    memset(&set, 0, sizeof(set));
+    MEMORY_TRACE_BEFORE;
+
+    for (i = 0; i <= LWM2M_MAX_ID; i++)
+    {
+        CU_ASSERT_EQUAL_FATAL(lwm2m_id_set_alloc(&set, &id), 0);
+        CU_ASSERT_EQUAL_FATAL(id, i);
+    }
+    CU_ASSERT_EQUAL(lwm2m_id_set_alloc(&set, &id), -1);
+
+    lwm2m_id_set_release(&set, 40000);
+    CU_ASSERT_EQUAL(lwm2m_id_set_previous(&set, LWM2M_MAX_ID), LWM2M_MAX_ID - 1);
+    CU_ASSERT_EQUAL(lwm2m_id_set_previous(&set, 40001), 39999);
+    CU_ASSERT_EQUAL(lwm2m_id_set_alloc(&set, &id), 0);
+    CU_ASSERT_EQUAL(id, 40000);
+
+    lwm2m_id_set_clear(&set);
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_id_set_reserve(void)
+{
+    lwm2m_id_set_t set;
+    uint16_t id;
+    int i;
+
+    memset(&set, 0, sizeof(set));
+    MEMORY_TRACE_BEFORE;
+
+    CU_ASSERT_EQUAL(lwm2m_id_set_reserve(&set, 300), 0);
+    CU_ASSERT_EQUAL(lwm2m_id_set_reserve(&set, 300), -1);
+    CU_ASSERT_EQUAL(lwm2m_id_set_previous(&set, 1000), 300);
+    for (i = 0; i < 64; i++)
+    {
+        if (i != 5) CU_ASSERT_EQUAL_FATAL(lwm2m_id_set_reserve(&set, i), 0);
+    }
+    CU_ASSERT_EQUAL(lwm2m_id_set_alloc(&set, &id), 0);
+    CU_ASSERT_EQUAL(id, 5);
+    CU_ASSERT_EQUAL(lwm2m_id_set_alloc(&set, &id), 0);
+    CU_ASSERT_EQUAL(id, 64);
+    CU_ASSERT_EQUAL(lwm2m_id_set_previous(&set, 300), 64);
+
+    lwm2m_id_set_clear(&set);
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static struct TestTable table[] = {
+        { "test of lwm2m_id_set_alloc() and lwm2m_id_set_release()", test_id_set_lowest },
+        { "test of lwm2m_id_set_alloc() with all IDs used", test_id_set_full },
+        { "test of lwm2m_id_set_reserve()", test_id_set_reserve },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_list_suit()
+{
+   CU_pSuite pSuite = NULL;
+
+   pSuite = CU_add_suite("Suite_list", NULL, NULL);
+   if (NULL == pSuite) {
+      return CU_get_error();
+   }
+
+   return add_tests(pSuite, table);
+}
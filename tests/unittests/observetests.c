@@ -0,0 +1,556 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2015 Bosch Software Innovations GmbH, Germany.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Bosch Software Innovations GmbH - Please refer to git log
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "liblwm2m.h"
+#include "internals.h"
+#include "memtest.h"
+
+#include <string.h>
+
+#define OBSERVE_SESSION     ((void *)1)
+#define OBSERVE_WINDOW      ((uint32_t)1 << 23)
+
+static uint8_t sentBuffer[COAP_MAX_PACKET_SIZE];
+static size_t sentLength;
+static int notifyCount;
+static int notifyStatus;
+
+static void * prv_connect(uint16_t secObjInstID,
+                          void * userData)
+{
+    (void)secObjInstID;
+    (void)userData;
+
+    return NULL;
+}
+
+static uint8_t prv_send(void * sessionH,
+                        uint8_t * buffer,
+                        size_t length,
+                        void * userData)
+{
+    (void)sessionH;
+    (void)userData;
+
+    if (length <= sizeof(sentBuffer))
+    {
+        memcpy(sentBuffer, buffer, length);
+        sentLength = length;
+    }
+
+    return COAP_NO_ERROR;
+}
+
+static void prv_notify(uint16_t clientID,
+                       lwm2m_uri_t * uriP,
+                       int status,
+                       lwm2m_media_type_t format,
+                       uint8_t * data,
+                       int dataLength,
+                       void * userData)
+{
+    (void)clientID;
+    (void)uriP;
+    (void)format;
+    (void)data;
+    (void)dataLength;
+    (void)userData;
+
+    notifyCount++;
+    notifyStatus = status;
+}
+
+/*
+ * Server side: a client registers and its resource /3/0/1 is observed, the first answer
+ * carrying the Observe value initialCount.
+ */
+static lwm2m_context_t * prv_serverNew(uint32_t initialCount,
+                                       lwm2m_observation_t ** observationPP)
+{
+    lwm2m_context_t * contextP;
+    coap_packet_t message[1];
+    uint8_t buffer[COAP_MAX_HEADER_SIZE + 16];
+    const uint8_t * token;
+    uint8_t tokenCopy[8];
+    int tokenLen;
+    uint16_t mid;
+    lwm2m_uri_t uri;
+    size_t length;
+
+    contextP = lwm2m_init(prv_connect, prv_send, NULL);
+    if (NULL == contextP) return NULL;
+
+    coap_init_message(message, COAP_TYPE_CON, COAP_POST, 1);
+    coap_set_header_uri_path(message, "/"URI_REGISTRATION_SEGMENT);
+    coap_set_header_uri_query(message, "ep=observed");
+    coap_set_header_content_type(message, LWM2M_CONTENT_LINK);
+    coap_set_payload(message, "</3/0>", 6);
+    length = coap_serialize_message(message, buffer);
+    lwm2m_handle_packet(contextP, buffer, (int)length, OBSERVE_SESSION);
+    if (NULL == contextP->clientList) goto error;
+
+    memset(&uri, 0, sizeof(uri));
+    uri.flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID | LWM2M_URI_FLAG_RESOURCE_ID;
+    uri.objectId = 3;
+    uri.instanceId = 0;
+    uri.resourceId = 1;
+    sentLength = 0;
+    if (0 != lwm2m_observe(contextP, contextP->clientList->internalID, &uri, prv_notify, NULL)) goto error;
+
+    // answer the Observe request sent to the client
+    if (NO_ERROR != coap_parse_message(message, sentBuffer, (uint16_t)sentLength)) goto error;
+    mid = message->mid;
+    tokenLen = coap_get_header_token(message, &token);
+    memcpy(tokenCopy, token, tokenLen);
+    coap_free_header(message);
+
+    coap_init_message(message, COAP_TYPE_ACK, COAP_205_CONTENT, mid);
+    coap_set_header_token(message, tokenCopy, tokenLen);
+    coap_set_header_observe(message, initialCount);
+    coap_set_header_content_type(message, LWM2M_CONTENT_TEXT);
+    coap_set_payload(message, "0", 1);
+    length = coap_serialize_message(message, buffer);
+    notifyCount = 0;
+    lwm2m_handle_packet(contextP, buffer, (int)length, OBSERVE_SESSION);
+    if (1 != notifyCount || 0 != notifyStatus) goto error;
+
+    *observationPP = contextP->clientList->observationList;
+    if (NULL == *observationPP || STATE_REGISTERED != (*observationPP)->status) goto error;
+    notifyCount = 0;
+
+    return contextP;
+
+error:
+    lwm2m_close(contextP);
+    return NULL;
+}
+
+// Sends a notification of the observation and returns true when it reached the callback.
+static bool prv_notification(lwm2m_context_t * contextP,
+                             lwm2m_observation_t * observationP,
+                             coap_message_type_t type,
+                             uint32_t count)
+{
+    coap_packet_t message[1];
+    uint8_t buffer[COAP_MAX_HEADER_SIZE + 16];
+    size_t length;
+    int before;
+
+    coap_init_message(message, type, COAP_205_CONTENT, (uint16_t)(count + 1000));
+    coap_set_header_token(message, observationP->token, observationP->tokenLen);
+    coap_set_header_observe(message, count);
+    coap_set_header_content_type(message, LWM2M_CONTENT_TEXT);
+    coap_set_payload(message, "1", 1);
+    length = coap_serialize_message(message, buffer);
+
+    before = notifyCount;
+    lwm2m_handle_packet(contextP, buffer, (int)length, OBSERVE_SESSION);
+    if (notifyCount == before) return false;
+
+    CU_ASSERT_EQUAL(notifyCount, before + 1);
+    CU_ASSERT_EQUAL(notifyStatus, (int)count);
+    return true;
+}
+
+static void test_notify_order(void)
+{
+    MEMORY_TRACE_BEFORE;
+    lwm2m_context_t * contextP;
+    lwm2m_observation_t * observationP;
+
+    contextP = prv_serverNew(10, &observationP);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    CU_ASSERT_TRUE(prv_notification(contextP, observationP, COAP_TYPE_NON, 11));
+    CU_ASSERT_FALSE(prv_notification(contextP, observationP, COAP_TYPE_NON, 9));
+    CU_ASSERT_FALSE(prv_notification(contextP, observationP, COAP_TYPE_NON, 11));
+    CU_ASSERT_EQUAL(observationP->counter, 11);
+
+    // a stale confirmable notification is acknowledged all the same
+    sentLength = 0;
+    CU_ASSERT_FALSE(prv_notification(contextP, observationP, COAP_TYPE_CON, 10));
+    CU_ASSERT_EQUAL(sentLength, 4);
+    CU_ASSERT_EQUAL(sentBuffer[0] & 0x30, COAP_TYPE_ACK << 4);
+
+    CU_ASSERT_TRUE(prv_notification(contextP, observationP, COAP_TYPE_CON, 12));
+    CU_ASSERT_EQUAL(observationP->counter, 12);
+
+    lwm2m_close(contextP);
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_notify_wraparound(void)
+{
+    MEMORY_TRACE_BEFORE;
+    lwm2m_context_t * contextP;
+    lwm2m_observation_t * observationP;
+
+    contextP = prv_serverNew(0xFFFFF0, &observationP);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    // the 24 bits value wraps to 0
+    CU_ASSERT_TRUE(prv_notification(contextP, observationP, COAP_TYPE_NON, 0xFFFFFF));
+    CU_ASSERT_TRUE(prv_notification(contextP, observationP, COAP_TYPE_NON, 5));
+    CU_ASSERT_FALSE(prv_notification(contextP, observationP, COAP_TYPE_NON, 0xFFFFF8));
+    CU_ASSERT_FALSE(prv_notification(contextP, observationP, COAP_TYPE_NON, 0xFFFFFF));
+    CU_ASSERT_TRUE(prv_notification(contextP, observationP, COAP_TYPE_NON, 6));
+    CU_ASSERT_EQUAL(observationP->counter, 6);
+
+    lwm2m_close(contextP);
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_notify_window(void)
+{
+    MEMORY_TRACE_BEFORE;
+    lwm2m_context_t * contextP;
+    lwm2m_observation_t * observationP;
+
+    contextP = prv_serverNew(100, &observationP);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    // a value 2^23 ahead is considered older
+    CU_ASSERT_FALSE(prv_notification(contextP, observationP, COAP_TYPE_NON, 100 + OBSERVE_WINDOW));
+    CU_ASSERT_TRUE(prv_notification(contextP, observationP, COAP_TYPE_NON, 100 + OBSERVE_WINDOW - 1));
+    // and a value more than 2^23 behind is considered newer
+    CU_ASSERT_FALSE(prv_notification(contextP, observationP, COAP_TYPE_NON, 99));
+    CU_ASSERT_TRUE(prv_notification(contextP, observationP, COAP_TYPE_NON, 97));
+    CU_ASSERT_EQUAL(observationP->counter, 97);
+
+    lwm2m_close(contextP);
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_notify_delay(void)
+{
+    MEMORY_TRACE_BEFORE;
+    lwm2m_context_t * contextP;
+    lwm2m_observation_t * observationP;
+
+    contextP = prv_serverNew(50, &observationP);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    CU_ASSERT_FALSE(prv_notification(contextP, observationP, COAP_TYPE_NON, 40));
+
+    // any value is accepted 128 s after the freshest notification
+    observationP->counterTime = lwm2m_gettime_ms() - 127000;
+    CU_ASSERT_FALSE(prv_notification(contextP, observationP, COAP_TYPE_NON, 40));
+    observationP->counterTime = lwm2m_gettime_ms() - 129000;
+    CU_ASSERT_TRUE(prv_notification(contextP, observationP, COAP_TYPE_NON, 40));
+    CU_ASSERT_EQUAL(observationP->counter, 40);
+    CU_ASSERT_FALSE(prv_notification(contextP, observationP, COAP_TYPE_NON, 39));
+
+    lwm2m_close(contextP);
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+/*
+ * Client side: the object 3 has the instance 0, whose resources 0 to 9 all read 42, and is
+ * managed by a single registered server.
+ */
+
+#define OBSERVE_RESOURCES   10
+
+static uint8_t prv_read(uint16_t instanceId,
+                        int * numDataP,
+                        lwm2m_data_t ** dataArrayP,
+                        lwm2m_object_t * objectP)
+{
+    int i;
+
+    (void)instanceId;
+    (void)objectP;
+
+    if (0 == *numDataP)
+    {
+        *dataArrayP = lwm2m_data_new(OBSERVE_RESOURCES);
+        if (NULL == *dataArrayP) return COAP_500_INTERNAL_SERVER_ERROR;
+        *numDataP = OBSERVE_RESOURCES;
+        for (i = 0 ; i < OBSERVE_RESOURCES ; i++)
+        {
+            (*dataArrayP)[i].type = LWM2M_TYPE_RESOURCE;
+            (*dataArrayP)[i].id = (uint16_t)i;
+        }
+    }
+    for (i = 0 ; i < *numDataP ; i++)
+    {
+        if ((*dataArrayP)[i].id >= OBSERVE_RESOURCES) return COAP_404_NOT_FOUND;
+        lwm2m_data_encode_int(42, (*dataArrayP) + i);
+    }
+
+    return COAP_205_CONTENT;
+}
+
+static lwm2m_context_t * prv_clientNew(lwm2m_object_t * objectP,
+                                       lwm2m_list_t * instanceP)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_server_t * serverP;
+
+    contextP = lwm2m_init(prv_connect, prv_send, NULL);
+    if (NULL == contextP) return NULL;
+
+    memset(instanceP, 0, sizeof(lwm2m_list_t));
+    memset(objectP, 0, sizeof(lwm2m_object_t));
+    objectP->objID = 3;
+    objectP->instanceList = instanceP;
+    objectP->readFunc = prv_read;
+    contextP->objectList = (lwm2m_object_t **)lwm2m_malloc(sizeof(lwm2m_object_t *));
+    serverP = (lwm2m_server_t *)lwm2m_malloc(sizeof(lwm2m_server_t));
+    if (NULL == contextP->objectList || NULL == serverP)
+    {
+        if (NULL != serverP) lwm2m_free(serverP);
+        lwm2m_close(contextP);
+        return NULL;
+    }
+    contextP->objectList[0] = objectP;
+    contextP->numObject = 1;
+
+    memset(serverP, 0, sizeof(lwm2m_server_t));
+    serverP->shortID = 1;
+    serverP->sessionH = OBSERVE_SESSION;
+    serverP->status = STATE_REGISTERED;
+    serverP->lifetime = 86400;
+    contextP->serverList = serverP;
+
+    return contextP;
+}
+
+// Sends a request of the server to the client and returns the code of the answer. query NULL
+// stands for an Observe request.
+static uint8_t prv_request(lwm2m_context_t * contextP,
+                           const char * path,
+                           const char * query)
+{
+    static uint16_t mid = 0;
+    coap_packet_t message[1];
+    uint8_t buffer[COAP_MAX_HEADER_SIZE + 64];
+    uint8_t token[2];
+    size_t length;
+
+    mid++;
+    token[0] = (uint8_t)(mid >> 8);
+    token[1] = (uint8_t)mid;
+    if (NULL == query)
+    {
+        coap_init_message(message, COAP_TYPE_CON, COAP_GET, mid);
+        coap_set_header_observe(message, 0);
+    }
+    else
+    {
+        coap_init_message(message, COAP_TYPE_CON, COAP_PUT, mid);
+        coap_set_header_uri_query(message, query);
+    }
+    coap_set_header_uri_path(message, path);
+    coap_set_header_token(message, token, sizeof(token));
+    length = coap_serialize_message(message, buffer);
+
+    sentLength = 0;
+    lwm2m_handle_packet(contextP, buffer, (int)length, OBSERVE_SESSION);
+    if (sentLength < 4) return 0;
+
+    return sentBuffer[1];
+}
+
+// Returns the watcher of the server for the resource /3/0/resourceId, if any.
+static lwm2m_watcher_t * prv_watcher(lwm2m_context_t * contextP,
+                                     int resourceId)
+{
+    lwm2m_observed_t * observedP;
+
+    for (observedP = contextP->observedList ; NULL != observedP ; observedP = observedP->next)
+    {
+        if (resourceId < 0 && !LWM2M_URI_IS_SET_RESOURCE((&observedP->uri))) return observedP->watcherList;
+        if (resourceId >= 0 && LWM2M_URI_IS_SET_RESOURCE((&observedP->uri)) && observedP->uri.resourceId == resourceId)
+        {
+            return observedP->watcherList;
+        }
+    }
+
+    return NULL;
+}
+
+static void test_attributes_periods(void)
+{
+    MEMORY_TRACE_BEFORE;
+    lwm2m_context_t * contextP;
+    lwm2m_object_t object;
+    lwm2m_list_t instance;
+    lwm2m_watcher_t * watcherP;
+
+    contextP = prv_clientNew(&object, &instance);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "pmin=10&pmax=20"), COAP_204_CHANGED);
+    watcherP = prv_watcher(contextP, 1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(watcherP);
+    CU_ASSERT_EQUAL(watcherP->attributes.flags, LWM2M_ATTR_FLAG_MIN_PERIOD | LWM2M_ATTR_FLAG_MAX_PERIOD);
+    CU_ASSERT_EQUAL(watcherP->attributes.minPeriod, 10);
+    CU_ASSERT_EQUAL(watcherP->attributes.maxPeriod, 20);
+
+    // pmin must not exceed pmax, including the one already set
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "pmin=30"), COAP_400_BAD_REQUEST);
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "pmax=5"), COAP_400_BAD_REQUEST);
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "pmin=20"), COAP_204_CHANGED);
+    CU_ASSERT_EQUAL(watcherP->attributes.minPeriod, 20);
+    CU_ASSERT_EQUAL(watcherP->attributes.maxPeriod, 20);
+
+    // grammar errors leave the attributes as they are
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "pmin=abc"), COAP_400_BAD_REQUEST);
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "pmin=-1"), COAP_400_BAD_REQUEST);
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "pmin:1"), COAP_400_BAD_REQUEST);
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "foo=1"), COAP_400_BAD_REQUEST);
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "pmin=1&pmin=2"), COAP_400_BAD_REQUEST);
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "pmax&pmax=40"), COAP_400_BAD_REQUEST);
+    CU_ASSERT_EQUAL(watcherP->attributes.flags, LWM2M_ATTR_FLAG_MIN_PERIOD | LWM2M_ATTR_FLAG_MAX_PERIOD);
+    CU_ASSERT_EQUAL(watcherP->attributes.minPeriod, 20);
+    CU_ASSERT_EQUAL(watcherP->attributes.maxPeriod, 20);
+
+    // a name without value clears the attribute, and pmax=0 stands for no maximum period
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "pmax"), COAP_204_CHANGED);
+    CU_ASSERT_EQUAL(watcherP->attributes.flags, LWM2M_ATTR_FLAG_MIN_PERIOD);
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "pmax=40"), COAP_204_CHANGED);
+    CU_ASSERT_EQUAL(watcherP->attributes.flags, LWM2M_ATTR_FLAG_MIN_PERIOD | LWM2M_ATTR_FLAG_MAX_PERIOD);
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "pmax=0"), COAP_204_CHANGED);
+    CU_ASSERT_EQUAL(watcherP->attributes.flags, LWM2M_ATTR_FLAG_MIN_PERIOD);
+
+    // the watcher of a resource not observed goes with its last attribute
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "pmin"), COAP_204_CHANGED);
+    CU_ASSERT_PTR_NULL(prv_watcher(contextP, 1));
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/2", "pmin"), COAP_204_CHANGED);
+    CU_ASSERT_PTR_NULL(prv_watcher(contextP, 2));
+
+    lwm2m_close(contextP);
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_attributes_numeric(void)
+{
+    MEMORY_TRACE_BEFORE;
+    lwm2m_context_t * contextP;
+    lwm2m_object_t object;
+    lwm2m_list_t instance;
+    lwm2m_watcher_t * watcherP;
+
+    contextP = prv_clientNew(&object, &instance);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    // the numerical attributes only apply to resources
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0", "gt=1"), COAP_400_BAD_REQUEST);
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0", "st=1"), COAP_400_BAD_REQUEST);
+    CU_ASSERT_PTR_NULL(prv_watcher(contextP, -1));
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0", "pmin=1"), COAP_204_CHANGED);
+    CU_ASSERT_PTR_NOT_NULL(prv_watcher(contextP, -1));
+
+    // lt < gt and lt + 2 * st < gt
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "gt=10&lt=10"), COAP_400_BAD_REQUEST);
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "gt=10&lt=5&st=2.5"), COAP_400_BAD_REQUEST);
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "gt=10&lt=5&st=2.4"), COAP_204_CHANGED);
+    watcherP = prv_watcher(contextP, 1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(watcherP);
+    CU_ASSERT_EQUAL(watcherP->attributes.flags, LWM2M_ATTR_FLAG_GREATER_THAN | LWM2M_ATTR_FLAG_LESS_THAN | LWM2M_ATTR_FLAG_STEP);
+    CU_ASSERT_DOUBLE_EQUAL(watcherP->attributes.greaterThan, 10, 0);
+    CU_ASSERT_DOUBLE_EQUAL(watcherP->attributes.lessThan, 5, 0);
+    CU_ASSERT_DOUBLE_EQUAL(watcherP->attributes.step, 2.4, 0);
+
+    // the rules apply to the attributes already set
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "gt=9"), COAP_400_BAD_REQUEST);
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "lt=10.5"), COAP_400_BAD_REQUEST);
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "st=-1"), COAP_400_BAD_REQUEST);
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "gt=1e"), COAP_400_BAD_REQUEST);
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "gt&gt=3"), COAP_400_BAD_REQUEST);
+    CU_ASSERT_DOUBLE_EQUAL(watcherP->attributes.greaterThan, 10, 0);
+    CU_ASSERT_DOUBLE_EQUAL(watcherP->attributes.step, 2.4, 0);
+
+    // without gt, lt and st are not bound
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "gt&lt=20&st=100"), COAP_204_CHANGED);
+    CU_ASSERT_EQUAL(watcherP->attributes.flags, LWM2M_ATTR_FLAG_LESS_THAN | LWM2M_ATTR_FLAG_STEP);
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "gt=30"), COAP_400_BAD_REQUEST);
+
+    lwm2m_close(contextP);
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_attributes_schedule(void)
+{
+    MEMORY_TRACE_BEFORE;
+    lwm2m_context_t * contextP;
+    lwm2m_object_t object;
+    lwm2m_list_t instance;
+    lwm2m_watcher_t * watcherP;
+
+    contextP = prv_clientNew(&object, &instance);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    // attributes alone do not schedule anything
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "pmax=5"), COAP_204_CHANGED);
+    watcherP = prv_watcher(contextP, 1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(watcherP);
+    CU_ASSERT_FALSE(watcherP->active);
+    CU_ASSERT_EQUAL(watcherP->heapIndex, 0);
+
+    // once observed, a notification is due pmax seconds after the last one
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", NULL), COAP_205_CONTENT);
+    CU_ASSERT_PTR_EQUAL(prv_watcher(contextP, 1), watcherP);
+    CU_ASSERT_TRUE(watcherP->active);
+    CU_ASSERT_NOT_EQUAL(watcherP->heapIndex, 0);
+    CU_ASSERT_EQUAL(watcherP->nextTime, watcherP->lastTime + 5000);
+
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "pmax=60"), COAP_204_CHANGED);
+    CU_ASSERT_NOT_EQUAL(watcherP->heapIndex, 0);
+    CU_ASSERT_EQUAL(watcherP->nextTime, watcherP->lastTime + 60000);
+
+    // without maximum period, nothing is due until a change
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "pmax=0"), COAP_204_CHANGED);
+    CU_ASSERT_EQUAL(watcherP->heapIndex, 0);
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "pmax=60"), COAP_204_CHANGED);
+    CU_ASSERT_NOT_EQUAL(watcherP->heapIndex, 0);
+    CU_ASSERT_EQUAL(prv_request(contextP, "/3/0/1", "pmax"), COAP_204_CHANGED);
+    CU_ASSERT_EQUAL(watcherP->heapIndex, 0);
+
+    // an observed resource keeps its watcher without attributes
+    CU_ASSERT_PTR_EQUAL(prv_watcher(contextP, 1), watcherP);
+    CU_ASSERT_EQUAL(watcherP->attributes.flags, 0);
+
+    lwm2m_close(contextP);
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static struct TestTable table[] = {
+        { "test of reordered notifications", test_notify_order },
+        { "test of the Observe value wraparound", test_notify_wraparound },
+        { "test of the Observe value window", test_notify_window },
+        { "test of the reordering delay", test_notify_delay },
+        { "test of the period attributes", test_attributes_periods },
+        { "test of the numerical attributes", test_attributes_numeric },
+        { "test of the schedule set by the attributes", test_attributes_schedule },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_observe_suit()
+{
+   CU_pSuite pSuite = NULL;
+
+   pSuite = CU_add_suite("Suite_observe", NULL, NULL);
+   if (NULL == pSuite) {
+      return CU_get_error();
+   }
+
+   return add_tests(pSuite, table);
+}
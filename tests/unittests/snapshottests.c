@@ -0,0 +1,414 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2015 Bosch Software Innovations GmbH, Germany.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Bosch Software Innovations GmbH - Please refer to git log
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "liblwm2m.h"
+#include "internals.h"
+#include "memtest.h"
+
+#include <string.h>
+
+#define SNAPSHOT_MAX_LENGTH     512
+#define SNAPSHOT_LIFETIME       300         // s
+#define SNAPSHOT_REMAINING      200000      // ms
+#define SNAPSHOT_AGE            5000        // ms
+
+typedef struct
+{
+    uint16_t id;
+    uint8_t  token[2];
+    uint32_t counter;
+} snapshot_observation_t;
+
+typedef struct
+{
+    uint16_t                 internalID;
+    const char *             name;
+    snapshot_observation_t * observations;
+    int                      observationCount;
+} snapshot_client_t;
+
+static snapshot_observation_t firstObservations[] = {
+        { 0, { 0x10, 0x01 }, 5 },
+        { 3, { 0x10, 0x02 }, 70000 },
+};
+
+static snapshot_observation_t secondObservations[] = {
+        { 1, { 0x20, 0x01 }, 1 },
+};
+
+static snapshot_client_t validClients[] = {
+        { 0, "ep1", firstObservations, 2 },
+        { 4, "ep2", secondObservations, 1 },
+};
+
+static snapshot_client_t duplicateNameClients[] = {
+        { 0, "ep1", firstObservations, 2 },
+        { 4, "ep1", secondObservations, 1 },
+};
+
+static snapshot_observation_t duplicateTokenObservations[] = {
+        { 1, { 0x10, 0x02 }, 1 },
+};
+
+static snapshot_client_t duplicateTokenClients[] = {
+        { 0, "ep1", firstObservations, 2 },
+        { 4, "ep2", duplicateTokenObservations, 1 },
+};
+
+static snapshot_observation_t unorderedObservations[] = {
+        { 3, { 0x10, 0x01 }, 5 },
+        { 1, { 0x10, 0x02 }, 6 },
+};
+
+static snapshot_client_t unorderedClients[] = {
+        { 0, "ep1", unorderedObservations, 2 },
+};
+
+static void prv_put(uint8_t * buffer,
+                    size_t * indexP,
+                    uint64_t value,
+                    size_t length)
+{
+    size_t i;
+
+    for (i = 0 ; i < length ; i++)
+    {
+        buffer[*indexP + i] = (uint8_t)(value >> (8 * (length - 1 - i)));
+    }
+    *indexP += length;
+}
+
+static void prv_putString(uint8_t * buffer,
+                          size_t * indexP,
+                          const char * string)
+{
+    if (NULL == string)
+    {
+        prv_put(buffer, indexP, 0xFFFF, 2);
+        return;
+    }
+    prv_put(buffer, indexP, strlen(string), 2);
+    memcpy(buffer + *indexP, string, strlen(string));
+    *indexP += strlen(string);
+}
+
+// Writes a snapshot in the format documented in snapshot.c. Each client has the object 3
+// with its instance 0 and its session is the byte 1.
+static size_t prv_writeSnapshot(uint8_t * buffer,
+                                snapshot_client_t * clients,
+                                int clientCount)
+{
+    size_t index;
+    int i;
+    int j;
+
+    index = 0;
+    memcpy(buffer, "LWS", 3);
+    index += 3;
+    prv_put(buffer, &index, 1, 1);
+    prv_put(buffer, &index, clientCount, 4);
+    for (i = 0 ; i < clientCount ; i++)
+    {
+        prv_put(buffer, &index, clients[i].internalID, 2);
+        prv_put(buffer, &index, BINDING_U, 1);
+        prv_put(buffer, &index, SNAPSHOT_LIFETIME, 4);
+        prv_put(buffer, &index, SNAPSHOT_REMAINING, 8);
+        prv_putString(buffer, &index, clients[i].name);
+        prv_putString(buffer, &index, NULL);
+        prv_putString(buffer, &index, NULL);
+        prv_put(buffer, &index, 1, 1);
+        prv_put(buffer, &index, 1, 1);
+        prv_put(buffer, &index, 1, 2);
+        prv_put(buffer, &index, 3, 2);
+        prv_put(buffer, &index, 1, 2);
+        prv_put(buffer, &index, 0, 2);
+        prv_put(buffer, &index, clients[i].observationCount, 2);
+        for (j = 0 ; j < clients[i].observationCount ; j++)
+        {
+            snapshot_observation_t * observationP = clients[i].observations + j;
+
+            prv_put(buffer, &index, observationP->id, 2);
+            prv_put(buffer, &index, LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID | LWM2M_URI_FLAG_RESOURCE_ID, 1);
+            prv_put(buffer, &index, 3, 2);
+            prv_put(buffer, &index, 0, 2);
+            prv_put(buffer, &index, observationP->id, 2);
+            prv_put(buffer, &index, sizeof(observationP->token), 1);
+            memcpy(buffer + index, observationP->token, sizeof(observationP->token));
+            index += sizeof(observationP->token);
+            prv_put(buffer, &index, observationP->counter, 4);
+            prv_put(buffer, &index, SNAPSHOT_AGE, 8);
+        }
+    }
+
+    return index;
+}
+
+static void * prv_connect(uint16_t secObjInstID,
+                          void * userData)
+{
+    (void)secObjInstID;
+    (void)userData;
+
+    return NULL;
+}
+
+static uint8_t prv_send(void * sessionH,
+                        uint8_t * buffer,
+                        size_t length,
+                        void * userData)
+{
+    (void)sessionH;
+    (void)buffer;
+    (void)length;
+    (void)userData;
+
+    return COAP_NO_ERROR;
+}
+
+static size_t prv_sessionSave(void * sessionH,
+                              uint8_t * buffer,
+                              size_t length,
+                              void * userData)
+{
+    (void)userData;
+
+    if (length < 1) return 0;
+    buffer[0] = (uint8_t)(intptr_t)sessionH;
+
+    return 1;
+}
+
+static void * prv_sessionLoad(const uint8_t * buffer,
+                              size_t length,
+                              void * userData)
+{
+    (void)userData;
+
+    if (1 != length) return NULL;
+
+    return (void *)(intptr_t)buffer[0];
+}
+
+static void prv_notify(uint16_t clientID,
+                       lwm2m_uri_t * uriP,
+                       int status,
+                       lwm2m_media_type_t format,
+                       uint8_t * data,
+                       int dataLength,
+                       void * userData)
+{
+    (void)clientID;
+    (void)uriP;
+    (void)status;
+    (void)format;
+    (void)data;
+    (void)dataLength;
+    (void)userData;
+}
+
+static lwm2m_context_t * prv_newContext(void)
+{
+    return lwm2m_init(prv_connect, prv_send, NULL);
+}
+
+static int prv_restore(lwm2m_context_t * contextP,
+                       const uint8_t * buffer,
+                       size_t length)
+{
+    return lwm2m_snapshot_restore(contextP, buffer, length, prv_sessionLoad, NULL, prv_notify, NULL);
+}
+
+// Checks that the context holds exactly the clients and observations of validClients, restored
+// less than a second ago.
+static void prv_checkValid(lwm2m_context_t * contextP)
+{
+    int64_t currentTime;
+    int i;
+    int j;
+
+    currentTime = lwm2m_gettime_ms();
+    CU_ASSERT_EQUAL(contextP->clientCount, sizeof(validClients) / sizeof(validClients[0]));
+    for (i = 0 ; i < (int)(sizeof(validClients) / sizeof(validClients[0])) ; i++)
+    {
+        lwm2m_client_t * clientP;
+        lwm2m_observation_t * observationP;
+
+        clientP = registration_find_client(contextP, validClients[i].internalID);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(clientP);
+        CU_ASSERT_STRING_EQUAL(clientP->name, validClients[i].name);
+        CU_ASSERT_PTR_NULL(clientP->msisdn);
+        CU_ASSERT_EQUAL(clientP->binding, BINDING_U);
+        CU_ASSERT_EQUAL(clientP->lifetime, SNAPSHOT_LIFETIME);
+        CU_ASSERT(clientP->endOfLife <= currentTime + SNAPSHOT_REMAINING);
+        CU_ASSERT(clientP->endOfLife > currentTime + SNAPSHOT_REMAINING - 1000);
+        CU_ASSERT_EQUAL(clientP->sessionH, (void *)1);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(clientP->objectList);
+        CU_ASSERT_EQUAL(clientP->objectList->id, 3);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(clientP->objectList->instanceList);
+        CU_ASSERT_EQUAL(clientP->objectList->instanceList->id, 0);
+
+        observationP = clientP->observationList;
+        for (j = 0 ; j < validClients[i].observationCount ; j++)
+        {
+            snapshot_observation_t * expectedP = validClients[i].observations + j;
+
+            CU_ASSERT_PTR_NOT_NULL_FATAL(observationP);
+            CU_ASSERT_EQUAL(observationP->id, expectedP->id);
+            CU_ASSERT_EQUAL(observationP->status, STATE_REGISTERED);
+            CU_ASSERT_EQUAL(observationP->uri.resourceId, expectedP->id);
+            CU_ASSERT_EQUAL(observationP->tokenLen, sizeof(expectedP->token));
+            CU_ASSERT(0 == memcmp(observationP->token, expectedP->token, sizeof(expectedP->token)));
+            CU_ASSERT_EQUAL(observationP->counter, expectedP->counter);
+            CU_ASSERT(observationP->counterTime <= currentTime - SNAPSHOT_AGE);
+            CU_ASSERT(observationP->counterTime > currentTime - SNAPSHOT_AGE - 1000);
+            observationP = observationP->next;
+        }
+        CU_ASSERT_PTR_NULL(observationP);
+    }
+}
+
+// A rejected snapshot leaves the context empty: a valid one can be restored right away.
+static void prv_checkRejected(uint8_t * buffer,
+                              size_t length)
+{
+    lwm2m_context_t * contextP;
+    uint8_t valid[SNAPSHOT_MAX_LENGTH];
+    size_t validLength;
+
+    contextP = prv_newContext();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    CU_ASSERT_NOT_EQUAL(prv_restore(contextP, buffer, length), 0);
+    registration_free_clients(contextP);
+    CU_ASSERT_EQUAL(contextP->clientCount, 0);
+    CU_ASSERT_PTR_NULL(contextP->clientList);
+    CU_ASSERT_EQUAL(lwm2m_id_set_previous(&contextP->clientIds, LWM2M_MAX_ID), -1);
+
+    validLength = prv_writeSnapshot(valid, validClients, sizeof(validClients) / sizeof(validClients[0]));
+    CU_ASSERT_EQUAL(prv_restore(contextP, valid, validLength), 0);
+    prv_checkValid(contextP);
+
+    lwm2m_close(contextP);
+}
+
+static void test_snapshot_roundtrip(void)
+{
+    MEMORY_TRACE_BEFORE;
+    lwm2m_context_t * contextP;
+    uint8_t buffer[SNAPSHOT_MAX_LENGTH];
+    uint8_t saved[SNAPSHOT_MAX_LENGTH];
+    size_t length;
+    size_t savedLength;
+
+    length = prv_writeSnapshot(buffer, validClients, sizeof(validClients) / sizeof(validClients[0]));
+
+    contextP = prv_newContext();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+    CU_ASSERT_EQUAL_FATAL(prv_restore(contextP, buffer, length), 0);
+    prv_checkValid(contextP);
+
+    // a restored context does not accept a second snapshot
+    CU_ASSERT_EQUAL(prv_restore(contextP, buffer, length), COAP_405_METHOD_NOT_ALLOWED);
+    prv_checkValid(contextP);
+
+    CU_ASSERT_EQUAL(lwm2m_snapshot_save(contextP, NULL, 0, prv_sessionSave, NULL), length);
+    CU_ASSERT_EQUAL(lwm2m_snapshot_save(contextP, saved, length - 1, prv_sessionSave, NULL), 0);
+    savedLength = lwm2m_snapshot_save(contextP, saved, sizeof(saved), prv_sessionSave, NULL);
+    CU_ASSERT_EQUAL_FATAL(savedLength, length);
+    lwm2m_close(contextP);
+
+    contextP = prv_newContext();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+    CU_ASSERT_EQUAL_FATAL(prv_restore(contextP, saved, savedLength), 0);
+    prv_checkValid(contextP);
+    lwm2m_close(contextP);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_snapshot_truncated(void)
+{
+    MEMORY_TRACE_BEFORE;
+    uint8_t buffer[SNAPSHOT_MAX_LENGTH];
+    size_t length;
+    size_t i;
+
+    length = prv_writeSnapshot(buffer, validClients, sizeof(validClients) / sizeof(validClients[0]));
+    for (i = 0 ; i < length ; i++)
+    {
+        prv_checkRejected(buffer, i);
+    }
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_snapshot_header(void)
+{
+    MEMORY_TRACE_BEFORE;
+    uint8_t buffer[SNAPSHOT_MAX_LENGTH];
+    size_t length;
+
+    length = prv_writeSnapshot(buffer, validClients, sizeof(validClients) / sizeof(validClients[0]));
+    buffer[0] = 'X';
+    prv_checkRejected(buffer, length);
+
+    length = prv_writeSnapshot(buffer, validClients, sizeof(validClients) / sizeof(validClients[0]));
+    buffer[3] = 2;
+    prv_checkRejected(buffer, length);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_snapshot_duplicate(void)
+{
+    MEMORY_TRACE_BEFORE;
+    uint8_t buffer[SNAPSHOT_MAX_LENGTH];
+    size_t length;
+
+    length = prv_writeSnapshot(buffer, duplicateNameClients, sizeof(duplicateNameClients) / sizeof(duplicateNameClients[0]));
+    prv_checkRejected(buffer, length);
+
+    length = prv_writeSnapshot(buffer, duplicateTokenClients, sizeof(duplicateTokenClients) / sizeof(duplicateTokenClients[0]));
+    prv_checkRejected(buffer, length);
+
+    length = prv_writeSnapshot(buffer, unorderedClients, sizeof(unorderedClients) / sizeof(unorderedClients[0]));
+    prv_checkRejected(buffer, length);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static struct TestTable table[] = {
+        { "test of a snapshot round trip", test_snapshot_roundtrip },
+        { "test of truncated snapshots", test_snapshot_truncated },
+        { "test of a bad magic and version", test_snapshot_header },
+        { "test of duplicate names, tokens and unordered IDs", test_snapshot_duplicate },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_snapshot_suit()
+{
+   CU_pSuite pSuite = NULL;
+
+   pSuite = CU_add_suite("Suite_snapshot", NULL, NULL);
+   if (NULL == pSuite) {
+      return CU_get_error();
+   }
+
+   return add_tests(pSuite, table);
+}
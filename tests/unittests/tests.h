@@ -28,6 +28,13 @@ struct TestTable {
 CU_ErrorCode add_tests(CU_pSuite pSuite, struct TestTable* testTable);
 CU_ErrorCode create_uri_suit();
 CU_ErrorCode create_tlv_suit();
+CU_ErrorCode create_json_suit();
+CU_ErrorCode create_utils_suit();
+CU_ErrorCode create_coap_suit();
+CU_ErrorCode create_list_suit();
+CU_ErrorCode create_transaction_suit();
+CU_ErrorCode create_snapshot_suit();
+CU_ErrorCode create_observe_suit();
 CU_ErrorCode create_object_read_suit();
 
 #endif /* TESTS_H_ */
@@ -236,7 +236,7 @@ static void test_tlv_parse()
     lwm2m_data_t *dataP;
     lwm2m_data_t *tlvSubP;
 
-    result = lwm2m_data_parse(data1, sizeof(data1), &dataP);
+    result = lwm2m_data_parse(data1, sizeof(data1), LWM2M_CONTENT_TLV, &dataP);
     CU_ASSERT_EQUAL(result, 1);
     CU_ASSERT_PTR_NOT_NULL_FATAL(dataP);
     CU_ASSERT_EQUAL(dataP->type, LWM2M_TYPE_RESOURCE);
@@ -245,7 +245,7 @@ static void test_tlv_parse()
     CU_ASSERT(0 == memcmp(dataP->value, &data1[2], 3));
     lwm2m_data_free(result, dataP);
 
-    result = lwm2m_data_parse(data2, sizeof(data2), &dataP);
+    result = lwm2m_data_parse(data2, sizeof(data2), LWM2M_CONTENT_TLV, &dataP);
     CU_ASSERT_EQUAL(result, 1);
     CU_ASSERT_PTR_NOT_NULL_FATAL(dataP);
     CU_ASSERT_EQUAL(dataP->type, LWM2M_TYPE_OBJECT_INSTANCE);
@@ -265,7 +265,7 @@ static void test_tlv_parse()
     CU_ASSERT(0 == memcmp(tlvSubP[1].value, &data2[12], 9));
     lwm2m_data_free(result, dataP);
 
-    result = lwm2m_data_parse(data3, sizeof(data3), &dataP);
+    result = lwm2m_data_parse(data3, sizeof(data3), LWM2M_CONTENT_TLV, &dataP);
     CU_ASSERT_EQUAL(result, 1);
     CU_ASSERT_PTR_NOT_NULL_FATAL(dataP);
     CU_ASSERT_EQUAL(dataP->type, LWM2M_TYPE_OBJECT_INSTANCE);
@@ -304,6 +304,7 @@ static void test_tlv_serialize()
     uint8_t data1[] = {1, 2, 3, 4};
     uint8_t data2[170] = {5, 6, 7, 8};
     uint8_t* buffer;
+    lwm2m_media_type_t format;
 
     dataP =  lwm2m_data_new(1);
     CU_ASSERT_PTR_NOT_NULL_FATAL(dataP);
@@ -333,7 +334,8 @@ static void test_tlv_serialize()
     tlvSubP[0].length = sizeof(data2);
     tlvSubP[0].value = data2;
 
-    result = lwm2m_data_serialize(1, dataP, &buffer);
+    format = LWM2M_CONTENT_TLV;
+    result = lwm2m_data_serialize(1, dataP, &format, &buffer);
     CU_ASSERT_EQUAL(result, sizeof(data2) + sizeof(data1) + 11);
 
     CU_ASSERT_EQUAL(buffer[0], 0x08);
@@ -359,6 +361,168 @@ static void test_tlv_serialize()
     MEMORY_TRACE_AFTER_EQ;
 }
 
+static void test_tlv_parse_tree(void)
+{
+    MEMORY_TRACE_BEFORE;
+    // Instance 1 {Resource 2 {7}, MultiResource 3 {}, MultiResource 4 {ResourceInstance 0 {8}, ResourceInstance 1 {9}}}, Instance 5 {}
+    uint8_t data[] = {0x08, 1, 13, 0xC1, 2, 7, 0x80, 3, 0x86, 4, 0x41, 0, 8, 0x41, 1, 9, 0x00, 5};
+    int result;
+    lwm2m_data_t *dataP;
+    lwm2m_data_t *tlvSubP;
+
+    result = lwm2m_data_parse(data, sizeof(data), LWM2M_CONTENT_TLV, &dataP);
+    CU_ASSERT_EQUAL_FATAL(result, 2);
+
+    CU_ASSERT_EQUAL(dataP[0].type, LWM2M_TYPE_OBJECT_INSTANCE);
+    CU_ASSERT_EQUAL(dataP[0].id, 1);
+    CU_ASSERT_EQUAL_FATAL(dataP[0].length, 3);
+    CU_ASSERT_EQUAL(dataP[1].type, LWM2M_TYPE_OBJECT_INSTANCE);
+    CU_ASSERT_EQUAL(dataP[1].id, 5);
+    CU_ASSERT_EQUAL(dataP[1].length, 0);
+
+    // the whole tree is in a single allocation
+    tlvSubP = (lwm2m_data_t *)dataP[0].value;
+    CU_ASSERT_PTR_EQUAL(tlvSubP, dataP + 2);
+    CU_ASSERT_EQUAL(tlvSubP[0].id, 2);
+    CU_ASSERT_EQUAL(tlvSubP[0].length, 1);
+    CU_ASSERT_EQUAL(tlvSubP[0].value[0], 7);
+    CU_ASSERT_EQUAL(tlvSubP[1].type, LWM2M_TYPE_MULTIPLE_RESOURCE);
+    CU_ASSERT_EQUAL(tlvSubP[1].length, 0);
+    CU_ASSERT_EQUAL(tlvSubP[2].type, LWM2M_TYPE_MULTIPLE_RESOURCE);
+    CU_ASSERT_EQUAL_FATAL(tlvSubP[2].length, 2);
+
+    tlvSubP = (lwm2m_data_t *)tlvSubP[2].value;
+    CU_ASSERT_PTR_EQUAL(tlvSubP, dataP + 5);
+    CU_ASSERT_EQUAL(tlvSubP[0].type, LWM2M_TYPE_RESOURCE_INSTANCE);
+    CU_ASSERT_EQUAL(tlvSubP[0].value[0], 8);
+    CU_ASSERT_EQUAL(tlvSubP[1].id, 1);
+    CU_ASSERT_EQUAL(tlvSubP[1].value[0], 9);
+
+    lwm2m_data_free(result, dataP);
+
+    // a container without any valid record
+    data[8] = 0x81;
+    result = lwm2m_data_parse(data, sizeof(data), LWM2M_CONTENT_TLV, &dataP);
+    CU_ASSERT_EQUAL(result, 0);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_tlv_iterator(void)
+{
+    MEMORY_TRACE_BEFORE;
+    uint8_t data[] = {0x08, 1, 13, 0xC1, 2, 7, 0x80, 3, 0x86, 4, 0x41, 0, 8, 0x41, 1, 9, 0x00, 5, 0xC1, 6, 10};
+    lwm2m_tlv_iterator_t iterator;
+    lwm2m_data_t data1;
+
+    lwm2m_tlv_iterator_init(&iterator, data, sizeof(data));
+
+    CU_ASSERT_EQUAL_FATAL(lwm2m_tlv_iterator_next(&iterator, &data1), 1);
+    CU_ASSERT_EQUAL(data1.type, LWM2M_TYPE_RESOURCE);
+    CU_ASSERT_EQUAL(data1.id, 2);
+    CU_ASSERT_EQUAL(data1.length, 1);
+    CU_ASSERT_PTR_EQUAL(data1.value, data + 5);
+    CU_ASSERT_EQUAL(iterator.instanceId, 1);
+    CU_ASSERT_EQUAL(iterator.resourceId, LWM2M_MAX_ID);
+
+    CU_ASSERT_EQUAL_FATAL(lwm2m_tlv_iterator_next(&iterator, &data1), 1);
+    CU_ASSERT_EQUAL(data1.type, LWM2M_TYPE_RESOURCE_INSTANCE);
+    CU_ASSERT_EQUAL(data1.id, 0);
+    CU_ASSERT_EQUAL(data1.value[0], 8);
+    CU_ASSERT_EQUAL(iterator.instanceId, 1);
+    CU_ASSERT_EQUAL(iterator.resourceId, 4);
+
+    CU_ASSERT_EQUAL_FATAL(lwm2m_tlv_iterator_next(&iterator, &data1), 1);
+    CU_ASSERT_EQUAL(data1.id, 1);
+    CU_ASSERT_EQUAL(data1.value[0], 9);
+    CU_ASSERT_EQUAL(iterator.resourceId, 4);
+
+    // outside of any container after the empty instance 5
+    CU_ASSERT_EQUAL_FATAL(lwm2m_tlv_iterator_next(&iterator, &data1), 1);
+    CU_ASSERT_EQUAL(data1.id, 6);
+    CU_ASSERT_EQUAL(data1.value[0], 10);
+    CU_ASSERT_EQUAL(iterator.instanceId, LWM2M_MAX_ID);
+    CU_ASSERT_EQUAL(iterator.resourceId, LWM2M_MAX_ID);
+
+    CU_ASSERT_EQUAL(lwm2m_tlv_iterator_next(&iterator, &data1), 0);
+
+    // an object instance in a multiple resource
+    data[10] = 0x01;
+    lwm2m_tlv_iterator_init(&iterator, data, sizeof(data));
+    CU_ASSERT_EQUAL(lwm2m_tlv_iterator_next(&iterator, &data1), 1);
+    CU_ASSERT_EQUAL(lwm2m_tlv_iterator_next(&iterator, &data1), -1);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_dataToTLV(void)
+{
+    MEMORY_TRACE_BEFORE;
+    int result;
+    lwm2m_data_t *dataP;
+    lwm2m_data_t *tlvSubP;
+    uint8_t data1[] = {1, 2, 3, 4};
+    uint8_t data2[300] = {5, 6, 7, 8};
+    uint8_t buffer[sizeof(data1) + sizeof(data2) + 16];
+
+    dataP =  lwm2m_data_new(1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(dataP);
+    tlvSubP =  lwm2m_data_new(2);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(tlvSubP);
+
+    tlvSubP[0].type = LWM2M_TYPE_RESOURCE;
+    tlvSubP[0].flags = LWM2M_TLV_FLAG_STATIC_DATA;
+    tlvSubP[0].id = 66;
+    tlvSubP[0].length = sizeof(data1);
+    tlvSubP[0].value = data1;
+
+    tlvSubP[1].type = LWM2M_TYPE_MULTIPLE_RESOURCE;
+    tlvSubP[1].id = 0x1234;
+    tlvSubP[1].length = 1;
+    tlvSubP[1].value = (uint8_t *) lwm2m_data_new(1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(tlvSubP[1].value);
+    lwm2m_data_include(tlvSubP, 2, dataP);
+    dataP->id = 3;
+    tlvSubP = (lwm2m_data_t *)tlvSubP[1].value;
+
+    tlvSubP[0].type = LWM2M_TYPE_RESOURCE_INSTANCE;
+    tlvSubP[0].flags = LWM2M_TLV_FLAG_STATIC_DATA;
+    tlvSubP[0].id = 0;
+    tlvSubP[0].length = sizeof(data2);
+    tlvSubP[0].value = data2;
+
+    // object instance, resource, multiple resource with a 16-bit ID, resource instance of 300 bytes
+    result = lwm2m_dataToTLV(1, dataP, NULL, 0);
+    CU_ASSERT_EQUAL(result, 4 + 2 + sizeof(data1) + 5 + 4 + sizeof(data2));
+
+    CU_ASSERT_EQUAL(lwm2m_dataToTLV(1, dataP, buffer, result - 1), 0);
+
+    result = lwm2m_dataToTLV(1, dataP, buffer, sizeof(buffer));
+    CU_ASSERT_EQUAL_FATAL(result, 4 + 2 + sizeof(data1) + 5 + 4 + sizeof(data2));
+
+    CU_ASSERT_EQUAL(buffer[0], 0x10);
+    CU_ASSERT_EQUAL(buffer[1], 3);
+    CU_ASSERT_EQUAL((buffer[2] << 8) + buffer[3], result - 4);
+
+    CU_ASSERT_EQUAL(buffer[4], 0xC0 + sizeof(data1));
+    CU_ASSERT_EQUAL(buffer[5], 66);
+    CU_ASSERT(0 == memcmp(data1, &buffer[6], sizeof(data1)));
+
+    CU_ASSERT_EQUAL(buffer[6 + sizeof(data1)], 0xB0);
+    CU_ASSERT_EQUAL(buffer[7 + sizeof(data1)], 0x12);
+    CU_ASSERT_EQUAL(buffer[8 + sizeof(data1)], 0x34);
+    CU_ASSERT_EQUAL((buffer[9 + sizeof(data1)] << 8) + buffer[10 + sizeof(data1)], sizeof(data2) + 4);
+
+    CU_ASSERT_EQUAL(buffer[11 + sizeof(data1)], 0x50);
+    CU_ASSERT_EQUAL(buffer[12 + sizeof(data1)], 0);
+    CU_ASSERT_EQUAL((buffer[13 + sizeof(data1)] << 8) + buffer[14 + sizeof(data1)], sizeof(data2));
+    CU_ASSERT(0 == memcmp(data2, &buffer[15 + sizeof(data1)], sizeof(data2)));
+
+    lwm2m_data_free(1, dataP);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
 static void test_tlv_encode_int(void)
 {
    MEMORY_TRACE_BEFORE;
@@ -560,7 +724,10 @@ static struct TestTable table[] = {
         { "test of lwm2m_decodeTLV()", test_decodeTLV },
         { "test of lwm2m_opaqueToInt()", test_opaqueToInt },
         { "test of lwm2m_data_parse()", test_tlv_parse },
+        { "test of lwm2m_data_parse() with nested containers", test_tlv_parse_tree },
+        { "test of lwm2m_tlv_iterator_next()", test_tlv_iterator },
         { "test of lwm2m_data_serialize()", test_tlv_serialize },
+        { "test of lwm2m_dataToTLV()", test_dataToTLV },
         { "test of lwm2m_data_encode_int()", test_tlv_encode_int },
         { "test of lwm2m_data_decode_int()", test_tlv_decode_int },
         { "test of lwm2m_data_encode_bool()", test_tlv_encode_bool },
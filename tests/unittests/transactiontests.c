@@ -0,0 +1,165 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2015 Bosch Software Innovations GmbH, Germany.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Bosch Software Innovations GmbH - Please refer to git log
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "liblwm2m.h"
+#include "internals.h"
+#include "memtest.h"
+
+#include <string.h>
+
+#define TRANSACTION_COUNT   4
+
+static int sentCount;
+static uint16_t sentMids[TRANSACTION_COUNT * 2];
+static int answeredCount;
+
+static void * prv_connect(uint16_t secObjInstID,
+                          void * userData)
+{
+    (void)secObjInstID;
+    (void)userData;
+
+    return NULL;
+}
+
+static uint8_t prv_send(void * sessionH,
+                        uint8_t * buffer,
+                        size_t length,
+                        void * userData)
+{
+    (void)sessionH;
+    (void)length;
+    (void)userData;
+
+    if (sentCount < (int)(sizeof(sentMids) / sizeof(sentMids[0])))
+    {
+        sentMids[sentCount] = (uint16_t)((buffer[2] << 8) | buffer[3]);
+    }
+    sentCount++;
+
+    return COAP_NO_ERROR;
+}
+
+static void prv_callback(lwm2m_transaction_t * transacP,
+                         void * message)
+{
+    (void)transacP;
+
+    if (NULL != message) answeredCount++;
+}
+
+static void prv_receive(lwm2m_context_t * contextP,
+                        void * sessionH,
+                        coap_message_type_t type,
+                        uint8_t code,
+                        uint16_t mid)
+{
+    coap_packet_t message[1];
+    uint8_t buffer[COAP_MAX_HEADER_SIZE];
+    size_t length;
+
+    coap_init_message(message, type, code, mid);
+    length = coap_serialize_message(message, buffer);
+    lwm2m_handle_packet(contextP, buffer, (int)length, sessionH);
+}
+
+// An ACK or a RST carrying the mID of a transaction still in the pendingList must not touch it.
+static void test_stray_answer(coap_message_type_t type,
+                              uint8_t code)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_server_t server;
+    lwm2m_transaction_t * transactions[TRANSACTION_COUNT];
+    void * sessionH = (void *)1;
+    int i;
+
+    contextP = lwm2m_init(prv_connect, prv_send, NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+    memset(&server, 0, sizeof(server));
+    server.sessionH = sessionH;
+    sentCount = 0;
+    answeredCount = 0;
+
+    for (i = 0 ; i < TRANSACTION_COUNT ; i++)
+    {
+        transactions[i] = transaction_new(COAP_TYPE_CON, COAP_POST, NULL, NULL, contextP->nextMID++, 0, NULL, ENDPOINT_SERVER, &server);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(transactions[i]);
+        transactions[i]->callback = prv_callback;
+        transaction_add(contextP, transactions[i]);
+        transaction_send(contextP, transactions[i]);
+    }
+    // COAP_NSTART is 1: only the first transaction is sent
+    CU_ASSERT_EQUAL_FATAL(sentCount, 1);
+    CU_ASSERT_EQUAL(server.queue.outstanding, 1);
+
+    prv_receive(contextP, sessionH, type, code, transactions[2]->mID);
+    CU_ASSERT_EQUAL(answeredCount, 0);
+    CU_ASSERT_EQUAL(server.queue.outstanding, 1);
+    CU_ASSERT_EQUAL(sentCount, 1);
+
+    // the queue drains as the transactions actually sent are answered
+    for (i = 0 ; i < TRANSACTION_COUNT && i < sentCount ; i++)
+    {
+        prv_receive(contextP, sessionH, COAP_TYPE_ACK, COAP_204_CHANGED, sentMids[i]);
+    }
+    CU_ASSERT_EQUAL(sentCount, TRANSACTION_COUNT);
+    CU_ASSERT_EQUAL(answeredCount, TRANSACTION_COUNT);
+    CU_ASSERT_EQUAL(server.queue.outstanding, 0);
+    CU_ASSERT_PTR_NULL(server.queue.pendingList);
+    CU_ASSERT_PTR_NULL(server.queue.activeList);
+
+    transaction_remove_peer(contextP, &server.queue);
+    lwm2m_close(contextP);
+}
+
+static void test_stray_reset(void)
+{
+    MEMORY_TRACE_BEFORE;
+
+    test_stray_answer(COAP_TYPE_RST, 0);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_stray_ack(void)
+{
+    MEMORY_TRACE_BEFORE;
+
+    test_stray_answer(COAP_TYPE_ACK, COAP_204_CHANGED);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static struct TestTable table[] = {
+        { "test of a RST for a queued transaction", test_stray_reset },
+        { "test of an ACK for a queued transaction", test_stray_ack },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_transaction_suit()
+{
+   CU_pSuite pSuite = NULL;
+
+   pSuite = CU_add_suite("Suite_transaction", NULL, NULL);
+   if (NULL == pSuite) {
+      return CU_get_error();
+   }
+
+   return add_tests(pSuite, table);
+}
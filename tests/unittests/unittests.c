@@ -43,9 +43,30 @@ int main()
    if (CUE_SUCCESS != create_tlv_suit()) {
        goto exit;
    }
+   if (CUE_SUCCESS != create_json_suit()) {
+       goto exit;
+   }
+   if (CUE_SUCCESS != create_utils_suit()) {
+       goto exit;
+   }
    if (CUE_SUCCESS != create_uri_suit()) {
        goto exit;
    }
+   if (CUE_SUCCESS != create_coap_suit()) {
+       goto exit;
+   }
+   if (CUE_SUCCESS != create_list_suit()) {
+       goto exit;
+   }
+   if (CUE_SUCCESS != create_transaction_suit()) {
+       goto exit;
+   }
+   if (CUE_SUCCESS != create_snapshot_suit()) {
+       goto exit;
+   }
+   if (CUE_SUCCESS != create_observe_suit()) {
+       goto exit;
+   }
 
    CU_basic_set_mode(CU_BRM_VERBOSE);
    CU_basic_run_tests();
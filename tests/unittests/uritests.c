@@ -24,6 +24,7 @@
 
 static void test_uri_decode(void)
 {
+    lwm2m_uri_t uriStorage;
     lwm2m_uri_t* uri;
     multi_option_t extraID = { .next = NULL, .is_static = 1, .len = 3, .data = (uint8_t *) "555" };
     multi_option_t rID = { .next = NULL, .is_static = 1, .len = 1, .data = (uint8_t *) "0" };
@@ -37,73 +38,63 @@ static void test_uri_decode(void)
     MEMORY_TRACE_BEFORE;
 
     /* "/rd" */
-    uri = lwm2m_decode_uri(NULL, &reg);
+    uri = lwm2m_decode_uri(NULL, &reg, &uriStorage);
     CU_ASSERT_PTR_NOT_NULL_FATAL(uri);
     CU_ASSERT_EQUAL(uri->flag, LWM2M_URI_FLAG_REGISTRATION);
-    lwm2m_free(uri);
 
     /* "/rd/5a3f" */
     reg.next = &location;
-    uri = lwm2m_decode_uri(NULL, &reg);
+    uri = lwm2m_decode_uri(NULL, &reg, &uriStorage);
     /* should not fail, error in uri_parse */
     /* CU_ASSERT_PTR_NOT_NULL(uri); */
-    lwm2m_free(uri);
 
     /* "/rd/5312" */
     reg.next = &locationDecimal;
-    uri = lwm2m_decode_uri(NULL, &reg);
+    uri = lwm2m_decode_uri(NULL, &reg, &uriStorage);
     CU_ASSERT_PTR_NOT_NULL_FATAL(uri);
     CU_ASSERT_EQUAL(uri->flag, LWM2M_URI_FLAG_REGISTRATION | LWM2M_URI_FLAG_OBJECT_ID);
     CU_ASSERT_EQUAL(uri->objectId, 5312);
-    lwm2m_free(uri);
 
     /* "/bs" */
-    uri = lwm2m_decode_uri(NULL, &boot);
+    uri = lwm2m_decode_uri(NULL, &boot, &uriStorage);
     CU_ASSERT_PTR_NOT_NULL_FATAL(uri);
     CU_ASSERT_EQUAL(uri->flag, LWM2M_URI_FLAG_BOOTSTRAP);
-    lwm2m_free(uri);
 
     /* "/bs/5a3f" */
     boot.next = &location;
-    uri = lwm2m_decode_uri(NULL, &boot);
+    uri = lwm2m_decode_uri(NULL, &boot, &uriStorage);
     CU_ASSERT_PTR_NULL(uri);
-    lwm2m_free(uri);
 
     /* "/9050/11/0" */
-    uri = lwm2m_decode_uri(NULL, &oID);
+    uri = lwm2m_decode_uri(NULL, &oID, &uriStorage);
     CU_ASSERT_PTR_NOT_NULL_FATAL(uri);
     CU_ASSERT_EQUAL(uri->flag, LWM2M_URI_FLAG_DM | LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID | LWM2M_URI_FLAG_RESOURCE_ID);
     CU_ASSERT_EQUAL(uri->objectId, 9050);
     CU_ASSERT_EQUAL(uri->instanceId, 11);
     CU_ASSERT_EQUAL(uri->resourceId, 0);
-    lwm2m_free(uri);
 
     /* "/11/0" */
-    uri = lwm2m_decode_uri(NULL, &iID);
+    uri = lwm2m_decode_uri(NULL, &iID, &uriStorage);
     CU_ASSERT_PTR_NOT_NULL_FATAL(uri);
     CU_ASSERT_EQUAL(uri->flag, LWM2M_URI_FLAG_DM | LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID);
     CU_ASSERT_EQUAL(uri->objectId, 11);
     CU_ASSERT_EQUAL(uri->instanceId, 0);
-    lwm2m_free(uri);
 
     /* "/0" */
-    uri = lwm2m_decode_uri(NULL, &rID);
+    uri = lwm2m_decode_uri(NULL, &rID, &uriStorage);
     CU_ASSERT_PTR_NOT_NULL_FATAL(uri);
     CU_ASSERT_EQUAL(uri->flag, LWM2M_URI_FLAG_DM | LWM2M_URI_FLAG_OBJECT_ID);
     CU_ASSERT_EQUAL(uri->objectId, 0);
-    lwm2m_free(uri);
 
     /* "/9050/11/0/555" */
     rID.next = &extraID;
-    uri = lwm2m_decode_uri(NULL, &oID);
+    uri = lwm2m_decode_uri(NULL, &oID, &uriStorage);
     CU_ASSERT_PTR_NULL(uri);
-    lwm2m_free(uri);
 
     /* "/0/5a3f" */
     rID.next = &location;
-    uri = lwm2m_decode_uri(NULL, &rID);
+    uri = lwm2m_decode_uri(NULL, &rID, &uriStorage);
     CU_ASSERT_PTR_NULL(uri);
-    lwm2m_free(uri);
 
     MEMORY_TRACE_AFTER_EQ;
 }
@@ -0,0 +1,247 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2015 Bosch Software Innovations GmbH, Germany.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Bosch Software Innovations GmbH - Please refer to git log
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "liblwm2m.h"
+#include "internals.h"
+#include "memtest.h"
+
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UTILS_ROUNDTRIP_ROUNDS  100000
+
+typedef struct
+{
+    double value;
+    const char * text;
+} float_text_t;
+
+static float_text_t floatTable[] = {
+        { 0.0, "0" },
+        { -0.0, "-0" },
+        { 1.0, "1" },
+        { -1.0, "-1" },
+        { 0.1, "0.1" },
+        { 0.3, "0.3" },
+        { 0.1 + 0.2, "0.30000000000000004" },
+        { 1.5, "1.5" },
+        { -12.375, "-12.375" },
+        { 3.14159, "3.14159" },
+        { 100.0, "100" },
+        { 123456789.0, "123456789" },
+        { 9007199254740992.0, "9007199254740992" },
+        { 1e21, "1e21" },
+        { 1e22, "1e22" },
+        { 1.5e300, "1.5e300" },
+        { 0.000001, "0.000001" },
+        { 0.0000001, "1e-7" },
+        { 1.2345e-7, "1.2345e-7" },
+        { 5e-324, "5e-324" },
+        { 2.2250738585072014e-308, "2.2250738585072014e-308" },
+        { DBL_MAX, "1.7976931348623157e308" },
+        { 1.8305252769034021e208, "1.830525276903402e208" },
+};
+
+typedef struct
+{
+    const char * text;
+    double value;
+} text_float_t;
+
+static text_float_t parseTable[] = {
+        { "0", 0.0 },
+        { "-0", -0.0 },
+        { "0.0", 0.0 },
+        { "1", 1.0 },
+        { "-2.5", -2.5 },
+        { ".5", 0.5 },
+        { "0.1", 0.1 },
+        { "000123.4500", 123.45 },
+        { "1e3", 1000.0 },
+        { "1E3", 1000.0 },
+        { "1e+3", 1000.0 },
+        { "25e-1", 2.5 },
+        { "1.7976931348623157e308", DBL_MAX },
+        { "4.9e-324", 5e-324 },
+        { "1e-400", 0.0 },
+        { "9007199254740993", 9007199254740992.0 },
+        { "9007199254740993.0000000000000000000001", 9007199254740994.0 },
+        { "2.22507385850720113605740979670913197593481954635164564e-308", 2.2250738585072009e-308 },
+        { "0.30000000000000004", 0.1 + 0.2 },
+};
+
+static const char * invalidTable[] = {
+        "",
+        "-",
+        ".",
+        "1.",
+        "1..2",
+        "1e",
+        "1e+",
+        "1x",
+        "--1",
+        "+1",
+        "1.7976931348623159e308",
+        "1e400",
+};
+
+static void test_float_to_text(void)
+{
+    size_t i;
+
+    for (i = 0 ; i < sizeof(floatTable) / sizeof(floatTable[0]) ; i++)
+    {
+        uint8_t buffer[32];
+        size_t length;
+
+        length = utils_floatToText(floatTable[i].value, buffer, sizeof(buffer));
+        CU_ASSERT_EQUAL(length, strlen(floatTable[i].text));
+        CU_ASSERT_NSTRING_EQUAL(buffer, floatTable[i].text, length);
+    }
+}
+
+static void test_int_to_text(void)
+{
+    MEMORY_TRACE_BEFORE;
+    uint8_t buffer[32];
+    uint8_t * textP;
+    size_t length;
+
+    length = utils_intToText(INT64_MIN, buffer, sizeof(buffer));
+    CU_ASSERT_EQUAL(length, 20);
+    CU_ASSERT_NSTRING_EQUAL(buffer, "-9223372036854775808", length);
+    length = utils_intToText(INT64_MAX, buffer, sizeof(buffer));
+    CU_ASSERT_EQUAL(length, 19);
+    CU_ASSERT_NSTRING_EQUAL(buffer, "9223372036854775807", length);
+    length = utils_intToText(0, buffer, sizeof(buffer));
+    CU_ASSERT_EQUAL(length, 1);
+    CU_ASSERT_NSTRING_EQUAL(buffer, "0", length);
+    CU_ASSERT_EQUAL(utils_intToText(123456, buffer, 5), 0);
+
+    length = lwm2m_int64ToPlainText(-42, &textP);
+    CU_ASSERT_EQUAL_FATAL(length, 3);
+    CU_ASSERT_NSTRING_EQUAL(textP, "-42", length);
+    lwm2m_free(textP);
+    length = lwm2m_float64ToPlainText(0.25, &textP);
+    CU_ASSERT_EQUAL_FATAL(length, 4);
+    CU_ASSERT_NSTRING_EQUAL(textP, "0.25", length);
+    lwm2m_free(textP);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_text_to_float(void)
+{
+    size_t i;
+
+    for (i = 0 ; i < sizeof(parseTable) / sizeof(parseTable[0]) ; i++)
+    {
+        double value;
+
+        CU_ASSERT_EQUAL_FATAL(lwm2m_PlainTextToFloat64((uint8_t *)parseTable[i].text, strlen(parseTable[i].text), &value), 1);
+        CU_ASSERT(0 == memcmp(&value, &parseTable[i].value, sizeof(value)));
+    }
+    for (i = 0 ; i < sizeof(invalidTable) / sizeof(invalidTable[0]) ; i++)
+    {
+        double value;
+
+        CU_ASSERT_EQUAL(lwm2m_PlainTextToFloat64((uint8_t *)invalidTable[i], strlen(invalidTable[i]), &value), 0);
+    }
+}
+
+static void test_float_roundtrip(void)
+{
+    uint64_t state;
+    int failures;
+    int i;
+
+    state = 0x2545F4914F6CDD1DULL;
+    failures = 0;
+    for (i = 0 ; i < UTILS_ROUNDTRIP_ROUNDS ; i++)
+    {
+        uint8_t buffer[32];
+        char reference[32];
+        uint64_t bits;
+        double value;
+        double result;
+        size_t length;
+
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        bits = state;
+        memcpy(&value, &bits, sizeof(value));
+        if (value != value || value > DBL_MAX || value < -DBL_MAX) continue;
+
+        length = utils_floatToText(value, buffer, sizeof(buffer));
+        if (length == 0
+         || 1 != lwm2m_PlainTextToFloat64(buffer, length, &result)
+         || 0 != memcmp(&value, &result, sizeof(value)))
+        {
+            failures++;
+            continue;
+        }
+        // the output has no more digits than the shortest "%g" reading back as value
+        {
+            int precision;
+            size_t digits;
+            size_t j;
+
+            for (precision = 1 ; precision < 17 ; precision++)
+            {
+                snprintf(reference, sizeof(reference), "%.*g", precision, value);
+                if (strtod(reference, NULL) == value) break;
+            }
+            digits = 0;
+            for (j = 0 ; j < length && buffer[j] != 'e' ; j++)
+            {
+                if ('0' <= buffer[j] && buffer[j] <= '9' && (digits != 0 || buffer[j] != '0')) digits++;
+            }
+            while (j > 0 && (buffer[j - 1] == '0' || buffer[j - 1] == '.') && digits > 1)
+            {
+                if (buffer[j - 1] == '0') digits--;
+                j--;
+            }
+            if (digits > (size_t)precision) failures++;
+        }
+    }
+    CU_ASSERT_EQUAL(failures, 0);
+}
+
+static struct TestTable table[] = {
+        { "test of utils_floatToText()", test_float_to_text },
+        { "test of utils_intToText()", test_int_to_text },
+        { "test of lwm2m_PlainTextToFloat64()", test_text_to_float },
+        { "test of utils_floatToText() round trip", test_float_roundtrip },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_utils_suit()
+{
+   CU_pSuite pSuite = NULL;
+
+   pSuite = CU_add_suite("Suite_utils", NULL, NULL);
+   if (NULL == pSuite) {
+      return CU_get_error();
+   }
+
+   return add_tests(pSuite, table);
+}
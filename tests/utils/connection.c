@@ -26,6 +26,8 @@ int connection_init(void)
 #ifdef _WIN32
     WSADATA wsa;
     return WSAStartup(0x202, &wsa);
+#else
+    return 0;
 #endif
 }
 
@@ -0,0 +1,433 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2015 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - initial API and implementation
+ *
+ *******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include "internals.h"
+#include "connection.h"
+#include "shardengine.h"
+
+#define MAX_PACKET_SIZE 1024
+
+typedef struct _shard_node_t
+{
+    _Atomic(struct _shard_node_t *) next;
+} shard_node_t;
+
+// An item is either a received datagram or a job, when job is not NULL.
+typedef struct
+{
+    shard_node_t                    node;
+    shard_job_t                     job;
+    void *                          userData;
+    struct sockaddr_storage         addr;
+    socklen_t                       addrLen;
+    size_t                          length;
+    uint8_t                         data[];
+} shard_item_t;
+
+/*
+ * Intrusive multiple-producer single-consumer queue, after Dmitry Vyukov's design:
+ * producers only swap the head, the shard thread alone walks from the tail.
+ */
+typedef struct
+{
+    _Atomic(shard_node_t *) head;
+    shard_node_t *          tail;
+    shard_node_t            stub;
+} shard_queue_t;
+
+typedef struct
+{
+    shard_engine_t *    engineP;
+    int                 index;
+    pthread_t           thread;
+    lwm2m_context_t *   contextP;
+    connection_t *      connList;
+    shard_queue_t       queue;
+    atomic_int          signaled;
+    int                 wakeFd[2];
+} shard_t;
+
+struct _shard_engine_t
+{
+    int         sock;
+    int         shardCount;
+    shard_t *   shards;
+    pthread_t   dispatcher;
+    atomic_int  stop;
+    int         stopFd[2];
+};
+
+static void prv_queue_init(shard_queue_t * queueP)
+{
+    atomic_init(&queueP->stub.next, NULL);
+    atomic_init(&queueP->head, &queueP->stub);
+    queueP->tail = &queueP->stub;
+}
+
+static void prv_queue_push(shard_queue_t * queueP,
+                           shard_node_t * nodeP)
+{
+    shard_node_t * prevP;
+
+    atomic_store_explicit(&nodeP->next, NULL, memory_order_relaxed);
+    prevP = atomic_exchange_explicit(&queueP->head, nodeP, memory_order_acq_rel);
+    atomic_store_explicit(&prevP->next, nodeP, memory_order_release);
+}
+
+// Returns NULL when the queue is empty or when a producer is between its two steps.
+// In the latter case, the producer wakes the shard up again once done.
+static shard_item_t * prv_queue_pop(shard_queue_t * queueP)
+{
+    shard_node_t * tailP = queueP->tail;
+    shard_node_t * nextP = atomic_load_explicit(&tailP->next, memory_order_acquire);
+
+    if (tailP == &queueP->stub)
+    {
+        if (NULL == nextP) return NULL;
+        queueP->tail = nextP;
+        tailP = nextP;
+        nextP = atomic_load_explicit(&tailP->next, memory_order_acquire);
+    }
+    if (NULL != nextP)
+    {
+        queueP->tail = nextP;
+        return (shard_item_t *)tailP;
+    }
+    if (tailP != atomic_load_explicit(&queueP->head, memory_order_acquire)) return NULL;
+
+    prv_queue_push(queueP, &queueP->stub);
+    nextP = atomic_load_explicit(&tailP->next, memory_order_acquire);
+    if (NULL != nextP)
+    {
+        queueP->tail = nextP;
+        return (shard_item_t *)tailP;
+    }
+
+    return NULL;
+}
+
+static int prv_pipe(int fd[2])
+{
+    if (0 != pipe(fd)) return -1;
+    fcntl(fd[0], F_SETFL, O_NONBLOCK);
+    fcntl(fd[1], F_SETFL, O_NONBLOCK);
+    return 0;
+}
+
+static void prv_drain_pipe(int fd)
+{
+    uint8_t buffer[64];
+
+    while (read(fd, buffer, sizeof(buffer)) > 0);
+}
+
+static void prv_wake(shard_t * shardP)
+{
+    // only the first producer since the shard last looked at its queue writes to the pipe
+    if (0 == atomic_exchange(&shardP->signaled, 1))
+    {
+        if (write(shardP->wakeFd[1], "", 1) < 0)
+        {
+            // the pipe is full, the shard is awake anyway
+        }
+    }
+}
+
+// Server contexts never connect on their own.
+static void * prv_connect(uint16_t secObjInstID,
+                          void * userData)
+{
+    (void)secObjInstID;
+    (void)userData;
+
+    return NULL;
+}
+
+static uint8_t prv_buffer_send(void * sessionH,
+                               uint8_t * buffer,
+                               size_t length,
+                               void * userData)
+{
+    connection_t * connP = (connection_t *)sessionH;
+
+    (void)userData;
+
+    if (-1 == connection_send(connP, buffer, length))
+    {
+        return COAP_500_INTERNAL_SERVER_ERROR;
+    }
+    return COAP_NO_ERROR;
+}
+
+static void prv_handle_item(shard_t * shardP,
+                            shard_item_t * itemP)
+{
+    connection_t * connP;
+
+    if (NULL != itemP->job)
+    {
+        itemP->job(shardP->contextP, shardP->index, itemP->userData);
+        return;
+    }
+
+    connP = connection_find(shardP->connList, &itemP->addr, itemP->addrLen);
+    if (NULL == connP)
+    {
+        connP = connection_new_incoming(shardP->connList, shardP->engineP->sock, (struct sockaddr *)&itemP->addr, itemP->addrLen);
+        if (NULL == connP) return;
+        shardP->connList = connP;
+    }
+    lwm2m_handle_packet(shardP->contextP, itemP->data, (int)itemP->length, connP);
+}
+
+static void prv_handle_queue(shard_t * shardP)
+{
+    shard_item_t * itemP;
+
+    while (NULL != (itemP = prv_queue_pop(&shardP->queue)))
+    {
+        prv_handle_item(shardP, itemP);
+        free(itemP);
+    }
+}
+
+static void * prv_shard_thread(void * arg)
+{
+    shard_t * shardP = (shard_t *)arg;
+
+    while (0 == atomic_load(&shardP->engineP->stop))
+    {
+        struct pollfd pfd;
+        int64_t timeout;
+
+        timeout = 60000;
+        lwm2m_step(shardP->contextP, &timeout);
+
+        pfd.fd = shardP->wakeFd[0];
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, (int)timeout) > 0)
+        {
+            prv_drain_pipe(shardP->wakeFd[0]);
+        }
+        atomic_store(&shardP->signaled, 0);
+
+        prv_handle_queue(shardP);
+    }
+    prv_handle_queue(shardP);
+
+    return NULL;
+}
+
+// Source addresses are hashed so that all the datagrams of a client reach the same shard.
+static int prv_route(shard_engine_t * engineP,
+                     struct sockaddr_storage * addr,
+                     socklen_t addrLen)
+{
+    return (int)(utils_hash((const uint8_t *)addr, addrLen) % (size_t)engineP->shardCount);
+}
+
+static void * prv_dispatcher_thread(void * arg)
+{
+    shard_engine_t * engineP = (shard_engine_t *)arg;
+    uint8_t buffer[MAX_PACKET_SIZE];
+
+    while (0 == atomic_load(&engineP->stop))
+    {
+        struct pollfd pfd[2];
+
+        pfd[0].fd = engineP->sock;
+        pfd[0].events = POLLIN;
+        pfd[1].fd = engineP->stopFd[0];
+        pfd[1].events = POLLIN;
+        if (poll(pfd, 2, -1) <= 0) continue;
+
+        if (pfd[0].revents & POLLIN)
+        {
+            struct sockaddr_storage addr;
+            socklen_t addrLen;
+            shard_item_t * itemP;
+            int numBytes;
+            int index;
+
+            addrLen = sizeof(addr);
+            numBytes = recvfrom(engineP->sock, buffer, MAX_PACKET_SIZE, 0, (struct sockaddr *)&addr, &addrLen);
+            if (numBytes <= 0) continue;
+
+            itemP = (shard_item_t *)malloc(sizeof(shard_item_t) + numBytes);
+            if (NULL == itemP) continue;
+            itemP->job = NULL;
+            memcpy(&itemP->addr, &addr, addrLen);
+            itemP->addrLen = addrLen;
+            itemP->length = numBytes;
+            memcpy(itemP->data, buffer, numBytes);
+
+            index = prv_route(engineP, &addr, addrLen);
+            prv_queue_push(&engineP->shards[index].queue, &itemP->node);
+            prv_wake(engineP->shards + index);
+        }
+    }
+
+    return NULL;
+}
+
+static void prv_close_shard(shard_t * shardP)
+{
+    if (NULL != shardP->contextP) lwm2m_close(shardP->contextP);
+    connection_free(shardP->connList);
+    if (shardP->wakeFd[0] >= 0) close(shardP->wakeFd[0]);
+    if (shardP->wakeFd[1] >= 0) close(shardP->wakeFd[1]);
+}
+
+shard_engine_t * shard_engine_new(int sock,
+                                  int shardCount,
+                                  shard_job_t initFunc,
+                                  void * userData)
+{
+    shard_engine_t * engineP;
+    sigset_t blocked;
+    sigset_t previous;
+    int started;
+    int i;
+
+    if (shardCount <= 0) return NULL;
+
+    engineP = (shard_engine_t *)malloc(sizeof(shard_engine_t));
+    if (NULL == engineP) return NULL;
+    memset(engineP, 0, sizeof(shard_engine_t));
+    engineP->sock = sock;
+    engineP->shardCount = shardCount;
+    atomic_init(&engineP->stop, 0);
+
+    engineP->shards = (shard_t *)malloc(shardCount * sizeof(shard_t));
+    if (NULL == engineP->shards || 0 != prv_pipe(engineP->stopFd))
+    {
+        free(engineP->shards);
+        free(engineP);
+        return NULL;
+    }
+    memset(engineP->shards, 0, shardCount * sizeof(shard_t));
+
+    for (i = 0; i < shardCount; i++)
+    {
+        shard_t * shardP = engineP->shards + i;
+
+        shardP->engineP = engineP;
+        shardP->index = i;
+        prv_queue_init(&shardP->queue);
+        atomic_init(&shardP->signaled, 0);
+        shardP->wakeFd[0] = shardP->wakeFd[1] = -1;
+        shardP->contextP = lwm2m_init(prv_connect, prv_buffer_send, NULL);
+        if (NULL == shardP->contextP || 0 != prv_pipe(shardP->wakeFd)) break;
+        if (NULL != initFunc) initFunc(shardP->contextP, i, userData);
+    }
+
+    // signals are left to the calling thread
+    sigfillset(&blocked);
+    pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+    started = 0;
+    if (i == shardCount)
+    {
+        while (started < shardCount
+            && 0 == pthread_create(&engineP->shards[started].thread, NULL, prv_shard_thread, engineP->shards + started))
+        {
+            started++;
+        }
+    }
+    if (started == shardCount
+     && 0 == pthread_create(&engineP->dispatcher, NULL, prv_dispatcher_thread, engineP))
+    {
+        pthread_sigmask(SIG_SETMASK, &previous, NULL);
+        return engineP;
+    }
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+    atomic_store(&engineP->stop, 1);
+    for (i = 0; i < started; i++)
+    {
+        prv_wake(engineP->shards + i);
+        pthread_join(engineP->shards[i].thread, NULL);
+    }
+    for (i = 0; i < shardCount; i++)
+    {
+        prv_close_shard(engineP->shards + i);
+    }
+    close(engineP->stopFd[0]);
+    close(engineP->stopFd[1]);
+    free(engineP->shards);
+    free(engineP);
+
+    return NULL;
+}
+
+void shard_engine_free(shard_engine_t * engineP)
+{
+    int i;
+
+    atomic_store(&engineP->stop, 1);
+    if (write(engineP->stopFd[1], "", 1) < 0)
+    {
+        // the pipe is full, the dispatcher is awake anyway
+    }
+    pthread_join(engineP->dispatcher, NULL);
+
+    for (i = 0; i < engineP->shardCount; i++)
+    {
+        prv_wake(engineP->shards + i);
+        pthread_join(engineP->shards[i].thread, NULL);
+        prv_close_shard(engineP->shards + i);
+    }
+
+    close(engineP->stopFd[0]);
+    close(engineP->stopFd[1]);
+    free(engineP->shards);
+    free(engineP);
+}
+
+int shard_engine_count(shard_engine_t * engineP)
+{
+    return engineP->shardCount;
+}
+
+int shard_engine_submit(shard_engine_t * engineP,
+                        int shardIndex,
+                        shard_job_t job,
+                        void * userData)
+{
+    shard_item_t * itemP;
+
+    if (shardIndex < 0 || shardIndex >= engineP->shardCount || NULL == job) return -1;
+    if (0 != atomic_load(&engineP->stop)) return -1;
+
+    itemP = (shard_item_t *)malloc(sizeof(shard_item_t));
+    if (NULL == itemP) return -1;
+    itemP->job = job;
+    itemP->userData = userData;
+
+    prv_queue_push(&engineP->shards[shardIndex].queue, &itemP->node);
+    prv_wake(engineP->shards + shardIndex);
+
+    return 0;
+}
@@ -0,0 +1,48 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2015 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    David Navarro, Intel Corporation - initial API and implementation
+ *
+ *******************************************************************************/
+
+/*
+ * Multi-threaded LWM2M server engine (POSIX only).
+ *
+ * Clients are spread over several shards, each one owning a lwm2m_context_t with its
+ * client list, transactions and observations, and running in its own thread. A
+ * dispatcher thread reads the shared UDP socket and routes each datagram to the shard
+ * owning its source address. Other threads act on a shard through shard_engine_submit().
+ */
+
+#ifndef SHARDENGINE_H_
+#define SHARDENGINE_H_
+
+#include "liblwm2m.h"
+
+typedef struct _shard_engine_t shard_engine_t;
+
+// A function run on the context of the shard shardIndex.
+typedef void (*shard_job_t)(lwm2m_context_t * contextP, int shardIndex, void * userData);
+
+// Creates shardCount server contexts sharing the bound UDP socket sock and starts their threads.
+// initFunc, if not NULL, is called for each context before the threads start.
+shard_engine_t * shard_engine_new(int sock, int shardCount, shard_job_t initFunc, void * userData);
+// Stops the threads after they ran the jobs already submitted, and closes the contexts.
+void shard_engine_free(shard_engine_t * engineP);
+
+int shard_engine_count(shard_engine_t * engineP);
+// Queues a job to run in the thread of the shard shardIndex. Can be called from any thread
+// until shard_engine_free(). Returns 0 on success.
+int shard_engine_submit(shard_engine_t * engineP, int shardIndex, shard_job_t job, void * userData);
+
+#endif